@@ -0,0 +1,29 @@
+#include "../parser.hpp"
+
+#include <cstddef>
+#include <ostream>
+#include <stdint.h>
+#include <vector>
+
+/* libFuzzer entry point, parses one input.
+ * The parser and input buffer are reused across iterations so that each run
+ * only pays for parsing: parse() resets the parser's node pool and line table.
+ */
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, std::size_t size)
+{
+	static Parser parser;
+	static std::vector<char> input;
+
+	// output is discarded, but the tokens are still read while printing them
+	static std::ostream sink(NULL);
+
+	// the parser expects a null-terminated string
+	input.assign(data, data + size);
+	input.push_back('\0');
+
+	parser.parse(&input[0]);
+
+	parser.printErrors(sink);
+
+	return 0;
+}
@@ -0,0 +1,138 @@
+#include "parser.hpp"
+#include "stats.hpp"
+#include "timer.hpp"
+#include "util.hpp"
+
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+void printUsage(std::ostream& outputStream, char *programName)
+{
+	outputStream << "Usage: " << programName << " [--time-report] [--time-trace FILE] [--stats FILE] [--error-limit N] [FILE]" << std::endl;
+}
+
+int main(int argc, char **argv)
+{
+	TimeReport timing;
+	bool timeReport = false;
+	const char *timeTrace = NULL;
+	const char *statsFile = NULL;
+	const char *fname = NULL;
+	int files = 0;
+	std::size_t errorLimit = PARSER_ERROR_LIMIT;
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (!strcmp(argv[i], "--time-report"))
+		{
+			timeReport = true;
+		}
+		else if (!strcmp(argv[i], "--time-trace") && i + 1 < argc)
+		{
+			timeTrace = argv[++i];
+			timing.tracing = true;
+		}
+		else if (!strcmp(argv[i], "--stats") && i + 1 < argc)
+		{
+			statsFile = argv[++i];
+#ifndef PARSER_STATS
+			std::cerr << "--stats: counting is not compiled in, rebuild with make STATS=1" << std::endl;
+			statsFile = NULL;
+#endif
+		}
+		else if (!strcmp(argv[i], "--error-limit") && i + 1 < argc)
+		{
+			errorLimit = strtoul(argv[++i], NULL, 10);
+		}
+		else
+		{
+			fname = argv[i];
+			files++;
+		}
+	}
+
+	if (files > 1)
+	{
+		printUsage(std::cerr, argv[0]);
+	}
+
+	// only count time if it is reported
+	TimeReport *report = timeReport || timeTrace ? &timing : NULL;
+	char *input;
+
+	// check if input was piped into the program via stdin
+	bool useStdin = !isatty(STDIN_FILENO);
+	if (useStdin)
+	{
+		// check if the user also specified an input file
+		if (files == 1)
+		{
+			std::cerr << "Detected input from stdin, ignoring file: \"" << fname << "\"" << std::endl;
+		}
+		timing.file = "-";
+	}
+	else if (files == 1)
+	{
+		timing.file = fname;
+	}
+	else
+	{
+		printUsage(std::cerr, argv[0]);
+		std::cerr << "No input from stdin, and no file specified, exiting..." << std::endl;
+		return 1;
+	}
+
+	{
+		PhaseTimer timer(report, ReadInput);
+		input = useStdin ? util::readStdin() : util::readFile(fname);
+	}
+
+	if (input == NULL)
+	{
+		std::cerr << "Failed to retrieve input, exiting..." << std::endl;
+		return 1;
+	}
+
+	Parser parser;
+	parser.timing = report;
+	parser.errorLimit = errorLimit;
+	{
+		PhaseTimer timer(report, Parse);
+		parser.parse(input);
+	}
+
+	{
+		PhaseTimer timer(report, Print);
+		const std::vector<ParserError> &errors = parser.getErrors();
+		if (errors.empty())
+		{
+			parser.printAst();
+			std::cout << "OK" << std::endl;
+		}
+
+		// report the errors found in the input
+		parser.printErrors(std::cerr);
+	}
+
+	if (timeReport)
+	{
+		timing.print(std::cerr);
+	}
+	if (timeTrace && timing.writeTrace(timeTrace))
+	{
+		std::cerr << timeTrace << ": " << strerror(errno) << std::endl;
+	}
+	if (statsFile && lexStats.write(statsFile))
+	{
+		std::cerr << statsFile << ": " << strerror(errno) << std::endl;
+	}
+
+	// cast to void * to remove const
+	free(input);
+	return 0;
+}
@@ -1,14 +1,13 @@
 #include "parser.hpp"
-#include "util.hpp"
-
-#include <unistd.h>
 
 #include <cstddef>
-#include <cstdio>
-#include <cstdlib>
 #include <cstring>
 #include <iostream>
 
+#include "perfect_hash.hpp"
+#include "scan.hpp"
+#include "stats.hpp"
+
 AstNode::AstNode()
 {
   type = AstUndefined;
@@ -21,87 +20,83 @@ AstNode::AstNode(AstNodeType t)
   tok.type = Undefined;
 }
 
-
-AstNode::~AstNode()
-{
-	for(std::vector<AstNode *>::size_type i = 0; i != children.size(); i++)
-	{
-		delete children[i];
-	}
-}
-
 void AstNode::addChild(AstNode *node)
 {
 	children.push_back(node);
 }
 
-const std::map<const char *, TokenType> Parser::keywords = createKeywordMap();
-const std::map<const char *, TokenType> Parser::operators = createOperatorMap();
-
-/* Map operator strings to their associated token type */
-const std::map<const char *, TokenType> Parser::createKeywordMap()
+AstVisitor::~AstVisitor()
 {
-	std::map<const char *, TokenType> tm;
-
-	tm["("] = OpenBracket;
-	tm[")"] = CloseBracket;
-
-	return tm;
 }
 
-/* Map keyword strings to their associated token type */
-const std::map<const char *, TokenType> Parser::createOperatorMap()
+void AstVisitor::leave(const AstNode *, int)
 {
-	std::map<const char *, TokenType> tm;
-
-	tm["package"] = Package;
-	tm["import"] = Import;
-
-	return tm;
 }
 
-/* Parses the token at input as a keyword defined by str.
- * Returns the length of the token if parsing was successful, 0 otherwise.
- */
-std::size_t Parser::parseKeyword(const char *input, const char *str)
+/* a node on the path walked by walkAst, and the index of its next child to visit */
+struct WalkFrame
 {
-	std::size_t i = 0;
-	while (input[i] && str[i])
+	const AstNode *node;
+	std::vector<AstNode *>::size_type next;
+};
+
+void walkAst(const AstNode *root, AstVisitor &visitor)
+{
+	std::vector<WalkFrame> path;
+	WalkFrame frame = {root, 0};
+
+	if (!root)
 	{
-		if (input[i] != str[i])
-		{
-			break;
-		}
-		i++;
+		return;
 	}
-	if (i == strlen(str) && !isalpha(input[i]))
+	if (!visitor.enter(root, 0))
 	{
-		return i;
+		visitor.leave(root, 0);
+		return;
 	}
-	return 0;
-}
+	path.push_back(frame);
 
-/* Parses the token at input as an operator defined by str.
- * Returns the length of the token if parsing was successful, 0 otherwise.
- */
-std::size_t Parser::parseOperator(const char *input, const char *str)
-{
-	std::size_t i = 0;
-	while (input[i] && str[i])
+	while (!path.empty())
 	{
-		if (input[i] != str[i])
+		WalkFrame &top = path.back();
+		if (top.next == top.node->children.size())
 		{
-			break;
+			const AstNode *node = top.node;
+			path.pop_back();
+			visitor.leave(node, path.size());
+			continue;
+		}
+
+		const AstNode *child = top.node->children[top.next++];
+		if (!child)
+		{
+			continue;
+		}
+		if (visitor.enter(child, path.size()))
+		{
+			frame.node = child;
+			path.push_back(frame);
+		}
+		else
+		{
+			visitor.leave(child, path.size());
 		}
-		i++;
-	}
-	if (i == strlen(str))
-	{
-		return i;
 	}
-	return 0;
 }
 
+/* Keywords and operators, which the scanner looks up once it has found the end of
+ * an identifier, or for any other single byte
+ */
+static const Keyword words[] =
+{
+	{"package", Package},
+	{"import", Import},
+	{"(", OpenBracket},
+	{")", CloseBracket}
+};
+
+static PERFECT_HASH_CONSTEXPR const PerfectHash<sizeof(words) / sizeof(words[0])> wordTable(words);
+
 /* Parses the token at input as a string literal.
  * Returns the length of the token if parsing was successful, 0 otherwise.
  */
@@ -115,16 +110,19 @@ std::size_t Parser::parseStringLiteral(const char *input)
 		{
 			if (input[i] == '"')
 			{
-				if (input[i - 1] != '\\')
-				{
-					i++;
-					break;
-				}
+				return i + 1;
+			}
+			if (input[i] == '\\' && input[i + 1] && input[i + 1] != '\n')
+			{
+				// skip the escaped character
+				i++;
 			}
 			i++;
 		}
 	}
-	return i;
+
+	// no closing quote before the end of the line
+	return 0;
 }
 
 /* Parses the token at input as an identifier.
@@ -133,13 +131,9 @@ std::size_t Parser::parseStringLiteral(const char *input)
 std::size_t Parser::parseIdentifier(const char *input)
 {
 	std::size_t i = 0;
-	if (isalpha(input[i]))
+	if (isalpha((unsigned char) input[i]))
 	{
-		i++;
-		while (isalnum(input[i]))
-		{
-			i++;
-		}
+		i = scan::skipClass(input + 1, end, scan::alnum) - input;
 	}
 	return i;
 }
@@ -147,61 +141,55 @@ std::size_t Parser::parseIdentifier(const char *input)
 /* Returns 1 if the next token was parsed successfully, 0 otherwise */
 int Parser::parseNextToken()
 {
+	PhaseTimer timer(timing, Lex);
 	std::size_t len;
 
-	// skip whitespace
-	while (isspace(*input))
+	// skip whitespace and comments
+	for (;;)
 	{
-		if (*input == '\n')
+		if (isspace((unsigned char) *input))
 		{
-			// let the parser know we've reached a new line
-			newLine(input);
+			STATS_BLANK(*input);
+			if (*input == '\n')
+			{
+				// let the parser know we've reached a new line
+				newLine(input);
+			}
+			input++;
 		}
-		input++;
-	}
-
-	// skip comments
-	while (*input == '/')
-	{
-		switch (*(input + 1))
+		else if (input[0] == '/' && input[1] == '/')
 		{
-			case '/':
-				// single line comment
+			// single line comment, the '\n' is skipped as whitespace
+			const char *comment = input;
+			while (*input && *input != '\n')
+			{
 				input++;
-				while (*input && *input != '\n')
-				{
-					input++;
-				}
+			}
+			STATS_COMMENT(comment, input);
+		}
+		else if (input[0] == '/' && input[1] == '*')
+		{
+			// multi-line comment
+			const char *comment = input;
+			input += 2;
+			while (*input && !(input[0] == '*' && input[1] == '/'))
+			{
 				if (*input == '\n')
 				{
 					// let the parser know we've reached a new line
 					newLine(input);
 				}
-				break;
-			case '*':
-				// multi-line comment
 				input++;
-				while (*input)
-				{
-					if (*input == '\n')
-					{
-						// let the parser know we've reached a new line
-						newLine(input);
-					}
-
-					if (*input == '*')
-					{
-						input++;
-						if (*input == '/')
-						{
-							input++;
-							break;
-						}
-					}
-
-					input++;
-				}
-				break;
+			}
+			if (*input)
+			{
+				input += 2;
+			}
+			STATS_COMMENT(comment, input);
+		}
+		else
+		{
+			break;
 		}
 	}
 
@@ -217,6 +205,8 @@ int Parser::parseNextToken()
 	switch (*input)
 	{
 		case '\0':
+			// the end of input has no length, so it is never stepped over
+			len = 0;
 			currentToken.type = EndOfFile;
 			break;
 		case '"':
@@ -227,45 +217,23 @@ int Parser::parseNextToken()
 			}
 			break;
 		default:
-			currentToken.type = Undefined;
-	}
-
-	// check if token value matches a keyword
-	if (currentToken.type == Undefined)
-	{
-		for (iter = keywords.begin(); iter != keywords.end(); iter++)
-		{
-			len = parseKeyword(input, iter->first);
+			// an identifier is a keyword if the whole of it is one, and any other
+			// byte is looked up as an operator, which are all one byte long
+			len = parseIdentifier(input);
 			if (len)
 			{
-				currentToken.type = iter->second;
-				break;
+				const Keyword *word = wordTable.find(input, len);
+				currentToken.type = word ? word->type : Identifier;
 			}
-		}
-	}
-
-	// check if token value matches an operator
-	if (currentToken.type == Undefined)
-	{
-		for (iter = operators.begin(); iter != operators.end(); iter++)
-		{
-			len = parseOperator(input, iter->first);
-			if (len)
+			else
 			{
-				currentToken.type = iter->second;
-				break;
+				const Keyword *word = wordTable.find(input, 1);
+				if (word)
+				{
+					len = 1;
+					currentToken.type = word->type;
+				}
 			}
-		}
-	}
-
-	// if token is still undefined, check if it could be an identifier
-	if (currentToken.type == Undefined)
-	{
-		len = parseIdentifier(input);
-		if (len)
-		{
-			currentToken.type = Identifier;
-		}
 	}
 
 	// if token is no longer undefined type
@@ -277,12 +245,13 @@ int Parser::parseNextToken()
 		// move the input pointer past the current token
 		input += currentToken.length;
 
+		STATS_TOKEN(currentToken.type, len);
 		return 1;
 	}
 
-	// token is still undefined, so we throw an exception
-	throw ParserException(currentToken);
-    return 0;
+	// token is still undefined, the caller decides how to report it
+	STATS_TOKEN(Undefined, currentToken.length);
+	return 0;
 }
 
 /* Called by the parser when it encounters '\n' during tokenisation
@@ -306,39 +275,105 @@ void Parser::printToken(std::ostream &out, Token tok)
 
 	while (ch < end)
 	{
-		if (isprint(*ch))
+		if (isprint((unsigned char) *ch))
 		{
 			out << *ch;
 		}
 		else
 		{
-			out << std::hex << *ch;
+			out << "\\x" << std::hex << (int) (unsigned char) *ch << std::dec;
 		}
 
 		ch++;
 	}
 }
 
+/* Returns a new node owned by this parser.
+ * std::deque never moves its elements when growing, so the pointer stays valid
+ * until the parser is reset by the next call to parse, or destroyed.
+ */
+AstNode * Parser::newNode(AstNodeType t)
+{
+	nodes.push_back(AstNode(t));
+	return &nodes.back();
+}
+
+/* Records an unexpected token error at the current token.
+ * Always returns NULL, so that productions can return its result to signal failure.
+ */
+AstNode * Parser::unexpectedToken()
+{
+	if (!errors.empty() && errors.back().getToken().line == currentToken.line
+		&& errors.back().getToken().column == currentToken.column)
+	{
+		// already reported
+	}
+	else if (errorLimit && errors.size() >= errorLimit)
+	{
+		droppedErrors++;
+	}
+	else
+	{
+		errors.push_back(ParserError(currentToken));
+	}
+	return NULL;
+}
+
+/* Discards tokens until one that can start a new statement, so that parsing
+ * can continue and later errors are also reported.
+ * Parsing resumes at the next import keyword, the first token on a later line
+ * than the offending token, or the end of input.
+ */
+void Parser::recover()
+{
+	std::size_t line = currentToken.line;
+
+	while (currentToken.type != Import && currentToken.type != EndOfFile)
+	{
+		if (currentToken.type == Undefined)
+		{
+			// step over the unrecognised character
+			input += currentToken.length;
+		}
+
+		// unrecognised characters are not reported while recovering
+		if (parseNextToken() && currentToken.line != line)
+		{
+			break;
+		}
+	}
+}
+
 /* functions that represent our grammar productions */
 AstNode * Parser::buildAst()
 {
-	AstNode *node = new AstNode(AstRoot);
+	AstNode *node = newNode(AstRoot);
+	AstNode *pkgStmtNode;
 
-	parseNextToken();
-	node->addChild(packageStatement());
+	pkgStmtNode = parseNextToken() ? packageStatement() : unexpectedToken();
+	if (pkgStmtNode)
+	{
+		node->addChild(pkgStmtNode);
+	}
+	else
+	{
+		recover();
+	}
 	node->addChild(importStatements());
 
 	return node;
 }
 
-int Parser::printAst(AstNode *node, int indent)
+/* Prints each node of the tree on its own line, indented by its depth */
+class AstPrinter : public AstVisitor
 {
-	if (!node)
-	{
-		return 0;
-	}
+public:
+	bool enter(const AstNode *node, int depth);
+};
 
-	for (int i = 0; i < indent; i++)
+bool AstPrinter::enter(const AstNode *node, int depth)
+{
+	for (int i = 0; i < depth; i++)
 	{
 		std::cout << "\t";
 	}
@@ -378,13 +413,7 @@ int Parser::printAst(AstNode *node, int indent)
 	}
 	std::cout << std::endl;
 
-	for(std::vector<int>::size_type i = 0; i != node->children.size(); i++)
-	{
-		printAst(node->children[i], indent + 1);
-	}
-
-
-	return 1;
+	return true;
 }
 
 AstNode * Parser::packageStatement()
@@ -394,58 +423,91 @@ AstNode * Parser::packageStatement()
 
 	if (currentToken.type != Package)
 	{
-		throw ParserException(currentToken);
+		return unexpectedToken();
 	}
-	pkgNode = new AstNode(AstPackage);
-	parseNextToken();
-	if (currentToken.type != Identifier)
+	pkgNode = newNode(AstPackage);
+	if (!parseNextToken() || currentToken.type != Identifier)
 	{
-		throw ParserException(currentToken);
+		return unexpectedToken();
+	}
+	strLitNode = newNode(AstStringLiteral);
+	if (!parseNextToken())
+	{
+		return unexpectedToken();
 	}
-	strLitNode = new AstNode(AstStringLiteral);
-	parseNextToken();
 
-	AstNode *node = new AstNode(AstPackageStatement);
+	AstNode *node = newNode(AstPackageStatement);
 	node->addChild(pkgNode);
 	node->addChild(strLitNode);
 
 	return node;
 }
 
+/* Parses import statements up to the end of input, and returns the last one */
 AstNode * Parser::importStatements()
 {
 	AstNode *impStmtNode;
-	impStmtNode = importStatement();
-	if (currentToken.type != EndOfFile)
+
+	do
 	{
-		return importStatements();
+		impStmtNode = importStatement();
+		if (!impStmtNode)
+		{
+			recover();
+		}
 	}
+	while (currentToken.type != EndOfFile);
+
 	return impStmtNode;
 }
 
 AstNode * Parser::importStatement()
 {
-	AstNode *node = new AstNode(AstImportStatement);
-	node->addChild(new AstNode(AstImport));
-	parseNextToken();
+	AstNode *impNode;
+
+	if (currentToken.type != Import)
+	{
+		return unexpectedToken();
+	}
+
+	AstNode *node = newNode(AstImportStatement);
+	node->addChild(newNode(AstImport));
+	if (!parseNextToken())
+	{
+		return unexpectedToken();
+	}
 
 	switch (currentToken.type)
 	{
 		case Identifier:
 			// fall through
 		case StringLiteral:
-			node->addChild(imports());
+			if (!(impNode = imports()))
+			{
+				return NULL;
+			}
+			node->addChild(impNode);
 			break;
 		case OpenBracket:
 			while (currentToken.type != CloseBracket)
 			{
-				parseNextToken();
-				node->addChild(imports());
+				if (!parseNextToken())
+				{
+					return unexpectedToken();
+				}
+				if (!(impNode = imports()))
+				{
+					return NULL;
+				}
+				node->addChild(impNode);
+			}
+			if (!parseNextToken())
+			{
+				return unexpectedToken();
 			}
-			parseNextToken();
 			break;
 		default:
-			throw ParserException(currentToken);
+			return unexpectedToken();
 	}
 	return node;
 }
@@ -456,20 +518,26 @@ AstNode * Parser::imports()
 	AstNode *impPathNode;
 	if (currentToken.type == Identifier)
 	{
-		impIdNode = new AstNode(AstIdentifier);
-		parseNextToken();
+		impIdNode = newNode(AstIdentifier);
+		if (!parseNextToken())
+		{
+			return unexpectedToken();
+		}
 	}
 
 	if (currentToken.type != StringLiteral)
 	{
-    	throw ParserException(currentToken);
-    }
+		return unexpectedToken();
+	}
 
-    impPathNode = new AstNode(AstStringLiteral);
+	impPathNode = newNode(AstStringLiteral);
 
-	parseNextToken();
+	if (!parseNextToken())
+	{
+		return unexpectedToken();
+	}
 
-	AstNode *node = new AstNode(AstImportItem);
+	AstNode *node = newNode(AstImportItem);
 	if (impIdNode)
 	{
 		node->addChild(impIdNode);
@@ -479,11 +547,23 @@ AstNode * Parser::imports()
 	return node;
 }
 
+Parser::Parser()
+{
+	timing = NULL;
+	errorLimit = PARSER_ERROR_LIMIT;
+	ast = NULL;
+	droppedErrors = 0;
+}
 
 void Parser::parse(const char *str)
 {
 	// use this pointer to move through the input
 	input = str;
+	end = str + strlen(str);
+
+	// free the tree and line table of any previous input
+	nodes.clear();
+	lines.clear();
 
 	// record the start of the input string as the start of a new line
 	lines.push_back(input);
@@ -491,95 +571,81 @@ void Parser::parse(const char *str)
 	// set the current line of input that we are on (0 means line 1)
 	currentLine = 0;
 
+	errors.clear();
+	droppedErrors = 0;
+
 	ast = buildAst();
 }
 
 /* Returns 1 if the Ast was printed successfully, 0 otherwise */
 int Parser::printAst()
 {
-	return printAst(ast, 0);
-}
-
-/* expects zero-based line and column numbers */
-ParserException::ParserException(Token t): tok(t)
-{
-	snprintf(msg, sizeof(msg) / sizeof(msg[0]), "%zu:%zu: Unexpected token", tok.line + 1, tok.column + 1);
-}
-
-/* Returns a copy of the Token tok which caused the exception */
-Token ParserException::getToken()
-{
-	return tok;
-}
+	if (!ast)
+	{
+		return 0;
+	}
 
-const char *ParserException::what() const throw()
-{
-	return msg;
+	AstPrinter printer;
+	walkAst(ast, printer);
+	return 1;
 }
 
-void printUsage(std::ostream& outputStream, char *programName)
+/* Returns the errors recorded during the last call to parse(), in the order they were found */
+const std::vector<ParserError> & Parser::getErrors()
 {
-	outputStream << "Usage: " << programName << " [FILE]" << std::endl;
+	return errors;
 }
 
-int main(int argc, char **argv)
+/* Prints the errors recorded during the last call to parse(), each followed by
+ * the line of input it was found on with the token underlined
+ */
+void Parser::printErrors(std::ostream &out)
 {
-	if (argc > 2)
+	for (std::vector<ParserError>::size_type i = 0; i != errors.size(); i++)
 	{
-		printUsage(std::cerr, argv[0]);
-	}
+		Token tok = errors[i].getToken();
+		const char *line = lines[tok.line];
+		const char *end = line;
 
-	char *input;
+		out << tok.line + 1 << ":" << tok.column + 1 << ": Unexpected token: ";
+		printToken(out, tok);
+		out << std::endl;
 
-	// check if input was piped into the program via stdin
-	if (!isatty(STDIN_FILENO))
-	{
-		// check if the user also specified an input file
-		if (argc == 2)
+		while (*end && *end != '\n' && *end != '\r')
 		{
-			std::cerr << "Detected input from stdin, ignoring file: \"" << argv[1] << "\"" << std::endl;
+			end++;
 		}
+		out << "    ";
+		out.write(line, end - line);
+		out << std::endl << "    ";
 
-		// read from stdin
-		input = util::readStdin();
-	}
-	else
-	{
-		// check if the user specified an input file
-		if (argc == 2)
+		// tabs are copied so that the underline lines up however they are shown
+		for (std::size_t c = 0; c < tok.column && line + c < end; c++)
 		{
-			// read from file
-			input = util::readFile(argv[1]);
+			out << (line[c] == '\t' ? '\t' : ' ');
 		}
-		else
+		out << '^';
+		for (std::size_t c = 1; c < tok.length && line + tok.column + c < end; c++)
 		{
-			printUsage(std::cerr, argv[0]);
-			std::cerr << "No input from stdin, and no file specified, exiting..." << std::endl;
-			return 1;
+			out << '~';
 		}
+		out << std::endl;
 	}
 
-	if (input == NULL)
+	if (droppedErrors)
 	{
-		std::cerr << "Failed to retrieve input, exiting..." << std::endl;
-		return 1;
+		out << "too many errors, " << droppedErrors << " more not shown" << std::endl;
 	}
+}
 
-	Parser parser;
-	try
-	{
-		parser.parse(input);
-		parser.printAst();
-		std::cout << "OK" << std::endl;
-	}
-	catch(ParserException& e)
-	{
-		std::cerr << e.what() << ": ";
-		parser.printToken(std::cerr, e.getToken());
-		std::cerr << std::endl;
-	}
+/* expects zero-based line and column numbers */
+ParserError::ParserError(Token t): tok(t)
+{
+}
 
-	// cast to void * to remove const
-	free(input);
-	return 0;
+/* Returns a copy of the Token tok which caused the error */
+Token ParserError::getToken() const
+{
+	return tok;
 }
+
@@ -2,11 +2,13 @@
 #define PARSER_HPP
 
 #include <cstddef>
-#include <map>
+#include <deque>
 #include <ostream>
 #include <vector>
 
-#define PARSER_EXCEP_MSG_LEN    64      // max length in bytes of parser exception message
+#include "timer.hpp"
+
+#define PARSER_ERROR_LIMIT    10      // default number of errors kept by the parser
 
 enum TokenType
 {
@@ -45,6 +47,9 @@ typedef struct Token
 	std::size_t column;
 } Token;
 
+/* Nodes are allocated from, and owned by, the Parser that created them.
+ * They are all freed together when the parser is reset or destroyed.
+ */
 class AstNode
 {
 public:
@@ -55,13 +60,56 @@ public:
 
 	AstNode();
 	AstNode(AstNodeType t);
-	~AstNode();
 	void addChild(AstNode *node);
 };
 
+/* Called by walkAst for every node of a tree */
+class AstVisitor
+{
+public:
+	virtual ~AstVisitor();
+
+	/* Called before the children of node, depth is 0 for the root.
+	 * Returns false if the children of node should not be visited
+	 */
+	virtual bool enter(const AstNode *node, int depth) = 0;
+
+	/* Called after the children of node */
+	virtual void leave(const AstNode *node, int depth);
+};
+
+/* Visits the tree rooted at root depth first, skipping NULL children.
+ * The path to the current node is kept on an explicit stack instead of recursing
+ */
+void walkAst(const AstNode *root, AstVisitor &visitor);
+
+/* Records unrecognised tokens during tokenisation and unexpected tokens during parsing.
+ * Only the token is kept: the message is formatted when the errors are printed.
+ */
+class ParserError
+{
+public:
+	ParserError(Token t);
+
+	/* Returns a copy of the token to the caller */
+	Token getToken() const;
+
+private:
+	// line and column numbers, zero-based
+	Token tok;
+};
+
 class Parser
 {
 public:
+	// where the time spent lexing is counted, NULL if it is not
+	TimeReport *timing;
+
+	// most errors kept by parse(), 0 for no limit
+	std::size_t errorLimit;
+
+	Parser();
+
 	/* Tokenises and generates an abstract syntax tree
 	 * for the input beginning at str
 	 */
@@ -74,41 +122,41 @@ public:
 	 */
 	void printToken(std::ostream &out, Token tok);
 
-private:
-	// maps strings to their associated token type
-	static const std::map<const char *, TokenType> keywords;
-	static const std::map<const char *, TokenType> operators;
+	/* Returns the errors recorded during the last call to parse(), in the order they were found */
+	const std::vector<ParserError> & getErrors();
 
-	std::map<const char *, TokenType>::const_iterator iter;
+	/* Prints the errors recorded during the last call to parse(), each followed by
+	 * the line of input it was found on, to the specified output stream
+	 */
+	void printErrors(std::ostream &out);
 
+private:
 	AstNode *ast;
 
+	// owns every node of the tree, including those of partial trees abandoned on error
+	std::deque<AstNode> nodes;
+
+	// syntax errors recorded so far, parsing continues after each one
+	std::vector<ParserError> errors;
+
+	// errors found past errorLimit, which are counted but not kept
+	std::size_t droppedErrors;
+
 	// data about current token
 	Token currentToken;
 
 	// current position in input buffer
 	const char *input;
 
+	// the NUL byte at the end of the input, which the scanning kernels stop short of
+	const char *end;
+
 	// vector holding pointers to the start of every line of input
 	std::vector<const char *> lines;
 
 	// current line of input, where 0 would mean the first line
 	std::size_t currentLine;
 
-	/* These functions return a map that maps strings to their token type */
-	static const std::map<const char *, TokenType> createKeywordMap();
-	static const std::map<const char *, TokenType> createOperatorMap();
-
-	/* Parses the token at input as a keyword defined by str.
-	 * Returns the length of the token if parsing was successful, 0 otherwise.
-	 */
-	std::size_t parseKeyword(const char *input, const char *str);
-
-	/* Parses the token at input as an operator defined by str.
-	 * Returns the length of the token if parsing was successful, 0 otherwise.
-	 */
-	std::size_t parseOperator(const char *input, const char *str);
-
 	/* Parses the token at input as a string literal.
 	 * Returns the length of the token if parsing was successful, 0 otherwise.
 	 */
@@ -125,13 +173,25 @@ private:
 	/* The parser should call this every time '\n' is encountered during tokenisation */
 	void newLine(const char *where);
 
+	/* Returns a new node owned by this parser */
+	AstNode * newNode(AstNodeType t);
+
+	/* Records an unexpected token error at the current token.
+	 * Always returns NULL, so that productions can return its result to signal failure.
+	 */
+	AstNode * unexpectedToken();
+
+	/* Discards tokens until one that can start a new statement
+	 * (import, a token on a new line, or end of input)
+	 */
+	void recover();
+
 	/* builds an abstract syntax tree */
 	AstNode * buildAst();
 
-	/* output the abtract syntax tree in text form */
-	int printAst(AstNode *node, int indent);
-
-	/* grammar productions */
+	/* grammar productions
+	 * each returns the node it built, or NULL after recording an error
+	 */
 
 	AstNode * packageStatement();
 
@@ -142,21 +202,4 @@ private:
 	AstNode * imports();
 };
 
-/* Currently used to report unrecognised tokens during tokenisation */
-class ParserException : public std::exception
-{
-public:
-	ParserException(Token t);
-
-	/* Returns a copy of the token to the caller */
-	Token getToken();
-
-	virtual const char *what() const throw();
-
-private:
-	char msg[PARSER_EXCEP_MSG_LEN];
-
-	// line and column numbers, zero-based
-	const Token tok;
-};
 #endif
@@ -0,0 +1,184 @@
+#ifndef PERFECT_HASH_HPP
+#define PERFECT_HASH_HPP
+
+#include <cstddef>
+#include <cstdlib>
+
+#include "parser.hpp"
+
+/* The hash tables are built by the compiler where it can run loops in constant
+ * expressions, and when the program starts otherwise
+ */
+#if __cplusplus >= 201402L
+# define PERFECT_HASH_CONSTEXPR constexpr
+#else
+# define PERFECT_HASH_CONSTEXPR
+#endif
+
+/* A word of the language, such as a keyword or an operator, and its token type */
+struct Keyword
+{
+	const char *text;
+	TokenType type;
+};
+
+/* Not constexpr, so that a table for which no hash function is found cannot be built
+ * at compile time. Without constexpr, the program aborts when it starts instead
+ */
+inline void perfectHashNotFound()
+{
+	abort();
+}
+
+/* A hash table without collisions for a fixed set of N words, so that looking up a
+ * word costs one hash and one comparison, however many words there are.
+ *
+ * The hash of a word s of length n is x ^ x >> 4, where x = a * s[0] + b * s[1]
+ * + s[n - 1] + n (s[1] is s[0] for words of one byte), masked to the size of the
+ * table. The constructor tries every multiplier a and b below 64 for each size of
+ * table from the smallest power of two that holds the words up to 16 times that,
+ * until no two words collide. Words are looked up after the scanner has found their
+ * end, so adding words costs nothing for each token scanned
+ */
+template <std::size_t N>
+class PerfectHash
+{
+public:
+	PERFECT_HASH_CONSTEXPR explicit PerfectHash(const Keyword (&words)[N])
+		: words(words), mask(0), a(0), b(0), slots()
+	{
+		// no hash function tells a word from itself
+		if (hasDuplicates())
+		{
+			perfectHashNotFound();
+			return;
+		}
+
+		std::size_t smallest = 1;
+		while (smallest < N)
+		{
+			smallest *= 2;
+		}
+
+		for (std::size_t size = smallest; size <= 16 * smallest && size <= maxSize; size *= 2)
+		{
+			for (unsigned int i = 1; i != 64; i++)
+			{
+				for (unsigned int j = 0; j != 64; j++)
+				{
+					if (tryHash(size, i, j))
+					{
+						fill(size, i, j);
+						return;
+					}
+				}
+			}
+		}
+		perfectHashNotFound();
+	}
+
+	/* Returns the entry of the length bytes at text, NULL if they are not a word */
+	const Keyword *find(const char *text, std::size_t length) const
+	{
+		if (!length)
+		{
+			return NULL;
+		}
+
+		int slot = slots[hash(text, length, a, b) & mask];
+		if (!slot)
+		{
+			return NULL;
+		}
+
+		const Keyword *word = &words[slot - 1];
+		for (std::size_t i = 0; i != length; i++)
+		{
+			if (word->text[i] != text[i])
+			{
+				return NULL;
+			}
+		}
+		return word->text[length] ? NULL : word;
+	}
+
+private:
+	enum { maxSize = 512 };
+
+	const Keyword *words;
+	std::size_t mask;
+	unsigned int a, b;
+
+	// 1 more than the index of the word hashed to each slot, 0 for none
+	int slots[maxSize];
+
+	static PERFECT_HASH_CONSTEXPR std::size_t hash(const char *text, std::size_t length, unsigned int a, unsigned int b)
+	{
+		std::size_t x = a * (unsigned char) text[0] + b * (unsigned char) text[length > 1]
+			+ (unsigned char) text[length - 1] + length;
+		return x ^ x >> 4;
+	}
+
+	static PERFECT_HASH_CONSTEXPR std::size_t lengthOf(const char *text)
+	{
+		std::size_t length = 0;
+		while (text[length])
+		{
+			length++;
+		}
+		return length;
+	}
+
+	PERFECT_HASH_CONSTEXPR int hasDuplicates() const
+	{
+		for (std::size_t w = 0; w != N; w++)
+		{
+			for (std::size_t v = 0; v != w; v++)
+			{
+				std::size_t c = 0;
+				while (words[w].text[c] && words[w].text[c] == words[v].text[c])
+				{
+					c++;
+				}
+				if (words[w].text[c] == words[v].text[c])
+				{
+					return 1;
+				}
+			}
+		}
+		return 0;
+	}
+
+	/* Returns 1 if no two words collide in a table of size slots with multipliers i
+	 * and j, 0 otherwise. The slots taken are kept as bits, which are cheaper to
+	 * clear than the table for each of the thousands of multipliers tried
+	 */
+	PERFECT_HASH_CONSTEXPR int tryHash(std::size_t size, unsigned int i, unsigned int j) const
+	{
+		unsigned long long taken[maxSize / 64] = {};
+		for (std::size_t w = 0; w != N; w++)
+		{
+			std::size_t s = hash(words[w].text, lengthOf(words[w].text), i, j) & (size - 1);
+			if (taken[s / 64] >> s % 64 & 1)
+			{
+				return 0;
+			}
+			taken[s / 64] |= 1ULL << s % 64;
+		}
+		return 1;
+	}
+
+	/* Fills the table with the multipliers found by tryHash */
+	PERFECT_HASH_CONSTEXPR void fill(std::size_t size, unsigned int i, unsigned int j)
+	{
+		for (std::size_t w = 0; w != N; w++)
+		{
+			slots[hash(words[w].text, lengthOf(words[w].text), i, j) & (size - 1)] = w + 1;
+		}
+		mask = size - 1;
+		a = i;
+		b = j;
+	}
+};
+
+#endif
@@ -0,0 +1,173 @@
+#include "scan.hpp"
+
+#include <ctype.h>
+
+#include <cstring>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SCAN_X86
+#include <immintrin.h>
+#endif
+
+/* Builds the byte table, then gives every different set of low nibbles found under a
+ * high nibble its own bit, so that a byte is in the set exactly when the entries for
+ * its two nibbles share that bit.
+ */
+ByteClass::ByteClass(int (*member)(int))
+{
+	uint16_t rows[8];
+	int numRows = 0;
+
+	memset(low, 0, sizeof(low));
+	memset(high, 0, sizeof(high));
+	nibbles = true;
+
+	for (int c = 0; c != 256; c++)
+	{
+		table[c] = member(c) != 0;
+	}
+
+	for (int h = 0; h != 16 && nibbles; h++)
+	{
+		uint16_t row = 0;
+		for (int l = 0; l != 16; l++)
+		{
+			if (table[h << 4 | l])
+			{
+				row |= 1 << l;
+			}
+		}
+		if (!row)
+		{
+			continue;
+		}
+
+		int bit = 0;
+		while (bit != numRows && rows[bit] != row)
+		{
+			bit++;
+		}
+		if (bit == numRows)
+		{
+			if (numRows == 8)
+			{
+				nibbles = false;
+				break;
+			}
+			rows[numRows++] = row;
+			for (int l = 0; l != 16; l++)
+			{
+				if (row & 1 << l)
+				{
+					low[l] |= 1 << bit;
+				}
+			}
+		}
+		high[h] = 1 << bit;
+	}
+}
+
+namespace scan
+{
+	const ByteClass alnum(isalnum);
+	const ByteClass digits(isdigit);
+}
+
+/* Looks up one byte at a time */
+static const char * skipTable(const char *p, const char *end, const ByteClass &cls)
+{
+	while (p != end && cls.table[(unsigned char) *p])
+	{
+		p++;
+	}
+	return p;
+}
+
+#ifdef SCAN_X86
+/* Looks up 16 bytes at a time with pshufb, which indexes a 16-byte table by the
+ * low nibble of each byte. Bytes from 0x80 have an index with the high bit set,
+ * which pshufb turns into 0, but their high nibble is masked to 8 to 15 first.
+ */
+__attribute__((target("ssse3")))
+static const char * skipSsse3(const char *p, const char *end, const ByteClass &cls)
+{
+	const __m128i low = _mm_loadu_si128((const __m128i *) cls.low);
+	const __m128i high = _mm_loadu_si128((const __m128i *) cls.high);
+	const __m128i nibble = _mm_set1_epi8(0x0f);
+
+	while (end - p >= 16)
+	{
+		__m128i bytes = _mm_loadu_si128((const __m128i *) p);
+		__m128i lows = _mm_shuffle_epi8(low, _mm_and_si128(bytes, nibble));
+		__m128i highs = _mm_shuffle_epi8(high, _mm_and_si128(_mm_srli_epi16(bytes, 4), nibble));
+		unsigned outside = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_and_si128(lows, highs), _mm_setzero_si128()));
+		if (outside)
+		{
+			return p + __builtin_ctz(outside);
+		}
+		p += 16;
+	}
+	return skipTable(p, end, cls);
+}
+
+/* The same with 32 bytes at a time. vpshufb looks up each 16-byte half in its own
+ * copy of the table.
+ */
+__attribute__((target("avx2")))
+static const char * skipAvx2(const char *p, const char *end, const ByteClass &cls)
+{
+	const __m256i low = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *) cls.low));
+	const __m256i high = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *) cls.high));
+	const __m256i nibble = _mm256_set1_epi8(0x0f);
+
+	while (end - p >= 32)
+	{
+		__m256i bytes = _mm256_loadu_si256((const __m256i *) p);
+		__m256i lows = _mm256_shuffle_epi8(low, _mm256_and_si256(bytes, nibble));
+		__m256i highs = _mm256_shuffle_epi8(high, _mm256_and_si256(_mm256_srli_epi16(bytes, 4), nibble));
+		unsigned outside = _mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_and_si256(lows, highs), _mm256_setzero_si256()));
+		if (outside)
+		{
+			return p + __builtin_ctz(outside);
+		}
+		p += 32;
+	}
+	return skipSsse3(p, end, cls);
+}
+#endif
+
+typedef const char * (*Kernel)(const char *, const char *, const ByteClass &);
+
+/* Picks the widest kernel the processor runs */
+static Kernel pickKernel()
+{
+#ifdef SCAN_X86
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2"))
+	{
+		return skipAvx2;
+	}
+	if (__builtin_cpu_supports("ssse3"))
+	{
+		return skipSsse3;
+	}
+#endif
+	return skipTable;
+}
+
+static const Kernel kernel = pickKernel();
+
+namespace scan
+{
+	/* Returns the first byte from p up to end that is not in cls, or end if they
+	 * all are. Bytes are only read below end.
+	 */
+	const char * skipClass(const char *p, const char *end, const ByteClass &cls)
+	{
+		if (!cls.nibbles)
+		{
+			return skipTable(p, end, cls);
+		}
+		return kernel(p, end, cls);
+	}
+}
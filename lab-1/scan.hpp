@@ -0,0 +1,44 @@
+#ifndef SCAN_HPP
+#define SCAN_HPP
+
+#include <stdint.h>
+
+/* A set of bytes, such as the characters that may continue an identifier.
+ * Besides a table of every byte, the set is kept as two tables indexed by the low
+ * and high nibble of a byte: a byte is in the set when the entries for its nibbles
+ * share a bit. Vector kernels look up 16 or 32 bytes at once in the nibble tables.
+ */
+class ByteClass
+{
+public:
+	// bits of the bytes' low nibbles
+	uint8_t low[16];
+
+	// bits of the bytes' high nibbles, 0 for those with no byte in the set
+	uint8_t high[16];
+
+	// whether each byte is in the set
+	bool table[256];
+
+	// false if the set has more than 8 different sets of low nibbles, which the bits
+	// of the nibble tables cannot tell apart; only the byte table is used then
+	bool nibbles;
+
+	/* builds the set of the bytes for which member returns non-zero */
+	explicit ByteClass(int (*member)(int));
+};
+
+namespace scan
+{
+	// letters and digits, which continue an identifier
+	extern const ByteClass alnum;
+
+	// decimal digits
+	extern const ByteClass digits;
+
+	/* Returns the first byte from p up to end that is not in cls, or end if they
+	 * all are. Bytes are only read below end.
+	 */
+	const char * skipClass(const char *p, const char *end, const ByteClass &cls);
+}
+#endif
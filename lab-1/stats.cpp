@@ -0,0 +1,110 @@
+#include "stats.hpp"
+
+#include <cstdio>
+#include <cstring>
+
+static const char *tokenNames[Undefined + 1] =
+{
+	"Import",
+	"Package",
+	"OpenBracket",
+	"CloseBracket",
+	"Identifier",
+	"EndOfFile",
+	"StringLiteral",
+	"Undefined"
+};
+
+LexStats lexStats;
+
+Histogram::Histogram()
+{
+	memset(buckets, 0, sizeof(buckets));
+}
+
+void Histogram::add(uint64_t value)
+{
+	int bucket = 0;
+	while (value && bucket != numBuckets - 1)
+	{
+		value >>= 1;
+		bucket++;
+	}
+	buckets[bucket]++;
+}
+
+LexStats::LexStats()
+{
+	memset(tokens, 0, sizeof(tokens));
+	nesting = 0;
+	blankBytes = 0;
+	commentBytes = 0;
+	lines = 0;
+}
+
+/* Counts a token of type t, of length bytes. An opening bracket is inside the
+ * brackets it opens, and unbalanced brackets never take the depth below 0
+ */
+void LexStats::token(TokenType t, std::size_t length)
+{
+	tokens[t]++;
+	tokenLength.add(length);
+	if (t == OpenBracket)
+	{
+		nesting++;
+	}
+	else if (t == CloseBracket && nesting)
+	{
+		nesting--;
+	}
+	depth.add(nesting);
+}
+
+/* Writes the buckets of h as a JSON object, keyed by the smallest value of each */
+static void writeHistogram(FILE *out, const Histogram &h)
+{
+	const char *separator = "";
+
+	fprintf(out, "{");
+	for (int i = 0; i != Histogram::numBuckets; i++)
+	{
+		if (h.buckets[i])
+		{
+			fprintf(out, "%s\"%llu\":%llu", separator, i ? 1ULL << (i - 1) : 0ULL, (unsigned long long) h.buckets[i]);
+			separator = ",";
+		}
+	}
+	fprintf(out, "}");
+}
+
+/* Writes the counts to the file denoted by fname as JSON.
+ * Returns 0 on success, 1 otherwise
+ */
+int LexStats::write(const char *fname) const
+{
+	const char *separator = "";
+
+	FILE *out = fopen(fname, "w");
+	if (!out)
+	{
+		return 1;
+	}
+
+	fprintf(out, "{\n\"tokens\":{");
+	for (int t = 0; t <= Undefined; t++)
+	{
+		if (tokens[t])
+		{
+			fprintf(out, "%s\"%s\":%llu", separator, tokenNames[t], (unsigned long long) tokens[t]);
+			separator = ",";
+		}
+	}
+	fprintf(out, "},\n\"token_length\":");
+	writeHistogram(out, tokenLength);
+	fprintf(out, ",\n\"nesting_depth\":");
+	writeHistogram(out, depth);
+	fprintf(out, ",\n\"blank_bytes\":%llu,\n\"comment_bytes\":%llu,\n\"lines\":%llu\n}\n",
+		(unsigned long long) blankBytes, (unsigned long long) commentBytes, (unsigned long long) lines);
+
+	return fclose(out) ? 1 : 0;
+}
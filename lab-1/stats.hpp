@@ -0,0 +1,69 @@
+#ifndef STATS_HPP
+#define STATS_HPP
+
+#include <stdint.h>
+
+#include <cstddef>
+
+#include "parser.hpp"
+
+/* A count of values by their power of two: bucket 0 counts 0, and bucket i counts
+ * the values from 2^(i-1) to 2^i - 1. The last bucket also counts anything larger.
+ */
+class Histogram
+{
+public:
+	static const int numBuckets = 16;
+
+	uint64_t buckets[numBuckets];
+
+	Histogram();
+
+	void add(uint64_t value);
+};
+
+/* Counts of what the lexer sees: the tokens of each type, their lengths, the bytes of
+ * blanks and comments, and the depth of brackets at each token.
+ *
+ * Counting is compiled in with make STATS=1, which defines PARSER_STATS. Without it,
+ * the STATS_ macros expand to nothing, so parseNextToken pays nothing for them.
+ * The parser runs on one thread, so there is a single set of counts.
+ */
+class LexStats
+{
+public:
+	uint64_t tokens[Undefined + 1];
+	Histogram tokenLength;
+
+	// depth of the brackets not closed yet, at each token
+	Histogram depth;
+	uint64_t nesting;
+
+	uint64_t blankBytes;
+	uint64_t commentBytes;
+	uint64_t lines;
+
+	LexStats();
+
+	/* Counts a token of type t, of length bytes */
+	void token(TokenType t, std::size_t length);
+
+	/* Writes the counts to the file denoted by fname as JSON.
+	 * Returns 0 on success, 1 otherwise
+	 */
+	int write(const char *fname) const;
+};
+
+extern LexStats lexStats;
+
+#ifdef PARSER_STATS
+#define STATS_TOKEN(type, length)	lexStats.token(type, length)
+#define STATS_BLANK(c)				(lexStats.blankBytes++, lexStats.lines += (c) == '\n')
+#define STATS_COMMENT(begin, end)	(lexStats.commentBytes += (end) - (begin))
+#else
+#define STATS_TOKEN(type, length)	((void) 0)
+#define STATS_BLANK(c)				((void) 0)
+#define STATS_COMMENT(begin, end)	((void) (begin), (void) (end))
+#endif
+
+#endif
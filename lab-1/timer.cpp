@@ -0,0 +1,245 @@
+#include "timer.hpp"
+
+#include <time.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <iomanip>
+#include <new>
+
+static const char *phaseNames[NumPhases] =
+{
+	"read input",
+	"lex",
+	"parse and build AST",
+	"print"
+};
+
+// bytes requested from operator new since the program started
+static uint64_t allocatedBytes;
+
+/* Counts the bytes allocated. The parser is built without exceptions, so running
+ * out of memory aborts instead of throwing std::bad_alloc
+ */
+void * operator new(std::size_t size)
+{
+	void *p = malloc(size ? size : 1);
+	if (!p)
+	{
+		abort();
+	}
+	__sync_fetch_and_add(&allocatedBytes, size);
+	return p;
+}
+
+void operator delete(void *p)
+{
+	free(p);
+}
+
+void * operator new[](std::size_t size)
+{
+	return operator new(size);
+}
+
+void operator delete[](void *p)
+{
+	free(p);
+}
+
+void * operator new(std::size_t size, const std::nothrow_t &) throw()
+{
+	void *p = malloc(size ? size : 1);
+	if (p)
+	{
+		__sync_fetch_and_add(&allocatedBytes, size);
+	}
+	return p;
+}
+
+void * operator new[](std::size_t size, const std::nothrow_t &nothrow) throw()
+{
+	return operator new(size, nothrow);
+}
+
+#if __cplusplus >= 201402L
+// sized deallocation would otherwise reach the library's operator delete
+void operator delete(void *p, std::size_t)
+{
+	free(p);
+}
+
+void operator delete[](void *p, std::size_t)
+{
+	free(p);
+}
+#endif
+
+/* Returns the time of the clock identified by id in milliseconds */
+static double now(clockid_t id)
+{
+	struct timespec ts;
+	clock_gettime(id, &ts);
+	return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+TimeReport::TimeReport()
+{
+	tracing = false;
+	for (int p = 0; p != NumPhases; p++)
+	{
+		phases[p].wall = 0;
+		phases[p].cpu = 0;
+		phases[p].bytes = 0;
+		phases[p].entries = 0;
+	}
+	origin = lastWall = now(CLOCK_MONOTONIC);
+	lastCpu = now(CLOCK_PROCESS_CPUTIME_ID);
+	lastBytes = allocatedBytes;
+}
+
+/* Charges the time and allocations since the last call to the innermost phase */
+void TimeReport::charge(bool sampleCpu)
+{
+	double wall = now(CLOCK_MONOTONIC);
+	uint64_t bytes = allocatedBytes;
+
+	if (!stack.empty())
+	{
+		phases[stack.back()].wall += wall - lastWall;
+		phases[stack.back()].bytes += bytes - lastBytes;
+	}
+	lastWall = wall;
+	lastBytes = bytes;
+
+	if (!sampleCpu)
+	{
+		return;
+	}
+
+	// the CPU time of lexing goes to the phase it was entered from
+	double cpu = now(CLOCK_PROCESS_CPUTIME_ID);
+	for (std::vector<Phase>::size_type s = stack.size(); s-- > 0;)
+	{
+		if (stack[s] != Lex)
+		{
+			phases[stack[s]].cpu += cpu - lastCpu;
+			break;
+		}
+	}
+	lastCpu = cpu;
+}
+
+/* Counts time against phase until the matching call to leave() */
+void TimeReport::enter(Phase phase)
+{
+	charge(phase != Lex);
+	stack.push_back(phase);
+	entered.push_back(lastWall);
+	phases[phase].entries++;
+}
+
+void TimeReport::leave()
+{
+	Phase phase = stack.back();
+
+	charge(phase != Lex);
+	if (tracing && phase != Lex)
+	{
+		TraceEvent event = {phase, (entered.back() - origin) * 1e3, (lastWall - entered.back()) * 1e3};
+		events.push_back(event);
+	}
+	stack.pop_back();
+	entered.pop_back();
+}
+
+/* Prints the time spent in each phase as a table */
+void TimeReport::print(std::ostream &out)
+{
+	Totals total = {0, 0, 0, 0};
+	std::ios::fmtflags flags = out.flags();
+	std::streamsize precision = out.precision();
+
+	out << std::left << std::setw(24) << "phase" << std::right
+		<< std::setw(12) << "wall (ms)" << std::setw(12) << "cpu (ms)"
+		<< std::setw(16) << "allocated (B)" << std::setw(10) << "entries" << std::endl;
+	out << std::fixed << std::setprecision(3);
+
+	for (int p = 0; p != NumPhases; p++)
+	{
+		if (!phases[p].entries)
+		{
+			continue;
+		}
+		out << std::left << std::setw(24) << phaseNames[p] << std::right
+			<< std::setw(12) << phases[p].wall;
+		if (p == Lex)
+		{
+			out << std::setw(12) << "-";
+		}
+		else
+		{
+			out << std::setw(12) << phases[p].cpu;
+		}
+		out << std::setw(16) << phases[p].bytes << std::setw(10) << phases[p].entries << std::endl;
+
+		total.wall += phases[p].wall;
+		total.cpu += phases[p].cpu;
+		total.bytes += phases[p].bytes;
+	}
+
+	out << std::left << std::setw(24) << "total" << std::right
+		<< std::setw(12) << total.wall << std::setw(12) << total.cpu
+		<< std::setw(16) << total.bytes << std::endl;
+
+	out.flags(flags);
+	out.precision(precision);
+}
+
+/* Writes str as a JSON string */
+static void writeJsonString(FILE *out, const std::string &str)
+{
+	fputc('"', out);
+	for (std::string::size_type i = 0; i != str.size(); i++)
+	{
+		unsigned char c = str[i];
+		if (c == '"' || c == '\\')
+		{
+			fprintf(out, "\\%c", c);
+		}
+		else if (c < 0x20)
+		{
+			fprintf(out, "\\u%04x", c);
+		}
+		else
+		{
+			fputc(c, out);
+		}
+	}
+	fputc('"', out);
+}
+
+/* Writes the recorded trace events to the file denoted by fname, in the trace event
+ * format read by chrome://tracing and Perfetto. Returns 0 on success, 1 otherwise.
+ */
+int TimeReport::writeTrace(const char *fname) const
+{
+	FILE *out = fopen(fname, "w");
+	if (!out)
+	{
+		return 1;
+	}
+
+	fprintf(out, "{\"traceEvents\":[");
+	for (std::vector<TraceEvent>::size_type e = 0; e != events.size(); e++)
+	{
+		fprintf(out, "%s\n{\"name\":\"%s\",\"cat\":\"phase\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,"
+			"\"pid\":1,\"tid\":1,\"args\":{\"file\":", e ? "," : "", phaseNames[events[e].phase],
+			events[e].start, events[e].duration);
+		writeJsonString(out, file);
+		fprintf(out, "}}");
+	}
+	fprintf(out, "\n],\"displayTimeUnit\":\"ms\"}\n");
+
+	return fclose(out) ? 1 : 0;
+}
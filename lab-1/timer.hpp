@@ -0,0 +1,109 @@
+#ifndef TIMER_HPP
+#define TIMER_HPP
+
+#include <stdint.h>
+
+#include <ostream>
+#include <string>
+#include <vector>
+
+enum Phase
+{
+	ReadInput,
+	Lex,
+	Parse,
+	Print,
+	NumPhases
+};
+
+/* Wall time, CPU time and bytes allocated with operator new in each phase of the
+ * parser. A phase entered within another one takes its time away from the outer phase.
+ *
+ * Tokens are read one at a time, so only the wall time of lexing is measured:
+ * reading the CPU clock takes a system call, and the CPU time of lexing stays with parsing.
+ */
+class TimeReport
+{
+public:
+	// file being processed, recorded with trace events
+	std::string file;
+
+	// whether phases are recorded as trace events
+	bool tracing;
+
+	TimeReport();
+
+	/* Counts time against phase until the matching call to leave() */
+	void enter(Phase phase);
+	void leave();
+
+	/* Prints the time spent in each phase as a table */
+	void print(std::ostream &out);
+
+	/* Writes the recorded trace events to the file denoted by fname, in the trace event
+	 * format read by chrome://tracing and Perfetto. Returns 0 on success, 1 otherwise.
+	 */
+	int writeTrace(const char *fname) const;
+
+private:
+	struct Totals
+	{
+		double wall;
+		double cpu;
+		uint64_t bytes;
+		uint64_t entries;
+	};
+
+	struct TraceEvent
+	{
+		Phase phase;
+
+		// microseconds since the report was created
+		double start;
+		double duration;
+	};
+
+	Totals phases[NumPhases];
+
+	// phases entered and not left yet, innermost last, with the wall time they were entered at
+	std::vector<Phase> stack;
+	std::vector<double> entered;
+
+	// when the time and allocations were last charged to a phase
+	double lastWall, lastCpu;
+	uint64_t lastBytes;
+	double origin;
+
+	std::vector<TraceEvent> events;
+
+	/* Charges the time and allocations since the last call to the innermost phase */
+	void charge(bool sampleCpu);
+};
+
+/* Counts time against a phase of report for the lifetime of the object,
+ * or does nothing if report is NULL
+ */
+class PhaseTimer
+{
+public:
+	PhaseTimer(TimeReport *report, Phase phase) : report(report)
+	{
+		if (report)
+		{
+			report->enter(phase);
+		}
+	}
+
+	~PhaseTimer()
+	{
+		if (report)
+		{
+			report->leave();
+		}
+	}
+
+private:
+	TimeReport *report;
+};
+
+#endif
@@ -23,7 +23,7 @@ namespace util
 		struct stat finfo;
 		int fd;
 
-		if (!(fd = open(fname, O_RDONLY)))
+		if ((fd = open(fname, O_RDONLY)) < 0)
 		{
 			std::cerr << "'" << fname << "': Couldn't open file" << std::endl;
 			return NULL;
@@ -32,12 +32,14 @@ namespace util
 		if (fstat(fd, &finfo))
 		{
 			std::cerr << fname << ": " << std::strerror(errno) << std::endl;
+			close(fd);
 			return NULL;
 		}
 
 		if (!S_ISREG(finfo.st_mode))
 		{
 			std::cerr << "'" << fname << "': Not a regular file" << std::endl;
+			close(fd);
 			return NULL;
 		}
 
@@ -71,34 +73,56 @@ namespace util
 	char * readStdin()
 	{
 		char *array;
+		char *resized;
 		std::size_t size;
+		std::size_t capacity;
+		ssize_t len;
 
-		std::size_t sizeIncrement = UTIL_STDIN_BUF_LEN;
+		capacity = UTIL_STDIN_BUF_LEN;
 
-		if (!(array = (char *) malloc(sizeIncrement)))
+		if (!(array = (char *) malloc(capacity)))
 		{
 			std::cerr << "Not enough memory to read input" << std::endl;
 			return NULL;
 		}
 
 		size = 0;
-		while (std::cin >> std::noskipws >> array[size++])
+		for (;;)
 		{
-			if (size == sizeof(array) - sizeof(array[0]))
+			// always leave room for the null terminator
+			len = read(STDIN_FILENO, array + size, capacity - size - 1);
+			if (len < 0)
 			{
-				// allocate more memory every time the buffer is full
-				if (!(array = (char *) realloc(array, size + sizeIncrement)))
+				if (errno == EINTR)
+				{
+					continue;
+				}
+				std::cerr << "Couldn't read input: " << std::strerror(errno) << std::endl;
+				free(array);
+				return NULL;
+			}
+			if (len == 0)
+			{
+				break;
+			}
+			size += len;
+
+			if (size == capacity - 1)
+			{
+				// double the size of the buffer every time it is full
+				if (!(resized = (char *) realloc(array, capacity * 2)))
 				{
 					std::cerr << "Not enough memory to read input" << std::endl;
 					free(array);
 					return NULL;
 				}
-
+				array = resized;
+				capacity *= 2;
 			}
 		}
 
 		// null-terminate the string
-		array[size - 1] = '\0';
+		array[size] = '\0';
 
 		return array;
 	}
@@ -1,5 +1,8 @@
 #include "ast_node.hpp"
 
+#include <cstddef>
+#include <deque>
+
 ast_node::ast_node()
 {
   type = ast_undefined;
@@ -8,25 +11,153 @@ ast_node::ast_node()
 ast_node::ast_node(ast_node_type t, ast_node child)
 {
   type = t;
-  children.push_back(child);
+  adopt(child);
 }
 
 ast_node::ast_node(ast_node_type t, ast_node child, ast_node child2)
 {
   type = t;
-  children.push_back(child);
-  children.push_back(child2);
+  children.reserve(2);
+  adopt(child);
+  adopt(child2);
 }
 
 ast_node::ast_node(ast_node_type t, ast_node child, ast_node child2, ast_node child3)
 {
   type = t;
-  children.push_back(child);
-  children.push_back(child2);
-  children.push_back(child3);
+  children.reserve(3);
+  adopt(child);
+  adopt(child2);
+  adopt(child3);
 }
 
 ast_node::ast_node(ast_node_type t)
 {
   type = t;
 }
+
+#if __cplusplus >= 201103L
+ast_node::ast_node(ast_node &&other) noexcept
+{
+  type = other.type;
+  children.swap(other.children);
+}
+
+ast_node &ast_node::operator=(ast_node &&other) noexcept
+{
+  swap(other);
+  return *this;
+}
+#endif
+
+/* Frees the nodes below without recursing: the subtrees of the children are moved to
+ * a queue and taken apart there, so every node is destroyed once its children are
+ * leaves. A node whose children are all leaves is freed as usual.
+ */
+ast_node::~ast_node()
+{
+  std::vector<ast_node>::size_type i;
+
+  for (i = 0; i != children.size() && children[i].children.empty(); i++)
+  {
+  }
+  if (i == children.size())
+  {
+    return;
+  }
+
+  std::deque<ast_node> pending;
+  for (; i != children.size(); i++)
+  {
+    if (!children[i].children.empty())
+    {
+      pending.push_back(ast_node());
+      pending.back().swap(children[i]);
+    }
+  }
+
+  while (!pending.empty())
+  {
+    ast_node node;
+    node.swap(pending.back());
+    pending.pop_back();
+
+    for (i = 0; i != node.children.size(); i++)
+    {
+      if (!node.children[i].children.empty())
+      {
+        pending.push_back(ast_node());
+        pending.back().swap(node.children[i]);
+      }
+    }
+  }
+}
+
+/* exchanges the type and children of the node with those of other */
+void ast_node::swap(ast_node &other)
+{
+  ast_node_type t = type;
+  type = other.type;
+  other.type = t;
+  children.swap(other.children);
+}
+
+/* appends child to the children, leaving child empty */
+void ast_node::adopt(ast_node &child)
+{
+  children.push_back(ast_node());
+  children.back().swap(child);
+}
+
+ast_visitor::~ast_visitor()
+{
+}
+
+void ast_visitor::leave(const ast_node &, unsigned int)
+{
+}
+
+/* a node on the path walked by ast_walk, and the index of its next child to visit */
+struct ast_walk_frame
+{
+  const ast_node *node;
+  std::vector<ast_node>::size_type next;
+};
+
+/* visits the tree rooted at root depth first, without recursing */
+void ast_walk(const ast_node &root, ast_visitor &visitor)
+{
+  std::vector<ast_walk_frame> path;
+  ast_walk_frame frame = {&root, 0};
+
+  if (!visitor.enter(root, 0))
+  {
+    visitor.leave(root, 0);
+    return;
+  }
+  path.push_back(frame);
+
+  while (!path.empty())
+  {
+    ast_walk_frame &top = path.back();
+    if (top.next == top.node->children.size())
+    {
+      const ast_node *node = top.node;
+      path.pop_back();
+      visitor.leave(*node, path.size());
+      continue;
+    }
+
+    const ast_node *child = &top.node->children[top.next++];
+    if (visitor.enter(*child, path.size()))
+    {
+      frame.node = child;
+      frame.next = 0;
+      path.push_back(frame);
+    }
+    else
+    {
+      visitor.leave(*child, path.size());
+    }
+  }
+}
@@ -16,6 +16,9 @@ enum ast_node_type
    ast_root
 };
 
+/* Nodes hold their children by value. Lists are nested one node per element, so
+ * nothing that goes over a whole tree may recurse once per level: see ast_walk.
+ */
 class ast_node
 {
 public:
@@ -26,12 +29,47 @@ public:
 	ast_node();
 	ast_node(ast_node_type t);
 
+	// the children are moved into the node, leaving the arguments empty
 	ast_node(ast_node_type t, ast_node child);
 
 	ast_node(ast_node_type t, ast_node child, ast_node child2);
 
 	ast_node(ast_node_type t, ast_node child, ast_node child2, ast_node child3);
 
+#if __cplusplus >= 201103L
+	// moving a node only swaps its children, the parser moves its values with automove
+	ast_node(const ast_node &other) = default;
+	ast_node(ast_node &&other) noexcept;
+	ast_node &operator=(const ast_node &other) = default;
+	ast_node &operator=(ast_node &&other) noexcept;
+#endif
+
+	/* frees the nodes below one at a time instead of recursing once per level */
+	~ast_node();
+
+	/* exchanges the type and children of the node with those of other */
+	void swap(ast_node &other);
+
+	/* appends child to the children, leaving child empty */
+	void adopt(ast_node &child);
 };
 
+/* Called by ast_walk for every node of a tree */
+class ast_visitor
+{
+public:
+	virtual ~ast_visitor();
+
+	/* called before the children of node, depth is 0 for the root.
+	 * returns false if the children of node should not be visited. */
+	virtual bool enter(const ast_node &node, unsigned int depth) = 0;
+
+	/* called after the children of node */
+	virtual void leave(const ast_node &node, unsigned int depth);
+};
+
+/* visits the tree rooted at root depth first. The path to the current node is kept on
+ * an explicit stack instead of recursing, so long lists cannot overflow the call stack. */
+void ast_walk(const ast_node &root, ast_visitor &visitor);
+
 #endif
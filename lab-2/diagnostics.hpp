@@ -0,0 +1,110 @@
+#ifndef DIAGNOSTICS_HPP
+#define DIAGNOSTICS_HPP
+
+#include <stdint.h>
+
+#include <cstddef>
+#include <ostream>
+#include <set>
+#include <string>
+#include <vector>
+
+enum diag_severity
+{
+	severity_error,
+	severity_warning
+};
+
+/* the messages that can be reported, %1 in their text stands for their argument */
+enum diag_message
+{
+	// lexical errors, also stored in token files, so new messages go last
+	msg_invalid_character,
+	msg_unterminated_string,
+
+	// the argument is Bison's description of the syntax error
+	msg_syntax,
+
+	// the argument is the reason, as given by strerror
+	msg_io,
+	msg_not_token_file,
+
+	num_messages
+};
+
+/* lines and columns from the scanner's locations, starting at 1. The end is the
+ * column after the last character, as in yy::location. Lines are 0 for no location. */
+struct source_span
+{
+	uint32_t first_line, first_column;
+	uint32_t last_line, last_column;
+
+	source_span();
+	source_span(uint32_t first_line, uint32_t first_column, uint32_t last_line, uint32_t last_column);
+};
+
+/* Collects the diagnostics of every input and prints them once processing is over.
+ * Each diagnostic is kept as a message and an argument, so nothing is formatted until
+ * it is printed. A diagnostic repeating the message and argument of one on the same
+ * line of the same file is dropped, and so is every diagnostic of a file past the
+ * first limit of them, so that error storms do not hold memory.
+ * An engine is only used by one thread: each driver has its own.
+ */
+class diagnostic_engine
+{
+public:
+	// most diagnostics kept for each file, 0 for no limit
+	std::size_t limit;
+
+	diagnostic_engine();
+
+	/* starts the diagnostics of the file named name, and returns its id */
+	uint32_t begin_file(const std::string &name);
+
+	/* records a diagnostic about the file identified by file */
+	void report(uint32_t file, const source_span &span, diag_message message,
+		const std::string &arg = std::string(), diag_severity severity = severity_error);
+
+	/* returns the number of errors reported about file, including those dropped */
+	std::size_t errors(uint32_t file) const;
+
+	/* prints the diagnostics kept, in the order they were reported, each followed by
+	 * the line of source it is about if the file can still be read. */
+	void render(std::ostream &out);
+
+	/* forgets every file and diagnostic */
+	void clear();
+
+private:
+	struct diagnostic
+	{
+		uint8_t severity;
+		uint8_t message;
+		uint32_t file;
+		source_span span;
+
+		// index into strings
+		uint32_t arg;
+	};
+
+	struct file_info
+	{
+		std::string name;
+		std::size_t kept, dropped, errors;
+	};
+
+	std::vector<file_info> files;
+	std::vector<diagnostic> kept;
+
+	// arguments of the diagnostics kept
+	std::vector<std::string> strings;
+
+	// file, line, message and argument of every diagnostic kept
+	std::set<std::string> seen;
+
+	/* prints the line of source the diagnostic d is about, with its span underlined */
+	void render_snippet(std::ostream &out, const diagnostic &d, const char *source,
+		const std::vector<std::size_t> &lines, std::size_t size);
+};
+
+#endif
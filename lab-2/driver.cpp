@@ -1,23 +1,18 @@
-#include <unistd.h>
-
-#include <cstring>
 #include <iostream>
 
 #include "driver.hpp"
 
 
-/* command line option flags */
-
-#define	LONG_OPT_TRACE_PARSING		"--parser-traces"
-#define	SHORT_OPT_TRACE_PARSING		"-p"
-#define	LONG_OPT_TRACE_SCANNING		"--scanner-traces"
-#define	SHORT_OPT_TRACE_SCANNING	"-s"
-
 /* constructor/destructor */
 go_driver::go_driver()
 {
+	buffer = NULL;
+	buffer_size = 0;
+	replay = NULL;
 	trace_scanning = false;
 	trace_parsing = false;
+	timing = NULL;
+	file_id = 0;
 }
 
 go_driver::~go_driver()
@@ -28,34 +23,168 @@ go_driver::~go_driver()
 int go_driver::parse(const std::string &fname)
 {
   file = fname;
-  scan_begin();
-  yy::go_parser parser(*this);
-  parser.set_debug_level(trace_parsing);
-  int res = parser.parse();
-  scan_end();
+  buffer = NULL;
+  buffer_size = 0;
+  return parse_input();
+}
+
+/* parses size bytes beginning at data instead of a file, name is used in diagnostics.
+ * returns 0 if the input was parsed successfully, 1 otherwise. */
+int go_driver::parse_buffer(const char *data, std::size_t size, const std::string &name)
+{
+  file = name;
+  buffer = data;
+  buffer_size = size;
+  return parse_input();
+}
+
+/* reads the file denoted by fname, "-" for stdin, and scans it whole into tokens.
+ * returns 0 on success, or the errno of the failure to read it. */
+int go_driver::scan_file(const std::string &fname, token_array &tokens)
+{
+  tokens.file = fname;
+  int err = tokens.read_source(fname);
+  if (!err)
+  {
+    scan_tokens(tokens);
+  }
+  return err;
+}
+
+/* parses tokens scanned ahead by scan_tokens instead of running the scanner.
+ * returns 0 if the input was parsed successfully, 1 otherwise. */
+int go_driver::parse_tokens(const token_array &tokens)
+{
+  file = tokens.file;
+  replay = &tokens;
+  replay_next = 0;
+  replay_offset = 0;
+  replay_errors = 0;
+  replay_loc.initialize(&file);
+
+  int res = parse_input();
+  replay = NULL;
   return res;
 }
 
-/* wrapper for private function of the same name */
-int go_driver::print_ast()
+/* parses the input selected by parse, parse_buffer or parse_tokens */
+int go_driver::parse_input()
 {
-	return print_ast(&tree, 0);
+  int res;
+
+  if (timing)
+  {
+    timing->file = file;
+  }
+  file_id = diagnostics.begin_file(file);
+
+  if (!replay)
+  {
+    phase_timer timer(timing, time_report::phase_read_input);
+    scan_begin();
+  }
+  {
+    phase_timer timer(timing, time_report::phase_parse);
+    yy::go_parser parser(*this);
+    parser.set_debug_level(trace_parsing);
+    res = parser.parse();
+  }
+  if (!replay)
+  {
+    phase_timer timer(timing, time_report::phase_read_input);
+    scan_end();
+  }
+  return res;
 }
 
-/* returns 1 if the AST was printed successfully, 0 otherwise. */
-int go_driver::print_ast(ast_node *node, int indent)
+/* scans the next token, counting the time spent against lexing if the driver is timed */
+go_token yylex(go_driver &driver)
 {
-	if (!node)
-	{
-		return 0;
-	}
+  if (driver.replay)
+  {
+    return driver.replay_token();
+  }
+  if (!driver.timing)
+  {
+    return scan_token(driver);
+  }
+  phase_timer timer(driver.timing, time_report::phase_lex);
+  return scan_token(driver);
+}
 
-	for (int i = 0; i < indent; i++)
-	{
-		std::cout << "\t";
-	}
+/* moves the location of the replayed tokens over the blanks up to offset */
+void go_driver::replay_blanks(std::size_t offset)
+{
+  if (replay_offset == offset)
+  {
+    return;
+  }
+  for (; replay_offset != offset; replay_offset++)
+  {
+    if (replay->source[replay_offset] == '\n')
+    {
+      replay_loc.lines(1);
+    }
+    else
+    {
+      replay_loc.columns(1);
+    }
+  }
+  replay_loc.step();
+}
 
-	switch (node->type)
+/* returns the next token of the array being parsed by parse_tokens. Its location is
+ * found from the text since the previous token, as the scanner would have. */
+go_token go_driver::replay_token()
+{
+  typedef yy::go_parser::symbol_kind symbol_kind;
+  const packed_token *token = &replay->tokens[replay_next];
+
+  replay_loc.step();
+  for (; token->kind == TOKEN_ERROR_KIND; token = &replay->tokens[++replay_next])
+  {
+    // the scanner does not start a new location after an error
+    replay_blanks(token->offset);
+    replay_loc.columns(token->length);
+    replay_offset += token->length;
+    error(replay_loc, (diag_message) replay->messages[replay_errors++]);
+  }
+
+  replay_blanks(token->offset);
+  replay_loc.columns(token->length);
+  replay_offset += token->length;
+
+  // the end of input is returned again if the parser asks for more
+  if (token->kind != symbol_kind::S_YYEOF)
+  {
+    replay_next++;
+  }
+
+  // tokens are numbered in the order of their symbol kinds, from YYerror on
+  typedef yy::go_parser::token token_number;
+  int kind = token->kind < symbol_kind::YYNTOKENS ? token->kind : (int) symbol_kind::S_YYUNDEF;
+  int number = kind == symbol_kind::S_YYEOF ? (int) token_number::TOK_END
+    : kind - symbol_kind::S_YYerror + token_number::TOK_YYerror;
+  if (kind == symbol_kind::S_IDENTIFIER || kind == symbol_kind::S_STRINGLITERAL)
+  {
+    return yy::go_parser::symbol_type(number, replay->source.substr(token->offset, token->length), replay_loc);
+  }
+  return yy::go_parser::symbol_type(number, replay_loc);
+}
+
+/* prints each node of the AST on its own line, indented by its depth */
+class ast_printer : public ast_visitor
+{
+public:
+	bool enter(const ast_node &node, unsigned int depth);
+};
+
+bool ast_printer::enter(const ast_node &node, unsigned int depth)
+{
+	// lists are nested a level per element, so the indentation can be long
+	std::cout << std::string(depth, '\t');
+
+	switch (node.type)
 	{
 		case ast_undefined:
 			std::cout << "undefined";
@@ -90,81 +219,37 @@ int go_driver::print_ast(ast_node *node, int indent)
 	}
 	std::cout << std::endl;
 
-	for(std::vector<int>::size_type i = 0; i != node->children.size(); i++)
-	{
-		print_ast(&node->children[i], indent + 1);
-	}
-
+	return true;
+}
 
+/* returns 1 if the AST was printed successfully, 0 otherwise. */
+int go_driver::print_ast()
+{
+	ast_printer printer;
+	ast_walk(tree, printer);
 	return 1;
 }
 
-/* prints an error message including the related location in the input file */
-void go_driver::error(const yy::location& l, const std::string& m)
+/* converts a location of the scanner to a span of the diagnostics */
+static source_span span_of(const yy::location &l)
 {
-  std::cerr << l << ": " << m << std::endl;
+  return source_span(l.begin.line, l.begin.column, l.end.line, l.end.column);
 }
 
-/* prints an error message */
-void go_driver::error(const std::string& m)
+/* reports a syntax error, described by the parser */
+void go_driver::error(const yy::location& l, const std::string& m)
 {
-  std::cerr << m << std::endl;
+  diagnostics.report(file_id, span_of(l), msg_syntax, m);
 }
 
-/* prints a program usage message */
-void printUsage(std::ostream& outputStream, char *programName)
+/* reports an error at a location in the input */
+void go_driver::error(const yy::location& l, diag_message message, const std::string& arg)
 {
-	outputStream
-		<< "Usage: " << programName << " [OPTION]... [FILE]..." << std::endl
-		<< std::endl
-		<< "\t-p, --parser-traces" << std::endl
-		<< "\t\tInclude parser traces" << std::endl
-		<< "\t-s, --scanner-traces" << std::endl
-		<< "\t\tPrint scanner traces" << std::endl;
+  diagnostics.report(file_id, span_of(l), message, arg);
 }
 
-int main(int argc, char **argv)
+/* reports an error about the input as a whole */
+void go_driver::error(diag_message message, const std::string& arg)
 {
-	go_driver driver;
-	int i = 1;
-
-	while (i < argc)
-	{
-		if ( !strcmp(argv[i], SHORT_OPT_TRACE_PARSING) || !strcmp(argv[i], LONG_OPT_TRACE_PARSING))
-		{
-			driver.trace_parsing = true;
-		}
-		else if (!strcmp(argv[i], SHORT_OPT_TRACE_SCANNING) || !strcmp(argv[i], LONG_OPT_TRACE_SCANNING))
-		{
-			driver.trace_scanning = true;
-		}
-		else if (!driver.parse(argv[i]))
-		{
-			// argument is a file to parse
-
-			// print resulting tree
-		 	driver.print_ast();
-		}
-		else
-		{
-			// argument meaning is unknown
-			std::cerr << "Unrecognised option: " << argv[i] << std::endl;
-			printUsage(std::cerr, argv[0]);
-			return 1;
-		}
-
-		i++;
-	}
-
-	// check if input was piped into the program via stdin
-	if (!isatty(STDIN_FILENO))
-	{
-		if (!driver.parse("-"))
-		{
-			// print resulting tree
-		 	driver.print_ast();
-		}
-	}
-
-	return 0;
+  diagnostics.report(file_id, source_span(), message, arg);
 }
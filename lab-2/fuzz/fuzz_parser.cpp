@@ -0,0 +1,19 @@
+#include "../driver.hpp"
+
+#include <cstddef>
+#include <stdint.h>
+
+/* libFuzzer entry point, parses one input.
+ * The driver is reused across iterations so that each run only pays for
+ * scanning and parsing: every parse restarts the scanner and location tracking.
+ */
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, std::size_t size)
+{
+	static go_driver driver;
+
+	driver.parse_buffer((const char *) data, size, "fuzz");
+	// nothing is printed, so the diagnostics of each run are dropped before the next
+	driver.diagnostics.clear();
+
+	return 0;
+}
@@ -0,0 +1,53 @@
+#ifndef LEX_PIPELINE_HPP
+#define LEX_PIPELINE_HPP
+
+#include <pthread.h>
+
+#include <deque>
+#include <string>
+#include <vector>
+
+#include "driver.hpp"
+#include "token_array.hpp"
+
+/* Scans a list of files on a separate thread, one file ahead of the parser, so that
+ * each file is scanned while the one before it is parsed. The scanner is not
+ * reentrant, so nothing else may scan while the pipeline runs.
+ */
+class lex_pipeline
+{
+public:
+	/* starts scanning the files denoted by fnames, in order */
+	lex_pipeline(const std::vector<std::string> &fnames, bool trace_scanning);
+
+	/* waits for the remaining files to be scanned */
+	~lex_pipeline();
+
+	/* waits for the next file to be scanned and moves its tokens into tokens.
+	 * returns 0 on success, or the errno of the failure to read it. */
+	int next(token_array &tokens);
+
+private:
+	std::vector<std::string> fnames;
+
+	// runs the scanner on the pipeline's thread
+	go_driver scanner;
+
+	// files scanned and not taken by next yet, with the errno of reading each
+	std::deque<token_array> scanned;
+	std::deque<int> errors;
+
+	pthread_t thread;
+	pthread_mutex_t lock;
+
+	// signalled whenever a file is scanned or taken
+	pthread_cond_t changed;
+
+	/* scans every file, waiting for the parser to take each one before scanning the next */
+	void run();
+
+	/* entry point of the thread */
+	static void *start(void *pipeline);
+};
+
+#endif
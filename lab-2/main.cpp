@@ -1,72 +1,272 @@
-#include "parser.h"
-#include "lexer.h"
-
-#include <errno.h>
 #include <unistd.h>
 
-#include <cstdio>
+#include <cerrno>
 #include <cstdlib>
+#include <cstring>
 #include <iostream>
+#include <string>
+#include <vector>
+
+#include "driver.hpp"
+#include "lex_pipeline.hpp"
+#include "time_report.hpp"
+
+/* command line option flags */
 
+#define	LONG_OPT_TRACE_PARSING		"--parser-traces"
+#define	SHORT_OPT_TRACE_PARSING		"-p"
+#define	LONG_OPT_TRACE_SCANNING		"--scanner-traces"
+#define	SHORT_OPT_TRACE_SCANNING	"-s"
+#define	LONG_OPT_TIME_REPORT		"--time-report"
+#define	LONG_OPT_TIME_TRACE			"--time-trace"
+#define	LONG_OPT_LEX_FIRST			"--lex-first"
+#define	LONG_OPT_PIPELINE			"--pipeline"
+#define	LONG_OPT_WRITE_TOKENS		"--write-tokens"
+#define	LONG_OPT_READ_TOKENS		"--read-tokens"
+#define	LONG_OPT_ERROR_LIMIT		"--error-limit"
+
+/* prints a program usage message */
 void printUsage(std::ostream& outputStream, char *programName)
 {
-	outputStream << "Usage: " << programName << " [FILE]" << std::endl;
+	outputStream
+		<< "Usage: " << programName << " [OPTION]... [FILE]..." << std::endl
+		<< std::endl
+		<< "\t-p, --parser-traces" << std::endl
+		<< "\t\tInclude parser traces" << std::endl
+		<< "\t-s, --scanner-traces" << std::endl
+		<< "\t\tPrint scanner traces" << std::endl
+		<< "\t--time-report" << std::endl
+		<< "\t\tPrint the time and memory spent in each phase, over all files, to stderr" << std::endl
+		<< "\t--time-trace FILE" << std::endl
+		<< "\t\tWrite the phases of each file to FILE as Chrome trace events" << std::endl
+		<< "\t--lex-first" << std::endl
+		<< "\t\tScan each file whole before parsing it" << std::endl
+		<< "\t--pipeline" << std::endl
+		<< "\t\tScan each file on a separate thread while the one before it is parsed" << std::endl
+		<< "\t--write-tokens" << std::endl
+		<< "\t\tWrite the tokens of each file to a .tok file instead of parsing it" << std::endl
+		<< "\t--read-tokens" << std::endl
+		<< "\t\tParse the tokens written by --write-tokens, given in place of each file" << std::endl
+		<< "\t--error-limit N" << std::endl
+		<< "\t\tPrint at most N errors for each file (default 10, 0 for no limit)" << std::endl;
 }
 
-int main(int argc, char **argv)
+/* where the phases are timed, and where to report them */
+static time_report timing;
+static bool time_report_wanted = false;
+static const char *time_trace = NULL;
+
+/* how the tokens of each file reach the parser */
+static bool lex_first = false;
+static bool pipelined = false;
+static bool write_tokens = false;
+static bool read_tokens = false;
+
+/* scans the files ahead of the parser with --pipeline, NULL otherwise */
+static lex_pipeline *pipeline = NULL;
+
+/* returns the name of the token file for the source file fname: its name with a .tok extension */
+static std::string token_file_name(const char *fname)
 {
-	yydebug = 0;
-	
-	//yytext
-	//yyleng
-	//yylineno
+	std::string name(fname);
+	if (name == "-")
+	{
+		return "a.tok";
+	}
+
+	std::string::size_type dot = name.rfind('.');
+	if (dot != std::string::npos && name.find('/', dot) == std::string::npos)
+	{
+		name.erase(dot);
+	}
+	return name + ".tok";
+}
 
-	if (argc > 2)
+/* scans the whole file denoted by fname into tokens, or takes its tokens from the
+ * pipeline. Exits after printing every error so far if the file cannot be read, as the
+ * scanner does. */
+static void scan(go_driver &driver, const char *fname, token_array &tokens)
+{
+	int err;
+	{
+		phase_timer timer(driver.timing, time_report::phase_lex);
+		err = pipeline ? pipeline->next(tokens) : driver.scan_file(fname, tokens);
+	}
+	if (err)
 	{
-		printUsage(std::cerr, argv[0]);
+		driver.diagnostics.report(driver.diagnostics.begin_file(fname), source_span(), msg_io, strerror(err));
+		driver.diagnostics.render(std::cerr);
+		exit(EXIT_FAILURE);
 	}
+}
 
-	// check if input was piped into the program via stdin
-	if (!isatty(STDIN_FILENO))
+/* parses the file denoted by fname, or the tokens in it with --read-tokens.
+ * returns 0 if it was parsed successfully, 1 otherwise. */
+static int parse(go_driver &driver, const char *fname)
+{
+	token_array tokens;
+
+	if (read_tokens)
 	{
-		// check if the user also specified an input file
-		if (argc == 2)
+		if (tokens.read(fname))
 		{
-			std::cerr << "Detected input from stdin, ignoring file: \"" << argv[1] << "\"" << std::endl;
+			driver.diagnostics.report(driver.diagnostics.begin_file(fname), source_span(), msg_not_token_file);
+			return 1;
 		}
-
-		// set input source to stdin
-		yyin = stdin;
+	}
+	else if (lex_first || pipeline)
+	{
+		scan(driver, fname, tokens);
 	}
 	else
 	{
-		// check if the user specified an input file
-		if (argc == 2)
+		return driver.parse(fname);
+	}
+	return driver.parse_tokens(tokens);
+}
+
+/* parses the file denoted by fname and prints its AST, or writes its tokens with
+ * --write-tokens. returns 0 on success, 1 otherwise. */
+static int process(go_driver &driver, const char *fname)
+{
+	if (write_tokens)
+	{
+		token_array tokens;
+		std::string tname = token_file_name(fname);
+		scan(driver, fname, tokens);
+		if (tokens.write(tname))
 		{
-			char *fname = argv[1];
-			FILE *fp;
+			driver.diagnostics.report(driver.diagnostics.begin_file(tname), source_span(), msg_io, strerror(errno));
+			return 1;
+		}
+		return 0;
+	}
 
-			if (!(fp = fopen(fname, "rb")))
-			{
-				std::cerr << "'" << fname << "': Couldn't open file" << std::endl;
-				exit(errno);
-			}
-			
-			// set input source to file
-			yyin = fp;
+	if (parse(driver, fname))
+	{
+		return 1;
+	}
+
+	// print resulting tree
+	phase_timer timer(driver.timing, time_report::phase_print);
+	driver.print_ast();
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	go_driver driver;
+	int i = 1;
+	std::vector<std::string> files;
+
+	while (i < argc)
+	{
+		if ( !strcmp(argv[i], SHORT_OPT_TRACE_PARSING) || !strcmp(argv[i], LONG_OPT_TRACE_PARSING))
+		{
+			driver.trace_parsing = true;
+		}
+		else if (!strcmp(argv[i], SHORT_OPT_TRACE_SCANNING) || !strcmp(argv[i], LONG_OPT_TRACE_SCANNING))
+		{
+			driver.trace_scanning = true;
+		}
+		else if (!strcmp(argv[i], LONG_OPT_TIME_REPORT))
+		{
+			time_report_wanted = true;
+			driver.timing = &timing;
+		}
+		else if (!strcmp(argv[i], LONG_OPT_TIME_TRACE) && i + 1 < argc)
+		{
+			time_trace = argv[++i];
+			timing.tracing = true;
+			driver.timing = &timing;
+		}
+		else if (!strcmp(argv[i], LONG_OPT_LEX_FIRST))
+		{
+			lex_first = true;
+		}
+		else if (!strcmp(argv[i], LONG_OPT_PIPELINE))
+		{
+			pipelined = true;
+		}
+		else if (!strcmp(argv[i], LONG_OPT_WRITE_TOKENS))
+		{
+			write_tokens = true;
+		}
+		else if (!strcmp(argv[i], LONG_OPT_READ_TOKENS))
+		{
+			read_tokens = true;
+		}
+		else if (!strcmp(argv[i], LONG_OPT_ERROR_LIMIT) && i + 1 < argc)
+		{
+			driver.diagnostics.limit = strtoul(argv[++i], NULL, 10);
+		}
+		else if (pipelined && !(argv[i][0] == '-' && argv[i][1]))
+		{
+			// with --pipeline, files are processed once every option has been read
+			files.push_back(argv[i]);
+		}
+		else if (!process(driver, argv[i]))
+		{
+			// argument is a file to parse
 		}
 		else
 		{
+			// argument meaning is unknown
+			driver.diagnostics.render(std::cerr);
+			std::cerr << "Unrecognised option: " << argv[i] << std::endl;
 			printUsage(std::cerr, argv[0]);
-			std::cerr << "No input from stdin, and no file specified, exiting..." << std::endl;
 			return 1;
 		}
+
+		i++;
+	}
+
+	// check if input was piped into the program via stdin
+	bool use_stdin = !isatty(STDIN_FILENO);
+	if (use_stdin && !pipelined)
+	{
+		process(driver, "-");
+	}
+
+	if (pipelined)
+	{
+		if (use_stdin)
+		{
+			files.push_back("-");
+		}
+		// token files are read whole already
+		if (!read_tokens)
+		{
+			pipeline = new lex_pipeline(files, driver.trace_scanning);
+		}
+		for (std::vector<std::string>::size_type f = 0; f != files.size(); f++)
+		{
+			if (process(driver, files[f].c_str()) && files[f] != "-")
+			{
+				driver.diagnostics.render(std::cerr);
+				std::cerr << "Unrecognised option: " << files[f] << std::endl;
+				printUsage(std::cerr, argv[0]);
+				delete pipeline;
+				return 1;
+			}
+		}
+		delete pipeline;
+		pipeline = NULL;
 	}
 
-	// send output to stdout
-	yyout = stdout;
+	{
+		phase_timer timer(driver.timing, time_report::phase_print);
+		driver.diagnostics.render(std::cerr);
+	}
 
-	yyparse();
+	if (time_report_wanted)
+	{
+		timing.print(std::cerr);
+	}
+	if (time_trace && timing.write_trace(time_trace))
+	{
+		std::cerr << time_trace << ": " << strerror(errno) << std::endl;
+	}
 
 	return 0;
 }
@@ -0,0 +1,38 @@
+#ifndef MAPPED_FILE_HPP
+#define MAPPED_FILE_HPP
+
+#include <cstddef>
+#include <string>
+
+/* A regular file mapped into memory, followed by the two NUL bytes that Flex's
+ * yy_scan_buffer needs to scan it in place. The mapping is private, so the scanner
+ * may write to it without changing the file.
+ */
+class mapped_file
+{
+public:
+	// first byte of the file, NULL if nothing is mapped
+	char *data;
+
+	// size of the file, not counting the NUL bytes
+	std::size_t size;
+
+	mapped_file();
+	~mapped_file();
+
+	/* maps the regular file denoted by fname, in place of any file mapped before.
+	 * returns 0 on success, or the errno of the failure. */
+	int map(const std::string &fname);
+
+	void unmap();
+
+private:
+	// size of the whole mapping, in pages
+	std::size_t length;
+
+	// copying would unmap the file twice
+	mapped_file(const mapped_file &);
+	mapped_file &operator=(const mapped_file &);
+};
+
+#endif
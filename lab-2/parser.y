@@ -5,6 +5,7 @@
 
 %define api.token.constructor
 %define api.value.type variant
+%define api.value.automove
 %define parse.assert
 
 %code requires
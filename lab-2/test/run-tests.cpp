@@ -0,0 +1,378 @@
+/* Runs the golden tests in a test directory concurrently.
+ *
+ * Every subdirectory of the test directory that contains an input.txt is a test.
+ * The parser is run with input.txt as its standard input, and its standard output
+ * is compared with output.txt. Trailing newlines are ignored.
+ * If the test has an args.txt, the whitespace-separated words in it are passed to
+ * the parser as arguments.
+ *
+ * The wall time and peak memory usage of every test is reported alongside its
+ * outcome, and the full output of every test is written to the log file.
+ */
+#include <dirent.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#define TEST_INPUT		"input.txt"
+#define TEST_OUTPUT		"output.txt"
+#define TEST_ARGS		"args.txt"
+#define DEFAULT_LOG		"output.log"
+
+#define OPT_JOBS		"-j"
+#define OPT_LOG			"-o"
+
+#define OUTCOME_WIDTH	80		// width of a result line in the terminal
+
+typedef struct TestCase
+{
+	std::string name;
+	std::string dir;
+
+	// filled in once the test has run
+	bool passed;
+	std::string output;
+	std::string expected;
+	double seconds;
+	long peakKb;
+	int status;
+} TestCase;
+
+/* shared between the worker threads */
+typedef struct TestQueue
+{
+	std::vector<TestCase> *tests;
+	std::size_t next;
+	pthread_mutex_t lock;
+	const char *exec;
+} TestQueue;
+
+/* Returns the contents of the file denoted by fname, or an empty string */
+static std::string readWhole(const std::string &fname)
+{
+	std::ifstream in(fname.c_str(), std::ios::binary);
+	return std::string((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+}
+
+/* Removes trailing newlines, as the shell does for command substitution */
+static std::string trimNewlines(const std::string &str)
+{
+	std::string::size_type end = str.find_last_not_of('\n');
+	return end == std::string::npos ? std::string() : str.substr(0, end + 1);
+}
+
+/* Returns 1 if fname is an existing regular file, 0 otherwise */
+static int isFile(const std::string &fname)
+{
+	struct stat finfo;
+	return !stat(fname.c_str(), &finfo) && S_ISREG(finfo.st_mode);
+}
+
+static bool compareNames(const TestCase &a, const TestCase &b)
+{
+	return a.name < b.name;
+}
+
+/* Appends a test for every subdirectory of dirName that contains an input file */
+static int discoverTests(const std::string &dirName, std::vector<TestCase> &tests)
+{
+	DIR *dir;
+	struct dirent *entry;
+
+	if (!(dir = opendir(dirName.c_str())))
+	{
+		std::cerr << "'" << dirName << "': " << std::strerror(errno) << std::endl;
+		return 0;
+	}
+
+	while ((entry = readdir(dir)))
+	{
+		TestCase test;
+		test.name = entry->d_name;
+		test.dir = dirName + "/" + entry->d_name;
+		if (test.name[0] != '.' && isFile(test.dir + "/" TEST_INPUT))
+		{
+			test.passed = false;
+			test.seconds = 0;
+			test.peakKb = 0;
+			test.status = 0;
+			tests.push_back(test);
+		}
+	}
+	closedir(dir);
+
+	std::sort(tests.begin(), tests.end(), compareNames);
+	return 1;
+}
+
+/* Runs the parser on the test's input, and records its output and resource usage */
+static void runTest(const char *exec, TestCase &test)
+{
+	std::string input = test.dir + "/" TEST_INPUT;
+	struct timeval start, end;
+	struct rusage usage;
+	int fds[2];
+	int inputFd;
+	pid_t pid;
+	char buf[4096];
+	ssize_t len;
+
+	test.expected = readWhole(test.dir + "/" TEST_OUTPUT);
+
+	// argument vector for the parser, built before forking
+	std::istringstream argStream(readWhole(test.dir + "/" TEST_ARGS));
+	std::vector<std::string> args;
+	std::vector<char *> argv;
+	std::string arg;
+
+	args.push_back(exec);
+	while (argStream >> arg)
+	{
+		args.push_back(arg);
+	}
+	for (std::vector<std::string>::size_type i = 0; i != args.size(); i++)
+	{
+		argv.push_back(&args[i][0]);
+	}
+	argv.push_back(NULL);
+
+	if ((inputFd = open(input.c_str(), O_RDONLY | O_CLOEXEC)) < 0)
+	{
+		test.output = input + ": " + std::strerror(errno);
+		return;
+	}
+	if (pipe2(fds, O_CLOEXEC))
+	{
+		test.output = std::string("pipe: ") + std::strerror(errno);
+		close(inputFd);
+		return;
+	}
+
+	gettimeofday(&start, NULL);
+
+	if (!(pid = fork()))
+	{
+		// child: the input file is stdin, so the parser never waits on a terminal
+		dup2(inputFd, STDIN_FILENO);
+		dup2(fds[1], STDOUT_FILENO);
+		execv(exec, &argv[0]);
+		_exit(127);
+	}
+
+	close(inputFd);
+	close(fds[1]);
+
+	if (pid < 0)
+	{
+		test.output = std::string("fork: ") + std::strerror(errno);
+		close(fds[0]);
+		return;
+	}
+
+	while ((len = read(fds[0], buf, sizeof(buf))) != 0)
+	{
+		if (len < 0)
+		{
+			if (errno == EINTR)
+			{
+				continue;
+			}
+			break;
+		}
+		test.output.append(buf, len);
+	}
+	close(fds[0]);
+
+	while (wait4(pid, &test.status, 0, &usage) < 0 && errno == EINTR)
+	{
+	}
+
+	gettimeofday(&end, NULL);
+
+	test.seconds = (end.tv_sec - start.tv_sec) + (end.tv_usec - start.tv_usec) / 1e6;
+
+	// ru_maxrss is in kilobytes on Linux
+	test.peakKb = usage.ru_maxrss;
+
+	test.passed = trimNewlines(test.output) == trimNewlines(test.expected);
+}
+
+/* worker thread: runs tests from the queue until there are none left */
+static void * worker(void *arg)
+{
+	TestQueue *queue = (TestQueue *) arg;
+	std::size_t i;
+
+	for (;;)
+	{
+		pthread_mutex_lock(&queue->lock);
+		i = queue->next++;
+		pthread_mutex_unlock(&queue->lock);
+
+		if (i >= queue->tests->size())
+		{
+			return NULL;
+		}
+		runTest(queue->exec, (*queue->tests)[i]);
+	}
+}
+
+/* Returns the 1-based line number of the first difference, 0 if equal */
+static std::size_t firstDifference(const std::string &a, const std::string &b)
+{
+	std::size_t line = 1;
+	std::size_t i;
+
+	for (i = 0; i < a.size() && i < b.size() && a[i] == b[i]; i++)
+	{
+		if (a[i] == '\n')
+		{
+			line++;
+		}
+	}
+	return (i == a.size() && i == b.size()) ? 0 : line;
+}
+
+static void printUsage(std::ostream &out, const char *programName)
+{
+	out << "Usage: " << programName << " [" OPT_JOBS " JOBS] [" OPT_LOG " LOG] PARSER_EXEC [TEST_DIR]" << std::endl
+		<< "PARSER_EXEC is the parser executable file that is being tested" << std::endl
+		<< "TEST_DIR is the directory holding the tests, the current directory by default" << std::endl;
+}
+
+int main(int argc, char **argv)
+{
+	const char *exec = NULL;
+	std::string testDir = ".";
+	std::string logName = DEFAULT_LOG;
+	long jobs = sysconf(_SC_NPROCESSORS_ONLN);
+	int i;
+
+	for (i = 1; i < argc; i++)
+	{
+		if (!strcmp(argv[i], OPT_JOBS) && i + 1 < argc)
+		{
+			jobs = atol(argv[++i]);
+		}
+		else if (!strcmp(argv[i], OPT_LOG) && i + 1 < argc)
+		{
+			logName = argv[++i];
+		}
+		else if (!exec)
+		{
+			exec = argv[i];
+		}
+		else
+		{
+			testDir = argv[i];
+		}
+	}
+
+	if (!exec || access(exec, X_OK))
+	{
+		std::cerr << "Error: Executable not found: " << (exec ? exec : "") << std::endl;
+		printUsage(std::cerr, argv[0]);
+		return 1;
+	}
+
+	std::vector<TestCase> tests;
+	if (!discoverTests(testDir, tests))
+	{
+		return 1;
+	}
+
+	if (jobs < 1)
+	{
+		jobs = 1;
+	}
+	if ((std::size_t) jobs > tests.size())
+	{
+		jobs = tests.size();
+	}
+
+	std::cout << "Begin testing..." << std::endl;
+
+	struct timeval start, end;
+	gettimeofday(&start, NULL);
+
+	TestQueue queue;
+	queue.tests = &tests;
+	queue.next = 0;
+	queue.exec = exec;
+	pthread_mutex_init(&queue.lock, NULL);
+
+	std::vector<pthread_t> threads(jobs);
+	for (i = 0; i < jobs; i++)
+	{
+		pthread_create(&threads[i], NULL, worker, &queue);
+	}
+	for (i = 0; i < jobs; i++)
+	{
+		pthread_join(threads[i], NULL);
+	}
+	pthread_mutex_destroy(&queue.lock);
+
+	gettimeofday(&end, NULL);
+
+	// print results in a stable order, regardless of which test finished first
+	std::ofstream log(logName.c_str());
+	std::size_t passed = 0;
+	char stats[64];
+
+	for (std::vector<TestCase>::size_type t = 0; t != tests.size(); t++)
+	{
+		const TestCase &test = tests[t];
+		const char *outcome = test.passed ? "[PASS]" : "[FAIL]";
+		std::string label = test.name + "/:";
+
+		snprintf(stats, sizeof(stats), "%9.3f ms %8ld KB  ", test.seconds * 1e3, test.peakKb);
+
+		int padding = OUTCOME_WIDTH - (int) strlen(outcome) - (int) strlen(stats) - (int) label.size();
+		std::cout << label << std::string(padding > 0 ? padding : 1, ' ') << stats << outcome << std::endl;
+
+		snprintf(stats, sizeof(stats), "%.3f ms, %ld KB", test.seconds * 1e3, test.peakKb);
+		log << "Test " << test.name << "/: " << outcome << " (" << stats << ")" << std::endl;
+		if (!test.passed)
+		{
+			log << "first difference at line " << firstDifference(trimNewlines(test.output), trimNewlines(test.expected));
+			if (WIFEXITED(test.status))
+			{
+				log << ", exit status " << WEXITSTATUS(test.status);
+			}
+			else if (WIFSIGNALED(test.status))
+			{
+				log << ", killed by signal " << WTERMSIG(test.status);
+			}
+			log << std::endl;
+		}
+		log << "----------------------------------BEGIN-OUTPUT---------------------------------" << std::endl
+			<< test.output
+			<< "-----------------------------------END-OUTPUT----------------------------------" << std::endl;
+
+		passed += test.passed;
+	}
+
+	double seconds = (end.tv_sec - start.tv_sec) + (end.tv_usec - start.tv_usec) / 1e6;
+	std::cout << "...end of testing." << std::endl
+		<< passed << "/" << tests.size() << " tests passed in " << seconds * 1e3 << " ms using "
+		<< jobs << " jobs." << std::endl;
+
+	return passed == tests.size() ? 0 : 1;
+}
@@ -0,0 +1,109 @@
+#ifndef TIME_REPORT_HPP
+#define TIME_REPORT_HPP
+
+#include <stdint.h>
+
+#include <ostream>
+#include <string>
+#include <vector>
+
+/* Wall time, CPU time and bytes allocated with operator new in each phase of the
+ * parser, summed over every file of a run. A phase entered within another one
+ * takes its time away from the outer phase.
+ *
+ * Lexing is entered once per token, so only its wall time is measured: reading the
+ * CPU clock takes a system call, and the CPU time of lexing stays with parsing.
+ */
+class time_report
+{
+public:
+	enum phase
+	{
+		phase_read_input,
+		phase_lex,
+		phase_parse,
+		phase_print,
+		num_phases
+	};
+
+	// file being processed, recorded with trace events
+	std::string file;
+
+	// whether the phases of each file are recorded as trace events
+	bool tracing;
+
+	time_report();
+
+	/* counts time against p until the matching call to leave */
+	void enter(phase p);
+	void leave();
+
+	/* prints the time spent in each phase as a table */
+	void print(std::ostream &out);
+
+	/* writes the recorded trace events to the file denoted by fname, in the trace event
+	 * format read by chrome://tracing and Perfetto. returns 0 on success, 1 otherwise. */
+	int write_trace(const std::string &fname) const;
+
+private:
+	struct totals
+	{
+		double wall;
+		double cpu;
+		uint64_t bytes;
+		uint64_t entries;
+	};
+
+	struct trace_event
+	{
+		phase p;
+		std::string file;
+
+		// microseconds since the report was created
+		double start;
+		double duration;
+	};
+
+	totals phases[num_phases];
+
+	// phases entered and not left yet, innermost last, with the wall time they were entered at
+	std::vector<phase> stack;
+	std::vector<double> entered;
+
+	// when the time and allocations were last charged to a phase
+	double last_wall, last_cpu;
+	uint64_t last_bytes;
+	double origin;
+
+	std::vector<trace_event> events;
+
+	/* charges the time and allocations since the last call to the phases on the stack */
+	void charge(bool sample_cpu);
+};
+
+/* counts time against a phase of report for the lifetime of the object,
+ * or does nothing if report is NULL */
+class phase_timer
+{
+public:
+	phase_timer(time_report *report, time_report::phase p) : report(report)
+	{
+		if (report)
+		{
+			report->enter(p);
+		}
+	}
+
+	~phase_timer()
+	{
+		if (report)
+		{
+			report->leave();
+		}
+	}
+
+private:
+	time_report *report;
+};
+
+#endif
@@ -0,0 +1,168 @@
+#include "token_array.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+
+// first bytes of every token file, and version of its layout
+static const char token_magic[4] = {'G', 'O', 'T', 'K'};
+static const uint32_t token_version = 2;
+
+/* exchanges the contents of the array with those of other */
+void token_array::swap(token_array &other)
+{
+	file.swap(other.file);
+	source.swap(other.source);
+	tokens.swap(other.tokens);
+	messages.swap(other.messages);
+}
+
+/* reads the input denoted by fname, "-" for stdin, into source.
+ * returns 0 on success, or the errno of the failure. */
+int token_array::read_source(const std::string &fname)
+{
+	bool use_stdin = fname.empty() || fname == "-";
+	FILE *in = use_stdin ? stdin : fopen(fname.c_str(), "rb");
+	char chunk[65536];
+	std::size_t n;
+
+	if (!in)
+	{
+		return errno;
+	}
+
+	source.clear();
+	while ((n = fread(chunk, 1, sizeof(chunk), in)) > 0)
+	{
+		source.append(chunk, n);
+	}
+
+	int err = ferror(in) ? errno : 0;
+	if (!use_stdin)
+	{
+		fclose(in);
+	}
+	// offsets into the source are 32-bit
+	if (!err && source.size() > UINT32_MAX - 2)
+	{
+		err = EFBIG;
+	}
+	return err;
+}
+
+/* writes n bytes beginning at data to out, returns 1 if they were all written */
+static int write_bytes(FILE *out, const void *data, std::size_t n)
+{
+	return !n || fwrite(data, 1, n, out) == n;
+}
+
+/* writes a 32-bit count followed by a string */
+static int write_string(FILE *out, const std::string &str)
+{
+	uint32_t size = str.size();
+	return write_bytes(out, &size, sizeof(size)) && write_bytes(out, str.data(), size);
+}
+
+/* writes the array to the file denoted by fname, in host byte order.
+ * returns 0 on success, 1 otherwise with errno set. */
+int token_array::write(const std::string &fname) const
+{
+	FILE *out = fopen(fname.c_str(), "wb");
+	if (!out)
+	{
+		return 1;
+	}
+
+	uint32_t num_tokens = tokens.size(), num_messages = messages.size();
+	int ok = write_bytes(out, token_magic, sizeof(token_magic))
+		&& write_bytes(out, &token_version, sizeof(token_version))
+		&& write_string(out, file)
+		&& write_string(out, source)
+		&& write_bytes(out, &num_tokens, sizeof(num_tokens))
+		&& write_bytes(out, num_tokens ? &tokens[0] : NULL, num_tokens * sizeof(packed_token))
+		&& write_bytes(out, &num_messages, sizeof(num_messages))
+		&& write_bytes(out, num_messages ? &messages[0] : NULL, num_messages);
+
+	return (fclose(out) || !ok) ? 1 : 0;
+}
+
+/* reads n bytes from in to data, returns 1 if they were all read */
+static int read_bytes(FILE *in, void *data, std::size_t n)
+{
+	return !n || fread(data, 1, n, in) == n;
+}
+
+/* reads a string written by write_string */
+static int read_string(FILE *in, std::string &str)
+{
+	uint32_t size;
+	if (!read_bytes(in, &size, sizeof(size)))
+	{
+		return 0;
+	}
+	str.resize(size);
+	return read_bytes(in, size ? &str[0] : NULL, size);
+}
+
+/* reads an array written by write from the file denoted by fname.
+ * returns 0 on success, 1 if the file could not be read or is not a token file. */
+int token_array::read(const std::string &fname)
+{
+	FILE *in = fopen(fname.c_str(), "rb");
+	char magic[sizeof(token_magic)];
+	uint32_t version, num_tokens, num_messages;
+
+	if (!in)
+	{
+		return 1;
+	}
+
+	int ok = read_bytes(in, magic, sizeof(magic))
+		&& std::equal(magic, magic + sizeof(magic), token_magic)
+		&& read_bytes(in, &version, sizeof(version)) && version == token_version
+		&& read_string(in, file)
+		&& read_string(in, source)
+		&& read_bytes(in, &num_tokens, sizeof(num_tokens))
+		&& num_tokens && num_tokens - 1 <= source.size();
+	if (ok)
+	{
+		tokens.resize(num_tokens);
+		ok = read_bytes(in, &tokens[0], num_tokens * sizeof(packed_token))
+			&& read_bytes(in, &num_messages, sizeof(num_messages))
+			&& num_messages <= num_tokens;
+	}
+	if (ok)
+	{
+		messages.resize(num_messages);
+		ok = read_bytes(in, num_messages ? &messages[0] : NULL, num_messages);
+	}
+	fclose(in);
+
+	return ok && valid() ? 0 : 1;
+}
+
+/* returns 1 if the tokens follow each other within the source, with a known message
+ * for every error and the end of input last, 0 otherwise */
+int token_array::valid() const
+{
+	uint64_t end = 0;
+	std::size_t errors = 0;
+
+	for (std::vector<packed_token>::size_type t = 0; t != tokens.size(); t++)
+	{
+		if (tokens[t].offset < end || (uint64_t) tokens[t].offset + tokens[t].length > source.size())
+		{
+			return 0;
+		}
+		end = (uint64_t) tokens[t].offset + tokens[t].length;
+		errors += tokens[t].kind == TOKEN_ERROR_KIND;
+	}
+	for (std::vector<uint8_t>::size_type m = 0; m != messages.size(); m++)
+	{
+		if (messages[m] >= num_messages)
+		{
+			return 0;
+		}
+	}
+	return !tokens.empty() && tokens.back().kind == 0 && errors == messages.size();
+}
@@ -1 +1,459 @@
-//TODO: implement
+#include "ast_node.hpp"
+
+#include <cstddef>
+
+ast_node::ast_node(ast_node_type t)
+{
+	type = t;
+	id = 0;
+}
+
+ast_node::~ast_node()
+{
+}
+
+ast_pool::~ast_pool()
+{
+	clear();
+}
+
+/* deletes every node in the pool */
+void ast_pool::clear()
+{
+	for (std::vector<ast_node *>::size_type i = 0; i != nodes.size(); i++)
+	{
+		delete nodes[i];
+	}
+	nodes.clear();
+}
+
+ast_stmt::ast_stmt(ast_node_type t) : ast_node(t)
+{
+	next = NULL;
+}
+
+ast_expr::ast_expr(ast_node_type t) : ast_stmt(t)
+{
+}
+
+/* identifiers and literals */
+
+ast_ident::ast_ident(const std::string &name) : ast_expr(node_ident), name(name)
+{
+}
+
+ast_int_lit::ast_int_lit(const int_literal &value) : ast_expr(node_int_lit), value(value)
+{
+}
+
+ast_str_lit::ast_str_lit(uint32_t value) : ast_expr(node_str_lit), value(value)
+{
+}
+
+ast_array_type::ast_array_type(ast_int_lit *length, const std::string &elem) : ast_ident(elem)
+{
+	type = node_array_type;
+	this->length = length;
+}
+
+ast_array_type::ast_array_type(const std::string &elem) : ast_ident(elem)
+{
+	type = node_array_type;
+	length = NULL;
+}
+
+/* declarations */
+
+ast_pkg_decl::ast_pkg_decl(ast_ident *name) : ast_node(node_pkg_decl)
+{
+	this->name = name;
+}
+
+ast_imp_spec::ast_imp_spec(ast_str_lit *path) : ast_node(node_imp_spec)
+{
+	next = NULL;
+	name = NULL;
+	this->path = path;
+}
+
+ast_imp_spec::ast_imp_spec(ast_ident *name, ast_str_lit *path) : ast_node(node_imp_spec)
+{
+	next = NULL;
+	this->name = name;
+	this->path = path;
+}
+
+ast_imp_decl::ast_imp_decl(ast_imp_spec *imp_specs) : ast_node(node_imp_decl)
+{
+	next = NULL;
+	this->imp_specs = imp_specs;
+}
+
+ast_var_decl::ast_var_decl(ast_ident *name, ast_ident *var_type) : ast_stmt(node_var_decl)
+{
+	this->name = name;
+	this->var_type = var_type;
+	value = NULL;
+}
+
+ast_var_decl::ast_var_decl(ast_ident *name, ast_expr *value) : ast_stmt(node_var_decl)
+{
+	this->name = name;
+	var_type = NULL;
+	this->value = value;
+}
+
+ast_var_decl::ast_var_decl(ast_ident *name, ast_ident *var_type, ast_expr *value) : ast_stmt(node_var_decl)
+{
+	this->name = name;
+	this->var_type = var_type;
+	this->value = value;
+}
+
+ast_block::ast_block(ast_stmt *stmts) : ast_node(node_block)
+{
+	this->stmts = stmts;
+}
+
+ast_block::ast_block() : ast_node(node_block)
+{
+	stmts = NULL;
+}
+
+ast_func_sig::ast_func_sig(ast_var_decl *args, ast_ident *return_type) : ast_node(node_func_sig)
+{
+	this->args = args;
+	this->return_type = return_type;
+}
+
+ast_func_sig::ast_func_sig(ast_var_decl *args) : ast_node(node_func_sig)
+{
+	this->args = args;
+	return_type = NULL;
+}
+
+ast_func_sig::ast_func_sig(ast_ident *return_type) : ast_node(node_func_sig)
+{
+	args = NULL;
+	this->return_type = return_type;
+}
+
+ast_func_sig::ast_func_sig() : ast_node(node_func_sig)
+{
+	args = NULL;
+	return_type = NULL;
+}
+
+ast_func_decl::ast_func_decl(ast_ident *name, ast_func_sig *sig, ast_block *body) : ast_stmt(node_func_decl)
+{
+	this->name = name;
+	this->sig = sig;
+	this->body = body;
+}
+
+ast_return::ast_return(ast_expr *value) : ast_stmt(node_return)
+{
+	this->value = value;
+}
+
+/* control flow */
+
+ast_if::ast_if(ast_expr *cond, ast_block *then_block, ast_block *else_block) : ast_stmt(node_if)
+{
+	this->cond = cond;
+	this->then_block = then_block;
+	this->else_block = else_block;
+}
+
+ast_for::ast_for(ast_expr *init, ast_expr *cond, ast_expr *post, ast_block *body) : ast_stmt(node_for)
+{
+	this->init = init;
+	this->cond = cond;
+	this->post = post;
+	this->body = body;
+}
+
+ast_case_clause::ast_case_clause(ast_expr *values, ast_stmt *stmts) : ast_node(node_case_clause)
+{
+	next = NULL;
+	this->values = values;
+	this->stmts = stmts;
+}
+
+ast_switch::ast_switch(ast_expr *tag, ast_case_clause *clauses) : ast_stmt(node_switch)
+{
+	this->tag = tag;
+	this->clauses = clauses;
+}
+
+ast_branch::ast_branch(ast_node_type t) : ast_stmt(t)
+{
+}
+
+/* expressions */
+
+ast_operation::ast_operation(ast_expr *lhs, const std::string &binary_op, ast_expr *rhs) : ast_expr(node_operation), op(binary_op)
+{
+	this->lhs = lhs;
+	this->rhs = rhs;
+}
+
+ast_operation::ast_operation(const std::string &unary_op, ast_expr *operand) : ast_expr(node_operation), op(unary_op)
+{
+	lhs = NULL;
+	rhs = operand;
+}
+
+ast_func_call::ast_func_call(ast_ident *name) : ast_expr(node_func_call)
+{
+	this->name = name;
+	args = NULL;
+}
+
+ast_func_call::ast_func_call(ast_ident *name, ast_expr *args) : ast_expr(node_func_call)
+{
+	this->name = name;
+	this->args = args;
+}
+
+ast_var_assign::ast_var_assign(ast_ident *name, ast_expr *value) : ast_expr(node_var_assign)
+{
+	this->name = name;
+	this->value = value;
+}
+
+ast_index::ast_index(ast_ident *name, ast_expr *index) : ast_expr(node_index)
+{
+	this->name = name;
+	this->index = index;
+}
+
+ast_slice_expr::ast_slice_expr(ast_ident *name, ast_expr *low, ast_expr *high) : ast_expr(node_slice_expr)
+{
+	this->name = name;
+	this->low = low;
+	this->high = high;
+}
+
+ast_index_assign::ast_index_assign(ast_ident *name, ast_expr *index, ast_expr *value) : ast_expr(node_index_assign)
+{
+	this->name = name;
+	this->index = index;
+	this->value = value;
+}
+
+ast_root::ast_root(ast_pkg_decl *package, ast_imp_decl *imports, ast_stmt *stmts) : ast_node(node_root)
+{
+	this->package = package;
+	this->imports = imports;
+	this->stmts = stmts;
+}
+
+ast_root::ast_root(ast_pkg_decl *package, ast_stmt *stmts) : ast_node(node_root)
+{
+	this->package = package;
+	imports = NULL;
+	this->stmts = stmts;
+}
+
+/* traversal */
+
+ast_visitor::~ast_visitor()
+{
+}
+
+void ast_visitor::leave(ast_node *, unsigned int)
+{
+}
+
+/* stores the children of node in children, in order, and returns how many there are.
+ * A child that starts a list stands for the whole list. */
+static int ast_children(ast_node *node, ast_node *children[4])
+{
+	switch (node->type)
+	{
+		case node_root:
+		{
+			ast_root *root = static_cast<ast_root *>(node);
+			children[0] = root->package;
+			children[1] = root->imports;
+			children[2] = root->stmts;
+			return 3;
+		}
+		case node_pkg_decl:
+			children[0] = static_cast<ast_pkg_decl *>(node)->name;
+			return 1;
+		case node_imp_decl:
+			children[0] = static_cast<ast_imp_decl *>(node)->imp_specs;
+			return 1;
+		case node_imp_spec:
+			children[0] = static_cast<ast_imp_spec *>(node)->name;
+			children[1] = static_cast<ast_imp_spec *>(node)->path;
+			return 2;
+		case node_block:
+			children[0] = static_cast<ast_block *>(node)->stmts;
+			return 1;
+		case node_func_sig:
+			children[0] = static_cast<ast_func_sig *>(node)->args;
+			children[1] = static_cast<ast_func_sig *>(node)->return_type;
+			return 2;
+		case node_func_decl:
+		{
+			ast_func_decl *func = static_cast<ast_func_decl *>(node);
+			children[0] = func->name;
+			children[1] = func->sig;
+			children[2] = func->body;
+			return 3;
+		}
+		case node_var_decl:
+		{
+			ast_var_decl *var = static_cast<ast_var_decl *>(node);
+			children[0] = var->name;
+			children[1] = var->var_type;
+			children[2] = var->value;
+			return 3;
+		}
+		case node_return:
+			children[0] = static_cast<ast_return *>(node)->value;
+			return 1;
+		case node_operation:
+			children[0] = static_cast<ast_operation *>(node)->lhs;
+			children[1] = static_cast<ast_operation *>(node)->rhs;
+			return 2;
+		case node_func_call:
+			children[0] = static_cast<ast_func_call *>(node)->name;
+			children[1] = static_cast<ast_func_call *>(node)->args;
+			return 2;
+		case node_var_assign:
+			children[0] = static_cast<ast_var_assign *>(node)->name;
+			children[1] = static_cast<ast_var_assign *>(node)->value;
+			return 2;
+		case node_if:
+		{
+			ast_if *branch = static_cast<ast_if *>(node);
+			children[0] = branch->cond;
+			children[1] = branch->then_block;
+			children[2] = branch->else_block;
+			return 3;
+		}
+		case node_for:
+		{
+			ast_for *loop = static_cast<ast_for *>(node);
+			children[0] = loop->init;
+			children[1] = loop->cond;
+			children[2] = loop->post;
+			children[3] = loop->body;
+			return 4;
+		}
+		case node_switch:
+			children[0] = static_cast<ast_switch *>(node)->tag;
+			children[1] = static_cast<ast_switch *>(node)->clauses;
+			return 2;
+		case node_case_clause:
+			children[0] = static_cast<ast_case_clause *>(node)->values;
+			children[1] = static_cast<ast_case_clause *>(node)->stmts;
+			return 2;
+		case node_array_type:
+			children[0] = static_cast<ast_array_type *>(node)->length;
+			return 1;
+		case node_index:
+			children[0] = static_cast<ast_index *>(node)->name;
+			children[1] = static_cast<ast_index *>(node)->index;
+			return 2;
+		case node_slice_expr:
+		{
+			ast_slice_expr *slice = static_cast<ast_slice_expr *>(node);
+			children[0] = slice->name;
+			children[1] = slice->low;
+			children[2] = slice->high;
+			return 3;
+		}
+		case node_index_assign:
+		{
+			ast_index_assign *assign = static_cast<ast_index_assign *>(node);
+			children[0] = assign->name;
+			children[1] = assign->index;
+			children[2] = assign->value;
+			return 3;
+		}
+		default:
+			return 0;
+	}
+}
+
+/* returns the node after node in the list it belongs to, or NULL */
+static ast_node *ast_next(ast_node *node)
+{
+	switch (node->type)
+	{
+		case node_imp_decl:
+			return static_cast<ast_imp_decl *>(node)->next;
+		case node_imp_spec:
+			return static_cast<ast_imp_spec *>(node)->next;
+		case node_case_clause:
+			return static_cast<ast_case_clause *>(node)->next;
+		case node_root:
+		case node_pkg_decl:
+		case node_block:
+		case node_func_sig:
+			return NULL;
+		default:
+			return static_cast<ast_stmt *>(node)->next;
+	}
+}
+
+/* a node waiting on the stack of ast_walk, to be entered, or left once its children
+ * have been visited */
+struct ast_walk_step
+{
+	ast_node *node;
+	unsigned int depth;
+	bool leaving;
+};
+
+/* visits the tree rooted at root depth first, without recursing. Entering a node
+ * pushes the next node of its list, then the step leaving it, then its children, so
+ * the stack holds a few steps per level of the tree however long its lists are. */
+void ast_walk(ast_node *root, ast_visitor &visitor)
+{
+	std::vector<ast_walk_step> stack;
+	ast_walk_step first = {root, 0, false};
+
+	if (root)
+	{
+		stack.push_back(first);
+	}
+
+	while (!stack.empty())
+	{
+		ast_walk_step step = stack.back();
+		stack.pop_back();
+
+		if (step.leaving)
+		{
+			visitor.leave(step.node, step.depth);
+			continue;
+		}
+
+		ast_node *next = ast_next(step.node);
+		if (next)
+		{
+			ast_walk_step sibling = {next, step.depth, false};
+			stack.push_back(sibling);
+		}
+
+		bool visit_children = visitor.enter(step.node, step.depth);
+		step.leaving = true;
+		stack.push_back(step);
+
+		ast_node *children[4];
+		for (int c = visit_children ? ast_children(step.node, children) : 0; c-- > 0;)
+		{
+			if (children[c])
+			{
+				ast_walk_step child = {children[c], step.depth + 1, false};
+				stack.push_back(child);
+			}
+		}
+	}
+}
@@ -1,115 +1,399 @@
 #ifndef AST_NODE_HPP
 #define AST_NODE_HPP
 
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "diagnostics.hpp"
+#include "int_literal.hpp"
+
+enum ast_node_type
+{
+	node_undefined,
+	node_root,
+	node_pkg_decl,
+	node_imp_decl,
+	node_imp_spec,
+	node_block,
+	node_func_sig,
+	node_func_decl,
+	node_var_decl,
+	node_ident,
+	node_int_lit,
+	node_str_lit,
+	node_operation,
+	node_func_call,
+	node_var_assign,
+	node_return,
+	node_if,
+	node_for,
+	node_switch,
+	node_case_clause,
+	node_break,
+	node_continue,
+	node_array_type,
+	node_index,
+	node_slice_expr,
+	node_index_assign
+};
+
+/* Nodes are owned by the ast_pool they were added to, not by their parents */
 class ast_node
 {
+public:
+	ast_node_type type;
+
+	// position of the node in the pool that owns it
+	unsigned int id;
+
+	// part of the input the node was parsed from, for diagnostics
+	source_span span;
+
+	ast_node(ast_node_type t);
+	virtual ~ast_node();
+};
+
+/* Owns every node created while parsing, including those of partial trees
+ * discarded during error recovery. All nodes are freed together.
+ */
+class ast_pool
+{
+public:
+	~ast_pool();
+
+	/* takes ownership of node and returns it */
+	template <class T>
+	T *add(T *node)
+	{
+		node->id = nodes.size();
+		nodes.push_back(node);
+		return node;
+	}
+
+	/* returns the node with the given id, or NULL if there is none */
+	ast_node *get(unsigned int id) const
+	{
+		return id < nodes.size() ? nodes[id] : NULL;
+	}
+
+	/* deletes every node in the pool */
+	void clear();
+
+private:
+	std::vector<ast_node *> nodes;
+};
+
+class ast_stmt : public ast_node
+{
+public:
+	// next statement in the list, or NULL
+	ast_stmt *next;
+
+	ast_stmt(ast_node_type t);
+};
+
+class ast_expr : public ast_stmt
+{
+public:
+	ast_expr(ast_node_type t);
+};
+
+/* identifiers and literals */
+
+class ast_ident : public ast_expr
+{
+public:
+	std::string name;
+
+	ast_ident(const std::string &name);
+};
+
+class ast_int_lit : public ast_expr
+{
+public:
+	int_literal value;
+
+	ast_int_lit(const int_literal &value);
 };
 
+class ast_str_lit : public ast_expr
+{
+public:
+	// id of the decoded value in the driver's string pool
+	uint32_t value;
+
+	ast_str_lit(uint32_t value);
+};
+
+/* [length]elem for arrays, []elem for slices. As types are identifiers otherwise,
+ * name is the type of the elements, which can be used wherever a type is expected */
+class ast_array_type : public ast_ident
+{
+public:
+	// NULL for a slice
+	ast_int_lit *length;
+
+	ast_array_type(ast_int_lit *length, const std::string &elem);
+	ast_array_type(const std::string &elem);
+};
+
+/* declarations */
+
 class ast_pkg_decl : public ast_node
 {
 public:
-	ast_pkg_decl(ast_str_lit name);
+	ast_ident *name;
+
+	ast_pkg_decl(ast_ident *name);
+};
+
+class ast_imp_spec : public ast_node
+{
+public:
+	// next import spec in the list, or NULL
+	ast_imp_spec *next;
+
+	// may be NULL if the package is not renamed
+	ast_ident *name;
+	ast_str_lit *path;
+
+	ast_imp_spec(ast_str_lit *path);
+	ast_imp_spec(ast_ident *name, ast_str_lit *path);
 };
 
 class ast_imp_decl : public ast_node
 {
 public:
+	// next import declaration in the list, or NULL
 	ast_imp_decl *next;
 
-	ast_imp_decl(ast_imp_spec imp_specs);
+	ast_imp_spec *imp_specs;
+
+	ast_imp_decl(ast_imp_spec *imp_specs);
 };
 
-class ast_imp_spec : public ast_node
+class ast_var_decl : public ast_stmt
 {
 public:
-	ast_imp_spec *next;
+	ast_ident *name;
+
+	// either of these may be NULL, but not both
+	ast_ident *var_type;
+	ast_expr *value;
 
-	ast_imp_spec(ast_str_lit path);
-	ast_imp_spec(ast_ident name, ast_str_lit path);
+	ast_var_decl(ast_ident *name, ast_ident *var_type);
+	ast_var_decl(ast_ident *name, ast_expr *value);
+	ast_var_decl(ast_ident *name, ast_ident *var_type, ast_expr *value);
 };
 
 class ast_block : public ast_node
 {
 public:
-	ast_block(ast_stmt statements);
+	// may be NULL for an empty block
+	ast_stmt *stmts;
+
+	ast_block(ast_stmt *stmts);
 	ast_block();
 };
 
-class ast_stmt : public ast_node
+class ast_func_sig : public ast_node
 {
 public:
-	ast_stmt *next;
+	// list of ast_var_decl linked through next, may be NULL
+	ast_var_decl *args;
+
+	// may be NULL if the function does not return a value
+	ast_ident *return_type;
 
-	ast_stmt(ast_func_decl func_decl);
-	ast_stmt(ast_var_decl var_decl);
-	ast_stmt(ast_expr expr);
+	ast_func_sig(ast_var_decl *args, ast_ident *return_type);
+	ast_func_sig(ast_var_decl *args);
+	ast_func_sig(ast_ident *return_type);
+	ast_func_sig();
 };
 
 class ast_func_decl : public ast_stmt
 {
 public:
-	ast_func_decl(ast_ident name, ast_var_decl args, ast_ident return_type, ast_block block);
+	ast_ident *name;
+	ast_func_sig *sig;
+	ast_block *body;
+
+	ast_func_decl(ast_ident *name, ast_func_sig *sig, ast_block *body);
 };
 
-class ast_var_decl : public ast_stmt
+class ast_return : public ast_stmt
 {
 public:
-	ast_var_decl *next;
+	ast_expr *value;
 
-	ast_var_assign(ast_ident name, ast_ident var_type);
-	ast_var_assign(ast_ident name, ast_expr value);
-	ast_var_assign(ast_ident name, ast_ident var_type, ast_expr value);
+	ast_return(ast_expr *value);
 };
 
-class ast_expr : public ast_stmt
+/* control flow */
+
+class ast_if : public ast_stmt
 {
+public:
+	ast_expr *cond;
+	ast_block *then_block;
+
+	// may be NULL if there is no else branch. An "else if" is a block holding the if
+	ast_block *else_block;
+
+	ast_if(ast_expr *cond, ast_block *then_block, ast_block *else_block);
 };
 
-class ast_ident : public ast_expr
+class ast_for : public ast_stmt
 {
 public:
-	ast_ident(std::string name);
+	// any of these may be NULL, a missing condition is always true
+	ast_expr *init;
+	ast_expr *cond;
+	ast_expr *post;
+
+	ast_block *body;
+
+	ast_for(ast_expr *init, ast_expr *cond, ast_expr *post, ast_block *body);
 };
 
-class ast_int_lit : public ast_expr
+class ast_case_clause : public ast_node
 {
 public:
-	ast_int_lit(std::string value);
+	// next clause of the switch, or NULL
+	ast_case_clause *next;
+
+	// list of ast_expr linked through next, NULL for the default clause
+	ast_expr *values;
+
+	// may be NULL for an empty clause
+	ast_stmt *stmts;
+
+	ast_case_clause(ast_expr *values, ast_stmt *stmts);
 };
 
-class ast_str_lit : public ast_expr
+class ast_switch : public ast_stmt
+{
+public:
+	// may be NULL, the clauses are then chosen by the first value that is true
+	ast_expr *tag;
+
+	// may be NULL for a switch without clauses
+	ast_case_clause *clauses;
+
+	ast_switch(ast_expr *tag, ast_case_clause *clauses);
+};
+
+/* break and continue, told apart by their type */
+class ast_branch : public ast_stmt
 {
 public:
-	ast_int_lit(std::string value);
+	ast_branch(ast_node_type t);
 };
 
+/* expressions */
+
 class ast_operation : public ast_expr
 {
 public:
-	ast_operation(ast_expr lhs, std::string binary_op, ast_expr rhs);
-	ast_operation(std::string unary_op, ast_expr operand);
+	// NULL for unary operations
+	ast_expr *lhs;
+	std::string op;
+	ast_expr *rhs;
+
+	ast_operation(ast_expr *lhs, const std::string &binary_op, ast_expr *rhs);
+	ast_operation(const std::string &unary_op, ast_expr *operand);
 };
 
 class ast_func_call : public ast_expr
 {
 public:
-	ast_func_call(ast_ident name);
-	ast_func_call(ast_ident name, ast_expr args);
+	ast_ident *name;
 
+	// list of ast_expr linked through next, may be NULL
+	ast_expr *args;
+
+	ast_func_call(ast_ident *name);
+	ast_func_call(ast_ident *name, ast_expr *args);
 };
 
 class ast_var_assign : public ast_expr
 {
 public:
-	ast_var_assign(ast_ident name, ast_ident value);
+	ast_ident *name;
+	ast_expr *value;
+
+	ast_var_assign(ast_ident *name, ast_expr *value);
+};
+
+/* name[index] */
+class ast_index : public ast_expr
+{
+public:
+	ast_ident *name;
+	ast_expr *index;
+
+	ast_index(ast_ident *name, ast_expr *index);
+};
+
+/* name[low:high], either bound may be NULL */
+class ast_slice_expr : public ast_expr
+{
+public:
+	ast_ident *name;
+	ast_expr *low;
+	ast_expr *high;
+
+	ast_slice_expr(ast_ident *name, ast_expr *low, ast_expr *high);
+};
+
+/* name[index] = value */
+class ast_index_assign : public ast_expr
+{
+public:
+	ast_ident *name;
+	ast_expr *index;
+	ast_expr *value;
+
+	ast_index_assign(ast_ident *name, ast_expr *index, ast_expr *value);
 };
 
 class ast_root : public ast_node
 {
 public:
-	ast_root(ast_pkg_decl package, ast_imp_decl imports, ast_stmt statements);
+	ast_pkg_decl *package;
+
+	// may be NULL if there are no imports
+	ast_imp_decl *imports;
+
+	// may be NULL if there are no statements
+	ast_stmt *stmts;
+
+	ast_root(ast_pkg_decl *package, ast_imp_decl *imports, ast_stmt *stmts);
+	ast_root(ast_pkg_decl *package, ast_stmt *stmts);
+};
+
+/* traversal */
+
+/* Called by ast_walk for every node of a tree. The nodes of a list are siblings: they
+ * are visited one after the other, at the depth of the first one.
+ */
+class ast_visitor
+{
+public:
+	virtual ~ast_visitor();
+
+	/* called before the children of node, depth is 0 for the root.
+	 * returns false if the children of node should not be visited. */
+	virtual bool enter(ast_node *node, unsigned int depth) = 0;
+
+	/* called after the children of node */
+	virtual void leave(ast_node *node, unsigned int depth);
+};
 
-	ast_root(ast_pkg_decl package, ast_stmt statements);
-}
+/* visits the tree rooted at root depth first. The nodes still to visit are kept on an
+ * explicit stack instead of recursing, so long lists and deeply nested expressions
+ * cannot overflow the call stack. */
+void ast_walk(ast_node *root, ast_visitor &visitor);
 
 #endif
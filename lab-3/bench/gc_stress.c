@@ -0,0 +1,55 @@
+/* Runs bench/gc_stress.go and prints its time and the counters of the collector.
+ *
+ * Churn allocates arrays that escape faster than they die: most become garbage right
+ * away, and one in a hundred is kept by a global until the next replaces it. Deep
+ * recurses with a small and a large array in each frame, churning at each level, and
+ * counts the arrays that changed while their frame waited for the frames above it.
+ *
+ * usage: gc_stress [ITERATIONS]
+ * RT_NURSERY_KB sets the size of the nursery.
+ */
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "../runtime/runtime.hpp"
+
+int64_t Churn(int64_t n);
+int64_t Deep(int64_t depth, int64_t n);
+
+/* the result of Churn(n), computed without allocating */
+static int64_t expected_churn(int64_t n)
+{
+	int64_t total = 0, kept = 0;
+	for (int64_t k = 0; k < n; k++)
+	{
+		if (k % 100 == 0)
+		{
+			kept = k;
+		}
+		// the sums of v + i for i below 64
+		total += 64 * k + 2016 + 64 * kept + 2016;
+	}
+	return total;
+}
+
+int main(int argc, char **argv)
+{
+	int64_t n = argc > 1 ? atoll(argv[1]) : 1000000;
+	struct timespec start, end;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	int64_t total = Churn(n);
+	int64_t changed = 0;
+	for (int i = 0; i < 20; i++)
+	{
+		changed += Deep(100, n / 1000);
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	printf("churn: %s, deep: %lld arrays changed\n", total == expected_churn(n) ? "ok" : "WRONG", (long long) changed);
+	printf("time: %.3f ms\n", (end.tv_sec - start.tv_sec) * 1e3 + (end.tv_nsec - start.tv_nsec) / 1e6);
+	rt_print_stats(stdout);
+	return total != expected_churn(n) || changed;
+}
@@ -0,0 +1,55 @@
+package main
+
+var kept []int
+
+func fill(s []int, v int) {
+	var i = 0
+	for i = 0; i < len(s); i = i + 1 {
+		s[i] = v + i
+	}
+}
+
+func sum(s []int) int {
+	var t = 0
+	var i = 0
+	for i = 0; i < len(s); i = i + 1 {
+		t = t + s[i]
+	}
+	return t
+}
+
+func Churn(n int) int {
+	var total = 0
+	var k = 0
+	for k = 0; k < n; k = k + 1 {
+		var a [64]int
+		var s = a[:]
+		fill(s, k)
+		if k - k / 100 * 100 == 0 {
+			kept = s
+		}
+		total = total + sum(s) + sum(kept)
+	}
+	return total
+}
+
+func Deep(depth int, n int) int {
+	var a [40]int
+	var s = a[:]
+	var b [1000]int
+	var r = b[:]
+	fill(s, depth)
+	fill(r, depth)
+	kept = s
+	kept = r
+	var before = sum(s) + sum(r)
+	var changed = 0
+	if depth > 0 {
+		changed = Deep(depth - 1, n)
+	}
+	Churn(n)
+	if sum(s) + sum(r) != before {
+		changed = changed + 1
+	}
+	return changed
+}
@@ -0,0 +1,20 @@
+#!/bin/sh
+# Prints a program with N functions to standard output, for benchmarking the parsers.
+#
+# usage: gen-input.sh N
+
+n=${1:-1000}
+
+printf 'package main\n\nimport (\n\t"fmt"\n\tstr "strings"\n)\n\n'
+
+awk -v n="$n" 'BEGIN {
+	for (i = 0; i < n; i++) {
+		printf "func f%d(a int, b int) int {\n", i
+		printf "\tvar c int = a * (b + %d) - a / 2\n", i
+		printf "\tvar d = c\n"
+		printf "\td = f%d(c, d + 1) * 3\n", (i > 0 ? i - 1 : 0)
+		printf "\tfmt(d, c)\n"
+		printf "}\n\n"
+		printf "var g%d int = %d\n\n", i, i
+	}
+}'
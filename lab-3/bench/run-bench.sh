@@ -0,0 +1,29 @@
+#!/bin/sh
+# Runs every parser on the input file RUNS times, and prints its fastest wall time.
+#
+# usage: run-bench.sh INPUT RUNS PARSER_EXEC...
+
+input=$1
+runs=$2
+shift 2
+
+printf 'input: %s (%s bytes), best of %s runs\n' "$input" "$(wc -c < "$input")" "$runs"
+
+for exec in "$@"
+do
+	best=
+	i=0
+	while [ "$i" -lt "$runs" ]
+	do
+		start=$(date +%s%N)
+		"$exec" "$input" > /dev/null 2>&1
+		end=$(date +%s%N)
+		ms=$(( (end - start) / 1000000 ))
+		if [ -z "$best" ] || [ "$ms" -lt "$best" ]
+		then
+			best=$ms
+		fi
+		i=$((i + 1))
+	done
+	printf '%-24s %8s ms\n' "$exec" "$best"
+done
@@ -0,0 +1,288 @@
+#include "diagnostics.hpp"
+
+#include <algorithm>
+
+#include "mapped_file.hpp"
+
+static const char *message_texts[num_messages] =
+{
+	"unknown token",
+	"unterminated string literal",
+	"%1",
+	"%1",
+	"not a token file",
+	"%1 redeclared",
+	"return at top level",
+	"too many return values",
+	"undefined: %1",
+	"unexpected expression",
+	"%1() used as value",
+	"cannot call non-function %1",
+	"constant %1 overflows int",
+	"invalid escape sequence %1",
+	"not enough arguments in call to %1",
+	"too many arguments in call to %1",
+	"%1 is not an export file",
+	"duplicate case %1 in switch",
+	"multiple defaults in switch",
+	"break is not in a loop or switch",
+	"continue is not in a loop",
+	"cannot index %1",
+	"cannot use %1 as int value",
+	"cannot use %1 as slice value",
+	"cannot copy array %1, use a slice of it",
+	"invalid array length %1",
+	"index %1 out of range",
+	"cannot return %1, functions return int",
+	"invalid argument %1 for len"
+};
+
+source_span::source_span()
+	: first_line(0), first_column(0), last_line(0), last_column(0)
+{
+}
+
+source_span::source_span(uint32_t first_line, uint32_t first_column, uint32_t last_line, uint32_t last_column)
+	: first_line(first_line), first_column(first_column), last_line(last_line), last_column(last_column)
+{
+}
+
+diagnostic_engine::diagnostic_engine()
+{
+	limit = 10;
+}
+
+/* starts the diagnostics of the file named name, and returns its id */
+uint32_t diagnostic_engine::begin_file(const std::string &name)
+{
+	file_info info = {name, 0, 0, 0};
+	files.push_back(info);
+	return files.size() - 1;
+}
+
+bool diagnostic_engine::diagnostic_key::operator<(const diagnostic_key &other) const
+{
+	if (file != other.file)
+	{
+		return file < other.file;
+	}
+	if (line != other.line)
+	{
+		return line < other.line;
+	}
+	if (message != other.message)
+	{
+		return message < other.message;
+	}
+	if (arg != other.arg)
+	{
+		return arg < other.arg;
+	}
+	return function < other.function;
+}
+
+/* returns the index of str in strings, adding it if add is set, or -1 if it is not */
+int64_t diagnostic_engine::string_id(const std::string &str, bool add)
+{
+	std::map<std::string, uint32_t>::const_iterator it = string_ids.find(str);
+	if (it != string_ids.end())
+	{
+		return it->second;
+	}
+	if (!add)
+	{
+		return -1;
+	}
+	strings.push_back(str);
+	string_ids[str] = strings.size() - 1;
+	return strings.size() - 1;
+}
+
+/* records a diagnostic about the file identified by file, unless it repeats one on the
+ * same line, which is dropped silently, or the file has reached the limit. Past the
+ * limit nothing new is held, so only repeats of the diagnostics kept are recognised. */
+void diagnostic_engine::report(uint32_t file, const source_span &span, diag_message message,
+	const std::string &arg, const std::string &function, diag_severity severity)
+{
+	file_info &info = files[file];
+	bool full = limit && info.kept >= limit;
+
+	if (severity == severity_error)
+	{
+		info.errors++;
+	}
+
+	int64_t arg_id = string_id(arg, !full);
+	int64_t function_id = string_id(function, !full);
+	if (arg_id >= 0 && function_id >= 0)
+	{
+		diagnostic_key key = {file, span.first_line, (uint8_t) message, (uint32_t) arg_id, (uint32_t) function_id};
+		if (seen.count(key))
+		{
+			return;
+		}
+		if (!full)
+		{
+			seen.insert(key);
+		}
+	}
+	if (full)
+	{
+		info.dropped++;
+		return;
+	}
+
+	diagnostic d;
+	d.severity = severity;
+	d.message = message;
+	d.file = file;
+	d.span = span;
+	d.arg = arg_id;
+	d.function = function_id;
+
+	kept.push_back(d);
+	info.kept++;
+}
+
+/* returns the number of errors reported about file, including those dropped */
+std::size_t diagnostic_engine::errors(uint32_t file) const
+{
+	return files[file].errors;
+}
+
+/* orders diagnostics by file, keeping the order they were reported in within each */
+struct by_file
+{
+	template <typename T>
+	bool operator()(const T &a, const T &b) const
+	{
+		return a.file < b.file;
+	}
+};
+
+/* prints the diagnostics kept, in the order they were reported, each followed by
+ * the line of source it is about if the file can still be read. The files are only
+ * read again now, so that nothing is held for those without diagnostics. */
+void diagnostic_engine::render(std::ostream &out)
+{
+	std::stable_sort(kept.begin(), kept.end(), by_file());
+
+	std::vector<diagnostic>::size_type d = 0;
+	for (uint32_t f = 0; f != files.size(); f++)
+	{
+		const file_info &info = files[f];
+		mapped_file source;
+		std::vector<std::size_t> lines;
+
+		if (d != kept.size() && kept[d].file == f && info.name != "-" && !source.map(info.name))
+		{
+			// offset of the start of every line
+			lines.push_back(0);
+			for (std::size_t i = 0; i != source.size; i++)
+			{
+				if (source.data[i] == '\n')
+				{
+					lines.push_back(i + 1);
+				}
+			}
+		}
+
+		for (; d != kept.size() && kept[d].file == f; d++)
+		{
+			const diagnostic &diag = kept[d];
+			const source_span &span = diag.span;
+
+			// the location is printed as yy::location prints it
+			out << info.name << ':';
+			if (span.first_line)
+			{
+				uint32_t end = span.last_column ? span.last_column - 1 : 0;
+				out << span.first_line << '.' << span.first_column;
+				if (span.first_line < span.last_line)
+				{
+					out << '-' << span.last_line << '.' << end;
+				}
+				else if (span.first_column < end)
+				{
+					out << '-' << end;
+				}
+				out << ':';
+			}
+			out << ' ';
+
+			if (diag.severity == severity_warning)
+			{
+				out << "warning: ";
+			}
+			if (!strings[diag.function].empty())
+			{
+				out << "in function " << strings[diag.function] << ": ";
+			}
+			for (const char *c = message_texts[diag.message]; *c; c++)
+			{
+				if (c[0] == '%' && c[1] == '1')
+				{
+					out << strings[diag.arg];
+					c++;
+				}
+				else
+				{
+					out << *c;
+				}
+			}
+			out << std::endl;
+
+			if (span.first_line && span.first_line <= lines.size())
+			{
+				render_snippet(out, diag, source.data, lines, source.size);
+			}
+		}
+
+		if (info.dropped)
+		{
+			out << info.name << ": too many errors, " << info.dropped << " more not shown" << std::endl;
+		}
+	}
+}
+
+/* prints the line of source the diagnostic d is about, with its span underlined.
+ * Tabs are copied to the underline so that it lines up however they are shown. */
+void diagnostic_engine::render_snippet(std::ostream &out, const diagnostic &d, const char *source,
+	const std::vector<std::size_t> &lines, std::size_t size)
+{
+	std::size_t begin = lines[d.span.first_line - 1];
+	std::size_t end = d.span.first_line < lines.size() ? lines[d.span.first_line] - 1 : size;
+	if (end > begin && source[end - 1] == '\r')
+	{
+		end--;
+	}
+	std::size_t length = end - begin;
+
+	out << "    ";
+	out.write(source + begin, length);
+	out << std::endl << "    ";
+
+	std::size_t first = d.span.first_column ? d.span.first_column - 1 : 0;
+	std::size_t last = d.span.first_line == d.span.last_line && d.span.last_column > d.span.first_column
+		? d.span.last_column - 1 : length;
+	for (std::size_t c = 0; c < first && c < length; c++)
+	{
+		out << (source[begin + c] == '\t' ? '\t' : ' ');
+	}
+	out << '^';
+	for (std::size_t c = first + 1; c < last && c < length; c++)
+	{
+		out << '~';
+	}
+	out << std::endl;
+}
+
+/* forgets every file and diagnostic */
+void diagnostic_engine::clear()
+{
+	files.clear();
+	kept.clear();
+	strings.clear();
+	string_ids.clear();
+	seen.clear();
+}
@@ -0,0 +1,153 @@
+#ifndef DIAGNOSTICS_HPP
+#define DIAGNOSTICS_HPP
+
+#include <stdint.h>
+
+#include <cstddef>
+#include <map>
+#include <ostream>
+#include <set>
+#include <string>
+#include <vector>
+
+enum diag_severity
+{
+	severity_error,
+	severity_warning
+};
+
+/* the messages that can be reported, %1 in their text stands for their argument */
+enum diag_message
+{
+	// lexical errors, also stored in token files, so new messages go last
+	msg_unknown_token,
+	msg_unterminated_string,
+
+	// the argument is Bison's description of the syntax error
+	msg_syntax,
+
+	// the argument is the reason, as given by strerror
+	msg_io,
+	msg_not_token_file,
+
+	msg_redeclared,
+	msg_return_at_top_level,
+	msg_too_many_return_values,
+	msg_undefined,
+	msg_unexpected_expression,
+	msg_used_as_value,
+	msg_call_non_function,
+	msg_constant_overflow,
+	msg_invalid_escape,
+	msg_not_enough_arguments,
+	msg_too_many_arguments,
+	msg_not_export_file,
+	msg_duplicate_case,
+	msg_multiple_defaults,
+	msg_misplaced_break,
+	msg_misplaced_continue,
+	msg_not_indexable,
+	msg_not_int,
+	msg_not_slice,
+	msg_array_copy,
+	msg_invalid_array_length,
+	msg_index_out_of_range,
+	msg_array_result,
+	msg_invalid_len,
+
+	num_messages
+};
+
+/* lines and columns from the scanner's locations, starting at 1. The end is the
+ * column after the last character, as in yy::location. Lines are 0 for no location. */
+struct source_span
+{
+	uint32_t first_line, first_column;
+	uint32_t last_line, last_column;
+
+	source_span();
+	source_span(uint32_t first_line, uint32_t first_column, uint32_t last_line, uint32_t last_column);
+};
+
+/* Collects the diagnostics of every input and prints them once processing is over.
+ * Each diagnostic is kept as a message and an argument, so nothing is formatted until
+ * it is printed. A diagnostic repeating the message and argument of one kept on the
+ * same line of the same file is dropped silently, and every other diagnostic of a file
+ * past the first limit of them is dropped and counted, so that error storms do not
+ * hold memory.
+ * An engine is only used by one thread: each driver has its own.
+ */
+class diagnostic_engine
+{
+public:
+	// most diagnostics kept for each file, 0 for no limit
+	std::size_t limit;
+
+	diagnostic_engine();
+
+	/* starts the diagnostics of the file named name, and returns its id */
+	uint32_t begin_file(const std::string &name);
+
+	/* records a diagnostic about the file identified by file. function names the
+	 * function it was found in, if any. */
+	void report(uint32_t file, const source_span &span, diag_message message,
+		const std::string &arg = std::string(), const std::string &function = std::string(),
+		diag_severity severity = severity_error);
+
+	/* returns the number of errors reported about file, including those dropped */
+	std::size_t errors(uint32_t file) const;
+
+	/* prints the diagnostics kept, in the order they were reported, each followed by
+	 * the line of source it is about if the file can still be read. */
+	void render(std::ostream &out);
+
+	/* forgets every file and diagnostic */
+	void clear();
+
+private:
+	struct diagnostic
+	{
+		uint8_t severity;
+		uint8_t message;
+		uint32_t file;
+		source_span span;
+
+		// indices into strings
+		uint32_t arg, function;
+	};
+
+	/* what makes two diagnostics the same, strings are referred to by their index */
+	struct diagnostic_key
+	{
+		uint32_t file, line;
+		uint8_t message;
+		uint32_t arg, function;
+
+		bool operator<(const diagnostic_key &other) const;
+	};
+
+	struct file_info
+	{
+		std::string name;
+		std::size_t kept, dropped, errors;
+	};
+
+	std::vector<file_info> files;
+	std::vector<diagnostic> kept;
+
+	// arguments and function names of the diagnostics kept, each held once
+	std::vector<std::string> strings;
+	std::map<std::string, uint32_t> string_ids;
+
+	// every diagnostic kept
+	std::set<diagnostic_key> seen;
+
+	/* returns the index of str in strings, adding it if add is set, or -1 if it is not */
+	int64_t string_id(const std::string &str, bool add);
+
+	/* prints the line of source the diagnostic d is about, with its span underlined */
+	void render_snippet(std::ostream &out, const diagnostic &d, const char *source,
+		const std::vector<std::size_t> &lines, std::size_t size);
+};
+
+#endif
@@ -1,88 +1,381 @@
-#include <unistd.h>
-
-#include <cstring>
+#include <algorithm>
 #include <iostream>
 
 #include "driver.hpp"
+#ifdef LR_PARSER
+#include "lr_parser.hpp"
+#endif
 
 
-/* command line option flags */
-
-#define	LONG_OPT_TRACE_PARSING		"--parser-traces"
-#define	SHORT_OPT_TRACE_PARSING		"-p"
-#define	LONG_OPT_TRACE_SCANNING		"--scanner-traces"
-#define	SHORT_OPT_TRACE_SCANNING	"-s"
-
 /* constructor/destructor */
 go_driver::go_driver()
 {
+	buffer = NULL;
+	buffer_size = 0;
+	replay = NULL;
+	tree = NULL;
 	trace_scanning = false;
 	trace_parsing = false;
+	timing = NULL;
+	file_id = 0;
 }
 
 go_driver::~go_driver()
 {
 }
 
-/* returns 0 if file denoted by fname was parsed successfully, 1 otherwise. */
+/* returns 0 if file denoted by fname was parsed without errors, 1 otherwise.
+ * parsing continues after syntax errors, so tree may hold a partial AST. */
 int go_driver::parse(const std::string &fname)
 {
   file = fname;
-  scan_begin();
-  yy::go_parser parser(*this);
-  parser.set_debug_level(trace_parsing);
-  int res = parser.parse();
-  scan_end();
+  buffer = NULL;
+  buffer_size = 0;
+  return parse_input();
+}
+
+/* parses size bytes beginning at data instead of a file, name is used in diagnostics.
+ * returns 0 if the input was parsed without errors, 1 otherwise. */
+int go_driver::parse_buffer(const char *data, std::size_t size, const std::string &name)
+{
+  file = name;
+  buffer = data;
+  buffer_size = size;
+  return parse_input();
+}
+
+/* reads the file denoted by fname, "-" for stdin, and scans it whole into tokens.
+ * returns 0 on success, or the errno of the failure to read it. */
+int go_driver::scan_file(const std::string &fname, token_array &tokens)
+{
+  tokens.file = fname;
+  int err = tokens.read_source(fname);
+  if (!err)
+  {
+    scan_tokens(tokens);
+  }
+  return err;
+}
+
+/* parses tokens scanned ahead by scan_tokens instead of running the scanner.
+ * returns 0 if the input was parsed without errors, 1 otherwise. */
+int go_driver::parse_tokens(const token_array &tokens)
+{
+  file = tokens.file;
+  replay = &tokens;
+  replay_next = 0;
+  replay_offset = 0;
+  replay_errors = 0;
+  replay_loc.initialize(&file);
+
+  int res = parse_input();
+  replay = NULL;
   return res;
 }
 
-/* wrapper for private function of the same name */
-int go_driver::print_ast()
+/* parses the input selected by parse, parse_buffer or parse_tokens */
+int go_driver::parse_input()
 {
-	return print_ast(&tree, 0);
+  int res;
+
+  if (timing)
+  {
+    timing->file = file;
+  }
+
+  nodes.clear();
+  strings.clear();
+  tree = NULL;
+  file_id = diagnostics.begin_file(file);
+  if (!replay)
+  {
+    phase_timer timer(timing, time_report::phase_read_input);
+    scan_begin();
+  }
+  {
+    phase_timer timer(timing, time_report::phase_parse);
+#ifdef LR_PARSER
+    lr_parser parser(*this);
+#else
+    yy::go_parser parser(*this);
+    parser.set_debug_level(trace_parsing);
+#endif
+    res = parser.parse();
+  }
+  if (!replay)
+  {
+    phase_timer timer(timing, time_report::phase_read_input);
+    scan_end();
+  }
+  return res || diagnostics.errors(file_id);
 }
 
-/* returns 1 if the AST was printed successfully, 0 otherwise. */
-int go_driver::print_ast(ast_node *node, int indent)
+/* scans the next token, counting the time spent against lexing if the driver is timed */
+go_token yylex(go_driver &driver)
+{
+  if (driver.replay)
+  {
+    return driver.replay_token();
+  }
+  if (!driver.timing)
+  {
+    return scan_token(driver);
+  }
+  phase_timer timer(driver.timing, time_report::phase_lex);
+  return scan_token(driver);
+}
+
+/* moves the location of the replayed tokens over the blanks up to offset */
+void go_driver::replay_blanks(std::size_t offset)
 {
-	if (!node)
+  if (replay_offset == offset)
+  {
+    return;
+  }
+  for (; replay_offset != offset; replay_offset++)
+  {
+    if (replay->source[replay_offset] == '\n')
+    {
+      replay_loc.lines(1);
+    }
+    else
+    {
+      replay_loc.columns(1);
+    }
+  }
+  replay_loc.step();
+}
+
+/* returns the next token of the array being parsed by parse_tokens. Its location is
+ * found from the text since the previous token, as the scanner would have. */
+go_token go_driver::replay_token()
+{
+  typedef yy::go_parser::symbol_kind symbol_kind;
+  const packed_token *token = &replay->tokens[replay_next];
+
+  replay_loc.step();
+  for (; token->kind == TOKEN_ERROR_KIND; token = &replay->tokens[++replay_next])
+  {
+    // the scanner does not start a new location after an error
+    replay_blanks(token->offset);
+    replay_loc.columns(token->length);
+    replay_offset += token->length;
+    error(replay_loc, (diag_message) replay->messages[replay_errors++]);
+  }
+
+  replay_blanks(token->offset);
+  replay_loc.columns(token->length);
+  replay_offset += token->length;
+
+  // the end of input is returned again if the parser asks for more
+  if (token->kind != symbol_kind::S_YYEOF)
+  {
+    replay_next++;
+  }
+
+  int kind = token->kind < symbol_kind::YYNTOKENS ? token->kind : (int) symbol_kind::S_YYUNDEF;
+  bool has_text = kind == symbol_kind::S_IDENTIFIER;
+  const char *text = replay->source.data() + token->offset;
+
+#ifdef LR_PARSER
+  token_loc = replay_loc;
+  if (has_text)
+  {
+    token_text.assign(text, token->length);
+  }
+  else if (kind == symbol_kind::S_INTEGERLITERAL)
+  {
+    token_int = parse_int_literal(text, token->length);
+  }
+  else if (kind == symbol_kind::S_STRINGLITERAL)
+  {
+    token_string = string_literal(text, token->length, replay_loc);
+  }
+  return kind;
+#else
+  // tokens are numbered in the order of their symbol kinds, from YYerror on
+  typedef yy::go_parser::token token_number;
+  int number = kind == symbol_kind::S_YYEOF ? (int) token_number::TOK_END
+    : kind - symbol_kind::S_YYerror + token_number::TOK_YYerror;
+  if (has_text)
+  {
+    return yy::go_parser::symbol_type(number, std::string(text, token->length), replay_loc);
+  }
+  if (kind == symbol_kind::S_INTEGERLITERAL)
+  {
+    return yy::go_parser::symbol_type(number, parse_int_literal(text, token->length), replay_loc);
+  }
+  if (kind == symbol_kind::S_STRINGLITERAL)
+  {
+    return yy::go_parser::symbol_type(number, string_literal(text, token->length, replay_loc), replay_loc);
+  }
+  return yy::go_parser::symbol_type(number, replay_loc);
+#endif
+}
+
+/* decodes the string literal of length bytes at text, found at loc, into strings
+ * and returns its id. Invalid escape sequences are reported. */
+uint32_t go_driver::string_literal(const char *text, std::size_t length, const yy::location &loc)
+{
+  std::size_t bad_escape;
+  uint32_t id = strings.add_literal(text, length, bad_escape);
+
+  if (bad_escape)
+  {
+    // point at the escape sequence, unless the literal spans several lines
+    yy::location at = loc;
+    if (loc.begin.line == loc.end.line)
+    {
+      at.begin.columns(bad_escape);
+      at.end = at.begin;
+      at.end.columns(std::min<std::size_t>(2, length - 1 - bad_escape));
+    }
+    error(at, msg_invalid_escape, std::string(text + bad_escape, std::min<std::size_t>(2, length - 1 - bad_escape)));
+  }
+  return id;
+}
+
+/* prints the string of length bytes at s as a quoted literal */
+static void print_quoted(std::ostream &out, const char *s, std::size_t length)
+{
+	static const char hex[] = "0123456789abcdef";
+
+	out << '"';
+	for (std::size_t i = 0; i != length; i++)
 	{
-		return 0;
+		unsigned char c = s[i];
+		switch (c)
+		{
+			case '"':	out << "\\\"";	break;
+			case '\\':	out << "\\\\";	break;
+			case '\n':	out << "\\n";	break;
+			case '\t':	out << "\\t";	break;
+			case '\r':	out << "\\r";	break;
+			default:
+				if (c < 0x20 || c == 0x7f)
+				{
+					out << "\\x" << hex[c >> 4] << hex[c & 0xf];
+				}
+				else
+				{
+					out << c;
+				}
+		}
 	}
+	out << '"';
+}
+
+/* prints each node of the AST on its own line, indented by its depth */
+class ast_printer : public ast_visitor
+{
+public:
+	ast_printer(const string_pool &strings);
+
+	bool enter(ast_node *node, unsigned int depth);
+
+private:
+	// values of the string literals
+	const string_pool &strings;
+};
+
+ast_printer::ast_printer(const string_pool &strings) : strings(strings)
+{
+}
 
-	for (int i = 0; i < indent; i++)
+bool ast_printer::enter(ast_node *node, unsigned int depth)
+{
+	for (unsigned int i = 0; i < depth; i++)
 	{
 		std::cout << "\t";
 	}
 
 	switch (node->type)
 	{
-		case ast_undefined:
-			std::cout << "undefined";
+		case node_root:
+			std::cout << "root";
 			break;
-		case ast_string_literal:
-			std::cout << "string literal";
+		case node_pkg_decl:
+			std::cout << "package declaration";
 			break;
-		case ast_identifier:
-			std::cout << "identifier";
+		case node_imp_decl:
+			std::cout << "import declaration";
 			break;
-		case ast_import_statement:
-			std::cout << "import statements";
+		case node_imp_spec:
+			std::cout << "import spec";
 			break;
-		case ast_import_item:
-			std::cout << "import item";
+		case node_block:
+			std::cout << "block";
 			break;
-		case ast_package_statement:
-			std::cout << "package statement";
+		case node_func_sig:
+			std::cout << "function signature";
 			break;
-		case ast_import:
-			std::cout << "import";
+		case node_func_decl:
+			std::cout << "function declaration";
 			break;
-		case ast_package:
-			std::cout << "package";
+		case node_var_decl:
+			std::cout << "variable declaration";
 			break;
-		case ast_root:
-			std::cout << "root";
+		case node_return:
+			std::cout << "return";
+			break;
+		case node_ident:
+			std::cout << "identifier " << static_cast<ast_ident *>(node)->name;
+			break;
+		case node_int_lit:
+			std::cout << "integer literal " << static_cast<ast_int_lit *>(node)->value;
+			break;
+		case node_str_lit:
+		{
+			uint32_t value = static_cast<ast_str_lit *>(node)->value;
+			std::cout << "string literal ";
+			print_quoted(std::cout, strings.data(value), strings.length(value));
+			break;
+		}
+		case node_operation:
+			std::cout << "operation " << static_cast<ast_operation *>(node)->op;
+			break;
+		case node_func_call:
+			std::cout << "function call";
+			break;
+		case node_var_assign:
+			std::cout << "assignment";
+			break;
+		case node_if:
+			std::cout << "if";
+			break;
+		case node_for:
+			std::cout << "for";
+			break;
+		case node_switch:
+			std::cout << "switch";
+			break;
+		case node_case_clause:
+			std::cout << (static_cast<ast_case_clause *>(node)->values ? "case clause" : "default clause");
+			break;
+		case node_break:
+			std::cout << "break";
+			break;
+		case node_continue:
+			std::cout << "continue";
+			break;
+		case node_array_type:
+		{
+			ast_array_type *array = static_cast<ast_array_type *>(node);
+			std::cout << (array->length ? "array type " : "slice type ") << array->name;
+			break;
+		}
+		case node_index:
+			std::cout << "index";
+			break;
+		case node_slice_expr:
+		{
+			// the bounds that are given follow the operand
+			ast_slice_expr *slice = static_cast<ast_slice_expr *>(node);
+			std::cout << "slice expression [" << (slice->low ? "low" : "") << ":" << (slice->high ? "high" : "") << "]";
+			break;
+		}
+		case node_index_assign:
+			std::cout << "element assignment";
 			break;
 		default:
 			std::cout << "undefined";
@@ -90,81 +383,48 @@ int go_driver::print_ast(ast_node *node, int indent)
 	}
 	std::cout << std::endl;
 
-	for(std::vector<int>::size_type i = 0; i != node->children.size(); i++)
+	return true;
+}
+
+/* returns 1 if the AST was printed successfully, 0 otherwise. */
+int go_driver::print_ast()
+{
+	if (!tree)
 	{
-		print_ast(&node->children[i], indent + 1);
+		return 0;
 	}
 
-
+	ast_printer printer(strings);
+	ast_walk(tree, printer);
 	return 1;
 }
 
-/* prints an error message including the related location in the input file */
-void go_driver::error(const yy::location& l, const std::string& m)
+/* converts a location of the scanner to a span of the diagnostics */
+source_span go_driver::span_of(const yy::location &l)
 {
-  std::cerr << l << ": " << m << std::endl;
+	return source_span(l.begin.line, l.begin.column, l.end.line, l.end.column);
 }
 
-/* prints an error message */
-void go_driver::error(const std::string& m)
+/* reports a syntax error, described by the parser */
+void go_driver::error(const yy::location& l, const std::string& m)
 {
-  std::cerr << m << std::endl;
+	diagnostics.report(file_id, span_of(l), msg_syntax, m);
 }
 
-/* prints a program usage message */
-void printUsage(std::ostream& outputStream, char *programName)
+/* reports an error at a location in the input */
+void go_driver::error(const yy::location& l, diag_message message, const std::string& arg)
 {
-	outputStream
-		<< "Usage: " << programName << " [OPTION]... [FILE]..." << std::endl
-		<< std::endl
-		<< "\t-p, --parser-traces" << std::endl
-		<< "\t\tInclude parser traces" << std::endl
-		<< "\t-s, --scanner-traces" << std::endl
-		<< "\t\tPrint scanner traces" << std::endl;
+	diagnostics.report(file_id, span_of(l), message, arg);
 }
 
-int main(int argc, char **argv)
+/* reports an error about the input as a whole */
+void go_driver::error(diag_message message, const std::string& arg)
 {
-	go_driver driver;
-	int i = 1;
-
-	while (i < argc)
-	{
-		if ( !strcmp(argv[i], SHORT_OPT_TRACE_PARSING) || !strcmp(argv[i], LONG_OPT_TRACE_PARSING))
-		{
-			driver.trace_parsing = true;
-		}
-		else if (!strcmp(argv[i], SHORT_OPT_TRACE_SCANNING) || !strcmp(argv[i], LONG_OPT_TRACE_SCANNING))
-		{
-			driver.trace_scanning = true;
-		}
-		else if (!driver.parse(argv[i]))
-		{
-			// argument is a file to parse
-
-			// print resulting tree
-		 	driver.print_ast();
-		}
-		else
-		{
-			// argument meaning is unknown
-			std::cerr << "Unrecognised option: " << argv[i] << std::endl;
-			printUsage(std::cerr, argv[0]);
-			return 1;
-		}
-
-		i++;
-	}
-
-	// check if input was piped into the program via stdin
-	if (!isatty(STDIN_FILENO))
-	{
-		if (!driver.parse("-"))
-		{
-			// print resulting tree
-		 	driver.print_ast();
-		}
-	}
+	diagnostics.report(file_id, source_span(), message, arg);
+}
 
-	return 0;
+/* reports an error about the part of the input at span, found in the function named function */
+void go_driver::error(const source_span& span, diag_message message, const std::string& arg, const std::string& function)
+{
+	diagnostics.report(file_id, span, message, arg, function);
 }
@@ -1,47 +1,146 @@
 #ifndef DRIVER_HH
 #define DRIVER_HH
 
+#include <ostream>
+#include <cstddef>
 #include <string>
+#include <vector>
 
 #include "ast_node.hpp"
+#include "diagnostics.hpp"
+#include "mapped_file.hpp"
 #include "parser.h"
+#include "string_pool.hpp"
+#include "time_report.hpp"
+#include "token_array.hpp"
 
 
+#ifdef LR_PARSER
+// the table-driven parser only takes the kind of each token, see lr_parser.hpp
+typedef int go_token;
+#else
+typedef yy::go_parser::symbol_type go_token;
+#endif
+
 // Tell Flex the lexer's prototype ...
-# define YY_DECL yy::go_parser::symbol_type yylex (go_driver& driver)
-// ... and declare it for the parser's sake.
+# define YY_DECL go_token scan_token (go_driver& driver)
 YY_DECL;
 
+// ... and declare the function the parser calls, which times the lexer for --time-report
+go_token yylex (go_driver& driver);
+
 class go_driver
 {
 public:
 	// name of input file for parsing
 	std::string file;
 
-	ast_node tree;
+	// root of the AST built by the last call to parse, NULL if nothing could be parsed
+	ast_root *tree;
+
+	// owns every node of the AST
+	ast_pool nodes;
+
+	// values of the string literals of the AST
+	string_pool strings;
+
+	// errors found in every input parsed, printed once they have all been processed
+	diagnostic_engine diagnostics;
+
+	// text or value, and location of the last token scanned, for the table-driven parser
+	std::string token_text;
+	int_literal token_int;
+	uint32_t token_string;
+	yy::location token_loc;
 
 	// whether parser/scanner traces should be shown
 	bool trace_scanning, trace_parsing;
 
+	// where the time spent in each phase is counted, NULL if it is not
+	time_report *timing;
+
 	// setup and teardown functions for scanner
 	void scan_begin();
 	void scan_end();
 
+	/* scans the whole of tokens.source into tokens. Lexical errors are recorded as tokens,
+	 * so that they are reported in the same order when the tokens are parsed. */
+	void scan_tokens(token_array &tokens);
+
+	/* reads the file denoted by fname, "-" for stdin, and scans it whole into tokens.
+	 * returns 0 on success, or the errno of the failure to read it. */
+	int scan_file(const std::string &fname, token_array &tokens);
+
 	go_driver();
 	virtual ~go_driver();
 
-	/* returns 1 if file denoted by fname was parsed successfully, 0 otherwise. */
+	/* returns 0 if file denoted by fname was parsed without errors, 1 otherwise.
+	 * parsing continues after syntax errors, so tree may hold a partial AST. */
 	int parse(const std::string& fname);
 
-	/* wrapper for private function of the same name */
+	/* parses size bytes beginning at data instead of a file, name is used in diagnostics.
+	 * returns 0 if the input was parsed without errors, 1 otherwise. */
+	int parse_buffer(const char *data, std::size_t size, const std::string &name);
+
+	/* parses tokens scanned ahead by scan_tokens instead of running the scanner.
+	 * returns 0 if the input was parsed without errors, 1 otherwise. */
+	int parse_tokens(const token_array &tokens);
+
+	/* decodes the string literal of length bytes at text, found at loc, into strings
+	 * and returns its id. Invalid escape sequences are reported. */
+	uint32_t string_literal(const char *text, std::size_t length, const yy::location &loc);
+
+	/* adds node to nodes as parsed from the part of the input at l, and returns it */
+	template <class T>
+	T *add(T *node, const yy::location &l)
+	{
+		node->span = span_of(l);
+		return nodes.add(node);
+	}
+
+	/* converts a location of the scanner to a span of the diagnostics */
+	static source_span span_of(const yy::location &l);
+
+	/* returns the next token of the array being parsed by parse_tokens */
+	go_token replay_token();
+
+	/* returns 1 if the AST was printed successfully, 0 otherwise. */
 	int print_ast();
 
-	// Error handling.
+	// Error handling, about the input being parsed.
 	void error(const yy::location& l, const std::string& m);
-	void error(const std::string& m);
+	void error(const yy::location& l, diag_message message, const std::string& arg = std::string());
+	void error(diag_message message, const std::string& arg = std::string());
+	void error(const source_span& span, diag_message message, const std::string& arg = std::string(),
+		const std::string& function = std::string());
 
 private:
-	/* returns 1 if the AST was printed successfully, 0 otherwise. */
-	int print_ast(ast_node *node, int indent);
+	friend go_token yylex(go_driver &driver);
+
+	// input held in memory for the scanner, NULL when reading from file
+	const char *buffer;
+	std::size_t buffer_size;
+
+	// id of the input being parsed in diagnostics
+	uint32_t file_id;
+
+	// file scanned in place, unmapped when reading through stdio
+	mapped_file mapped;
+
+	// tokens parsed instead of running the scanner, NULL when scanning
+	const token_array *replay;
+
+	// next token and error message to parse from replay, end of the last token
+	// in its source, and location of that token
+	std::size_t replay_next;
+	std::size_t replay_errors;
+	std::size_t replay_offset;
+	yy::location replay_loc;
+
+	/* moves the location of the replayed tokens over the blanks up to offset */
+	void replay_blanks(std::size_t offset);
+
+	/* parses the input selected by parse or parse_buffer */
+	int parse_input();
 };
 #endif
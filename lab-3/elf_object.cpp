@@ -0,0 +1,217 @@
+#include "elf_object.hpp"
+
+#include <elf.h>
+
+#include "runtime/stack_map.hpp"
+
+#include <cstdio>
+#include <cstring>
+
+/* section header indices */
+enum
+{
+	sec_null,
+	sec_text,
+	sec_bss,
+	sec_gc_roots,
+	sec_symtab,
+	sec_strtab,
+	sec_rela_text,
+	sec_rela_gc_roots,
+	sec_shstrtab,
+	sec_note_stack,
+	num_sections
+};
+
+/* appends size bytes at data to buf, after padding it to a multiple of align */
+static std::size_t append(std::vector<unsigned char> &buf, const void *data, std::size_t size, std::size_t align)
+{
+	while (buf.size() % align)
+	{
+		buf.push_back(0);
+	}
+	std::size_t offset = buf.size();
+	buf.insert(buf.end(), (const unsigned char *) data, (const unsigned char *) data + size);
+	return offset;
+}
+
+/* appends str and its terminating NUL to a string table, returns its offset */
+static uint32_t add_string(std::vector<char> &table, const std::string &str)
+{
+	uint32_t offset = table.size();
+	table.insert(table.end(), str.begin(), str.end());
+	table.push_back('\0');
+	return offset;
+}
+
+/* writes the object to the file denoted by fname, symbols holds the name of each symbol.
+ * returns 0 on success, 1 otherwise with errno set. */
+int elf_object::write(const std::string &fname, const std::vector<std::string> &symbols) const
+{
+	std::vector<unsigned char> file;
+	std::vector<char> strtab(1, '\0'), shstrtab(1, '\0');
+	std::vector<Elf64_Sym> symtab;
+	std::vector<Elf64_Rela> rela, rela_roots;
+	std::vector<uint32_t> elf_index(symbols.size(), 0);
+	Elf64_Shdr sections[num_sections];
+	Elf64_Ehdr header;
+	Elf64_Sym sym;
+
+	// symbol 0 is reserved, and all the others are global
+	std::memset(&sym, 0, sizeof(sym));
+	symtab.push_back(sym);
+
+	for (std::vector<elf_function>::size_type f = 0; f != functions.size(); f++)
+	{
+		sym.st_name = add_string(strtab, symbols[functions[f].symbol]);
+		sym.st_info = ELF64_ST_INFO(STB_GLOBAL, STT_FUNC);
+		sym.st_shndx = sec_text;
+		sym.st_value = functions[f].offset;
+		sym.st_size = functions[f].size;
+		elf_index[functions[f].symbol] = symtab.size();
+		symtab.push_back(sym);
+	}
+	uint64_t bss_size = 0;
+	for (std::vector<uint32_t>::size_type v = 0; v != variables.size(); v++)
+	{
+		sym.st_name = add_string(strtab, symbols[variables[v]]);
+		sym.st_info = ELF64_ST_INFO(STB_GLOBAL, STT_OBJECT);
+		sym.st_shndx = sec_bss;
+		sym.st_value = bss_size;
+		sym.st_size = 8 * (uint64_t) variable_words[v];
+		bss_size += sym.st_size;
+		elf_index[variables[v]] = symtab.size();
+		symtab.push_back(sym);
+	}
+	for (std::vector<elf_reloc>::size_type r = 0; r != relocs.size(); r++)
+	{
+		uint32_t s = relocs[r].symbol;
+		if (!elf_index[s])
+		{
+			sym.st_name = add_string(strtab, symbols[s]);
+			sym.st_info = ELF64_ST_INFO(STB_GLOBAL, STT_NOTYPE);
+			sym.st_shndx = SHN_UNDEF;
+			sym.st_value = 0;
+			sym.st_size = 0;
+			elf_index[s] = symtab.size();
+			symtab.push_back(sym);
+		}
+
+		Elf64_Rela entry;
+		entry.r_offset = relocs[r].offset;
+		entry.r_info = ELF64_R_INFO(elf_index[s], relocs[r].type);
+		entry.r_addend = relocs[r].addend;
+		rela.push_back(entry);
+	}
+
+	// an 8-byte address for each root, filled in by the linker
+	std::vector<unsigned char> roots_data(8 * roots.size(), 0);
+	for (std::vector<uint32_t>::size_type r = 0; r != roots.size(); r++)
+	{
+		Elf64_Rela entry;
+		entry.r_offset = 8 * r;
+		entry.r_info = ELF64_R_INFO(elf_index[roots[r]], R_X86_64_64);
+		entry.r_addend = 0;
+		rela_roots.push_back(entry);
+	}
+
+	std::memset(sections, 0, sizeof(sections));
+	std::memset(&header, 0, sizeof(header));
+	file.resize(sizeof(header));
+
+	sections[sec_text].sh_name = add_string(shstrtab, ".text");
+	sections[sec_text].sh_type = SHT_PROGBITS;
+	sections[sec_text].sh_flags = SHF_ALLOC | SHF_EXECINSTR;
+	sections[sec_text].sh_offset = append(file, text.empty() ? NULL : &text[0], text.size(), 16);
+	sections[sec_text].sh_size = text.size();
+	sections[sec_text].sh_addralign = 16;
+
+	sections[sec_bss].sh_name = add_string(shstrtab, ".bss");
+	sections[sec_bss].sh_type = SHT_NOBITS;
+	sections[sec_bss].sh_flags = SHF_ALLOC | SHF_WRITE;
+	sections[sec_bss].sh_offset = file.size();
+	sections[sec_bss].sh_size = bss_size;
+	sections[sec_bss].sh_addralign = 8;
+
+	sections[sec_gc_roots].sh_name = add_string(shstrtab, GC_ROOTS_SECTION);
+	sections[sec_gc_roots].sh_type = SHT_PROGBITS;
+	sections[sec_gc_roots].sh_flags = SHF_ALLOC | SHF_WRITE;
+	sections[sec_gc_roots].sh_offset = append(file, roots_data.empty() ? NULL : &roots_data[0], roots_data.size(), 8);
+	sections[sec_gc_roots].sh_size = roots_data.size();
+	sections[sec_gc_roots].sh_addralign = 8;
+
+	sections[sec_symtab].sh_name = add_string(shstrtab, ".symtab");
+	sections[sec_symtab].sh_type = SHT_SYMTAB;
+	sections[sec_symtab].sh_offset = append(file, &symtab[0], symtab.size() * sizeof(Elf64_Sym), 8);
+	sections[sec_symtab].sh_size = symtab.size() * sizeof(Elf64_Sym);
+	sections[sec_symtab].sh_link = sec_strtab;
+	sections[sec_symtab].sh_info = 1;		// index of the first global symbol
+	sections[sec_symtab].sh_addralign = 8;
+	sections[sec_symtab].sh_entsize = sizeof(Elf64_Sym);
+
+	sections[sec_strtab].sh_name = add_string(shstrtab, ".strtab");
+	sections[sec_strtab].sh_type = SHT_STRTAB;
+	sections[sec_strtab].sh_offset = append(file, &strtab[0], strtab.size(), 1);
+	sections[sec_strtab].sh_size = strtab.size();
+	sections[sec_strtab].sh_addralign = 1;
+
+	sections[sec_rela_text].sh_name = add_string(shstrtab, ".rela.text");
+	sections[sec_rela_text].sh_type = SHT_RELA;
+	sections[sec_rela_text].sh_flags = SHF_INFO_LINK;
+	sections[sec_rela_text].sh_offset = append(file, rela.empty() ? NULL : &rela[0], rela.size() * sizeof(Elf64_Rela), 8);
+	sections[sec_rela_text].sh_size = rela.size() * sizeof(Elf64_Rela);
+	sections[sec_rela_text].sh_link = sec_symtab;
+	sections[sec_rela_text].sh_info = sec_text;
+	sections[sec_rela_text].sh_addralign = 8;
+	sections[sec_rela_text].sh_entsize = sizeof(Elf64_Rela);
+
+	sections[sec_rela_gc_roots].sh_name = add_string(shstrtab, ".rela" GC_ROOTS_SECTION);
+	sections[sec_rela_gc_roots].sh_type = SHT_RELA;
+	sections[sec_rela_gc_roots].sh_flags = SHF_INFO_LINK;
+	sections[sec_rela_gc_roots].sh_offset = append(file, rela_roots.empty() ? NULL : &rela_roots[0],
+		rela_roots.size() * sizeof(Elf64_Rela), 8);
+	sections[sec_rela_gc_roots].sh_size = rela_roots.size() * sizeof(Elf64_Rela);
+	sections[sec_rela_gc_roots].sh_link = sec_symtab;
+	sections[sec_rela_gc_roots].sh_info = sec_gc_roots;
+	sections[sec_rela_gc_roots].sh_addralign = 8;
+	sections[sec_rela_gc_roots].sh_entsize = sizeof(Elf64_Rela);
+
+	// an empty note marks the stack as not executable
+	sections[sec_note_stack].sh_name = add_string(shstrtab, ".note.GNU-stack");
+	sections[sec_note_stack].sh_type = SHT_PROGBITS;
+	sections[sec_note_stack].sh_offset = file.size();
+	sections[sec_note_stack].sh_addralign = 1;
+
+	sections[sec_shstrtab].sh_name = add_string(shstrtab, ".shstrtab");
+	sections[sec_shstrtab].sh_type = SHT_STRTAB;
+	sections[sec_shstrtab].sh_offset = append(file, &shstrtab[0], shstrtab.size(), 1);
+	sections[sec_shstrtab].sh_size = shstrtab.size();
+	sections[sec_shstrtab].sh_addralign = 1;
+
+	std::memcpy(header.e_ident, ELFMAG, SELFMAG);
+	header.e_ident[EI_CLASS] = ELFCLASS64;
+	header.e_ident[EI_DATA] = ELFDATA2LSB;
+	header.e_ident[EI_VERSION] = EV_CURRENT;
+	header.e_ident[EI_OSABI] = ELFOSABI_SYSV;
+	header.e_type = ET_REL;
+	header.e_machine = EM_X86_64;
+	header.e_version = EV_CURRENT;
+	header.e_shoff = append(file, sections, sizeof(sections), 8);
+	header.e_ehsize = sizeof(Elf64_Ehdr);
+	header.e_shentsize = sizeof(Elf64_Shdr);
+	header.e_shnum = num_sections;
+	header.e_shstrndx = sec_shstrtab;
+	std::memcpy(&file[0], &header, sizeof(header));
+
+	FILE *out = fopen(fname.c_str(), "wb");
+	if (!out)
+	{
+		return 1;
+	}
+	std::size_t written = fwrite(&file[0], 1, file.size(), out);
+	if (fclose(out) || written != file.size())
+	{
+		return 1;
+	}
+	return 0;
+}
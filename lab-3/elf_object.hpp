@@ -0,0 +1,56 @@
+#ifndef ELF_OBJECT_HPP
+#define ELF_OBJECT_HPP
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+/* a reference from the code to a symbol, patched by the linker */
+struct elf_reloc
+{
+	// position in .text of the field to patch
+	uint32_t offset;
+
+	// index into the symbol names given to elf_object::write
+	uint32_t symbol;
+
+	// R_X86_64_* relocation type
+	uint32_t type;
+	int64_t addend;
+};
+
+/* a function defined in .text */
+struct elf_function
+{
+	uint32_t symbol;
+	uint32_t offset;
+	uint32_t size;
+};
+
+/* Relocatable x86-64 ELF object file, with code in .text and variables in .bss.
+ * Every defined symbol is global, and symbols that are only referenced are undefined.
+ * The gc_roots section lists the address of the variables the garbage collector of the
+ * runtime must update, see runtime/stack_map.hpp.
+ */
+class elf_object
+{
+public:
+	std::vector<unsigned char> text;
+	std::vector<elf_function> functions;
+
+	// symbols of the zero-initialised variables in .bss, and their size in 8-byte words
+	std::vector<uint32_t> variables;
+	std::vector<uint32_t> variable_words;
+
+	// symbols of the variables listed in gc_roots
+	std::vector<uint32_t> roots;
+
+	std::vector<elf_reloc> relocs;
+
+	/* writes the object to the file denoted by fname, symbols holds the name of each symbol.
+	 * returns 0 on success, 1 otherwise with errno set. */
+	int write(const std::string &fname, const std::vector<std::string> &symbols) const;
+};
+
+#endif
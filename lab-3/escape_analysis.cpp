@@ -0,0 +1,393 @@
+#include "escape_analysis.hpp"
+
+/* the shape of a variable of the given type, as for ir_builder */
+static int is_array_type(ast_ident *type, bool slice)
+{
+	return type && type->type == node_array_type && !static_cast<ast_array_type *>(type)->length == slice;
+}
+
+/* Records every function declared in the tree, with a location for each slice parameter,
+ * and the global slices, before any call or assignment is analysed */
+class escape_analysis::collector : public ast_visitor
+{
+public:
+	escape_analysis &analysis;
+
+	// nesting of function declarations and blocks, globals are declared outside of any
+	unsigned int functions;
+	unsigned int blocks;
+
+	explicit collector(escape_analysis &analysis) : analysis(analysis), functions(0), blocks(0)
+	{
+	}
+
+	bool enter(ast_node *node, unsigned int)
+	{
+		if (node->type == node_func_decl)
+		{
+			ast_func_decl *decl = static_cast<ast_func_decl *>(node);
+			function_info &info = analysis.functions[decl->name->name];
+			info.params.clear();
+			for (ast_var_decl *arg = decl->sig->args; arg; arg = static_cast<ast_var_decl *>(arg->next))
+			{
+				info.params.push_back(is_array_type(arg->var_type, true)
+					? (int) analysis.add_location(arg, decl->name->name, false, true) : -1);
+			}
+			functions++;
+			return true;
+		}
+		if (node->type == node_block)
+		{
+			blocks++;
+		}
+		if (node->type == node_var_decl && !functions && !blocks)
+		{
+			ast_var_decl *decl = static_cast<ast_var_decl *>(node);
+			if (is_array_type(decl->var_type, true) || (!decl->var_type && decl->value
+				&& decl->value->type == node_slice_expr))
+			{
+				analysis.global_slices[decl->name->name] = true;
+			}
+		}
+		return true;
+	}
+
+	void leave(ast_node *node, unsigned int)
+	{
+		if (node->type == node_func_decl)
+		{
+			functions--;
+		}
+		if (node->type == node_block)
+		{
+			blocks--;
+		}
+	}
+};
+
+/* Follows the slices through the declarations, assignments and calls of every function,
+ * with the names in scope at each. Statements outside of functions form the init function. */
+class escape_analysis::analyser : public ast_visitor
+{
+public:
+	escape_analysis &analysis;
+
+	// the function being analysed last, those it is declared in before it
+	std::vector<scope_stack> stack;
+
+	analyser(escape_analysis &analysis, const std::string &init_name) : analysis(analysis)
+	{
+		scope_stack init;
+		init.body = NULL;
+		init.function = init_name;
+		stack.push_back(init);
+	}
+
+	/* returns 1 if name is a local variable of the function being analysed */
+	int is_local(const std::string &name)
+	{
+		const std::vector<std::map<std::string, int> > &scopes = stack.back().scopes;
+		for (std::vector<std::map<std::string, int> >::size_type s = 0; s != scopes.size(); s++)
+		{
+			if (scopes[s].count(name))
+			{
+				return 1;
+			}
+		}
+		return 0;
+	}
+
+	/* the slice expr takes flows into location, or escapes for reason if location is -1 */
+	void flow(ast_expr *expr, int location, const std::string &reason)
+	{
+		int from = analysis.source(stack.back(), expr);
+		if (from < 0)
+		{
+			return;
+		}
+		if (location >= 0)
+		{
+			analysis.locations[location].sources.push_back(from);
+		}
+		else if (analysis.locations[from].reason.empty())
+		{
+			analysis.locations[from].reason = reason;
+		}
+	}
+
+	/* a slice passed to a parameter flows into it, and one passed to a function declared
+	 * elsewhere escapes, as nothing is known of what it does with it */
+	void call(ast_func_call *call)
+	{
+		const std::string &name = call->name->name;
+		std::map<std::string, function_info>::const_iterator callee = analysis.functions.find(name);
+		if (callee == analysis.functions.end() && name == "len")
+		{
+			return;
+		}
+
+		std::vector<int>::size_type p = 0;
+		for (ast_expr *arg = call->args; arg; arg = static_cast<ast_expr *>(arg->next), p++)
+		{
+			if (callee == analysis.functions.end())
+			{
+				flow(arg, -1, "passed to external function " + name);
+			}
+			else if (p < callee->second.params.size() && callee->second.params[p] >= 0)
+			{
+				flow(arg, callee->second.params[p], "");
+			}
+		}
+	}
+
+	/* returns the kind of variable decl declares: 1 for an array, 2 for a slice, 0 otherwise */
+	int kind_of(ast_var_decl *decl)
+	{
+		if (decl->var_type)
+		{
+			return is_array_type(decl->var_type, false) ? 1 : is_array_type(decl->var_type, true) ? 2 : 0;
+		}
+		if (decl->value->type == node_slice_expr)
+		{
+			return 2;
+		}
+		if (decl->value->type != node_ident)
+		{
+			return 0;
+		}
+		const std::string &name = static_cast<ast_ident *>(decl->value)->name;
+		int location = analysis.lookup(stack.back(), name);
+		if (location >= 0)
+		{
+			return analysis.locations[location].is_array ? 0 : 2;
+		}
+		return !is_local(name) && analysis.global_slices.count(name) ? 2 : 0;
+	}
+
+	bool enter(ast_node *node, unsigned int)
+	{
+		scope_stack &scope = stack.back();
+
+		switch (node->type)
+		{
+			case node_func_decl:
+			{
+				// nested functions cannot refer to the locals of the enclosing one
+				ast_func_decl *decl = static_cast<ast_func_decl *>(node);
+				scope_stack inner;
+				inner.body = decl->body;
+				inner.function = decl->name->name;
+				inner.scopes.push_back(std::map<std::string, int>());
+				const function_info &info = analysis.functions[decl->name->name];
+				std::vector<int>::size_type p = 0;
+				for (ast_var_decl *arg = decl->sig->args; arg; arg = static_cast<ast_var_decl *>(arg->next), p++)
+				{
+					inner.scopes.back()[arg->name->name] = info.params[p];
+				}
+				stack.push_back(inner);
+				return true;
+			}
+			case node_func_sig:
+				return false;
+			case node_block:
+				if (node != scope.body)
+				{
+					scope.scopes.push_back(std::map<std::string, int>());
+				}
+				return true;
+			case node_case_clause:
+				scope.scopes.push_back(std::map<std::string, int>());
+				return true;
+			case node_var_decl:
+			{
+				ast_var_decl *decl = static_cast<ast_var_decl *>(node);
+				int kind = scope.scopes.empty() ? 0 : kind_of(decl);
+				if (kind)
+				{
+					uint32_t location = analysis.add_location(decl, scope.function, kind == 1, false);
+					if (decl->value)
+					{
+						flow(decl->value, location, "");
+					}
+				}
+				return true;
+			}
+			case node_var_assign:
+			{
+				ast_var_assign *assign = static_cast<ast_var_assign *>(node);
+				const std::string &name = assign->name->name;
+				int location = analysis.lookup(scope, name);
+				if (location >= 0)
+				{
+					flow(assign->value, location, "");
+				}
+				else if (!is_local(name) && analysis.global_slices.count(name))
+				{
+					flow(assign->value, -1, "assigned to global " + name);
+				}
+				return true;
+			}
+			case node_func_call:
+				call(static_cast<ast_func_call *>(node));
+				return true;
+			default:
+				return true;
+		}
+	}
+
+	void leave(ast_node *node, unsigned int)
+	{
+		scope_stack &scope = stack.back();
+
+		switch (node->type)
+		{
+			case node_func_decl:
+				stack.pop_back();
+				break;
+			case node_block:
+				if (node != scope.body)
+				{
+					scope.scopes.pop_back();
+				}
+				break;
+			case node_case_clause:
+				scope.scopes.pop_back();
+				break;
+			case node_var_decl:
+			{
+				// declared after its value, which may refer to a variable it hides
+				ast_var_decl *decl = static_cast<ast_var_decl *>(node);
+				if (!scope.scopes.empty())
+				{
+					std::map<const ast_var_decl *, uint32_t>::const_iterator it = analysis.declared.find(decl);
+					scope.scopes.back()[decl->name->name] = it != analysis.declared.end() ? (int) it->second : -1;
+				}
+				break;
+			}
+			default:
+				break;
+		}
+	}
+};
+
+escape_analysis::escape_analysis(ast_root *tree)
+{
+	collector functions(*this);
+	ast_walk(tree, functions);
+
+	analyser slices(*this, (tree->package ? tree->package->name->name : "main") + ".init");
+	ast_walk(tree, slices);
+
+	propagate();
+}
+
+/* returns 1 if the array declared by decl must outlive the frame of its function */
+int escape_analysis::escapes(const ast_var_decl *decl) const
+{
+	std::map<const ast_var_decl *, uint32_t>::const_iterator it = declared.find(decl);
+	return it != declared.end() && !locations[it->second].reason.empty();
+}
+
+/* prints where each local array and slice parameter is kept, and why it escapes */
+void escape_analysis::report(std::ostream &out) const
+{
+	for (std::vector<location>::size_type l = 0; l != locations.size(); l++)
+	{
+		const location &loc = locations[l];
+		const std::string &name = loc.decl->name->name;
+		if (!loc.is_array && !loc.is_param)
+		{
+			continue;
+		}
+
+		out << "escape: " << loc.function << ": ";
+		if (loc.reason.empty())
+		{
+			out << (loc.is_param ? "parameter " : "") << name << " does not escape" << std::endl;
+		}
+		else
+		{
+			out << (loc.is_param ? "leaking parameter: " : "moved to heap: ") << name
+				<< " (" << loc.reason << ")" << std::endl;
+		}
+	}
+}
+
+/* returns the location of the array or slice expr takes a slice of, or -1 */
+int escape_analysis::source(const scope_stack &scope, ast_expr *expr) const
+{
+	if (expr->type == node_slice_expr)
+	{
+		return lookup(scope, static_cast<ast_slice_expr *>(expr)->name->name);
+	}
+	if (expr->type == node_ident)
+	{
+		return lookup(scope, static_cast<ast_ident *>(expr)->name);
+	}
+	return -1;
+}
+
+/* returns the location called name in scope, or -1 */
+int escape_analysis::lookup(const scope_stack &scope, const std::string &name) const
+{
+	for (std::vector<std::map<std::string, int> >::size_type s = scope.scopes.size(); s-- > 0;)
+	{
+		std::map<std::string, int>::const_iterator it = scope.scopes[s].find(name);
+		if (it != scope.scopes[s].end())
+		{
+			return it->second;
+		}
+	}
+	return -1;
+}
+
+/* adds a location for the array or slice declared by decl */
+uint32_t escape_analysis::add_location(const ast_var_decl *decl, const std::string &function, bool is_array,
+	bool is_param)
+{
+	location loc;
+	loc.decl = decl;
+	loc.function = function;
+	loc.is_array = is_array;
+	loc.is_param = is_param;
+	locations.push_back(loc);
+	declared[decl] = locations.size() - 1;
+	return locations.size() - 1;
+}
+
+/* marks the locations whose slices reach an escaping one as escaping too, naming the
+ * variable or parameter each escapes through */
+void escape_analysis::propagate()
+{
+	std::vector<uint32_t> worklist;
+
+	for (std::vector<location>::size_type l = 0; l != locations.size(); l++)
+	{
+		if (!locations[l].reason.empty())
+		{
+			worklist.push_back(l);
+		}
+	}
+	while (!worklist.empty())
+	{
+		const location &to = locations[worklist.back()];
+		worklist.pop_back();
+		for (std::vector<uint32_t>::size_type s = 0; s != to.sources.size(); s++)
+		{
+			location &from = locations[to.sources[s]];
+			if (!from.reason.empty())
+			{
+				continue;
+			}
+			if (to.is_param && to.function != from.function)
+			{
+				from.reason = "passed to " + to.function + ", leaking parameter " + to.decl->name->name;
+			}
+			else
+			{
+				from.reason = "flows to " + to.decl->name->name;
+			}
+			worklist.push_back(to.sources[s]);
+		}
+	}
+}
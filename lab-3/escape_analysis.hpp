@@ -0,0 +1,87 @@
+#ifndef ESCAPE_ANALYSIS_HPP
+#define ESCAPE_ANALYSIS_HPP
+
+#include <map>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "ast_node.hpp"
+
+/* Finds the local arrays that may be referred to after their function returns, which
+ * must be allocated on the heap, over the function declarations of a tree.
+ *
+ * Only slices refer to arrays, so the analysis follows where slices go: a slice of an
+ * array, or a slice holding one, flows into the slice variables it is assigned to and the
+ * slice parameters it is passed to. An array escapes if a slice of it reaches a global
+ * variable, a function of another file, or a parameter of a function it escapes from.
+ * Flows are recorded whatever the order of the statements, so a variable assigned an
+ * escaping slice anywhere escapes everywhere.
+ */
+class escape_analysis
+{
+public:
+	explicit escape_analysis(ast_root *tree);
+
+	/* returns 1 if the array declared by decl must outlive the frame of its function */
+	int escapes(const ast_var_decl *decl) const;
+
+	/* prints where each local array and slice parameter is kept, and why it escapes */
+	void report(std::ostream &out) const;
+
+private:
+	/* a local array or slice, or a slice parameter */
+	struct location
+	{
+		const ast_var_decl *decl;
+		std::string function;
+		bool is_array;
+		bool is_param;
+
+		// the locations whose slices flow into this one
+		std::vector<uint32_t> sources;
+
+		// why the location escapes, empty if it does not
+		std::string reason;
+	};
+
+	/* a function declared in the tree, and the location of each slice parameter, -1 for others */
+	struct function_info
+	{
+		std::vector<int> params;
+	};
+
+	/* what a name refers to in a function: a location, -1 for an int variable */
+	struct scope_stack
+	{
+		std::vector<std::map<std::string, int> > scopes;
+
+		// the block of the function, whose scope is that of its parameters
+		ast_block *body;
+		std::string function;
+	};
+
+	class collector;
+	class analyser;
+
+	std::vector<location> locations;
+	std::map<std::string, function_info> functions;
+	std::map<const ast_var_decl *, uint32_t> declared;
+
+	// names of the global slices
+	std::map<std::string, bool> global_slices;
+
+	/* returns the location of the array or slice expr takes a slice of, or -1 */
+	int source(const scope_stack &scope, ast_expr *expr) const;
+
+	/* returns the location called name in scope, or -1 */
+	int lookup(const scope_stack &scope, const std::string &name) const;
+
+	/* adds a location for the array or slice declared by decl */
+	uint32_t add_location(const ast_var_decl *decl, const std::string &function, bool is_array, bool is_param);
+
+	/* marks the locations whose slices reach an escaping one as escaping too */
+	void propagate();
+};
+
+#endif
@@ -0,0 +1,173 @@
+#include "export_data.hpp"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+
+static const char export_magic[4] = {'G', 'O', 'X', 'P'};
+static const uint32_t export_version = 1;
+
+/* FNV-1a hash of the length bytes at name */
+static uint32_t hash_name(const char *name, std::size_t length)
+{
+	uint32_t hash = 2166136261u;
+	for (std::size_t i = 0; i != length; i++)
+	{
+		hash = (hash ^ (unsigned char) name[i]) * 16777619u;
+	}
+	return hash;
+}
+
+export_data::export_data()
+{
+	head = NULL;
+	buckets = NULL;
+	mapped_entries = NULL;
+	mapped_names = NULL;
+}
+
+/* adds an exported name, before the file is written */
+void export_data::add(const std::string &name, export_kind kind, uint32_t num_params, bool has_result)
+{
+	export_entry entry;
+	entry.hash = hash_name(name.data(), name.size());
+	entry.name_offset = names.size();
+	entry.name_length = name.size();
+	entry.kind = kind;
+	entry.has_result = has_result;
+	entry.num_params = num_params;
+	entries.push_back(entry);
+	names += name;
+}
+
+/* writes n bytes beginning at data to out, returns 1 if they were all written */
+static int write_bytes(FILE *out, const void *data, std::size_t n)
+{
+	return !n || fwrite(data, 1, n, out) == n;
+}
+
+/* writes the names added to the file denoted by fname. The table has at least twice
+ * as many buckets as there are names, a power of two, each holding 1 more than the
+ * index of an entry or 0 if it is empty. Collisions go to the next free bucket. */
+int export_data::write(const std::string &fname) const
+{
+	header h;
+	memcpy(h.magic, export_magic, sizeof(h.magic));
+	h.version = export_version;
+	h.num_entries = entries.size();
+	h.num_buckets = 1;
+	while (h.num_buckets < 2 * h.num_entries)
+	{
+		h.num_buckets *= 2;
+	}
+
+	// the package name is stored first, followed by the exported names
+	std::string all = package + names;
+	h.names_size = all.size();
+	std::vector<export_entry> stored(entries);
+	std::vector<uint32_t> table(h.num_buckets, 0);
+	for (uint32_t e = 0; e != stored.size(); e++)
+	{
+		stored[e].name_offset += package.size();
+		uint32_t b = stored[e].hash & (h.num_buckets - 1);
+		while (table[b])
+		{
+			b = (b + 1) & (h.num_buckets - 1);
+		}
+		table[b] = e + 1;
+	}
+
+	FILE *out = fopen(fname.c_str(), "wb");
+	if (!out)
+	{
+		return 1;
+	}
+	uint32_t package_length = package.size();
+	int ok = write_bytes(out, &h, sizeof(h))
+		&& write_bytes(out, &table[0], table.size() * sizeof(uint32_t))
+		&& write_bytes(out, stored.empty() ? NULL : &stored[0], stored.size() * sizeof(export_entry))
+		&& write_bytes(out, &package_length, sizeof(package_length))
+		&& write_bytes(out, all.data(), all.size());
+
+	return (fclose(out) || !ok) ? 1 : 0;
+}
+
+/* maps the export file denoted by fname, and checks that its header describes parts
+ * lying within it. The buckets and entries are only checked by find as it reads them,
+ * so that opening a file costs the same whatever its size. */
+int export_data::open(const std::string &fname)
+{
+	int err = file.map(fname);
+	head = NULL;
+	if (err)
+	{
+		return err;
+	}
+
+	const char *data = file.data;
+	std::size_t size = file.size;
+	if (size < sizeof(header))
+	{
+		return EINVAL;
+	}
+	const header *h = reinterpret_cast<const header *>(data);
+	uint64_t table_end = sizeof(header) + (uint64_t) h->num_buckets * sizeof(uint32_t);
+	uint64_t entries_end = table_end + (uint64_t) h->num_entries * sizeof(export_entry);
+	uint64_t names_begin = entries_end + sizeof(uint32_t);
+	if (memcmp(h->magic, export_magic, sizeof(h->magic)) || h->version != export_version
+		|| !h->num_buckets || (h->num_buckets & (h->num_buckets - 1))
+		|| h->num_entries >= h->num_buckets || names_begin + h->names_size != size)
+	{
+		return EINVAL;
+	}
+
+	const uint32_t *table = reinterpret_cast<const uint32_t *>(data + sizeof(header));
+	const export_entry *stored = reinterpret_cast<const export_entry *>(data + table_end);
+	uint32_t package_length;
+	memcpy(&package_length, data + entries_end, sizeof(package_length));
+	if (package_length > h->names_size)
+	{
+		return EINVAL;
+	}
+
+	head = h;
+	buckets = table;
+	mapped_entries = stored;
+	mapped_names = data + names_begin;
+	package.assign(mapped_names, package_length);
+	return 0;
+}
+
+/* returns the entry of the exported name in the file opened, NULL if there is none or
+ * the part of the file searched is corrupt */
+const export_entry *export_data::find(const std::string &name) const
+{
+	if (!head)
+	{
+		return NULL;
+	}
+
+	uint32_t hash = hash_name(name.data(), name.size());
+	uint32_t mask = head->num_buckets - 1;
+	// the table is never full, so an empty bucket ends the search, unless the file is
+	// corrupt: the search then stops once it has been through every bucket
+	uint32_t b = hash & mask;
+	for (uint32_t probes = 0; probes != head->num_buckets && buckets[b]; probes++, b = (b + 1) & mask)
+	{
+		if (buckets[b] > head->num_entries)
+		{
+			return NULL;
+		}
+		const export_entry *entry = &mapped_entries[buckets[b] - 1];
+		if ((uint64_t) entry->name_offset + entry->name_length > head->names_size)
+		{
+			return NULL;
+		}
+		if (entry->hash == hash && entry->name_length == name.size()
+			&& !memcmp(mapped_names + entry->name_offset, name.data(), name.size()))
+		{
+			return entry;
+		}
+	}
+	return NULL;
+}
@@ -0,0 +1,81 @@
+#ifndef EXPORT_DATA_HPP
+#define EXPORT_DATA_HPP
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include "mapped_file.hpp"
+
+enum export_kind
+{
+	export_func,
+	export_var
+};
+
+/* an exported name, as stored in an export file */
+struct export_entry
+{
+	uint32_t hash;
+	uint32_t name_offset;
+	uint32_t name_length;
+	uint8_t kind;
+	uint8_t has_result;
+	uint16_t num_params;
+};
+
+/* The exported functions and variables of a compiled package, written next to its
+ * object by -c so that importing the package does not need its source.
+ *
+ * An export file is read in place once mapped: a header, a hash table of the names,
+ * the entries, and the names themselves, all in host byte order. Looking up a name
+ * hashes it and probes the table, without reading the other entries.
+ * The only type is int, so the signature of a function is its number of parameters
+ * and whether it returns a value.
+ */
+class export_data
+{
+public:
+	// name of the package, from its package clause
+	std::string package;
+
+	export_data();
+
+	/* adds an exported name, before the file is written */
+	void add(const std::string &name, export_kind kind, uint32_t num_params, bool has_result);
+
+	/* writes the names added to the file denoted by fname.
+	 * returns 0 on success, 1 otherwise with errno set. */
+	int write(const std::string &fname) const;
+
+	/* maps the export file denoted by fname. returns 0 on success, EINVAL if it is not
+	 * an export file, or the errno of the failure to map it. */
+	int open(const std::string &fname);
+
+	/* returns the entry of the exported name in the file opened, NULL if there is none */
+	const export_entry *find(const std::string &name) const;
+
+private:
+	struct header
+	{
+		char magic[4];
+		uint32_t version;
+		uint32_t num_entries;
+		uint32_t num_buckets;
+		uint32_t names_size;
+	};
+
+	// names added, and their entries, before the file is written
+	std::string names;
+	std::vector<export_entry> entries;
+
+	// the file opened, and its parts
+	mapped_file file;
+	const header *head;
+	const uint32_t *buckets;
+	const export_entry *mapped_entries;
+	const char *mapped_names;
+};
+
+#endif
@@ -0,0 +1,119 @@
+/* Runs a fuzz target without libFuzzer, for compilers that do not support
+ * -fsanitize=fuzzer. Each input file, or each file in an input directory,
+ * is passed to LLVMFuzzerTestOneInput.
+ *
+ * With -runs=N every input is run N times in-process, and the throughput is
+ * reported, which is useful for measuring the cost of one fuzzing iteration.
+ */
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+
+#include <cerrno>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#define OPT_RUNS	"-runs="
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, std::size_t size);
+
+/* appends fname, or every regular file in fname if it is a directory, to files */
+static void collectInputs(const std::string &fname, std::vector<std::string> &files)
+{
+	struct stat finfo;
+	DIR *dir;
+	struct dirent *entry;
+
+	if (stat(fname.c_str(), &finfo))
+	{
+		std::cerr << "'" << fname << "': " << std::strerror(errno) << std::endl;
+		return;
+	}
+
+	if (!S_ISDIR(finfo.st_mode))
+	{
+		files.push_back(fname);
+		return;
+	}
+
+	if (!(dir = opendir(fname.c_str())))
+	{
+		std::cerr << "'" << fname << "': Couldn't open directory" << std::endl;
+		return;
+	}
+	while ((entry = readdir(dir)))
+	{
+		if (entry->d_name[0] != '.')
+		{
+			collectInputs(fname + "/" + entry->d_name, files);
+		}
+	}
+	closedir(dir);
+}
+
+int main(int argc, char **argv)
+{
+	std::vector<std::string> files;
+	long runs = 1;
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (!strncmp(argv[i], OPT_RUNS, strlen(OPT_RUNS)))
+		{
+			runs = atol(argv[i] + strlen(OPT_RUNS));
+		}
+		else
+		{
+			collectInputs(argv[i], files);
+		}
+	}
+
+	if (files.empty())
+	{
+		std::cerr << "Usage: " << argv[0] << " [" OPT_RUNS "N] FILE|DIR..." << std::endl;
+		return 1;
+	}
+
+	std::vector<std::vector<uint8_t> > inputs;
+	std::size_t bytes = 0;
+	for (std::vector<std::string>::size_type i = 0; i != files.size(); i++)
+	{
+		std::ifstream in(files[i].c_str(), std::ios::binary);
+		inputs.push_back(std::vector<uint8_t>((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>()));
+		bytes += inputs.back().size();
+	}
+
+	struct timeval start, end;
+	gettimeofday(&start, NULL);
+
+	for (long run = 0; run < runs; run++)
+	{
+		for (std::vector<std::vector<uint8_t> >::size_type i = 0; i != inputs.size(); i++)
+		{
+			// never pass NULL, even for empty inputs
+			static const uint8_t empty = 0;
+			LLVMFuzzerTestOneInput(inputs[i].empty() ? &empty : &inputs[i][0], inputs[i].size());
+		}
+	}
+
+	gettimeofday(&end, NULL);
+	double seconds = (end.tv_sec - start.tv_sec) + (end.tv_usec - start.tv_usec) / 1e6;
+	double execs = (double) runs * inputs.size();
+
+	std::cerr << "Executed " << inputs.size() << " inputs " << runs << " times in " << seconds << "s";
+	if (seconds > 0)
+	{
+		std::cerr << " (" << (long) (execs / seconds) << " exec/s, "
+			<< (long) (bytes * (double) runs / seconds / 1e6) << " MB/s)";
+	}
+	std::cerr << std::endl;
+
+	return 0;
+}
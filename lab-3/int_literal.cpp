@@ -0,0 +1,107 @@
+#include "int_literal.hpp"
+
+#include <cstring>
+
+int_literal::int_literal()
+{
+	value = 0;
+}
+
+/* returns 1 if the value fits in 64 bits, 0 if only its digits are known */
+int int_literal::fits() const
+{
+	return digits.empty();
+}
+
+/* returns 1 if the value fits in an int, which has 64 bits with a sign */
+int int_literal::fits_int() const
+{
+	return fits() && value <= (uint64_t) INT64_MAX;
+}
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+/* returns the value of the 8 digits at text. They are loaded as one word with the
+ * first digit in its low byte, and combined in pairs of bytes, then pairs of 16-bit
+ * halves and finally the two 32-bit halves, with three multiplications in all. */
+static uint32_t parse_eight_digits(const char *text)
+{
+	uint64_t word;
+	memcpy(&word, text, sizeof(word));
+
+	word -= 0x3030303030303030ULL;
+	// every other byte holds the value of two digits
+	word = word * 10 + (word >> 8);
+	// the upper half holds the value of all eight
+	word = ((word & 0x000000ff000000ffULL) * (100 + (1000000ULL << 32))
+		+ ((word >> 16) & 0x000000ff000000ffULL) * (1 + (10000ULL << 32))) >> 32;
+	return (uint32_t) word;
+}
+#else
+static uint32_t parse_eight_digits(const char *text)
+{
+	uint32_t value = 0;
+	for (int i = 0; i != 8; i++)
+	{
+		value = value * 10 + (text[i] - '0');
+	}
+	return value;
+}
+#endif
+
+/* returns the value of the length digits at text, at most 19 so that it cannot overflow */
+static uint64_t parse_digits(const char *text, std::size_t length)
+{
+	uint64_t value = 0;
+
+	for (; length >= 8; text += 8, length -= 8)
+	{
+		value = value * 100000000 + parse_eight_digits(text);
+	}
+	for (; length; text++, length--)
+	{
+		value = value * 10 + (*text - '0');
+	}
+	return value;
+}
+
+/* converts the length decimal digits at text, which must all be digits */
+int_literal parse_int_literal(const char *text, std::size_t length)
+{
+	int_literal literal;
+
+	// leading zeros add nothing, but a literal of zeros keeps one
+	while (length > 1 && *text == '0')
+	{
+		text++;
+		length--;
+	}
+
+	// 19 digits always fit in 64 bits, 20 digits may, and more never do
+	if (length <= 19)
+	{
+		literal.value = parse_digits(text, length);
+		return literal;
+	}
+	if (length == 20)
+	{
+		uint64_t value = parse_digits(text, 19);
+		unsigned int last = text[19] - '0';
+		if (value <= (UINT64_MAX - last) / 10)
+		{
+			literal.value = value * 10 + last;
+			return literal;
+		}
+	}
+	literal.digits.assign(text, length);
+	return literal;
+}
+
+/* prints the value of the literal, without leading zeros */
+std::ostream &operator<<(std::ostream &out, const int_literal &literal)
+{
+	if (literal.fits())
+	{
+		return out << literal.value;
+	}
+	return out << literal.digits;
+}
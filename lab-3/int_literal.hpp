@@ -0,0 +1,37 @@
+#ifndef INT_LITERAL_HPP
+#define INT_LITERAL_HPP
+
+#include <stdint.h>
+
+#include <cstddef>
+#include <ostream>
+#include <string>
+
+/* The value of a decimal integer literal, converted once by the scanner.
+ * Go's integer constants have no size limit, so a literal too large for 64 bits
+ * keeps its digits instead, and is only an error once it is used as an int.
+ */
+struct int_literal
+{
+	// the value, if it fits in 64 bits
+	uint64_t value;
+
+	// the digits of a value that does not fit, without leading zeros, empty otherwise
+	std::string digits;
+
+	int_literal();
+
+	/* returns 1 if the value fits in 64 bits, 0 if only its digits are known */
+	int fits() const;
+
+	/* returns 1 if the value fits in an int, which has 64 bits with a sign */
+	int fits_int() const;
+};
+
+/* converts the length decimal digits at text, which must all be digits */
+int_literal parse_int_literal(const char *text, std::size_t length);
+
+/* prints the value of the literal, without leading zeros */
+std::ostream &operator<<(std::ostream &out, const int_literal &literal);
+
+#endif
@@ -0,0 +1,460 @@
+#include "ir.hpp"
+
+#include <algorithm>
+
+ir_inst::ir_inst(ir_opcode op, ir_value result)
+{
+	this->op = op;
+	this->result = result;
+	a = IR_NO_VALUE;
+	b = IR_NO_VALUE;
+	imm = 0;
+	args_begin = 0;
+	args_count = 0;
+}
+
+/* returns 1 if the instruction can be removed when its result is unused */
+int ir_inst::is_pure() const
+{
+	switch (op)
+	{
+		case ir_store:
+		case ir_write:
+		case ir_zero:
+		case ir_check:
+		case ir_call:
+		case ir_ret:
+		case ir_jump:
+		case ir_branch:
+		case ir_switch:
+			return 0;
+		case ir_div:
+			// division by zero traps
+			return 0;
+		default:
+			return 1;
+	}
+}
+
+ir_function::ir_function(uint32_t name, uint32_t num_params, bool has_result)
+{
+	this->name = name;
+	this->num_params = num_params;
+	this->has_result = has_result;
+	num_values = 0;
+	frame_words = 0;
+	ref_params.assign(num_params, false);
+}
+
+/* returns a new value id */
+ir_value ir_function::new_value()
+{
+	return num_values++;
+}
+
+/* replaces every operand v by map[v], map must have num_values entries */
+void ir_function::replace_uses(const std::vector<ir_value> &map)
+{
+	for (std::vector<ir_block>::size_type b = 0; b != blocks.size(); b++)
+	{
+		std::vector<ir_inst> &insts = blocks[b].insts;
+		for (std::vector<ir_inst>::size_type i = 0; i != insts.size(); i++)
+		{
+			ir_inst &inst = insts[i];
+			if (inst.a != IR_NO_VALUE)
+			{
+				inst.a = map[inst.a];
+			}
+			if (inst.b != IR_NO_VALUE)
+			{
+				inst.b = map[inst.b];
+			}
+			for (uint32_t j = inst.args_begin; j != inst.args_begin + inst.args_count; j++)
+			{
+				args[j] = map[args[j]];
+			}
+		}
+	}
+}
+
+/* removes the instructions that were turned into ir_nop */
+void ir_function::compact()
+{
+	for (std::vector<ir_block>::size_type b = 0; b != blocks.size(); b++)
+	{
+		std::vector<ir_inst> &insts = blocks[b].insts;
+		std::vector<ir_inst>::size_type kept = 0;
+		for (std::vector<ir_inst>::size_type i = 0; i != insts.size(); i++)
+		{
+			if (insts[i].op != ir_nop)
+			{
+				insts[kept++] = insts[i];
+			}
+		}
+		insts.resize(kept, ir_inst(ir_nop, IR_NO_VALUE));
+	}
+}
+
+/* removes the blocks that cannot be reached from the entry, and renumbers the others */
+void ir_function::remove_unreachable_blocks()
+{
+	const uint32_t unreachable = (uint32_t) -1;
+	std::vector<uint32_t> index(blocks.size(), unreachable);
+	std::vector<uint32_t> worklist;
+	std::vector<ir_block> kept;
+
+	if (blocks.empty())
+	{
+		return;
+	}
+
+	index[0] = 0;
+	worklist.push_back(0);
+	while (!worklist.empty())
+	{
+		uint32_t b = worklist.back();
+		worklist.pop_back();
+		for (std::vector<uint32_t>::size_type s = 0; s != blocks[b].succs.size(); s++)
+		{
+			if (index[blocks[b].succs[s]] == unreachable)
+			{
+				index[blocks[b].succs[s]] = 0;
+				worklist.push_back(blocks[b].succs[s]);
+			}
+		}
+	}
+
+	// new indices keep the reachable blocks in order
+	uint32_t num_kept = 0;
+	for (std::vector<uint32_t>::size_type b = 0; b != index.size(); b++)
+	{
+		if (index[b] != unreachable)
+		{
+			index[b] = num_kept++;
+		}
+	}
+	if (num_kept == blocks.size())
+	{
+		return;
+	}
+
+	for (std::vector<ir_block>::size_type b = 0; b != blocks.size(); b++)
+	{
+		if (index[b] == unreachable)
+		{
+			continue;
+		}
+
+		ir_block &block = blocks[b];
+		std::vector<uint32_t> preds;
+		for (std::vector<ir_inst>::size_type i = 0; i != block.insts.size(); i++)
+		{
+			ir_inst &inst = block.insts[i];
+			if (inst.op == ir_jump)
+			{
+				inst.imm = index[inst.imm];
+			}
+			if (inst.op != ir_phi)
+			{
+				continue;
+			}
+
+			// phis keep the operands of the predecessors that remain
+			uint32_t begin = args.size();
+			for (std::vector<uint32_t>::size_type p = 0; p != block.preds.size(); p++)
+			{
+				if (index[block.preds[p]] != unreachable)
+				{
+					ir_value v = args[inst.args_begin + p];
+					args.push_back(v);
+				}
+			}
+			inst.args_begin = begin;
+			inst.args_count = args.size() - begin;
+		}
+
+		for (std::vector<uint32_t>::size_type p = 0; p != block.preds.size(); p++)
+		{
+			if (index[block.preds[p]] != unreachable)
+			{
+				preds.push_back(index[block.preds[p]]);
+			}
+		}
+		block.preds.swap(preds);
+		for (std::vector<uint32_t>::size_type s = 0; s != block.succs.size(); s++)
+		{
+			block.succs[s] = index[block.succs[s]];
+		}
+		kept.push_back(block);
+	}
+	blocks.swap(kept);
+}
+
+/* returns the number of instructions in the function */
+std::size_t ir_function::size() const
+{
+	std::size_t n = 0;
+	for (std::vector<ir_block>::size_type b = 0; b != blocks.size(); b++)
+	{
+		n += blocks[b].insts.size();
+	}
+	return n;
+}
+
+/* returns the index of the symbol called name, adding it if needed */
+uint32_t ir_module::symbol(const std::string &name)
+{
+	std::map<std::string, uint32_t>::iterator it = symbol_ids.find(name);
+	if (it != symbol_ids.end())
+	{
+		return it->second;
+	}
+	symbols.push_back(name);
+	symbol_ids[name] = symbols.size() - 1;
+	return symbols.size() - 1;
+}
+
+/* returns the function defining symbol sym, or NULL if it is external */
+ir_function *ir_module::find_function(uint32_t sym)
+{
+	for (std::vector<ir_function>::size_type f = 0; f != functions.size(); f++)
+	{
+		if (functions[f].name == sym)
+		{
+			return &functions[f];
+		}
+	}
+	return NULL;
+}
+
+/* returns 1 if ret immediately follows call and returns its result, or nothing,
+ * so that the call can reuse the frame of its caller */
+int ir_is_tail_call(const ir_inst &call, const ir_inst &ret)
+{
+	return call.op == ir_call && ret.op == ir_ret && (ret.a == IR_NO_VALUE || ret.a == call.result);
+}
+
+/* Returns, for each value of func, whether it may hold an address into the heap.
+ * Arrays only hold integers, so addresses only come from allocations, parameters and
+ * global slices, and spread through copies, phis and address arithmetic until nothing
+ * changes, as phis of loops may refer to values defined later. */
+std::vector<bool> ir_references(const ir_module &module, const ir_function &func)
+{
+	std::vector<bool> refs(func.num_values, false);
+	std::vector<const ir_inst *> defs(func.num_values, (const ir_inst *) NULL);
+
+	for (std::vector<ir_block>::size_type b = 0; b != func.blocks.size(); b++)
+	{
+		const std::vector<ir_inst> &insts = func.blocks[b].insts;
+		for (std::vector<ir_inst>::size_type i = 0; i != insts.size(); i++)
+		{
+			if (insts[i].result != IR_NO_VALUE)
+			{
+				defs[insts[i].result] = &insts[i];
+			}
+		}
+	}
+
+	bool changed = true;
+	while (changed)
+	{
+		changed = false;
+		for (ir_value v = 0; v != func.num_values; v++)
+		{
+			const ir_inst *inst = defs[v];
+			if (refs[v] || !inst)
+			{
+				continue;
+			}
+
+			bool ref = false;
+			switch (inst->op)
+			{
+				case ir_call:
+					ref = module.symbols[inst->imm] == IR_HEAP_ALLOC;
+					break;
+				case ir_param:
+					ref = func.ref_params[inst->imm];
+					break;
+				case ir_load:
+					ref = std::find(module.roots.begin(), module.roots.end(), inst->imm) != module.roots.end();
+					break;
+				case ir_read:
+				{
+					const ir_inst *addr = defs[inst->a];
+					ref = addr && addr->op == ir_global_addr
+						&& std::find(module.roots.begin(), module.roots.end(), addr->imm) != module.roots.end();
+					break;
+				}
+				case ir_copy:
+					ref = refs[inst->a];
+					break;
+				case ir_add:
+					ref = refs[inst->a] || refs[inst->b];
+					break;
+				case ir_sub:
+					ref = refs[inst->a] && !refs[inst->b];
+					break;
+				case ir_phi:
+					for (uint32_t j = 0; j != inst->args_count && !ref; j++)
+					{
+						ref = refs[func.args[inst->args_begin + j]];
+					}
+					break;
+				default:
+					break;
+			}
+			if (ref)
+			{
+				refs[v] = true;
+				changed = true;
+			}
+		}
+	}
+	return refs;
+}
+
+static const char *opcode_name(ir_opcode op)
+{
+	switch (op)
+	{
+		case ir_nop:	return "nop";
+		case ir_const:	return "const";
+		case ir_param:	return "param";
+		case ir_copy:	return "copy";
+		case ir_phi:	return "phi";
+		case ir_add:	return "add";
+		case ir_sub:	return "sub";
+		case ir_mul:	return "mul";
+		case ir_div:	return "div";
+		case ir_eq:		return "eq";
+		case ir_ne:		return "ne";
+		case ir_lt:		return "lt";
+		case ir_le:		return "le";
+		case ir_gt:		return "gt";
+		case ir_ge:		return "ge";
+		case ir_load:	return "load";
+		case ir_store:	return "store";
+		case ir_frame_addr:		return "frame";
+		case ir_global_addr:	return "addr";
+		case ir_read:	return "read";
+		case ir_write:	return "write";
+		case ir_zero:	return "zero";
+		case ir_check:	return "check";
+		case ir_call:	return "call";
+		case ir_ret:	return "ret";
+		case ir_jump:	return "jump";
+		case ir_branch:	return "branch";
+		case ir_switch:	return "switch";
+	}
+	return "?";
+}
+
+/* prints inst, the successors of block follow the operands of a branch or a switch, with
+ * the value of the first entry of the jump table of a switch before them */
+static void print_inst(std::ostream &out, const ir_module &module, const ir_function &func, const ir_block &block,
+	const ir_inst &inst)
+{
+	out << "\t";
+	if (inst.result != IR_NO_VALUE)
+	{
+		out << "%" << inst.result << " = ";
+	}
+	out << opcode_name(inst.op);
+
+	switch (inst.op)
+	{
+		case ir_const:
+		case ir_param:
+		case ir_frame_addr:
+			out << " " << inst.imm;
+			break;
+		case ir_load:
+		case ir_store:
+		case ir_global_addr:
+		case ir_call:
+			out << " @" << module.symbols[inst.imm];
+			break;
+		case ir_jump:
+			out << " b" << inst.imm;
+			break;
+		default:
+			break;
+	}
+
+	const char *sep = " ";
+	if (inst.a != IR_NO_VALUE)
+	{
+		out << sep << "%" << inst.a;
+		sep = ", ";
+	}
+	if (inst.b != IR_NO_VALUE)
+	{
+		out << sep << "%" << inst.b;
+		sep = ", ";
+	}
+	if (inst.op == ir_zero)
+	{
+		out << ", " << inst.imm;
+	}
+	if (inst.op == ir_call || inst.op == ir_phi)
+	{
+		out << "(";
+		for (uint32_t i = 0; i != inst.args_count; i++)
+		{
+			out << (i ? ", %" : "%") << func.args[inst.args_begin + i];
+		}
+		out << ")";
+	}
+	if (inst.op == ir_branch && block.succs.size() == 2)
+	{
+		out << ", b" << block.succs[0] << ", b" << block.succs[1];
+	}
+	if (inst.op == ir_switch && !block.succs.empty())
+	{
+		out << ", b" << block.succs[0] << ", " << inst.imm << ": [";
+		for (std::vector<uint32_t>::size_type s = 1; s != block.succs.size(); s++)
+		{
+			out << (s > 1 ? ", b" : "b") << block.succs[s];
+		}
+		out << "]";
+	}
+	out << std::endl;
+}
+
+/* prints the module in text form */
+void ir_module::print(std::ostream &out) const
+{
+	for (std::vector<uint32_t>::size_type g = 0; g != globals.size(); g++)
+	{
+		out << "global @" << symbols[globals[g]];
+		if (global_words[g] != 1)
+		{
+			out << " [" << global_words[g] << "]";
+		}
+		out << std::endl;
+	}
+
+	for (std::vector<ir_function>::size_type f = 0; f != functions.size(); f++)
+	{
+		const ir_function &func = functions[f];
+		out << std::endl << "func @" << symbols[func.name] << "(" << func.num_params << ")"
+			<< (func.has_result ? " int" : "") << std::endl;
+
+		for (std::vector<ir_block>::size_type b = 0; b != func.blocks.size(); b++)
+		{
+			const ir_block &block = func.blocks[b];
+			out << "b" << b << ":";
+			for (std::vector<uint32_t>::size_type p = 0; p != block.preds.size(); p++)
+			{
+				out << (p ? ", b" : "\t\t; preds b") << block.preds[p];
+			}
+			out << std::endl;
+
+			for (std::vector<ir_inst>::size_type i = 0; i != block.insts.size(); i++)
+			{
+				print_inst(out, *this, func, block, block.insts[i]);
+			}
+		}
+	}
+}
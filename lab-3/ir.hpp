@@ -0,0 +1,178 @@
+#ifndef IR_HPP
+#define IR_HPP
+
+#include <stdint.h>
+
+#include <map>
+#include <ostream>
+#include <string>
+#include <vector>
+
+/* Mid-level intermediate representation in SSA form.
+ *
+ * Every instruction that produces a value defines a new value id, unique within
+ * its function, and operands refer to values by id. Instructions are kept small
+ * so that each basic block holds them in one contiguous vector.
+ * All values are 64-bit integers.
+ */
+
+typedef uint32_t ir_value;
+
+#define IR_NO_VALUE		((ir_value) -1)		// missing operand or result
+
+/* allocates a zeroed array on the garbage-collected heap, see runtime/runtime.hpp */
+#define IR_HEAP_ALLOC	"rt_alloc"
+
+enum ir_opcode
+{
+	ir_nop,			// deleted instruction, removed by ir_function::compact
+	ir_const,		// the constant imm
+	ir_param,		// the imm-th parameter of the function
+	ir_copy,		// a
+	ir_phi,			// one operand in args per predecessor of the block, in the same order
+	ir_add,			// a + b
+	ir_sub,			// a - b
+	ir_mul,			// a * b
+	ir_div,			// a / b
+	ir_eq,			// 1 if a == b, 0 otherwise
+	ir_ne,			// 1 if a != b, 0 otherwise
+	ir_lt,			// 1 if a < b, 0 otherwise
+	ir_le,			// 1 if a <= b, 0 otherwise
+	ir_gt,			// 1 if a > b, 0 otherwise
+	ir_ge,			// 1 if a >= b, 0 otherwise
+	ir_load,		// the global variable with symbol imm
+	ir_store,		// stores a in the global variable with symbol imm
+	ir_frame_addr,	// the address of the array imm words into the arrays of the frame
+	ir_global_addr,	// the address of the global variable with symbol imm
+	ir_read,		// the word at address a
+	ir_write,		// stores b at address a
+	ir_zero,		// sets the imm words from address a to 0
+	ir_check,		// stops the program unless 0 <= a < b
+	ir_call,		// calls the function with symbol imm, passing args
+	ir_ret,			// returns a, or nothing if a is IR_NO_VALUE
+	ir_jump,		// jumps to the block imm, the only successor of its block
+	ir_branch,		// jumps to the first successor of its block if a is not 0, to the second otherwise
+	ir_switch		// jumps to the successor 1 + a - imm of its block if there is one, to the first otherwise
+};
+
+struct ir_inst
+{
+	ir_opcode op;
+
+	// value defined by the instruction, IR_NO_VALUE if there is none
+	ir_value result;
+
+	// operands, IR_NO_VALUE if unused
+	ir_value a, b;
+
+	// constant, parameter index or symbol, depending on op
+	int64_t imm;
+
+	// operands of calls and phis, held in ir_function::args
+	uint32_t args_begin;
+	uint32_t args_count;
+
+	ir_inst(ir_opcode op, ir_value result);
+
+	/* returns 1 if the instruction can be removed when its result is unused */
+	int is_pure() const;
+};
+
+class ir_block
+{
+public:
+	std::vector<ir_inst> insts;
+
+	// blocks that can jump to this one, and that this one can jump to. The jump table of
+	// a switch is its list of successors, where a block may appear more than once, but a
+	// block appears once among the predecessors of each of its successors
+	std::vector<uint32_t> preds;
+	std::vector<uint32_t> succs;
+};
+
+class ir_function
+{
+public:
+	// symbol naming the function
+	uint32_t name;
+
+	uint32_t num_params;
+
+	// whether the function returns a value
+	bool has_result;
+
+	// the first block is the entry
+	std::vector<ir_block> blocks;
+
+	// operands of calls and phis
+	std::vector<ir_value> args;
+
+	// number of value ids handed out, all ids are below it
+	ir_value num_values;
+
+	// 8-byte words of the local arrays, which live in the frame
+	uint32_t frame_words;
+
+	// which parameters are addresses of arrays, which may be on the heap
+	std::vector<bool> ref_params;
+
+	ir_function(uint32_t name, uint32_t num_params, bool has_result);
+
+	/* returns a new value id */
+	ir_value new_value();
+
+	/* replaces every operand v by map[v], map must have num_values entries */
+	void replace_uses(const std::vector<ir_value> &map);
+
+	/* removes the instructions that were turned into ir_nop */
+	void compact();
+
+	/* removes the blocks that cannot be reached from the entry, and renumbers the others */
+	void remove_unreachable_blocks();
+
+	/* returns the number of instructions in the function */
+	std::size_t size() const;
+};
+
+/* returns 1 if ret immediately follows call and returns its result, or nothing,
+ * so that the call can reuse the frame of its caller */
+int ir_is_tail_call(const ir_inst &call, const ir_inst &ret);
+
+class ir_module;
+
+/* returns, for each value of func, whether it may hold an address into the heap, which
+ * the garbage collector must find and update: the results of IR_HEAP_ALLOC, the
+ * parameters in ref_params, the first word of the globals in module.roots, and the
+ * copies, phis and sums of those */
+std::vector<bool> ir_references(const ir_module &module, const ir_function &func);
+
+class ir_module
+{
+public:
+	// names of the functions and global variables, referred to by index
+	std::vector<std::string> symbols;
+
+	// functions defined by the module
+	std::vector<ir_function> functions;
+
+	// symbols of the global variables defined by the module, and their size in 8-byte words
+	std::vector<uint32_t> globals;
+	std::vector<uint32_t> global_words;
+
+	// symbols of the globals whose first word may hold an address into the heap
+	std::vector<uint32_t> roots;
+
+	/* returns the index of the symbol called name, adding it if needed */
+	uint32_t symbol(const std::string &name);
+
+	/* returns the function defining symbol sym, or NULL if it is external */
+	ir_function *find_function(uint32_t sym);
+
+	/* prints the module in text form */
+	void print(std::ostream &out) const;
+
+private:
+	std::map<std::string, uint32_t> symbol_ids;
+};
+
+#endif
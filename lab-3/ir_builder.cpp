@@ -0,0 +1,1492 @@
+#include "ir_builder.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <set>
+#include <sstream>
+
+#include "driver.hpp"
+
+/* a switch on at least this many integer constants, covering at least a third of the
+ * values between the smallest and the largest, jumps through a table. Others compare
+ * the tag with each value in turn. */
+#define SWITCH_TABLE_MIN_CASES	4
+#define SWITCH_TABLE_DENSITY	3
+
+/* the most elements an array may have */
+#define MAX_ARRAY_LENGTH		(1 << 24)
+
+ir_builder::ir_builder(go_driver &driver, ir_module &module) : driver(driver), module(module)
+{
+	func = module.functions.size();
+	block = 0;
+	num_locals = 0;
+	errors = 0;
+	escape_report = NULL;
+	escapes = NULL;
+}
+
+ir_builder::~ir_builder()
+{
+	for (std::vector<export_data *>::size_type i = 0; i != imports.size(); i++)
+	{
+		delete imports[i];
+	}
+}
+
+/* returns 1 if type is a slice type */
+static int is_slice_type(ast_ident *type)
+{
+	return type && type->type == node_array_type && !static_cast<ast_array_type *>(type)->length;
+}
+
+/* returns the number of values passed to a function, two for each slice */
+static uint32_t count_params(ast_func_sig *sig)
+{
+	uint32_t num_params = 0;
+
+	for (ast_var_decl *arg = sig->args; arg; arg = static_cast<ast_var_decl *>(arg->next))
+	{
+		num_params += is_slice_type(arg->var_type) ? 2 : 1;
+	}
+	return num_params;
+}
+
+/* returns type as written, for messages */
+static std::string type_name(ast_ident *type)
+{
+	std::ostringstream name;
+
+	if (type->type == node_array_type && static_cast<ast_array_type *>(type)->length)
+	{
+		name << "[" << static_cast<ast_array_type *>(type)->length->value << "]";
+	}
+	else if (type->type == node_array_type)
+	{
+		name << "[]";
+	}
+	name << type->name;
+	return name.str();
+}
+
+/* returns 1 if name is exported from its package */
+static int is_exported(const std::string &name)
+{
+	return isupper((unsigned char) name[0]) ? 1 : 0;
+}
+
+/* returns the instruction computing the binary operator op */
+static ir_opcode binary_opcode(const std::string &op)
+{
+	bool or_equal = op.size() > 1 && op[1] == '=';
+
+	switch (op[0])
+	{
+		case '+':	return ir_add;
+		case '-':	return ir_sub;
+		case '*':	return ir_mul;
+		case '/':	return ir_div;
+		case '=':	return ir_eq;
+		case '!':	return ir_ne;
+		case '<':	return or_equal ? ir_le : ir_lt;
+		default:	return or_equal ? ir_ge : ir_gt;
+	}
+}
+
+/* adds the functions and global variables of tree to the module.
+ * returns 0 if the tree was translated without errors, 1 otherwise. */
+int ir_builder::build(ast_root *tree)
+{
+	ast_stmt *stmt;
+	bool has_init = false;
+
+	errors = 0;
+	func = module.functions.size();
+	if (!tree)
+	{
+		return 1;
+	}
+
+	exports.package = tree->package ? tree->package->name->name : "main";
+	open_imports(tree);
+
+	escape_analysis analysis(tree);
+	escapes = &analysis;
+	if (escape_report)
+	{
+		analysis.report(*escape_report);
+	}
+
+	// declare every top-level name first, so that functions can refer to any of them
+	for (stmt = tree->stmts; stmt; stmt = stmt->next)
+	{
+		if (stmt->type == node_func_decl)
+		{
+			ast_func_decl *decl = static_cast<ast_func_decl *>(stmt);
+			declare_function(decl);
+			if (is_exported(decl->name->name))
+			{
+				exports.add(decl->name->name, export_func, count_params(decl->sig), decl->sig->return_type != NULL);
+			}
+		}
+		else if (stmt->type == node_var_decl)
+		{
+			ast_var_decl *decl = static_cast<ast_var_decl *>(stmt);
+			uint32_t sym = module.symbol(decl->name->name);
+			var_kind kind = decl->var_type ? kind_of_type(decl->var_type) : kind_of_expr(decl->value);
+			int64_t length = 1;
+			if (globals.count(sym) || functions.count(sym))
+			{
+				error(decl->name, msg_redeclared, decl->name->name);
+			}
+			if (kind == kind_slice)
+			{
+				length = 2;
+			}
+			else if (kind == kind_array)
+			{
+				length = checked_length(static_cast<ast_array_type *>(decl->var_type));
+			}
+			globals[sym] = true;
+			module.globals.push_back(sym);
+			module.global_words.push_back(length);
+
+			// importers see every variable as an int
+			if (kind == kind_array)
+			{
+				global_arrays[sym] = length;
+			}
+			else if (kind == kind_slice)
+			{
+				global_slices[sym] = true;
+				module.roots.push_back(sym);
+			}
+			else if (is_exported(decl->name->name))
+			{
+				exports.add(decl->name->name, export_var, 0, false);
+			}
+			has_init = true;
+		}
+		else
+		{
+			has_init = true;
+		}
+	}
+
+	if (has_init)
+	{
+		begin_function(exports.package + ".init", 0, false);
+		for (stmt = tree->stmts; stmt; stmt = stmt->next)
+		{
+			if (stmt->type != node_func_decl)
+			{
+				build_stmt(stmt);
+			}
+		}
+		emit(ir_ret, IR_NO_VALUE, IR_NO_VALUE, 0, false);
+		module.functions[func].remove_unreachable_blocks();
+	}
+
+	for (stmt = tree->stmts; stmt; stmt = stmt->next)
+	{
+		if (stmt->type == node_func_decl)
+		{
+			build_function(static_cast<ast_func_decl *>(stmt));
+		}
+	}
+
+	// functions declared inside others may declare more of them
+	while (!pending.empty())
+	{
+		ast_func_decl *decl = pending.back();
+		pending.pop_back();
+		build_function(decl);
+	}
+
+	escapes = NULL;
+	return errors ? 1 : 0;
+}
+
+/* reports an error about node, in the function being built if there is one */
+void ir_builder::error(const ast_node *node, diag_message message, const std::string &arg)
+{
+	if (func < module.functions.size())
+	{
+		driver.error(node->span, message, arg, module.symbols[module.functions[func].name]);
+	}
+	else
+	{
+		driver.error(node->span, message, arg);
+	}
+	errors++;
+}
+
+/* declares the function and its result so that calls to it can be checked */
+void ir_builder::declare_function(ast_func_decl *decl)
+{
+	uint32_t sym = module.symbol(decl->name->name);
+
+	if (globals.count(sym) || functions.count(sym))
+	{
+		error(decl->name, msg_redeclared, decl->name->name);
+	}
+	callee info = {count_params(decl->sig), decl->sig->return_type != NULL, std::vector<bool>()};
+	for (ast_var_decl *arg = decl->sig->args; arg; arg = static_cast<ast_var_decl *>(arg->next))
+	{
+		if (kind_of_type(arg->var_type) == kind_array)
+		{
+			error(arg->var_type, msg_array_copy, arg->name->name);
+		}
+		info.slices.push_back(is_slice_type(arg->var_type));
+	}
+	if (decl->sig->return_type && decl->sig->return_type->type == node_array_type)
+	{
+		error(decl->sig->return_type, msg_array_result, type_name(decl->sig->return_type));
+	}
+	functions[sym] = info;
+}
+
+/* opens the export file of each package imported by tree that can be found, in the
+ * first of the import directories that has one. Packages without an export file, such
+ * as those of the standard library, stay unchecked: their functions are external. */
+void ir_builder::open_imports(ast_root *tree)
+{
+	std::vector<std::string> dirs(import_dirs);
+
+	if (dirs.empty())
+	{
+		dirs.push_back(".");
+	}
+	for (ast_imp_decl *decl = tree->imports; decl; decl = decl->next)
+	{
+		for (ast_imp_spec *spec = decl->imp_specs; spec; spec = spec->next)
+		{
+			std::string path = driver.strings.data(spec->path->value);
+			for (std::vector<std::string>::size_type d = 0; d != dirs.size(); d++)
+			{
+				std::string fname = dirs[d] + "/" + path + ".x";
+				import_candidates.push_back(fname);
+
+				export_data *data = new export_data();
+				int err = data->open(fname);
+				if (!err)
+				{
+					imports.push_back(data);
+					break;
+				}
+				delete data;
+				if (err == EINVAL)
+				{
+					error(spec->path, msg_not_export_file, fname);
+					break;
+				}
+			}
+		}
+	}
+}
+
+/* looks name up in the imported packages, unless it is declared here or was found before */
+void ir_builder::resolve(const std::string &name, uint32_t sym)
+{
+	if (!globals.count(sym) && !functions.count(sym))
+	{
+		find_import(name, sym);
+	}
+}
+
+/* returns 1 if name is exported by an imported package, after declaring it as sym so
+ * that later uses do not look it up again */
+int ir_builder::find_import(const std::string &name, uint32_t sym)
+{
+	for (std::vector<export_data *>::size_type i = 0; i != imports.size(); i++)
+	{
+		const export_entry *entry = imports[i]->find(name);
+		if (!entry)
+		{
+			continue;
+		}
+		if (entry->kind == export_func)
+		{
+			callee info = {entry->num_params, entry->has_result != 0, std::vector<bool>()};
+			functions[sym] = info;
+		}
+		else
+		{
+			globals[sym] = true;
+		}
+		return 1;
+	}
+	return 0;
+}
+
+/* starts a new function, with an entry block */
+void ir_builder::begin_function(const std::string &name, uint32_t num_params, bool has_result)
+{
+	module.functions.push_back(ir_function(module.symbol(name), num_params, has_result));
+	func = module.functions.size() - 1;
+
+	scopes.clear();
+	num_locals = 0;
+	locals.clear();
+	defs.clear();
+	sealed.clear();
+	incomplete.clear();
+	targets.clear();
+
+	// the entry block has no predecessors
+	block = new_block();
+	seal_block(block);
+}
+
+/* appends a new block and returns its index */
+uint32_t ir_builder::new_block()
+{
+	module.functions[func].blocks.push_back(ir_block());
+	defs.push_back(std::vector<ir_value>());
+	sealed.push_back(false);
+	return module.functions[func].blocks.size() - 1;
+}
+
+/* adds the phi operands of a block whose predecessors are all known */
+void ir_builder::seal_block(uint32_t b)
+{
+	std::vector<incomplete_phi> waiting;
+
+	for (std::vector<incomplete_phi>::size_type i = 0; i != incomplete.size(); i++)
+	{
+		if (incomplete[i].block == b)
+		{
+			waiting.push_back(incomplete[i]);
+			incomplete.erase(incomplete.begin() + i--);
+		}
+	}
+	for (std::vector<incomplete_phi>::size_type i = 0; i != waiting.size(); i++)
+	{
+		add_phi_operands(waiting[i].var, waiting[i].phi, b);
+	}
+	sealed[b] = true;
+}
+
+/* adds to from the successor to, and from to the predecessor to. A switch may jump to
+ * the same block for several values, but is only one of its predecessors. */
+void ir_builder::add_edge(uint32_t from, uint32_t to)
+{
+	std::vector<ir_block> &blocks = module.functions[func].blocks;
+
+	blocks[from].succs.push_back(to);
+	for (std::vector<uint32_t>::size_type p = 0; p != blocks[to].preds.size(); p++)
+	{
+		if (blocks[to].preds[p] == from)
+		{
+			return;
+		}
+	}
+	blocks[to].preds.push_back(from);
+}
+
+/* ends the current block with a jump to target */
+void ir_builder::jump_to(uint32_t target)
+{
+	emit(ir_jump, IR_NO_VALUE, IR_NO_VALUE, target, false);
+	add_edge(block, target);
+}
+
+/* makes target the next successor of each block of sources, and the target of the jump
+ * that ends those ending with one */
+void ir_builder::connect(const std::vector<uint32_t> &sources, uint32_t target)
+{
+	for (std::vector<uint32_t>::size_type s = 0; s != sources.size(); s++)
+	{
+		std::vector<ir_inst> &insts = module.functions[func].blocks[sources[s]].insts;
+		if (!insts.empty() && insts.back().op == ir_jump)
+		{
+			insts.back().imm = target;
+		}
+		add_edge(sources[s], target);
+	}
+}
+
+void ir_builder::write_variable(uint32_t var, uint32_t b, ir_value value)
+{
+	if (defs[b].size() <= var)
+	{
+		defs[b].resize(num_locals, IR_NO_VALUE);
+	}
+	defs[b][var] = value;
+}
+
+ir_value ir_builder::read_variable(uint32_t var, uint32_t b)
+{
+	if (var < defs[b].size() && defs[b][var] != IR_NO_VALUE)
+	{
+		return defs[b][var];
+	}
+	return read_variable_recursive(var, b);
+}
+
+ir_value ir_builder::read_variable_recursive(uint32_t var, uint32_t b)
+{
+	ir_block &blk = module.functions[func].blocks[b];
+	ir_value value;
+
+	if (!sealed[b])
+	{
+		// more predecessors may be added, so their values are not known yet
+		value = insert_front(b, ir_phi, 0);
+		incomplete_phi phi = {b, var, value};
+		incomplete.push_back(phi);
+	}
+	else if (blk.preds.size() == 1)
+	{
+		value = read_variable(var, blk.preds[0]);
+	}
+	else if (blk.preds.empty())
+	{
+		// only reachable through a variable read before its declaration
+		value = insert_front(b, ir_const, 0);
+	}
+	else
+	{
+		// the phi breaks cycles through loops before its operands are read
+		value = insert_front(b, ir_phi, 0);
+		write_variable(var, b, value);
+		add_phi_operands(var, value, b);
+	}
+	write_variable(var, b, value);
+	return value;
+}
+
+void ir_builder::add_phi_operands(uint32_t var, ir_value phi, uint32_t b)
+{
+	std::vector<ir_value> operands;
+	ir_value same = IR_NO_VALUE;
+	bool trivial = true;
+
+	for (std::vector<uint32_t>::size_type p = 0; p != module.functions[func].blocks[b].preds.size(); p++)
+	{
+		ir_value v = read_variable(var, module.functions[func].blocks[b].preds[p]);
+		operands.push_back(v);
+		if (v != phi && v != same)
+		{
+			trivial = trivial && same == IR_NO_VALUE;
+			same = v;
+		}
+	}
+
+	ir_function &f = module.functions[func];
+	std::vector<ir_inst> &insts = f.blocks[b].insts;
+	for (std::vector<ir_inst>::size_type i = 0; i != insts.size() && insts[i].op == ir_phi; i++)
+	{
+		if (insts[i].result != phi)
+		{
+			continue;
+		}
+		if (trivial && same != IR_NO_VALUE)
+		{
+			// all operands are the same value, copy propagation removes the phi. The copy
+			// goes after the phis, which the phis still incomplete are looked up among
+			ir_inst copy = insts[i];
+			copy.op = ir_copy;
+			copy.a = same;
+			insts.erase(insts.begin() + i);
+			std::vector<ir_inst>::iterator pos = insts.begin();
+			while (pos != insts.end() && pos->op == ir_phi)
+			{
+				pos++;
+			}
+			insts.insert(pos, copy);
+		}
+		else
+		{
+			insts[i].args_begin = f.args.size();
+			insts[i].args_count = operands.size();
+			f.args.insert(f.args.end(), operands.begin(), operands.end());
+		}
+		break;
+	}
+}
+
+/* inserts an instruction at the start of block b, after its phis */
+ir_value ir_builder::insert_front(uint32_t b, ir_opcode op, int64_t imm)
+{
+	ir_function &f = module.functions[func];
+	std::vector<ir_inst> &insts = f.blocks[b].insts;
+	std::vector<ir_inst>::iterator pos = insts.begin();
+
+	while (pos != insts.end() && pos->op == ir_phi)
+	{
+		pos++;
+	}
+	ir_inst inst(op, f.new_value());
+	inst.imm = imm;
+	insts.insert(pos, inst);
+	return inst.result;
+}
+
+/* appends an instruction to the current block and returns its result */
+ir_value ir_builder::emit(ir_opcode op, ir_value a, ir_value b, int64_t imm, bool has_result)
+{
+	ir_function &f = module.functions[func];
+	ir_inst inst(op, has_result ? f.new_value() : IR_NO_VALUE);
+
+	inst.a = a;
+	inst.b = b;
+	inst.imm = imm;
+	f.blocks[block].insts.push_back(inst);
+	return inst.result;
+}
+
+/* appends a call of the function sym with the given arguments */
+ir_value ir_builder::emit_call(uint32_t sym, const std::vector<ir_value> &operands, bool has_result)
+{
+	ir_function &f = module.functions[func];
+	ir_inst inst(ir_call, has_result ? f.new_value() : IR_NO_VALUE);
+
+	inst.imm = sym;
+	inst.args_begin = f.args.size();
+	inst.args_count = operands.size();
+	f.args.insert(f.args.end(), operands.begin(), operands.end());
+	f.blocks[block].insts.push_back(inst);
+	return inst.result;
+}
+
+/* returns the index of the local variable called name, or -1 */
+int ir_builder::find_local(const std::string &name)
+{
+	for (std::vector<std::map<std::string, uint32_t> >::size_type s = scopes.size(); s-- > 0;)
+	{
+		std::map<std::string, uint32_t>::iterator it = scopes[s].find(name);
+		if (it != scopes[s].end())
+		{
+			return it->second;
+		}
+	}
+	return -1;
+}
+
+uint32_t ir_builder::declare_local(ast_ident *name, var_kind kind)
+{
+	local_var var = {kind, 0, 0, false};
+	uint32_t index = num_locals;
+
+	if (scopes.back().count(name->name))
+	{
+		error(name, msg_redeclared, name->name);
+	}
+	scopes.back()[name->name] = index;
+	num_locals += kind == kind_slice ? 2 : 1;
+	locals.resize(num_locals, var);
+	return index;
+}
+
+/* returns the shape of variables of the given type */
+ir_builder::var_kind ir_builder::kind_of_type(ast_ident *type)
+{
+	if (!type || type->type != node_array_type)
+	{
+		return kind_int;
+	}
+	return static_cast<ast_array_type *>(type)->length ? kind_array : kind_slice;
+}
+
+/* returns the number of elements of an array type, or 0 after reporting an error */
+int64_t ir_builder::checked_length(ast_array_type *type)
+{
+	const int_literal &length = type->length->value;
+
+	if (!length.fits_int() || length.value > MAX_ARRAY_LENGTH)
+	{
+		std::ostringstream digits;
+		digits << length;
+		error(type->length, msg_invalid_array_length, digits.str());
+		return 0;
+	}
+	return length.value;
+}
+
+/* returns the kind of value expr gives: only slices are values, arrays are not copied */
+ir_builder::var_kind ir_builder::kind_of_expr(ast_expr *expr)
+{
+	if (expr && expr->type == node_slice_expr)
+	{
+		return kind_slice;
+	}
+	if (expr && expr->type == node_ident)
+	{
+		int var = find_local(static_cast<ast_ident *>(expr)->name);
+		if (var >= 0 ? locals[var].kind == kind_slice
+			: global_slices.count(module.symbol(static_cast<ast_ident *>(expr)->name)))
+		{
+			return kind_slice;
+		}
+	}
+	return kind_int;
+}
+
+void ir_builder::build_function(ast_func_decl *decl)
+{
+	uint32_t num_params = 0;
+	ast_var_decl *arg;
+
+	begin_function(decl->name->name, count_params(decl->sig), decl->sig->return_type != NULL);
+	scopes.push_back(std::map<std::string, uint32_t>());
+
+	// a slice is passed as its address and its length
+	for (arg = decl->sig->args; arg; arg = static_cast<ast_var_decl *>(arg->next))
+	{
+		bool slice = is_slice_type(arg->var_type);
+		uint32_t var = declare_local(arg->name, slice ? kind_slice : kind_int);
+		if (slice)
+		{
+			module.functions[func].ref_params[num_params] = true;
+		}
+		write_variable(var, block, emit(ir_param, IR_NO_VALUE, IR_NO_VALUE, num_params++, true));
+		if (slice)
+		{
+			write_variable(var + 1, block, emit(ir_param, IR_NO_VALUE, IR_NO_VALUE, num_params++, true));
+		}
+	}
+
+	build_stmts(decl->body->stmts);
+
+	// functions that do not end with a return statement return the zero value
+	if (module.functions[func].has_result)
+	{
+		emit(ir_ret, emit(ir_const, IR_NO_VALUE, IR_NO_VALUE, 0, true), IR_NO_VALUE, 0, false);
+	}
+	else
+	{
+		emit(ir_ret, IR_NO_VALUE, IR_NO_VALUE, 0, false);
+	}
+	module.functions[func].remove_unreachable_blocks();
+}
+
+void ir_builder::build_stmts(ast_stmt *stmts)
+{
+	for (ast_stmt *stmt = stmts; stmt; stmt = stmt->next)
+	{
+		build_stmt(stmt);
+	}
+}
+
+void ir_builder::build_stmt(ast_stmt *stmt)
+{
+	switch (stmt->type)
+	{
+		case node_var_decl:
+			build_var_decl(static_cast<ast_var_decl *>(stmt));
+			break;
+		case node_func_decl:
+			// nested functions cannot refer to the locals of the enclosing one
+			declare_function(static_cast<ast_func_decl *>(stmt));
+			pending.push_back(static_cast<ast_func_decl *>(stmt));
+			break;
+		case node_return:
+			build_return(static_cast<ast_return *>(stmt));
+			break;
+		case node_if:
+			build_if(static_cast<ast_if *>(stmt));
+			break;
+		case node_for:
+			build_for(static_cast<ast_for *>(stmt));
+			break;
+		case node_switch:
+			build_switch(static_cast<ast_switch *>(stmt));
+			break;
+		case node_break:
+		case node_continue:
+			build_branch(static_cast<ast_branch *>(stmt));
+			break;
+		default:
+			build_expr(static_cast<ast_expr *>(stmt));
+			break;
+	}
+}
+
+void ir_builder::build_var_decl(ast_var_decl *decl)
+{
+	var_kind kind = decl->var_type ? kind_of_type(decl->var_type) : kind_of_expr(decl->value);
+	ir_value value;
+
+	if (kind != kind_int && scopes.empty())
+	{
+		// global arrays are zeroed in .bss, and so are global slices without a value
+		ir_value ptr, len;
+		if (decl->value && kind == kind_array)
+		{
+			error(decl->value, msg_array_copy, decl->name->name);
+		}
+		else if (decl->value && build_slice(decl->value, ptr, len))
+		{
+			store_global_slice(module.symbol(decl->name->name), ptr, len);
+		}
+		return;
+	}
+	if (kind == kind_array)
+	{
+		build_array_decl(decl);
+		return;
+	}
+	if (kind == kind_slice)
+	{
+		build_slice_decl(decl);
+		return;
+	}
+
+	if (decl->value)
+	{
+		value = build_value(decl->value);
+	}
+	else
+	{
+		value = emit(ir_const, IR_NO_VALUE, IR_NO_VALUE, 0, true);
+	}
+
+	if (scopes.empty())
+	{
+		// top-level variables are declared by build
+		emit(ir_store, value, IR_NO_VALUE, module.symbol(decl->name->name), false);
+	}
+	else
+	{
+		write_variable(declare_local(decl->name), block, value);
+	}
+}
+
+void ir_builder::build_return(ast_return *ret)
+{
+	ir_value value = build_value(ret->value);
+
+	if (scopes.empty())
+	{
+		error(ret, msg_return_at_top_level);
+		return;
+	}
+	if (!module.functions[func].has_result)
+	{
+		error(ret->value, msg_too_many_return_values);
+		return;
+	}
+	emit(ir_ret, value, IR_NO_VALUE, 0, false);
+
+	// the statements that follow are unreachable, and their block is removed
+	// once the function is built
+	block = new_block();
+	seal_block(block);
+}
+
+/* builds the statements of body in a scope of their own */
+void ir_builder::build_block(ast_block *body)
+{
+	scopes.push_back(std::map<std::string, uint32_t>());
+	build_stmts(body->stmts);
+	scopes.pop_back();
+}
+
+/* the condition branches to the then block, or to the else block or past the statement.
+ * Both branches end by jumping past the statement, where phis merge their variables. */
+void ir_builder::build_if(ast_if *stmt)
+{
+	std::vector<uint32_t> ends;
+	uint32_t cond_block;
+
+	emit(ir_branch, build_value(stmt->cond), IR_NO_VALUE, 0, false);
+	cond_block = block;
+
+	block = new_block();
+	add_edge(cond_block, block);
+	seal_block(block);
+	build_block(stmt->then_block);
+	ends.push_back(block);
+	emit(ir_jump, IR_NO_VALUE, IR_NO_VALUE, 0, false);
+
+	if (stmt->else_block)
+	{
+		block = new_block();
+		add_edge(cond_block, block);
+		seal_block(block);
+		build_block(stmt->else_block);
+		ends.push_back(block);
+		emit(ir_jump, IR_NO_VALUE, IR_NO_VALUE, 0, false);
+	}
+	else
+	{
+		ends.insert(ends.begin(), cond_block);
+	}
+
+	block = new_block();
+	connect(ends, block);
+	seal_block(block);
+}
+
+/* Loops are rotated: the condition is tested once before the loop, and then at the end
+ * of every iteration, which branches back to the start of the body or leaves the loop.
+ * Each iteration then takes a single branch, and the body is entered from one block
+ * before the loop and left through one block at its end, where the post statement and
+ * the test are, and where continue statements jump. The body is only sealed once that
+ * block is built, so that the variables it assigns become phis at its start.
+ */
+void ir_builder::build_for(ast_for *loop)
+{
+	jump_targets loop_targets;
+	uint32_t body;
+
+	if (loop->init)
+	{
+		build_expr(loop->init);
+	}
+
+	loop_targets.is_loop = true;
+	body = new_block();
+	if (loop->cond)
+	{
+		// the second successor, leaving the loop, is added once it exists
+		emit(ir_branch, build_value(loop->cond), IR_NO_VALUE, 0, false);
+		add_edge(block, body);
+		loop_targets.breaks.push_back(block);
+	}
+	else
+	{
+		jump_to(body);
+	}
+	targets.push_back(loop_targets);
+
+	block = body;
+	build_block(loop->body);
+	emit(ir_jump, IR_NO_VALUE, IR_NO_VALUE, 0, false);
+	targets.back().continues.push_back(block);
+
+	block = new_block();
+	connect(targets.back().continues, block);
+	seal_block(block);
+	if (loop->post)
+	{
+		build_expr(loop->post);
+	}
+	if (loop->cond)
+	{
+		emit(ir_branch, build_value(loop->cond), IR_NO_VALUE, 0, false);
+		add_edge(block, body);
+		targets.back().breaks.push_back(block);
+	}
+	else
+	{
+		jump_to(body);
+	}
+	seal_block(body);
+
+	block = new_block();
+	connect(targets.back().breaks, block);
+	seal_block(block);
+	targets.pop_back();
+}
+
+/* returns 1 if the clauses of stmt can be chosen through a jump table: the switch has a
+ * tag, its values are integer constants, and they are many and dense enough. low and
+ * high are set to the smallest and largest of them. */
+int ir_builder::has_dense_cases(ast_switch *stmt, int64_t &low, int64_t &high)
+{
+	uint64_t count = 0;
+
+	if (!stmt->tag)
+	{
+		return 0;
+	}
+	for (ast_case_clause *clause = stmt->clauses; clause; clause = clause->next)
+	{
+		for (ast_stmt *value = clause->values; value; value = value->next)
+		{
+			if (value->type != node_int_lit || !static_cast<ast_int_lit *>(value)->value.fits_int())
+			{
+				return 0;
+			}
+			int64_t v = static_cast<ast_int_lit *>(value)->value.value;
+			low = count ? std::min(low, v) : v;
+			high = count ? std::max(high, v) : v;
+			count++;
+		}
+	}
+	return count >= SWITCH_TABLE_MIN_CASES && (uint64_t) (high - low) < SWITCH_TABLE_DENSITY * count;
+}
+
+/* Every clause gets a block, and so does the default even without a clause, before the
+ * one that chooses between them. Dense switches on constants jump through a table
+ * indexed by the value of the tag, and others compare it with each value in turn, in
+ * the order of the source. Clauses end by jumping past the switch.
+ */
+void ir_builder::build_switch(ast_switch *stmt)
+{
+	jump_targets switch_targets;
+	std::vector<uint32_t> clause_blocks;
+	uint32_t default_block = (uint32_t) -1;
+	std::set<int64_t> seen;
+	int64_t low = 0, high = 0;
+	ast_case_clause *clause;
+
+	ir_value tag = stmt->tag ? build_value(stmt->tag) : IR_NO_VALUE;
+
+	for (clause = stmt->clauses; clause; clause = clause->next)
+	{
+		clause_blocks.push_back(new_block());
+		if (clause->values)
+		{
+			continue;
+		}
+		if (default_block != (uint32_t) -1)
+		{
+			error(clause, msg_multiple_defaults);
+		}
+		default_block = clause_blocks.back();
+	}
+	bool has_default = default_block != (uint32_t) -1;
+	if (!has_default)
+	{
+		default_block = new_block();
+	}
+
+	// constants may only appear once, the first clause would always be chosen
+	for (clause = stmt->clauses; clause && stmt->tag; clause = clause->next)
+	{
+		for (ast_stmt *value = clause->values; value; value = value->next)
+		{
+			ast_int_lit *literal = static_cast<ast_int_lit *>(value);
+			if (value->type == node_int_lit && literal->value.fits_int() && !seen.insert(literal->value.value).second)
+			{
+				std::ostringstream digits;
+				digits << literal->value;
+				error(value, msg_duplicate_case, digits.str());
+			}
+		}
+	}
+
+	if (has_dense_cases(stmt, low, high))
+	{
+		std::vector<uint32_t> table(high - low + 1, default_block);
+		uint32_t c = 0;
+
+		for (clause = stmt->clauses; clause; clause = clause->next, c++)
+		{
+			for (ast_stmt *value = clause->values; value; value = value->next)
+			{
+				uint32_t &entry = table[static_cast<ast_int_lit *>(value)->value.value - low];
+				entry = entry == default_block ? clause_blocks[c] : entry;
+			}
+		}
+		emit(ir_switch, tag, IR_NO_VALUE, low, false);
+		add_edge(block, default_block);
+		for (std::vector<uint32_t>::size_type t = 0; t != table.size(); t++)
+		{
+			add_edge(block, table[t]);
+		}
+	}
+	else
+	{
+		uint32_t c = 0;
+
+		for (clause = stmt->clauses; clause; clause = clause->next, c++)
+		{
+			for (ast_stmt *value = clause->values; value; value = value->next)
+			{
+				ir_value v = build_value(static_cast<ast_expr *>(value));
+				emit(ir_branch, stmt->tag ? emit(ir_eq, tag, v, 0, true) : v, IR_NO_VALUE, 0, false);
+				add_edge(block, clause_blocks[c]);
+
+				uint32_t next = new_block();
+				add_edge(block, next);
+				seal_block(next);
+				block = next;
+			}
+		}
+		jump_to(default_block);
+	}
+
+	switch_targets.is_loop = false;
+	targets.push_back(switch_targets);
+
+	for (std::vector<uint32_t>::size_type b = 0; b != clause_blocks.size(); b++)
+	{
+		seal_block(clause_blocks[b]);
+	}
+	seal_block(default_block);
+
+	uint32_t c = 0;
+	for (clause = stmt->clauses; clause; clause = clause->next, c++)
+	{
+		block = clause_blocks[c];
+		scopes.push_back(std::map<std::string, uint32_t>());
+		build_stmts(clause->stmts);
+		scopes.pop_back();
+		emit(ir_jump, IR_NO_VALUE, IR_NO_VALUE, 0, false);
+		targets.back().breaks.push_back(block);
+	}
+	if (!has_default)
+	{
+		block = default_block;
+		emit(ir_jump, IR_NO_VALUE, IR_NO_VALUE, 0, false);
+		targets.back().breaks.push_back(block);
+	}
+
+	block = new_block();
+	connect(targets.back().breaks, block);
+	seal_block(block);
+	targets.pop_back();
+}
+
+/* jumps past the innermost loop or switch for break, or to the end of the body of the
+ * innermost loop for continue */
+void ir_builder::build_branch(ast_branch *stmt)
+{
+	std::vector<jump_targets>::size_type t = targets.size();
+
+	while (t > 0 && stmt->type == node_continue && !targets[t - 1].is_loop)
+	{
+		t--;
+	}
+	if (!t)
+	{
+		error(stmt, stmt->type == node_break ? msg_misplaced_break : msg_misplaced_continue);
+		return;
+	}
+
+	emit(ir_jump, IR_NO_VALUE, IR_NO_VALUE, 0, false);
+	if (stmt->type == node_break)
+	{
+		targets[t - 1].breaks.push_back(block);
+	}
+	else
+	{
+		targets[t - 1].continues.push_back(block);
+	}
+
+	// the statements that follow are unreachable, like those after a return
+	block = new_block();
+	seal_block(block);
+}
+
+ir_value ir_builder::build_expr(ast_expr *expr)
+{
+	switch (expr->type)
+	{
+		case node_ident:
+		{
+			const std::string &name = static_cast<ast_ident *>(expr)->name;
+			int var = find_local(name);
+			if (var >= 0 && locals[var].kind == kind_int)
+			{
+				return read_variable(var, block);
+			}
+			uint32_t sym = module.symbol(name);
+			if (var < 0)
+			{
+				resolve(name, sym);
+			}
+			if (var >= 0 || global_arrays.count(sym) || global_slices.count(sym))
+			{
+				error(expr, msg_not_int, name);
+				return emit(ir_const, IR_NO_VALUE, IR_NO_VALUE, 0, true);
+			}
+			if (!globals.count(sym))
+			{
+				error(expr, msg_undefined, name);
+				return emit(ir_const, IR_NO_VALUE, IR_NO_VALUE, 0, true);
+			}
+			return emit(ir_load, IR_NO_VALUE, IR_NO_VALUE, sym, true);
+		}
+		case node_int_lit:
+		{
+			const int_literal &literal = static_cast<ast_int_lit *>(expr)->value;
+			if (!literal.fits_int())
+			{
+				std::ostringstream digits;
+				digits << literal;
+				error(expr, msg_constant_overflow, digits.str());
+				return emit(ir_const, IR_NO_VALUE, IR_NO_VALUE, 0, true);
+			}
+			return emit(ir_const, IR_NO_VALUE, IR_NO_VALUE, (int64_t) literal.value, true);
+		}
+		case node_operation:
+		{
+			ast_operation *op = static_cast<ast_operation *>(expr);
+			ir_value lhs = op->lhs ? build_value(op->lhs) : emit(ir_const, IR_NO_VALUE, IR_NO_VALUE, 0, true);
+			ir_value rhs = build_value(op->rhs);
+			return emit(binary_opcode(op->op), lhs, rhs, 0, true);
+		}
+		case node_func_call:
+			return build_call(static_cast<ast_func_call *>(expr));
+		case node_var_assign:
+		{
+			ast_var_assign *assign = static_cast<ast_var_assign *>(expr);
+			int var = find_local(assign->name->name);
+			ir_value ptr, len;
+			if (var >= 0 && locals[var].kind == kind_slice)
+			{
+				if (!build_slice(assign->value, ptr, len))
+				{
+					return emit(ir_const, IR_NO_VALUE, IR_NO_VALUE, 0, true);
+				}
+				write_variable(var, block, ptr);
+				write_variable(var + 1, block, len);
+				return ptr;
+			}
+			if (var >= 0 && locals[var].kind == kind_array)
+			{
+				error(assign, msg_array_copy, assign->name->name);
+				return emit(ir_const, IR_NO_VALUE, IR_NO_VALUE, 0, true);
+			}
+			uint32_t sym = module.symbol(assign->name->name);
+			if (var < 0 && global_slices.count(sym))
+			{
+				if (!build_slice(assign->value, ptr, len))
+				{
+					return emit(ir_const, IR_NO_VALUE, IR_NO_VALUE, 0, true);
+				}
+				store_global_slice(sym, ptr, len);
+				return ptr;
+			}
+			return build_assign(assign->name, build_value(assign->value));
+		}
+		case node_index:
+		{
+			ast_index *index = static_cast<ast_index *>(expr);
+			ir_value addr = build_element(index->name, index->index);
+			if (addr == IR_NO_VALUE)
+			{
+				return emit(ir_const, IR_NO_VALUE, IR_NO_VALUE, 0, true);
+			}
+			return emit(ir_read, addr, IR_NO_VALUE, 0, true);
+		}
+		case node_index_assign:
+		{
+			ast_index_assign *assign = static_cast<ast_index_assign *>(expr);
+			ir_value addr = build_element(assign->name, assign->index);
+			ir_value value = build_value(assign->value);
+			if (addr != IR_NO_VALUE)
+			{
+				emit(ir_write, addr, value, 0, false);
+			}
+			return value;
+		}
+		case node_slice_expr:
+			error(expr, msg_not_int, "slice of " + static_cast<ast_slice_expr *>(expr)->name->name);
+			return emit(ir_const, IR_NO_VALUE, IR_NO_VALUE, 0, true);
+		default:
+			error(expr, msg_unexpected_expression);
+			return emit(ir_const, IR_NO_VALUE, IR_NO_VALUE, 0, true);
+	}
+}
+
+/* like build_expr, but reports calls to functions without a result */
+ir_value ir_builder::build_value(ast_expr *expr)
+{
+	ir_value value = build_expr(expr);
+
+	if (value == IR_NO_VALUE)
+	{
+		error(expr, msg_used_as_value, static_cast<ast_func_call *>(expr)->name->name);
+		value = emit(ir_const, IR_NO_VALUE, IR_NO_VALUE, 0, true);
+	}
+	return value;
+}
+
+ir_value ir_builder::build_call(ast_func_call *call)
+{
+	std::vector<ir_value> operands;
+	uint32_t sym = module.symbol(call->name->name);
+
+	resolve(call->name->name, sym);
+	std::map<uint32_t, callee>::iterator info = functions.find(sym);
+	if (info == functions.end() && !globals.count(sym) && call->name->name == "len")
+	{
+		return build_len(call);
+	}
+
+	// slices are passed as two values, to the parameters declared as slices, and when
+	// only the number of parameters is known, wherever an argument is a slice
+	std::vector<bool>::size_type p = 0;
+	for (ast_stmt *arg = call->args; arg; arg = arg->next, p++)
+	{
+		ast_expr *value = static_cast<ast_expr *>(arg);
+		bool slice = info != functions.end() && p < info->second.slices.size() ? info->second.slices[p]
+			: kind_of_expr(value) == kind_slice;
+		ir_value ptr, len;
+		if (!slice)
+		{
+			operands.push_back(build_value(value));
+		}
+		else if (build_slice(value, ptr, len))
+		{
+			operands.push_back(ptr);
+			operands.push_back(len);
+		}
+		else
+		{
+			operands.push_back(emit(ir_const, IR_NO_VALUE, IR_NO_VALUE, 0, true));
+			operands.push_back(operands.back());
+		}
+	}
+
+	if (globals.count(sym))
+	{
+		error(call->name, msg_call_non_function, call->name->name);
+	}
+
+	else if (info != functions.end() && operands.size() != info->second.num_params)
+	{
+		error(call, operands.size() < info->second.num_params ? msg_not_enough_arguments : msg_too_many_arguments, call->name->name);
+	}
+
+	// functions that are neither declared here nor exported by an imported package are
+	// external, and assumed to return a value
+	return emit_call(sym, operands, info == functions.end() || info->second.has_result);
+}
+
+ir_value ir_builder::build_assign(ast_ident *name, ir_value value)
+{
+	int var = find_local(name->name);
+
+	if (var >= 0)
+	{
+		write_variable(var, block, value);
+		return value;
+	}
+
+	uint32_t sym = module.symbol(name->name);
+	resolve(name->name, sym);
+	if (!globals.count(sym))
+	{
+		error(name, msg_undefined, name->name);
+	}
+	else if (global_arrays.count(sym))
+	{
+		error(name, msg_array_copy, name->name);
+	}
+	else
+	{
+		emit(ir_store, value, IR_NO_VALUE, sym, false);
+	}
+	return value;
+}
+
+/* arrays and slices */
+
+/* reserves the elements in the frame, and zeroes them each time the declaration runs.
+ * An array that escapes is allocated again each time instead, as each run declares a new
+ * variable that slices of the previous one may still refer to. */
+void ir_builder::build_array_decl(ast_var_decl *decl)
+{
+	int64_t length = checked_length(static_cast<ast_array_type *>(decl->var_type));
+	ir_function &f = module.functions[func];
+	uint32_t offset = f.frame_words;
+
+	if (decl->value)
+	{
+		error(decl->value, msg_array_copy, decl->name->name);
+	}
+
+	if (escapes && escapes->escapes(decl))
+	{
+		std::vector<ir_value> operands;
+		operands.push_back(emit(ir_const, IR_NO_VALUE, IR_NO_VALUE, length, true));
+		ir_value ptr = emit_call(module.symbol(IR_HEAP_ALLOC), operands, true);
+		uint32_t var = declare_local(decl->name, kind_array);
+		locals[var].length = length;
+		locals[var].heap = true;
+		write_variable(var, block, ptr);
+		return;
+	}
+
+	f.frame_words += length;
+	uint32_t var = declare_local(decl->name, kind_array);
+	locals[var].length = length;
+	locals[var].offset = offset;
+	if (length)
+	{
+		emit(ir_zero, emit(ir_frame_addr, IR_NO_VALUE, IR_NO_VALUE, offset, true), IR_NO_VALUE, length, false);
+	}
+}
+
+/* a slice without a value is nil: no address and a length of 0 */
+void ir_builder::build_slice_decl(ast_var_decl *decl)
+{
+	ir_value ptr, len;
+
+	if (!decl->value || !build_slice(decl->value, ptr, len))
+	{
+		ptr = len = emit(ir_const, IR_NO_VALUE, IR_NO_VALUE, 0, true);
+	}
+
+	// declared after its value is built, which may refer to a variable it hides
+	uint32_t var = declare_local(decl->name, kind_slice);
+	write_variable(var, block, ptr);
+	write_variable(var + 1, block, len);
+}
+
+/* sets ptr and len to the address of the first element and the length of the array or
+ * slice called name, and length to the number of elements of an array, -1 for a slice.
+ * returns 1 on success, 0 after reporting message. */
+int ir_builder::build_base(ast_ident *name, diag_message message, ir_value &ptr, ir_value &len, int64_t &length)
+{
+	int var = find_local(name->name);
+	uint32_t sym = module.symbol(name->name);
+
+	if (var >= 0 && locals[var].kind == kind_slice)
+	{
+		ptr = read_variable(var, block);
+		len = read_variable(var + 1, block);
+		length = -1;
+		return 1;
+	}
+	if (var < 0 && global_slices.count(sym))
+	{
+		load_global_slice(sym, ptr, len);
+		length = -1;
+		return 1;
+	}
+	if (var >= 0 && locals[var].kind == kind_array)
+	{
+		ptr = locals[var].heap ? read_variable(var, block)
+			: emit(ir_frame_addr, IR_NO_VALUE, IR_NO_VALUE, locals[var].offset, true);
+		length = locals[var].length;
+	}
+	else if (var < 0 && global_arrays.count(sym))
+	{
+		ptr = emit(ir_global_addr, IR_NO_VALUE, IR_NO_VALUE, sym, true);
+		length = global_arrays[sym];
+	}
+	else
+	{
+		error(name, message, name->name);
+		return 0;
+	}
+	len = emit(ir_const, IR_NO_VALUE, IR_NO_VALUE, length, true);
+	return 1;
+}
+
+/* sets ptr and len to the address of the first element and the length of the slice expr
+ * gives. A slice expression checks that 0 <= low <= high <= the length it slices.
+ * returns 1 on success, 0 after reporting an error. */
+int ir_builder::build_slice(ast_expr *expr, ir_value &ptr, ir_value &len)
+{
+	int64_t length;
+
+	if (expr->type == node_ident)
+	{
+		const std::string &name = static_cast<ast_ident *>(expr)->name;
+		if (kind_of_expr(expr) != kind_slice)
+		{
+			error(expr, msg_not_slice, name);
+			return 0;
+		}
+		return build_base(static_cast<ast_ident *>(expr), msg_not_slice, ptr, len, length);
+	}
+	if (expr->type != node_slice_expr)
+	{
+		error(expr, msg_not_slice, "expression");
+		return 0;
+	}
+
+	ast_slice_expr *slice = static_cast<ast_slice_expr *>(expr);
+	ir_value base, n;
+	if (!build_base(slice->name, msg_not_indexable, base, n, length))
+	{
+		return 0;
+	}
+
+	ir_value low = slice->low ? build_value(slice->low) : emit(ir_const, IR_NO_VALUE, IR_NO_VALUE, 0, true);
+	ir_value high = slice->high ? build_value(slice->high) : n;
+	ir_value one = emit(ir_const, IR_NO_VALUE, IR_NO_VALUE, 1, true);
+	if (slice->high)
+	{
+		emit(ir_check, high, emit(ir_add, n, one, 0, true), 0, false);
+	}
+	if (slice->low)
+	{
+		emit(ir_check, low, emit(ir_add, high, one, 0, true), 0, false);
+	}
+
+	ir_value offset = emit(ir_mul, low, emit(ir_const, IR_NO_VALUE, IR_NO_VALUE, 8, true), 0, true);
+	ptr = emit(ir_add, base, offset, 0, true);
+	len = emit(ir_sub, high, low, 0, true);
+	return 1;
+}
+
+/* returns the address of element index of the array or slice called name, after checking
+ * that it is in range, or IR_NO_VALUE after reporting an error. Constant indices into
+ * arrays are checked here instead. */
+ir_value ir_builder::build_element(ast_ident *name, ast_expr *index)
+{
+	ir_value ptr, len;
+	int64_t length;
+
+	if (!build_base(name, msg_not_indexable, ptr, len, length))
+	{
+		build_value(index);
+		return IR_NO_VALUE;
+	}
+
+	ir_value i = build_value(index);
+	if (index->type == node_int_lit && length >= 0)
+	{
+		const int_literal &literal = static_cast<ast_int_lit *>(index)->value;
+		if (literal.fits_int() && (int64_t) literal.value >= length)
+		{
+			std::ostringstream digits;
+			digits << literal;
+			error(index, msg_index_out_of_range, digits.str());
+		}
+	}
+	else
+	{
+		emit(ir_check, i, len, 0, false);
+	}
+
+	ir_value offset = emit(ir_mul, i, emit(ir_const, IR_NO_VALUE, IR_NO_VALUE, 8, true), 0, true);
+	return emit(ir_add, ptr, offset, 0, true);
+}
+
+/* the length of an array is a constant, that of a slice is held next to its address */
+ir_value ir_builder::build_len(ast_func_call *call)
+{
+	ast_expr *arg = call->args;
+	ir_value ptr, len;
+	int64_t length;
+
+	if (!arg || arg->next)
+	{
+		error(call, arg ? msg_too_many_arguments : msg_not_enough_arguments, call->name->name);
+	}
+	else if (arg->type == node_slice_expr && build_slice(arg, ptr, len))
+	{
+		return len;
+	}
+	else if (arg->type == node_ident && build_base(static_cast<ast_ident *>(arg), msg_invalid_len, ptr, len, length))
+	{
+		return len;
+	}
+	else if (arg->type != node_slice_expr && arg->type != node_ident)
+	{
+		build_value(arg);
+		error(arg, msg_invalid_len, "expression");
+	}
+	return emit(ir_const, IR_NO_VALUE, IR_NO_VALUE, 0, true);
+}
+
+/* the address of the global slice sym, and of its length after it */
+void ir_builder::load_global_slice(uint32_t sym, ir_value &ptr, ir_value &len)
+{
+	ir_value addr = emit(ir_global_addr, IR_NO_VALUE, IR_NO_VALUE, sym, true);
+	ir_value len_addr = emit(ir_add, addr, emit(ir_const, IR_NO_VALUE, IR_NO_VALUE, 8, true), 0, true);
+
+	ptr = emit(ir_read, addr, IR_NO_VALUE, 0, true);
+	len = emit(ir_read, len_addr, IR_NO_VALUE, 0, true);
+}
+
+void ir_builder::store_global_slice(uint32_t sym, ir_value ptr, ir_value len)
+{
+	ir_value addr = emit(ir_global_addr, IR_NO_VALUE, IR_NO_VALUE, sym, true);
+	ir_value len_addr = emit(ir_add, addr, emit(ir_const, IR_NO_VALUE, IR_NO_VALUE, 8, true), 0, true);
+
+	emit(ir_write, addr, ptr, 0, false);
+	emit(ir_write, len_addr, len, 0, false);
+}
@@ -0,0 +1,253 @@
+#ifndef IR_BUILDER_HPP
+#define IR_BUILDER_HPP
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "ast_node.hpp"
+#include "diagnostics.hpp"
+#include "escape_analysis.hpp"
+#include "export_data.hpp"
+#include "ir.hpp"
+
+class go_driver;
+
+/* Translates the AST into SSA form in a single pass, with the algorithm of Braun et al.,
+ * "Simple and Efficient Construction of Static Single Assignment Form": the value of a
+ * local variable is looked up in the block being built, and phis are only placed in
+ * blocks where a variable is read before it is assigned.
+ *
+ * Top-level variables become globals, and the other top-level statements form the
+ * function "<package>.init". Errors are reported through the driver.
+ *
+ * Arrays are laid out contiguously, local ones in the frame and others in .bss, and are
+ * zeroed when declared. A slice is a pair of values, the address of its first element
+ * and its length, held in two consecutive local variables or passed as two arguments.
+ * Every index is checked against the length before the element is accessed. Arrays a
+ * slice of which may outlive their function, as found by escape_analysis, are allocated
+ * on the heap instead, and a global slice takes two words of .bss.
+ *
+ * Imported packages are looked up in the export files of their compiled objects, and a
+ * name that is not declared here is searched for in them the first time it is used.
+ * The grammar has no selectors, so the names a package exports are used unqualified.
+ */
+class ir_builder
+{
+public:
+	// directories searched for "<path>.x", the export file of each imported package
+	std::vector<std::string> import_dirs;
+
+	// every export file looked for, whether it was found or not, in order
+	std::vector<std::string> import_candidates;
+
+	// the functions and variables of the tree whose name starts with an upper-case letter
+	export_data exports;
+
+	// where the escape analysis of the tree is reported, NULL for nowhere
+	std::ostream *escape_report;
+
+	ir_builder(go_driver &driver, ir_module &module);
+	~ir_builder();
+
+	/* adds the functions and global variables of tree to the module.
+	 * returns 0 if the tree was translated without errors, 1 otherwise. */
+	int build(ast_root *tree);
+
+private:
+	/* a phi whose operands are added once all predecessors of its block are known */
+	struct incomplete_phi
+	{
+		uint32_t block;
+		uint32_t var;
+		ir_value phi;
+	};
+
+	/* the blocks ending with a jump out of the innermost loop or switch, whose target
+	 * is only created once its body is built */
+	struct jump_targets
+	{
+		std::vector<uint32_t> breaks;
+
+		// only loops can be continued, at the end of their body
+		std::vector<uint32_t> continues;
+		bool is_loop;
+	};
+
+	/* what calls to a function are checked against. num_params counts the values passed,
+	 * two for each slice */
+	struct callee
+	{
+		uint32_t num_params;
+		bool has_result;
+
+		// which of the declared parameters are slices, empty for imported functions
+		std::vector<bool> slices;
+	};
+
+	enum var_kind
+	{
+		kind_int,
+		kind_array,
+		kind_slice
+	};
+
+	/* the shape of a local variable. A slice uses the variable after its own for its length */
+	struct local_var
+	{
+		var_kind kind;
+
+		// for arrays, the number of elements, and the offset of the first in the frame.
+		// The address of an array on the heap is the value of the variable instead
+		int64_t length;
+		uint32_t offset;
+		bool heap;
+	};
+
+	go_driver &driver;
+	ir_module &module;
+
+	// index of the function being built in module.functions, and of its current block.
+	// func is past the end of module.functions outside of any function
+	std::size_t func;
+	uint32_t block;
+
+	// innermost scope last, each maps the name of a local variable to its index
+	std::vector<std::map<std::string, uint32_t> > scopes;
+	uint32_t num_locals;
+	std::vector<local_var> locals;
+
+	// defs[block][var] is the value of a local variable at the end of a block
+	std::vector<std::vector<ir_value> > defs;
+
+	// whether all predecessors of each block are known
+	std::vector<bool> sealed;
+	std::vector<incomplete_phi> incomplete;
+
+	// symbols of the global variables and of the functions, including those imported
+	std::map<uint32_t, bool> globals;
+	std::map<uint32_t, callee> functions;
+
+	// number of elements of the global arrays, and the global slices
+	std::map<uint32_t, int64_t> global_arrays;
+	std::map<uint32_t, bool> global_slices;
+
+	// the arrays of the tree being built that escape, NULL outside of build
+	const escape_analysis *escapes;
+
+	// export files of the imported packages that were found
+	std::vector<export_data *> imports;
+
+	// loops and switches enclosing the statement being built, innermost last
+	std::vector<jump_targets> targets;
+
+	// functions declared inside other functions, built after the current one
+	std::vector<ast_func_decl *> pending;
+
+	int errors;
+
+	/* reports an error about node, in the function being built if there is one */
+	void error(const ast_node *node, diag_message message, const std::string &arg = std::string());
+
+	/* declares the function and its result so that calls to it can be checked */
+	void declare_function(ast_func_decl *decl);
+
+	/* opens the export file of each package imported by tree that can be found */
+	void open_imports(ast_root *tree);
+
+	/* looks name up in the imported packages, unless it is declared here or was found before */
+	void resolve(const std::string &name, uint32_t sym);
+
+	/* returns 1 if name is exported by an imported package, after declaring it as sym */
+	int find_import(const std::string &name, uint32_t sym);
+
+	/* starts a new function, with an entry block */
+	void begin_function(const std::string &name, uint32_t num_params, bool has_result);
+
+	/* appends a new block and returns its index */
+	uint32_t new_block();
+
+	/* adds the phi operands of a block whose predecessors are all known */
+	void seal_block(uint32_t b);
+
+	/* adds to from the successor to, and from to the predecessor to */
+	void add_edge(uint32_t from, uint32_t to);
+
+	/* ends the current block with a jump to target */
+	void jump_to(uint32_t target);
+
+	/* makes target the next successor of each block of sources, and the target of the jump
+	 * that ends those ending with one */
+	void connect(const std::vector<uint32_t> &sources, uint32_t target);
+
+	/* SSA construction proper */
+	void write_variable(uint32_t var, uint32_t b, ir_value value);
+	ir_value read_variable(uint32_t var, uint32_t b);
+	ir_value read_variable_recursive(uint32_t var, uint32_t b);
+	void add_phi_operands(uint32_t var, ir_value phi, uint32_t b);
+
+	/* inserts an instruction at the start of block b, after its phis */
+	ir_value insert_front(uint32_t b, ir_opcode op, int64_t imm);
+
+	/* appends an instruction to the current block and returns its result */
+	ir_value emit(ir_opcode op, ir_value a, ir_value b, int64_t imm, bool has_result);
+
+	/* appends a call of the function sym with the given arguments */
+	ir_value emit_call(uint32_t sym, const std::vector<ir_value> &operands, bool has_result);
+
+	/* returns the index of the local variable called name, or -1 */
+	int find_local(const std::string &name);
+	uint32_t declare_local(ast_ident *name, var_kind kind = kind_int);
+
+	/* returns the shape of variables of the given type */
+	var_kind kind_of_type(ast_ident *type);
+
+	/* returns the number of elements of an array type, or 0 after reporting an error */
+	int64_t checked_length(ast_array_type *type);
+
+	/* returns the kind of value expr gives */
+	var_kind kind_of_expr(ast_expr *expr);
+
+	/* builders for each kind of node */
+	void build_function(ast_func_decl *decl);
+	void build_stmts(ast_stmt *stmts);
+	void build_stmt(ast_stmt *stmt);
+	void build_var_decl(ast_var_decl *decl);
+	void build_return(ast_return *ret);
+	void build_block(ast_block *body);
+	void build_if(ast_if *stmt);
+	void build_for(ast_for *loop);
+	void build_switch(ast_switch *stmt);
+	void build_branch(ast_branch *stmt);
+
+	/* returns 1 if the clauses of stmt can be chosen through a jump table */
+	int has_dense_cases(ast_switch *stmt, int64_t &low, int64_t &high);
+	ir_value build_expr(ast_expr *expr);
+	ir_value build_value(ast_expr *expr);
+	ir_value build_call(ast_func_call *call);
+	ir_value build_assign(ast_ident *name, ir_value value);
+
+	/* arrays and slices */
+	void build_array_decl(ast_var_decl *decl);
+	void build_slice_decl(ast_var_decl *decl);
+
+	/* sets ptr and len to the address of the first element and the length of the array or
+	 * slice called name, and length to the number of elements of an array, -1 for a slice.
+	 * returns 1 on success, 0 after reporting message. */
+	int build_base(ast_ident *name, diag_message message, ir_value &ptr, ir_value &len, int64_t &length);
+
+	/* sets ptr and len to the address of the first element and the length of the slice
+	 * expr gives. returns 1 on success, 0 after reporting an error. */
+	int build_slice(ast_expr *expr, ir_value &ptr, ir_value &len);
+
+	/* returns the address of element index of the array or slice called name, after
+	 * checking that it is in range, or IR_NO_VALUE after reporting an error */
+	ir_value build_element(ast_ident *name, ast_expr *index);
+	ir_value build_len(ast_func_call *call);
+
+	/* the address of the global slice sym, and of its length after it */
+	void load_global_slice(uint32_t sym, ir_value &ptr, ir_value &len);
+	void store_global_slice(uint32_t sym, ir_value ptr, ir_value len);
+};
+
+#endif
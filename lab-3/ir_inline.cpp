@@ -0,0 +1,271 @@
+#include "ir_inline.hpp"
+
+#include <algorithm>
+#include <map>
+#include <sstream>
+#include <utility>
+
+ir_inline_options::ir_inline_options()
+	: callee_limit(16), caller_limit(400), report(NULL)
+{
+}
+
+/* maps the symbol of every function defined by module to its index */
+static std::map<uint32_t, uint32_t> function_indices(const ir_module &module)
+{
+	std::map<uint32_t, uint32_t> indices;
+	for (std::vector<ir_function>::size_type f = 0; f != module.functions.size(); f++)
+	{
+		indices[module.functions[f].name] = f;
+	}
+	return indices;
+}
+
+/* returns the index of the function called by inst, or -1 if it is not defined in the module */
+static int64_t callee_index(const std::map<uint32_t, uint32_t> &indices, const ir_inst &inst)
+{
+	std::map<uint32_t, uint32_t>::const_iterator it = indices.find(inst.imm);
+	return it == indices.end() ? -1 : (int64_t) it->second;
+}
+
+/* Finds the strongly connected components with Tarjan's algorithm, which completes
+ * each component after every component it calls: that order is bottom-up.
+ */
+ir_call_graph::ir_call_graph(const ir_module &module)
+{
+	std::map<uint32_t, uint32_t> indices = function_indices(module);
+	std::size_t num_functions = module.functions.size();
+	std::vector<std::vector<uint32_t> > callees(num_functions);
+	std::vector<int64_t> index(num_functions, -1), lowlink(num_functions, 0);
+	std::vector<bool> on_stack(num_functions, false);
+	std::vector<uint32_t> stack;
+	int64_t next_index = 0;
+	uint32_t num_components = 0;
+
+	// (function, next callee to visit)
+	std::vector<std::pair<uint32_t, uint32_t> > work;
+
+	component.assign(num_functions, 0);
+	call_sites.assign(num_functions, 0);
+	recursive.assign(num_functions, false);
+
+	for (std::size_t f = 0; f != num_functions; f++)
+	{
+		const std::vector<ir_block> &blocks = module.functions[f].blocks;
+		for (std::vector<ir_block>::size_type b = 0; b != blocks.size(); b++)
+		{
+			for (std::vector<ir_inst>::size_type i = 0; i != blocks[b].insts.size(); i++)
+			{
+				int64_t callee = blocks[b].insts[i].op == ir_call ? callee_index(indices, blocks[b].insts[i]) : -1;
+				if (callee >= 0)
+				{
+					callees[f].push_back(callee);
+					call_sites[callee]++;
+					recursive[f] = recursive[f] || callee == (int64_t) f;
+				}
+			}
+		}
+	}
+
+	for (std::size_t root = 0; root != num_functions; root++)
+	{
+		if (index[root] >= 0)
+		{
+			continue;
+		}
+
+		index[root] = lowlink[root] = next_index++;
+		stack.push_back(root);
+		on_stack[root] = true;
+		work.push_back(std::make_pair((uint32_t) root, 0u));
+
+		while (!work.empty())
+		{
+			uint32_t f = work.back().first;
+			if (work.back().second < callees[f].size())
+			{
+				uint32_t callee = callees[f][work.back().second++];
+				if (index[callee] < 0)
+				{
+					index[callee] = lowlink[callee] = next_index++;
+					stack.push_back(callee);
+					on_stack[callee] = true;
+					work.push_back(std::make_pair(callee, 0u));
+				}
+				else if (on_stack[callee])
+				{
+					lowlink[f] = std::min(lowlink[f], index[callee]);
+				}
+				continue;
+			}
+
+			work.pop_back();
+			if (!work.empty())
+			{
+				uint32_t caller = work.back().first;
+				lowlink[caller] = std::min(lowlink[caller], lowlink[f]);
+			}
+			if (lowlink[f] != index[f])
+			{
+				continue;
+			}
+
+			// f is the first function visited in its component, which is on the stack above it
+			std::vector<uint32_t>::size_type first = std::find(stack.begin(), stack.end(), f) - stack.begin();
+			bool cycle = stack.size() - first > 1;
+			for (std::vector<uint32_t>::size_type s = first; s != stack.size(); s++)
+			{
+				component[stack[s]] = num_components;
+				recursive[stack[s]] = recursive[stack[s]] || cycle;
+				on_stack[stack[s]] = false;
+				bottom_up.push_back(stack[s]);
+			}
+			stack.resize(first);
+			num_components++;
+		}
+	}
+}
+
+/* returns why the call inst to callee cannot be inlined into a function of size caller_size,
+ * or NULL if it can */
+static const char *inline_failure(const ir_function &callee, const ir_inst &inst, std::size_t caller_size,
+	const ir_call_graph &graph, uint32_t callee_index, const ir_inline_options &options, std::string &detail)
+{
+	std::size_t callee_size = callee.size();
+	std::ostringstream msg;
+
+	if (graph.recursive[callee_index])
+	{
+		return "recursive";
+	}
+	if (callee.blocks.size() != 1 || callee.blocks[0].insts.empty() || callee.blocks[0].insts.back().op != ir_ret)
+	{
+		return "has control flow";
+	}
+	if (callee.frame_words)
+	{
+		return "has local arrays";
+	}
+	if (callee.num_params != inst.args_count || callee.has_result != (inst.result != IR_NO_VALUE))
+	{
+		return "does not match the call";
+	}
+	if (callee_size > options.callee_limit)
+	{
+		msg << callee_size << " instructions, the limit is " << options.callee_limit;
+	}
+	else if (caller_size + callee_size - 1 > options.caller_limit)
+	{
+		msg << "caller would grow past " << options.caller_limit << " instructions";
+	}
+	else
+	{
+		return NULL;
+	}
+	detail = msg.str();
+	return detail.c_str();
+}
+
+/* appends the body of callee to insts in place of the call inst made by func */
+static void splice(ir_function &func, const ir_inst &inst, const ir_function &callee, std::vector<ir_inst> &insts)
+{
+	const std::vector<ir_inst> &body = callee.blocks[0].insts;
+	std::vector<ir_value> map(callee.num_values, IR_NO_VALUE);
+
+	for (std::vector<ir_inst>::size_type i = 0; i != body.size(); i++)
+	{
+		const ir_inst &orig = body[i];
+		if (orig.op == ir_nop)
+		{
+			continue;
+		}
+		if (orig.op == ir_param)
+		{
+			// parameters stand for the arguments directly
+			map[orig.result] = func.args[inst.args_begin + orig.imm];
+			continue;
+		}
+		if (orig.op == ir_ret)
+		{
+			if (inst.result != IR_NO_VALUE)
+			{
+				ir_inst copy(ir_copy, inst.result);
+				copy.a = map[orig.a];
+				insts.push_back(copy);
+			}
+			continue;
+		}
+
+		ir_inst clone = orig;
+		if (orig.result != IR_NO_VALUE)
+		{
+			clone.result = map[orig.result] = func.new_value();
+		}
+		clone.a = orig.a == IR_NO_VALUE ? IR_NO_VALUE : map[orig.a];
+		clone.b = orig.b == IR_NO_VALUE ? IR_NO_VALUE : map[orig.b];
+		clone.args_begin = func.args.size();
+		for (uint32_t j = 0; j != orig.args_count; j++)
+		{
+			func.args.push_back(map[callee.args[orig.args_begin + j]]);
+		}
+		insts.push_back(clone);
+	}
+}
+
+/* replaces the calls made by the function of index caller with the body of their callee,
+ * for callees that are small and not recursive. Returns the number of calls inlined. */
+std::size_t ir_inline_calls(ir_module &module, uint32_t caller, const ir_call_graph &graph,
+	const ir_inline_options &options)
+{
+	std::map<uint32_t, uint32_t> indices = function_indices(module);
+	ir_function &func = module.functions[caller];
+	std::size_t size = func.size();
+	std::size_t inlined = 0;
+
+	for (std::vector<ir_block>::size_type b = 0; b != func.blocks.size(); b++)
+	{
+		std::vector<ir_inst> insts;
+		insts.swap(func.blocks[b].insts);
+		func.blocks[b].insts.reserve(insts.size());
+
+		for (std::vector<ir_inst>::size_type i = 0; i != insts.size(); i++)
+		{
+			const ir_inst &inst = insts[i];
+			int64_t index = inst.op == ir_call ? callee_index(indices, inst) : -1;
+			if (index < 0)
+			{
+				func.blocks[b].insts.push_back(inst);
+				continue;
+			}
+
+			const ir_function &callee = module.functions[index];
+			std::string detail;
+			const char *failure = inline_failure(callee, inst, size, graph, index, options, detail);
+			if (options.report)
+			{
+				*options.report << (failure ? "not inlined: " : "inlined: ")
+					<< module.symbols[callee.name] << " into " << module.symbols[func.name];
+				if (failure)
+				{
+					*options.report << ": " << failure;
+				}
+				else
+				{
+					*options.report << " (" << callee.size() << " instructions, "
+						<< graph.call_sites[index] << (graph.call_sites[index] == 1 ? " call site)" : " call sites)");
+				}
+				*options.report << std::endl;
+			}
+
+			if (failure)
+			{
+				func.blocks[b].insts.push_back(inst);
+				continue;
+			}
+			size += callee.size() - 1;
+			splice(func, inst, callee, func.blocks[b].insts);
+			inlined++;
+		}
+	}
+	return inlined;
+}
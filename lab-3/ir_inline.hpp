@@ -0,0 +1,48 @@
+#ifndef IR_INLINE_HPP
+#define IR_INLINE_HPP
+
+#include <cstddef>
+#include <ostream>
+
+#include "ir.hpp"
+
+/* limits of the inliner */
+struct ir_inline_options
+{
+	// largest callee inlined, in instructions
+	std::size_t callee_limit;
+
+	// size a caller may not grow past through inlining
+	std::size_t caller_limit;
+
+	// where each decision is reported, NULL for nowhere
+	std::ostream *report;
+
+	ir_inline_options();
+};
+
+/* Calls between the functions defined by a module */
+class ir_call_graph
+{
+public:
+	// indices of the functions, every function coming after those it calls outside of its cycle
+	std::vector<uint32_t> bottom_up;
+
+	// strongly connected component of each function, functions calling each other share one
+	std::vector<uint32_t> component;
+
+	// number of calls to each function from the module
+	std::vector<uint32_t> call_sites;
+
+	// whether each function can end up calling itself
+	std::vector<bool> recursive;
+
+	explicit ir_call_graph(const ir_module &module);
+};
+
+/* replaces the calls made by the function of index caller with the body of their callee,
+ * for callees that are small and not recursive. Returns the number of calls inlined. */
+std::size_t ir_inline_calls(ir_module &module, uint32_t caller, const ir_call_graph &graph,
+	const ir_inline_options &options);
+
+#endif
@@ -0,0 +1,848 @@
+#include "ir_passes.hpp"
+
+#include <stdint.h>
+
+#include <algorithm>
+#include <map>
+#include <utility>
+
+/* returns the value v stands for, following the chain of replacements in map */
+static ir_value resolve(const std::vector<ir_value> &map, ir_value v)
+{
+	while (map[v] != v)
+	{
+		v = map[v];
+	}
+	return v;
+}
+
+/* makes every entry of map point directly to the value it resolves to */
+static void flatten(std::vector<ir_value> &map)
+{
+	for (std::vector<ir_value>::size_type v = 0; v != map.size(); v++)
+	{
+		map[v] = resolve(map, v);
+	}
+}
+
+static std::vector<ir_value> identity_map(const ir_function &func)
+{
+	std::vector<ir_value> map(func.num_values);
+	for (ir_value v = 0; v != func.num_values; v++)
+	{
+		map[v] = v;
+	}
+	return map;
+}
+
+/* replaces the uses of copies, and of phis whose operands are all the same value,
+ * by the value they copy */
+std::size_t ir_copy_propagation(ir_function &func)
+{
+	std::vector<ir_value> map = identity_map(func);
+	std::size_t removed = 0;
+	bool changed = true;
+
+	// a phi may only become trivial once the copies among its operands are resolved
+	while (changed)
+	{
+		changed = false;
+		for (std::vector<ir_block>::size_type b = 0; b != func.blocks.size(); b++)
+		{
+			std::vector<ir_inst> &insts = func.blocks[b].insts;
+			for (std::vector<ir_inst>::size_type i = 0; i != insts.size(); i++)
+			{
+				ir_inst &inst = insts[i];
+				ir_value same = IR_NO_VALUE;
+
+				if (inst.op == ir_copy)
+				{
+					same = resolve(map, inst.a);
+				}
+				else if (inst.op == ir_phi)
+				{
+					for (uint32_t j = 0; j != inst.args_count; j++)
+					{
+						ir_value v = resolve(map, func.args[inst.args_begin + j]);
+						if (v == inst.result || v == same)
+						{
+							continue;
+						}
+						if (same != IR_NO_VALUE)
+						{
+							same = IR_NO_VALUE;
+							break;
+						}
+						same = v;
+					}
+				}
+
+				if (same != IR_NO_VALUE)
+				{
+					map[inst.result] = same;
+					inst.op = ir_nop;
+					removed++;
+					changed = true;
+				}
+			}
+		}
+	}
+
+	flatten(map);
+	func.replace_uses(map);
+	func.compact();
+	return removed;
+}
+
+/* everything that identifies the value computed by an instruction */
+struct value_key
+{
+	int op;
+	ir_value a, b;
+	int64_t imm;
+	std::vector<ir_value> args;
+
+	bool operator<(const value_key &other) const
+	{
+		if (op != other.op)		return op < other.op;
+		if (a != other.a)		return a < other.a;
+		if (b != other.b)		return b < other.b;
+		if (imm != other.imm)	return imm < other.imm;
+		return args < other.args;
+	}
+};
+
+/* returns the blocks reachable from the entry in reverse postorder */
+static std::vector<uint32_t> reverse_postorder(const ir_function &func)
+{
+	std::vector<uint32_t> order;
+	std::vector<bool> visited(func.blocks.size(), false);
+
+	// (block, next successor to visit)
+	std::vector<std::pair<uint32_t, uint32_t> > stack;
+
+	if (func.blocks.empty())
+	{
+		return order;
+	}
+
+	stack.push_back(std::make_pair(0u, 0u));
+	visited[0] = true;
+	while (!stack.empty())
+	{
+		std::pair<uint32_t, uint32_t> &top = stack.back();
+		const std::vector<uint32_t> &succs = func.blocks[top.first].succs;
+		if (top.second < succs.size())
+		{
+			uint32_t s = succs[top.second++];
+			if (!visited[s])
+			{
+				visited[s] = true;
+				stack.push_back(std::make_pair(s, 0u));
+			}
+		}
+		else
+		{
+			order.push_back(top.first);
+			stack.pop_back();
+		}
+	}
+	std::reverse(order.begin(), order.end());
+	return order;
+}
+
+/* returns the immediate dominator of every block, computed as in Cooper, Harvey and Kennedy,
+ * "A Simple, Fast Dominance Algorithm". Unreachable blocks have none. */
+static std::vector<uint32_t> dominators(const ir_function &func, const std::vector<uint32_t> &rpo)
+{
+	const uint32_t none = (uint32_t) -1;
+	std::vector<uint32_t> idom(func.blocks.size(), none);
+	std::vector<uint32_t> position(func.blocks.size(), none);
+	bool changed = true;
+
+	for (std::vector<uint32_t>::size_type i = 0; i != rpo.size(); i++)
+	{
+		position[rpo[i]] = i;
+	}
+	if (rpo.empty())
+	{
+		return idom;
+	}
+
+	idom[rpo[0]] = rpo[0];
+	while (changed)
+	{
+		changed = false;
+		for (std::vector<uint32_t>::size_type i = 1; i != rpo.size(); i++)
+		{
+			const std::vector<uint32_t> &preds = func.blocks[rpo[i]].preds;
+			uint32_t new_idom = none;
+
+			for (std::vector<uint32_t>::size_type p = 0; p != preds.size(); p++)
+			{
+				uint32_t other = preds[p];
+				if (idom[other] == none)
+				{
+					continue;
+				}
+				if (new_idom == none)
+				{
+					new_idom = other;
+					continue;
+				}
+				// walk up from both blocks until they meet
+				while (other != new_idom)
+				{
+					while (position[other] > position[new_idom])
+					{
+						other = idom[other];
+					}
+					while (position[new_idom] > position[other])
+					{
+						new_idom = idom[new_idom];
+					}
+				}
+			}
+			if (idom[rpo[i]] != new_idom)
+			{
+				idom[rpo[i]] = new_idom;
+				changed = true;
+			}
+		}
+	}
+	return idom;
+}
+
+/* returns 1 if the instructions computing a value can be merged */
+static int is_numbered(ir_opcode op)
+{
+	switch (op)
+	{
+		case ir_const:
+		case ir_param:
+		case ir_phi:
+		case ir_add:
+		case ir_sub:
+		case ir_mul:
+		case ir_div:
+		case ir_eq:
+		case ir_ne:
+		case ir_lt:
+		case ir_le:
+		case ir_gt:
+		case ir_ge:
+		case ir_frame_addr:
+		case ir_global_addr:
+			return 1;
+		case ir_check:
+			// has no result, but one check dominated by the same one never fails
+			return 1;
+		default:
+			return 0;
+	}
+}
+
+/* removes instructions that compute the same value as one that dominates them */
+std::size_t ir_value_numbering(ir_function &func)
+{
+	std::vector<uint32_t> rpo = reverse_postorder(func);
+	std::vector<uint32_t> idom = dominators(func, rpo);
+	std::vector<std::vector<uint32_t> > children(func.blocks.size());
+	std::vector<ir_value> map = identity_map(func);
+	std::map<value_key, ir_value> table;
+	std::vector<std::map<value_key, ir_value>::iterator> added;
+	std::size_t removed = 0;
+
+	for (std::vector<uint32_t>::size_type i = 1; i < rpo.size(); i++)
+	{
+		children[idom[rpo[i]]].push_back(rpo[i]);
+	}
+
+	// values are only visible in the blocks their definition dominates, so the table
+	// is walked down the dominator tree and entries are dropped on the way back up.
+	// each stack entry is (block, next child to visit, size of added on entry)
+	std::vector<std::pair<uint32_t, std::pair<uint32_t, std::size_t> > > stack;
+	if (!rpo.empty())
+	{
+		stack.push_back(std::make_pair(rpo[0], std::make_pair(0u, (std::size_t) 0)));
+	}
+
+	while (!stack.empty())
+	{
+		uint32_t b = stack.back().first;
+		uint32_t &next_child = stack.back().second.first;
+
+		if (next_child == 0)
+		{
+			std::vector<ir_inst> &insts = func.blocks[b].insts;
+			for (std::vector<ir_inst>::size_type i = 0; i != insts.size(); i++)
+			{
+				ir_inst &inst = insts[i];
+				if (!is_numbered(inst.op))
+				{
+					continue;
+				}
+
+				value_key key;
+				key.op = inst.op;
+				key.a = inst.a == IR_NO_VALUE ? inst.a : map[inst.a];
+				key.b = inst.b == IR_NO_VALUE ? inst.b : map[inst.b];
+				key.imm = inst.op == ir_phi ? b : inst.imm;
+				for (uint32_t j = 0; j != inst.args_count; j++)
+				{
+					key.args.push_back(map[func.args[inst.args_begin + j]]);
+				}
+				if ((inst.op == ir_add || inst.op == ir_mul || inst.op == ir_eq || inst.op == ir_ne) && key.b < key.a)
+				{
+					std::swap(key.a, key.b);
+				}
+
+				std::pair<std::map<value_key, ir_value>::iterator, bool> entry = table.insert(std::make_pair(key, inst.result));
+				if (entry.second)
+				{
+					added.push_back(entry.first);
+				}
+				else
+				{
+					if (inst.result != IR_NO_VALUE)
+					{
+						map[inst.result] = entry.first->second;
+					}
+					inst.op = ir_nop;
+					removed++;
+				}
+			}
+		}
+
+		if (next_child < children[b].size())
+		{
+			uint32_t child = children[b][next_child++];
+			stack.push_back(std::make_pair(child, std::make_pair(0u, added.size())));
+			continue;
+		}
+
+		std::size_t mark = stack.back().second.second;
+		while (added.size() > mark)
+		{
+			table.erase(added.back());
+			added.pop_back();
+		}
+		stack.pop_back();
+	}
+
+	flatten(map);
+	func.replace_uses(map);
+	func.compact();
+	return removed;
+}
+
+/* removes instructions whose results are never used and that have no side effects */
+std::size_t ir_dead_code_elimination(ir_function &func)
+{
+	// block and index of the instruction defining each value
+	std::vector<std::pair<uint32_t, uint32_t> > defs(func.num_values, std::make_pair((uint32_t) -1, 0u));
+	std::vector<bool> live(func.num_values, false);
+	std::vector<ir_value> worklist;
+	std::size_t removed = 0;
+
+	for (std::vector<ir_block>::size_type b = 0; b != func.blocks.size(); b++)
+	{
+		const std::vector<ir_inst> &insts = func.blocks[b].insts;
+		for (std::vector<ir_inst>::size_type i = 0; i != insts.size(); i++)
+		{
+			if (insts[i].result != IR_NO_VALUE)
+			{
+				defs[insts[i].result] = std::make_pair(b, i);
+			}
+		}
+	}
+
+	// the operands of instructions with side effects are live, and so are theirs
+	for (std::vector<ir_block>::size_type b = 0; b != func.blocks.size(); b++)
+	{
+		const std::vector<ir_inst> &insts = func.blocks[b].insts;
+		for (std::vector<ir_inst>::size_type i = 0; i != insts.size(); i++)
+		{
+			const ir_inst &inst = insts[i];
+			bool removable = inst.is_pure();
+
+			// division by zero traps, so only divisions by other constants are pure
+			if (inst.op == ir_div && defs[inst.b].first != (uint32_t) -1)
+			{
+				const ir_inst &divisor = func.blocks[defs[inst.b].first].insts[defs[inst.b].second];
+				removable = divisor.op == ir_const && divisor.imm != 0;
+			}
+
+			if (!removable && inst.result != IR_NO_VALUE && !live[inst.result])
+			{
+				live[inst.result] = true;
+				worklist.push_back(inst.result);
+			}
+			if (!removable && inst.result == IR_NO_VALUE)
+			{
+				ir_value operands[2] = {inst.a, inst.b};
+				for (int j = 0; j != 2; j++)
+				{
+					if (operands[j] != IR_NO_VALUE && !live[operands[j]])
+					{
+						live[operands[j]] = true;
+						worklist.push_back(operands[j]);
+					}
+				}
+				for (uint32_t j = 0; j != inst.args_count; j++)
+				{
+					ir_value v = func.args[inst.args_begin + j];
+					if (!live[v])
+					{
+						live[v] = true;
+						worklist.push_back(v);
+					}
+				}
+			}
+		}
+	}
+
+	while (!worklist.empty())
+	{
+		ir_value v = worklist.back();
+		worklist.pop_back();
+		if (defs[v].first == (uint32_t) -1)
+		{
+			continue;
+		}
+
+		const ir_inst &inst = func.blocks[defs[v].first].insts[defs[v].second];
+		ir_value operands[2] = {inst.a, inst.b};
+		for (int j = 0; j != 2; j++)
+		{
+			if (operands[j] != IR_NO_VALUE && !live[operands[j]])
+			{
+				live[operands[j]] = true;
+				worklist.push_back(operands[j]);
+			}
+		}
+		for (uint32_t j = 0; j != inst.args_count; j++)
+		{
+			ir_value arg = func.args[inst.args_begin + j];
+			if (!live[arg])
+			{
+				live[arg] = true;
+				worklist.push_back(arg);
+			}
+		}
+	}
+
+	for (std::vector<ir_block>::size_type b = 0; b != func.blocks.size(); b++)
+	{
+		std::vector<ir_inst> &insts = func.blocks[b].insts;
+		for (std::vector<ir_inst>::size_type i = 0; i != insts.size(); i++)
+		{
+			if (insts[i].result != IR_NO_VALUE && !live[insts[i].result])
+			{
+				insts[i].op = ir_nop;
+				removed++;
+			}
+		}
+	}
+
+	func.compact();
+	return removed;
+}
+
+/* the loop of a rotated for statement: the guard before it and the latch at its end both
+ * branch to the header while a counter stays below a bound */
+struct counted_loop
+{
+	uint32_t header, guard, latch;
+
+	// the counter, the bound it stays below, and its initial value
+	ir_value counter, bound;
+	int64_t init;
+};
+
+/* returns the instruction defining v, or NULL for a parameter of the block */
+static const ir_inst *definition(const ir_function &func,
+	const std::vector<std::pair<uint32_t, uint32_t> > &defs, ir_value v)
+{
+	if (v == IR_NO_VALUE || defs[v].first == (uint32_t) -1)
+	{
+		return NULL;
+	}
+	return &func.blocks[defs[v].first].insts[defs[v].second];
+}
+
+/* returns 1 if v is a constant, stored in value */
+static int constant_value(const ir_function &func, const std::vector<std::pair<uint32_t, uint32_t> > &defs,
+	ir_value v, int64_t &value)
+{
+	const ir_inst *inst = definition(func, defs, v);
+	if (!inst || inst->op != ir_const)
+	{
+		return 0;
+	}
+	value = inst->imm;
+	return 1;
+}
+
+/* returns the compare "lt" ending block b when it branches to target while it holds */
+static const ir_inst *loop_test(const ir_function &func, const std::vector<std::pair<uint32_t, uint32_t> > &defs,
+	uint32_t b, uint32_t target)
+{
+	const ir_block &block = func.blocks[b];
+	if (block.insts.empty() || block.insts.back().op != ir_branch || block.succs[0] != target)
+	{
+		return NULL;
+	}
+	const ir_inst *test = definition(func, defs, block.insts.back().a);
+	return test && test->op == ir_lt ? test : NULL;
+}
+
+/* returns 1 if the phi at index i of header counts from a constant at least 0 upwards, in
+ * steps that cannot overflow past the bound before the latch compares them to it */
+static int is_counter(const ir_function &func, const std::vector<std::pair<uint32_t, uint32_t> > &defs,
+	counted_loop &loop, const ir_inst &phi, ir_value first, ir_value next)
+{
+	int64_t step, bound;
+	const ir_inst *add = definition(func, defs, next);
+
+	if (phi.args_count != 2 || func.args[phi.args_begin] != first || !constant_value(func, defs, first, loop.init)
+		|| loop.init < 0 || !add || add->op != ir_add)
+	{
+		return 0;
+	}
+	ir_value other = add->a == phi.result ? add->b : add->b == phi.result ? add->a : IR_NO_VALUE;
+	if (func.args[phi.args_begin + 1] != next || !constant_value(func, defs, other, step) || step <= 0)
+	{
+		return 0;
+	}
+	return step == 1 || (constant_value(func, defs, loop.bound, bound) && bound <= INT64_MAX - step);
+}
+
+/* returns 1 if header starts a counted loop, described in loop */
+static int find_counted_loop(const ir_function &func, const std::vector<std::pair<uint32_t, uint32_t> > &defs,
+	uint32_t header, counted_loop &loop)
+{
+	const ir_block &block = func.blocks[header];
+	if (block.preds.size() != 2)
+	{
+		return 0;
+	}
+
+	loop.header = header;
+	loop.guard = block.preds[0];
+	loop.latch = block.preds[1];
+	const ir_inst *guard_test = loop_test(func, defs, loop.guard, header);
+	const ir_inst *latch_test = loop_test(func, defs, loop.latch, header);
+	if (!guard_test || !latch_test || guard_test->b != latch_test->b)
+	{
+		return 0;
+	}
+	loop.bound = latch_test->b;
+
+	for (std::vector<ir_inst>::size_type i = 0; i != block.insts.size() && block.insts[i].op == ir_phi; i++)
+	{
+		if (is_counter(func, defs, loop, block.insts[i], guard_test->a, latch_test->a))
+		{
+			loop.counter = block.insts[i].result;
+			return 1;
+		}
+	}
+	return 0;
+}
+
+/* returns the blocks of loop, those from which the latch is reached without the header */
+static std::vector<bool> loop_blocks(const ir_function &func, const counted_loop &loop)
+{
+	std::vector<bool> in_loop(func.blocks.size(), false);
+	std::vector<uint32_t> worklist;
+
+	in_loop[loop.header] = true;
+	if (!in_loop[loop.latch])
+	{
+		in_loop[loop.latch] = true;
+		worklist.push_back(loop.latch);
+	}
+	while (!worklist.empty())
+	{
+		uint32_t b = worklist.back();
+		worklist.pop_back();
+		for (std::vector<uint32_t>::size_type p = 0; p != func.blocks[b].preds.size(); p++)
+		{
+			uint32_t pred = func.blocks[b].preds[p];
+			if (!in_loop[pred])
+			{
+				in_loop[pred] = true;
+				worklist.push_back(pred);
+			}
+		}
+	}
+	return in_loop;
+}
+
+/* inserts an empty block at index pos, which jumps to the block that was there */
+static void insert_block(ir_function &func, uint32_t pos)
+{
+	for (std::vector<ir_block>::size_type b = 0; b != func.blocks.size(); b++)
+	{
+		ir_block &block = func.blocks[b];
+		for (std::vector<uint32_t>::size_type p = 0; p != block.preds.size(); p++)
+		{
+			block.preds[p] += block.preds[p] >= pos;
+		}
+		for (std::vector<uint32_t>::size_type s = 0; s != block.succs.size(); s++)
+		{
+			block.succs[s] += block.succs[s] >= pos;
+		}
+		if (!block.insts.empty() && block.insts.back().op == ir_jump)
+		{
+			block.insts.back().imm += block.insts.back().imm >= pos;
+		}
+	}
+
+	ir_block pad;
+	ir_inst jump(ir_jump, IR_NO_VALUE);
+	jump.imm = pos + 1;
+	pad.insts.push_back(jump);
+	pad.succs.push_back(pos + 1);
+	func.blocks.insert(func.blocks.begin() + pos, pad);
+}
+
+/* moves the checks of values loop does not change, at the start of its header, to a new
+ * block before the header. Returns the number of checks moved. */
+static std::size_t hoist_checks(ir_function &func, const std::vector<std::pair<uint32_t, uint32_t> > &defs,
+	const counted_loop &loop)
+{
+	std::vector<bool> in_loop = loop_blocks(func, loop);
+	std::vector<ir_inst> &insts = func.blocks[loop.header].insts;
+	std::vector<ir_inst> hoisted;
+
+	for (std::vector<ir_inst>::size_type i = 0; i != insts.size(); i++)
+	{
+		ir_inst &inst = insts[i];
+		if (inst.op == ir_check && !in_loop[defs[inst.a].first] && !in_loop[defs[inst.b].first])
+		{
+			hoisted.push_back(inst);
+			inst.op = ir_nop;
+		}
+		else if (!inst.is_pure())
+		{
+			// the checks after it may not run, or run after its side effects
+			break;
+		}
+	}
+	if (hoisted.empty())
+	{
+		return 0;
+	}
+
+	// the new block takes the place of the guard as a predecessor of the header
+	insert_block(func, loop.header);
+	uint32_t pad = loop.header;
+	uint32_t guard = loop.guard + (loop.guard >= pad);
+	func.blocks[pad + 1].preds[0] = pad;
+	func.blocks[pad].preds.push_back(guard);
+	func.blocks[pad].insts.insert(func.blocks[pad].insts.begin(), hoisted.begin(), hoisted.end());
+	func.blocks[guard].succs[0] = pad;
+	return hoisted.size();
+}
+
+/* Removes the checks of the counter of a counted loop against its bound, or against a
+ * constant length the bound does not exceed: the counter only takes values the guard or
+ * the latch compared to the bound. Checks of values the loop does not change, at the
+ * start of its header, move before the loop, where they run once.
+ */
+std::size_t ir_bounds_checks(ir_function &func)
+{
+	std::size_t removed = 0;
+	std::size_t hoisted = 1;
+
+	// a new block renumbers those after it, so the loops are found again after each
+	while (hoisted)
+	{
+		std::vector<std::pair<uint32_t, uint32_t> > defs(func.num_values, std::make_pair((uint32_t) -1, 0u));
+		std::vector<counted_loop> loops;
+
+		for (std::vector<ir_block>::size_type b = 0; b != func.blocks.size(); b++)
+		{
+			const std::vector<ir_inst> &insts = func.blocks[b].insts;
+			for (std::vector<ir_inst>::size_type i = 0; i != insts.size(); i++)
+			{
+				if (insts[i].result != IR_NO_VALUE)
+				{
+					defs[insts[i].result] = std::make_pair(b, i);
+				}
+			}
+		}
+		for (std::vector<ir_block>::size_type b = 0; b != func.blocks.size(); b++)
+		{
+			counted_loop loop;
+			if (find_counted_loop(func, defs, b, loop))
+			{
+				loops.push_back(loop);
+			}
+		}
+
+		for (std::vector<counted_loop>::size_type l = 0; l != loops.size(); l++)
+		{
+			const counted_loop &loop = loops[l];
+			int64_t bound, length;
+			bool constant_bound = constant_value(func, defs, loop.bound, bound);
+
+			for (std::vector<ir_block>::size_type b = 0; b != func.blocks.size(); b++)
+			{
+				std::vector<ir_inst> &insts = func.blocks[b].insts;
+				for (std::vector<ir_inst>::size_type i = 0; i != insts.size(); i++)
+				{
+					ir_inst &inst = insts[i];
+					if (inst.op == ir_check && inst.a == loop.counter && (inst.b == loop.bound
+						|| (constant_bound && constant_value(func, defs, inst.b, length) && bound <= length)))
+					{
+						inst.op = ir_nop;
+						removed++;
+					}
+				}
+			}
+		}
+
+		hoisted = 0;
+		for (std::vector<counted_loop>::size_type l = 0; l != loops.size() && !hoisted; l++)
+		{
+			hoisted = hoist_checks(func, defs, loops[l]);
+			removed += hoisted;
+		}
+		func.compact();
+	}
+	return removed;
+}
+
+/* turns the calls of func to itself whose result is returned right away into jumps back to
+ * its start, where phis merge the new arguments into the parameters. Functions with arrays
+ * are left alone, as the arguments may point into the arrays the next iteration zeroes. */
+std::size_t ir_tail_recursion(ir_function &func)
+{
+	// blocks ending with a self tail call, and the arguments of each call
+	std::vector<uint32_t> sites;
+	std::vector<std::vector<ir_value> > site_args;
+
+	for (std::vector<ir_block>::size_type b = 0; b != func.blocks.size(); b++)
+	{
+		const std::vector<ir_inst> &insts = func.blocks[b].insts;
+		std::vector<ir_inst>::size_type n = insts.size();
+		if (n >= 2 && ir_is_tail_call(insts[n - 2], insts[n - 1]) && !func.frame_words
+			&& insts[n - 2].imm == func.name && insts[n - 2].args_count == func.num_params)
+		{
+			sites.push_back(b + 1);
+		}
+	}
+	if (sites.empty())
+	{
+		return 0;
+	}
+
+	// the parameters are read in a new entry block, and the old one becomes the loop header
+	ir_block entry;
+	std::vector<ir_value> params(func.num_params, IR_NO_VALUE);
+	std::vector<ir_inst> &old_entry = func.blocks[0].insts;
+	for (std::vector<ir_inst>::size_type i = 0; i != old_entry.size(); i++)
+	{
+		if (old_entry[i].op == ir_param)
+		{
+			params[old_entry[i].imm] = old_entry[i].result;
+			entry.insts.push_back(old_entry[i]);
+			old_entry[i].op = ir_nop;
+		}
+	}
+	for (uint32_t p = 0; p != func.num_params; p++)
+	{
+		if (params[p] == IR_NO_VALUE)
+		{
+			ir_inst param(ir_param, params[p] = func.new_value());
+			param.imm = p;
+			entry.insts.push_back(param);
+		}
+	}
+	ir_inst jump(ir_jump, IR_NO_VALUE);
+	jump.imm = 1;
+	entry.insts.push_back(jump);
+	entry.succs.push_back(1);
+
+	func.blocks.insert(func.blocks.begin(), entry);
+	for (std::vector<ir_block>::size_type b = 1; b != func.blocks.size(); b++)
+	{
+		ir_block &block = func.blocks[b];
+		for (std::vector<uint32_t>::size_type p = 0; p != block.preds.size(); p++)
+		{
+			block.preds[p]++;
+		}
+		for (std::vector<uint32_t>::size_type s = 0; s != block.succs.size(); s++)
+		{
+			block.succs[s]++;
+		}
+		if (!block.insts.empty() && block.insts.back().op == ir_jump)
+		{
+			block.insts.back().imm++;
+		}
+	}
+	func.blocks[1].preds.insert(func.blocks[1].preds.begin(), 0u);
+
+	// the body reads the parameters through phis
+	std::vector<ir_value> phis(func.num_params);
+	for (uint32_t p = 0; p != func.num_params; p++)
+	{
+		phis[p] = func.new_value();
+	}
+	std::vector<ir_value> map = identity_map(func);
+	for (uint32_t p = 0; p != func.num_params; p++)
+	{
+		map[params[p]] = phis[p];
+	}
+	func.replace_uses(map);
+
+	// the calls become jumps to the header
+	for (std::vector<uint32_t>::size_type s = 0; s != sites.size(); s++)
+	{
+		std::vector<ir_inst> &insts = func.blocks[sites[s]].insts;
+		ir_inst &call = insts[insts.size() - 2];
+		site_args.push_back(std::vector<ir_value>(func.args.begin() + call.args_begin,
+			func.args.begin() + call.args_begin + call.args_count));
+		call.op = ir_nop;
+		insts.back() = jump;
+		func.blocks[sites[s]].succs.push_back(1);
+		func.blocks[1].preds.push_back(sites[s]);
+	}
+
+	std::vector<ir_inst> &header = func.blocks[1].insts;
+	for (uint32_t p = func.num_params; p-- > 0;)
+	{
+		ir_inst phi(ir_phi, phis[p]);
+		phi.args_begin = func.args.size();
+		phi.args_count = 1 + sites.size();
+		func.args.push_back(params[p]);
+		for (std::vector<uint32_t>::size_type s = 0; s != sites.size(); s++)
+		{
+			func.args.push_back(site_args[s][p]);
+		}
+		header.insert(header.begin(), phi);
+	}
+
+	func.compact();
+	return sites.size();
+}
+
+/* runs every pass over every function of the module, callees before their callers so that
+ * the calls inlined by the settings in inlining are already optimised */
+void ir_optimize(ir_module &module, const ir_inline_options &inlining)
+{
+	ir_call_graph graph(module);
+
+	for (std::vector<uint32_t>::size_type f = 0; f != graph.bottom_up.size(); f++)
+	{
+		ir_function &func = module.functions[graph.bottom_up[f]];
+		ir_inline_calls(module, graph.bottom_up[f], graph, inlining);
+		ir_copy_propagation(func);
+		ir_value_numbering(func);
+		ir_copy_propagation(func);
+		ir_bounds_checks(func);
+		ir_dead_code_elimination(func);
+	}
+}
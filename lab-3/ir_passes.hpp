@@ -0,0 +1,36 @@
+#ifndef IR_PASSES_HPP
+#define IR_PASSES_HPP
+
+#include <cstddef>
+
+#include "ir.hpp"
+#include "ir_inline.hpp"
+
+/* Optimisation passes over the SSA form.
+ * Each returns the number of instructions it removed from the function.
+ */
+
+/* replaces the uses of copies, and of phis whose operands are all the same value,
+ * by the value they copy */
+std::size_t ir_copy_propagation(ir_function &func);
+
+/* removes instructions that compute the same value as one that dominates them */
+std::size_t ir_value_numbering(ir_function &func);
+
+/* removes instructions whose results are never used and that have no side effects */
+std::size_t ir_dead_code_elimination(ir_function &func);
+
+/* removes the bounds checks of the counter of a counted loop that it cannot fail, and moves
+ * those of values the loop does not change before it. Returns the number of checks removed
+ * from the loops. */
+std::size_t ir_bounds_checks(ir_function &func);
+
+/* turns the calls of func to itself whose result is returned right away into jumps back to
+ * its start, where phis merge the new arguments into the parameters */
+std::size_t ir_tail_recursion(ir_function &func);
+
+/* runs every pass over every function of the module, callees before their callers so that
+ * the calls inlined by the settings in inlining are already optimised */
+void ir_optimize(ir_module &module, const ir_inline_options &inlining = ir_inline_options());
+
+#endif
@@ -0,0 +1,82 @@
+#include "lex_pipeline.hpp"
+
+/* starts scanning the files denoted by fnames, in order */
+lex_pipeline::lex_pipeline(const std::vector<std::string> &fnames, bool trace_scanning)
+	: fnames(fnames)
+{
+	scanner.trace_scanning = trace_scanning;
+	pthread_mutex_init(&lock, NULL);
+	pthread_cond_init(&changed, NULL);
+	pthread_create(&thread, NULL, start, this);
+}
+
+/* waits for the remaining files to be scanned */
+lex_pipeline::~lex_pipeline()
+{
+	pthread_mutex_lock(&lock);
+	fnames.clear();
+	pthread_cond_broadcast(&changed);
+	pthread_mutex_unlock(&lock);
+
+	pthread_join(thread, NULL);
+	pthread_cond_destroy(&changed);
+	pthread_mutex_destroy(&lock);
+}
+
+/* waits for the next file to be scanned and moves its tokens into tokens.
+ * returns 0 on success, or the errno of the failure to read it. */
+int lex_pipeline::next(token_array &tokens)
+{
+	pthread_mutex_lock(&lock);
+	while (scanned.empty())
+	{
+		pthread_cond_wait(&changed, &lock);
+	}
+
+	tokens.swap(scanned.front());
+	int err = errors.front();
+	scanned.pop_front();
+	errors.pop_front();
+
+	pthread_cond_broadcast(&changed);
+	pthread_mutex_unlock(&lock);
+	return err;
+}
+
+/* scans every file, waiting for the parser to take each one before scanning the next */
+void lex_pipeline::run()
+{
+	for (std::vector<std::string>::size_type f = 0;; f++)
+	{
+		pthread_mutex_lock(&lock);
+		while (!scanned.empty() && f < fnames.size())
+		{
+			pthread_cond_wait(&changed, &lock);
+		}
+		// fnames is cleared when the pipeline is destroyed early
+		if (f >= fnames.size())
+		{
+			pthread_mutex_unlock(&lock);
+			return;
+		}
+		std::string fname = fnames[f];
+		pthread_mutex_unlock(&lock);
+
+		token_array tokens;
+		int err = scanner.scan_file(fname, tokens);
+
+		pthread_mutex_lock(&lock);
+		scanned.push_back(token_array());
+		scanned.back().swap(tokens);
+		errors.push_back(err);
+		pthread_cond_broadcast(&changed);
+		pthread_mutex_unlock(&lock);
+	}
+}
+
+/* entry point of the thread */
+void *lex_pipeline::start(void *pipeline)
+{
+	static_cast<lex_pipeline *>(pipeline)->run();
+	return NULL;
+}
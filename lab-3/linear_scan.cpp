@@ -0,0 +1,304 @@
+#include "linear_scan.hpp"
+
+#include <algorithm>
+#include <climits>
+
+/* first and last position where a value may be live, -1 for values that do not exist */
+struct interval
+{
+	int start;
+	int end;
+};
+
+static void extend(interval &range, int pos)
+{
+	if (range.end < 0)
+	{
+		range.start = range.end = pos;
+		return;
+	}
+	range.start = std::min(range.start, pos);
+	range.end = std::max(range.end, pos);
+}
+
+/* calls f for every operand of inst */
+template <class F>
+static void for_each_operand(const ir_function &func, const ir_inst &inst, F f)
+{
+	if (inst.a != IR_NO_VALUE)
+	{
+		f(inst.a);
+	}
+	if (inst.b != IR_NO_VALUE)
+	{
+		f(inst.b);
+	}
+	if (inst.op != ir_phi)
+	{
+		for (uint32_t j = 0; j != inst.args_count; j++)
+		{
+			f(func.args[inst.args_begin + j]);
+		}
+	}
+}
+
+struct set_bit
+{
+	std::vector<bool> &bits;
+	set_bit(std::vector<bool> &bits) : bits(bits) {}
+	void operator()(ir_value v) { bits[v] = true; }
+};
+
+struct gen_if_not_killed
+{
+	std::vector<bool> &gen;
+	const std::vector<bool> &kill;
+	gen_if_not_killed(std::vector<bool> &gen, const std::vector<bool> &kill) : gen(gen), kill(kill) {}
+	void operator()(ir_value v) { if (!kill[v]) gen[v] = true; }
+};
+
+struct extend_to
+{
+	std::vector<interval> &ranges;
+	int pos;
+	extend_to(std::vector<interval> &ranges, int pos) : ranges(ranges), pos(pos) {}
+	void operator()(ir_value v) { extend(ranges[v], pos); }
+};
+
+/* returns the live interval of every value, and the positions of the calls */
+static std::vector<interval> live_intervals(const ir_function &func, std::vector<int> &calls)
+{
+	std::size_t num_blocks = func.blocks.size();
+	std::vector<std::vector<bool> > gen(num_blocks), kill(num_blocks), phi_defs(num_blocks), phi_uses(num_blocks);
+	std::vector<std::vector<bool> > live_in(num_blocks), live_out(num_blocks);
+	std::vector<int> block_start(num_blocks), block_end(num_blocks);
+	std::vector<interval> ranges(func.num_values);
+	int pos = 0;
+
+	for (std::vector<interval>::size_type v = 0; v != ranges.size(); v++)
+	{
+		ranges[v].start = ranges[v].end = -1;
+	}
+
+	for (std::size_t b = 0; b != num_blocks; b++)
+	{
+		gen[b].assign(func.num_values, false);
+		kill[b].assign(func.num_values, false);
+		phi_defs[b].assign(func.num_values, false);
+		phi_uses[b].assign(func.num_values, false);
+		live_in[b].assign(func.num_values, false);
+		live_out[b].assign(func.num_values, false);
+	}
+
+	// local uses and definitions, and the positions of the instructions
+	for (std::size_t b = 0; b != num_blocks; b++)
+	{
+		const std::vector<ir_inst> &insts = func.blocks[b].insts;
+		block_start[b] = pos;
+		for (std::vector<ir_inst>::size_type i = 0; i != insts.size(); i++, pos += 2)
+		{
+			const ir_inst &inst = insts[i];
+			for_each_operand(func, inst, gen_if_not_killed(gen[b], kill[b]));
+			for_each_operand(func, inst, extend_to(ranges, pos));
+			if (inst.op == ir_phi)
+			{
+				// phi operands are used at the end of the corresponding predecessor
+				for (uint32_t j = 0; j != inst.args_count; j++)
+				{
+					phi_uses[func.blocks[b].preds[j]][func.args[inst.args_begin + j]] = true;
+				}
+				phi_defs[b][inst.result] = true;
+			}
+			if (inst.result != IR_NO_VALUE)
+			{
+				kill[b][inst.result] = true;
+				extend(ranges[inst.result], pos);
+			}
+			if (inst.op == ir_call)
+			{
+				calls.push_back(pos);
+			}
+		}
+		block_end[b] = pos;
+		pos += 2;
+	}
+
+	// live_in = gen + (live_out - kill), live_out = phi uses + live_in of successors - their phis
+	bool changed = true;
+	while (changed)
+	{
+		changed = false;
+		for (std::size_t b = num_blocks; b-- > 0;)
+		{
+			const std::vector<uint32_t> &succs = func.blocks[b].succs;
+			for (ir_value v = 0; v != func.num_values; v++)
+			{
+				bool out = phi_uses[b][v];
+				for (std::vector<uint32_t>::size_type s = 0; !out && s != succs.size(); s++)
+				{
+					out = live_in[succs[s]][v] && !phi_defs[succs[s]][v];
+				}
+				bool in = gen[b][v] || (out && !kill[b][v]);
+				if (out != live_out[b][v] || in != live_in[b][v])
+				{
+					live_out[b][v] = out;
+					live_in[b][v] = in;
+					changed = true;
+				}
+			}
+		}
+	}
+
+	for (std::size_t b = 0; b != num_blocks; b++)
+	{
+		for (ir_value v = 0; v != func.num_values; v++)
+		{
+			if (live_in[b][v])
+			{
+				extend(ranges[v], block_start[b]);
+			}
+			if (live_out[b][v])
+			{
+				extend(ranges[v], block_end[b]);
+			}
+		}
+
+		// phi results are written by the moves at the end of every predecessor
+		const std::vector<ir_inst> &insts = func.blocks[b].insts;
+		for (std::vector<ir_inst>::size_type i = 0; i != insts.size() && insts[i].op == ir_phi; i++)
+		{
+			for (std::vector<uint32_t>::size_type p = 0; p != func.blocks[b].preds.size(); p++)
+			{
+				extend(ranges[insts[i].result], block_end[func.blocks[b].preds[p]]);
+			}
+		}
+	}
+	return ranges;
+}
+
+struct earlier_start
+{
+	const std::vector<interval> &ranges;
+	earlier_start(const std::vector<interval> &ranges) : ranges(ranges) {}
+	bool operator()(ir_value a, ir_value b) const { return ranges[a].start < ranges[b].start; }
+};
+
+/* Assigns registers to the values of func with the linear scan algorithm of Poletto and
+ * Sarkar. Each value gets a single live interval spanning every instruction where it may
+ * be live, and when there are not enough registers the interval that ends last is spilled.
+ * The values in refs, as found by ir_references, are spilled if they are live across a
+ * call, where the garbage collector may move what they point to.
+ */
+ls_allocation linear_scan(const ir_function &func, const ls_registers &regs, const std::vector<bool> &refs)
+{
+	std::vector<int> calls;
+	std::vector<interval> ranges = live_intervals(func, calls);
+	std::vector<ir_value> order;
+	std::vector<ir_value> active;
+	std::vector<bool> in_use(16, false), saved(16, false);
+	ls_allocation result;
+
+	result.num_slots = 0;
+	result.locations.resize(func.num_values);
+	for (ir_value v = 0; v != func.num_values; v++)
+	{
+		result.locations[v].reg = -1;
+		result.locations[v].slot = -1;
+		if (ranges[v].end >= 0)
+		{
+			order.push_back(v);
+		}
+	}
+	std::stable_sort(order.begin(), order.end(), earlier_start(ranges));
+
+	for (std::vector<ir_value>::size_type i = 0; i != order.size(); i++)
+	{
+		ir_value v = order[i];
+		const interval &range = ranges[v];
+
+		// free the registers of intervals that ended
+		for (std::vector<ir_value>::size_type a = 0; a != active.size(); a++)
+		{
+			if (ranges[active[a]].end < range.start)
+			{
+				in_use[result.locations[active[a]].reg] = false;
+				active.erase(active.begin() + a--);
+			}
+		}
+
+		// a value live across a call must survive it
+		std::vector<int>::iterator call = std::upper_bound(calls.begin(), calls.end(), range.start);
+		bool crosses_call = call != calls.end() && *call < range.end;
+
+		// the collector only finds references in the frame, in slots of their own
+		if (crosses_call && refs[v])
+		{
+			result.locations[v].slot = result.num_slots++;
+			continue;
+		}
+
+		std::vector<int> allowed;
+		if (!crosses_call)
+		{
+			allowed = regs.caller_saved;
+		}
+		allowed.insert(allowed.end(), regs.callee_saved.begin(), regs.callee_saved.end());
+
+		int reg = -1;
+		for (std::vector<int>::size_type r = 0; r != allowed.size() && reg < 0; r++)
+		{
+			if (!in_use[allowed[r]])
+			{
+				reg = allowed[r];
+			}
+		}
+
+		if (reg < 0)
+		{
+			// spill whichever of this and the active intervals using an allowed register ends last
+			std::vector<ir_value>::size_type victim = active.size();
+			for (std::vector<ir_value>::size_type a = 0; a != active.size(); a++)
+			{
+				int r = result.locations[active[a]].reg;
+				if (std::find(allowed.begin(), allowed.end(), r) != allowed.end()
+					&& ranges[active[a]].end > range.end
+					&& (victim == active.size() || ranges[active[a]].end > ranges[active[victim]].end))
+				{
+					victim = a;
+				}
+			}
+			if (victim == active.size())
+			{
+				result.locations[v].slot = result.num_slots++;
+				continue;
+			}
+			reg = result.locations[active[victim]].reg;
+			result.locations[active[victim]].reg = -1;
+			result.locations[active[victim]].slot = result.num_slots++;
+			active.erase(active.begin() + victim);
+		}
+
+		result.locations[v].reg = reg;
+		in_use[reg] = true;
+		active.push_back(v);
+
+		if (std::find(regs.callee_saved.begin(), regs.callee_saved.end(), reg) != regs.callee_saved.end() && !saved[reg])
+		{
+			saved[reg] = true;
+			result.used_callee_saved.push_back(reg);
+		}
+	}
+
+	result.call_refs.resize(calls.size());
+	for (std::vector<int>::size_type c = 0; c != calls.size(); c++)
+	{
+		for (ir_value v = 0; v != func.num_values; v++)
+		{
+			if (refs[v] && ranges[v].start < calls[c] && calls[c] < ranges[v].end)
+			{
+				result.call_refs[c].push_back(result.locations[v].slot);
+			}
+		}
+	}
+	return result;
+}
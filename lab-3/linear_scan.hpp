@@ -0,0 +1,49 @@
+#ifndef LINEAR_SCAN_HPP
+#define LINEAR_SCAN_HPP
+
+#include <vector>
+
+#include "ir.hpp"
+
+/* where a value lives for its whole lifetime: a register, or a stack slot if spilled */
+struct ls_location
+{
+	// register number, -1 if the value is spilled
+	int reg;
+
+	// index of the stack slot of a spilled value
+	int slot;
+};
+
+/* registers the allocator may hand out, in order of preference.
+ * Values live across a call only get callee-saved registers. */
+struct ls_registers
+{
+	std::vector<int> caller_saved;
+	std::vector<int> callee_saved;
+};
+
+class ls_allocation
+{
+public:
+	// location of every value, indexed by value id
+	std::vector<ls_location> locations;
+
+	int num_slots;
+
+	// callee-saved registers that were handed out, to be saved by the prologue
+	std::vector<int> used_callee_saved;
+
+	// for each call, in the order of the code, the slots of the references live across it
+	std::vector<std::vector<int> > call_refs;
+};
+
+/* Assigns registers to the values of func with the linear scan algorithm of Poletto and
+ * Sarkar. Each value gets a single live interval spanning every instruction where it may
+ * be live, and when there are not enough registers the interval that ends last is spilled.
+ * The values in refs, as found by ir_references, are spilled if they are live across a
+ * call, where the garbage collector may move what they point to.
+ */
+ls_allocation linear_scan(const ir_function &func, const ls_registers &regs, const std::vector<bool> &refs);
+
+#endif
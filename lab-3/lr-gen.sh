@@ -0,0 +1,88 @@
+#!/bin/sh
+# Extracts the parse tables or the semantic actions from the parser Bison
+# generates for parser.y, for use by the table-driven parser in lr_parser.cpp.
+#
+# usage: lr-gen.sh tables PARSER_C PARSER_H > lr_tables.h
+#        lr-gen.sh actions PARSER_C > lr_actions.h
+
+set -e
+
+case "$1" in
+tables)
+	echo "/* generated by lr-gen.sh from $2, do not edit */"
+	awk '
+	# the element type of a table is on the line before its name
+	/^  const [a-z ]+$/ {
+		type = substr($0, 9)
+		next
+	}
+	/go_parser::yy(pact|defact|pgoto|defgoto|table|check|r1|r2)_\[\] =/ {
+		name = $0
+		sub(/.*go_parser::yy/, "", name)
+		sub(/_\[\] =.*/, "", name)
+		print "static const " type " lr_" name "[] ="
+		copy = 1
+		next
+	}
+	/go_parser::yytname_\[\] =/ {
+		print "static const char *const lr_tname[] ="
+		copy = 1
+		next
+	}
+	copy {
+		gsub(/YY_NULLPTR/, "NULL")
+		print
+		if ($0 ~ /};/) {
+			copy = 0
+			print ""
+		}
+		next
+	}
+	/go_parser::yy(pact|table)_ninf_ = / {
+		name = $0
+		sub(/.*go_parser::yy/, "", name)
+		sub(/_ = .*/, "", name)
+		value = $NF
+		sub(/;/, "", value)
+		print "static const int lr_" name " = " value ";"
+		next
+	}
+	/^ *(yylast_|yyfinal_|YYNTOKENS) = [0-9]+/ && !seen[$1]++ {
+		name = tolower($1)
+		sub(/^yy/, "", name)
+		sub(/_$/, "", name)
+		value = $3
+		sub(/,/, "", value)
+		print "static const int lr_" name " = " value ";"
+	}
+	' "$2" "$3"
+	;;
+actions)
+	echo "/* generated by lr-gen.sh from $2, do not edit */"
+	# the cases of the switch in go_parser::parse, with the variant and location
+	# accessors replaced by the lhs node and the value() and location() lookups
+	# of lr_parser
+	awk '
+	/^ *switch \(yyn\)/ {
+		inside = 1
+		getline
+		next
+	}
+	inside && /^ *default:/ {
+		exit
+	}
+	inside && !/^#line/ {
+		print
+	}
+	' "$2" | sed -E \
+		-e 's/yylhs\.value\.as < ([^>]*) > \(\) = /lhs = /g' \
+		-e 's/yylhs\.value\.as < ([^>]*) > \(\)/static_cast< \1 >(lhs)/g' \
+		-e 's/yystack_\[([0-9]+)\]\.value\.as < ([^>]*) > \(\)/value< \2 >(\1)/g' \
+		-e 's/yylhs\.location/lhs_location/g' \
+		-e 's/yystack_\[([0-9]+)\]\.location/location(\1)/g'
+	;;
+*)
+	echo "usage: $0 tables PARSER_C PARSER_H | actions PARSER_C" >&2
+	exit 1
+	;;
+esac
@@ -0,0 +1,300 @@
+#include "lr_parser.hpp"
+
+#include "driver.hpp"
+#include "lr_tables.h"
+#include "parse_stats.hpp"
+
+#define NO_VALUE		((unsigned int) -1)		// value of tokens without text, and of NULL nodes
+#define MAX_EXPECTED	4						// more expected tokens than this are not listed
+
+typedef yy::go_parser::symbol_kind symbol_kind;
+
+/* returns the state reached from state after reducing to the nonterminal sym */
+static int goto_state(int state, int sym)
+{
+	int n = lr_pgoto[sym - lr_ntokens] + state;
+
+	if (0 <= n && n <= lr_last && lr_check[n] == state)
+	{
+		return lr_table[n];
+	}
+	return lr_defgoto[sym - lr_ntokens];
+}
+
+/* returns the name of sym as Bison prints it, without the quotes around "import" etc. */
+static std::string symbol_name(int sym)
+{
+	const char *name = lr_tname[sym];
+	std::string stripped;
+
+	if (*name != '"')
+	{
+		return name;
+	}
+	for (const char *p = name + 1; *p != '"'; p++)
+	{
+		if (*p == '\'' || *p == ',' || (*p == '\\' && *++p != '\\'))
+		{
+			return name;
+		}
+		stripped += *p;
+	}
+	return stripped;
+}
+
+lr_parser::lr_parser(go_driver &d) : driver(d)
+{
+	lookahead = -1;
+	err_status = 0;
+}
+
+/* returns 0 if the input was accepted, 1 if parsing was aborted */
+int lr_parser::parse()
+{
+	int n;
+
+	states.clear();
+	values.clear();
+	locations.clear();
+	texts.clear();
+	ints.clear();
+	strings.clear();
+	lookahead = -1;
+	err_status = 0;
+
+	states.push_back(0);
+	values.push_back(NO_VALUE);
+	locations.push_back(yy::location(&driver.file));
+
+	while (states.back() != lr_final)
+	{
+		n = next_action(states.back());
+		if (n > 0)
+		{
+			shift(n);
+		}
+		else if (n < 0)
+		{
+			reduce(-n);
+		}
+		else if (!recover())
+		{
+			return 1;
+		}
+	}
+	return 0;
+}
+
+/* returns the state to shift to if positive, or minus the rule to reduce by if negative.
+ * returns 0 on a syntax error. The lookahead is only read if the state needs it. */
+int lr_parser::next_action(int state)
+{
+	int n = lr_pact[state];
+
+	if (n != lr_pact_ninf)
+	{
+		if (lookahead < 0)
+		{
+			lookahead = yylex(driver);
+		}
+
+		n += lookahead;
+		if (0 <= n && n <= lr_last && lr_check[n] == lookahead)
+		{
+			n = lr_table[n];
+			return n == lr_table_ninf ? 0 : n;
+		}
+	}
+
+	// default reduction, 0 if the state has none
+	return -lr_defact[state];
+}
+
+/* pushes the lookahead token and the state n onto the stack */
+void lr_parser::shift(int n)
+{
+	unsigned int v = NO_VALUE;
+
+	switch (lookahead)
+	{
+		case symbol_kind::S_IDENTIFIER:
+			v = texts.size();
+			texts.push_back(driver.token_text);
+			break;
+		case symbol_kind::S_STRINGLITERAL:
+			v = strings.size();
+			strings.push_back(driver.token_string);
+			break;
+		case symbol_kind::S_INTEGERLITERAL:
+			v = ints.size();
+			ints.push_back(driver.token_int);
+			break;
+	}
+
+	if (err_status)
+	{
+		err_status--;
+	}
+
+	states.push_back(n);
+	values.push_back(v);
+	locations.push_back(driver.token_loc);
+	lookahead = -1;
+}
+
+/* runs the action of rule n and replaces its right-hand side with its left-hand side */
+void lr_parser::reduce(int n)
+{
+	int len = lr_r2[n];
+
+	// from the first symbol reduced to the last, or empty at the end of the one before
+	lhs_location.begin = len ? location(len - 1).begin : location(0).end;
+	lhs_location.end = location(0).end;
+
+	ast_node *lhs = rule_action(n);
+
+	STATS_REDUCE(n);
+
+	states.resize(states.size() - len);
+	values.resize(values.size() - len);
+	locations.resize(locations.size() - len);
+
+	states.push_back(goto_state(states.back(), lr_r1[n]));
+	values.push_back(lhs ? lhs->id : NO_VALUE);
+	locations.push_back(lhs_location);
+}
+
+/* returns the semantic value k symbols below the top of the stack */
+template <class T>
+T lr_parser::value(int k)
+{
+	return static_cast<T>(driver.nodes.get(values[values.size() - 1 - k]));
+}
+
+template <>
+std::string lr_parser::value<std::string>(int k)
+{
+	return texts[values[values.size() - 1 - k]];
+}
+
+template <>
+int_literal lr_parser::value<int_literal>(int k)
+{
+	return ints[values[values.size() - 1 - k]];
+}
+
+template <>
+uint32_t lr_parser::value<uint32_t>(int k)
+{
+	return strings[values[values.size() - 1 - k]];
+}
+
+/* returns the location of the symbol k symbols below the top of the stack */
+const yy::location &lr_parser::location(int k) const
+{
+	return locations[locations.size() - 1 - k];
+}
+
+/* returns the node built by the action of rule n, see lr_actions.h */
+ast_node *lr_parser::rule_action(int n)
+{
+	ast_node *lhs = NULL;
+
+	switch (n)
+	{
+#include "lr_actions.h"
+		default:
+			break;
+	}
+	return lhs;
+}
+
+/* reports the error unless still recovering from the previous one, then pops states
+ * until one where the error token can be shifted. Returns 0 if there is none. */
+int lr_parser::recover()
+{
+	int n;
+	// the error token spans the symbols popped and the lookahead
+	yy::location error_location = driver.token_loc;
+
+	if (!err_status)
+	{
+		report_syntax_error();
+	}
+	else if (err_status == 3 && lookahead >= 0)
+	{
+		// the lookahead could not be shifted after the last error, so discard it
+		if (lookahead == symbol_kind::S_YYEOF)
+		{
+			return 0;
+		}
+		lookahead = -1;
+	}
+	err_status = 3;
+
+	for (;;)
+	{
+		n = lr_pact[states.back()];
+		if (n != lr_pact_ninf)
+		{
+			n += symbol_kind::S_YYerror;
+			if (0 <= n && n <= lr_last && lr_check[n] == symbol_kind::S_YYerror && lr_table[n] > 0)
+			{
+				error_location.end = driver.token_loc.end;
+				states.push_back(lr_table[n]);
+				values.push_back(NO_VALUE);
+				locations.push_back(error_location);
+				return 1;
+			}
+		}
+
+		if (states.size() == 1)
+		{
+			return 0;
+		}
+		error_location.begin = locations.back().begin;
+		states.pop_back();
+		values.pop_back();
+		locations.pop_back();
+	}
+}
+
+/* records a syntax error listing the tokens expected in the current state */
+void lr_parser::report_syntax_error()
+{
+	std::string msg = "syntax error";
+	int expected[MAX_EXPECTED];
+	int count = 0;
+	int n = lr_pact[states.back()];
+
+	if (lookahead < 0)
+	{
+		driver.error(driver.token_loc, msg);
+		return;
+	}
+
+	if (n != lr_pact_ninf)
+	{
+		// tokens with an action in this state, unless there are too many to list
+		int end = lr_last - n + 1 < lr_ntokens ? lr_last - n + 1 : lr_ntokens;
+		for (int sym = n < 0 ? -n : 0; sym < end; sym++)
+		{
+			if (lr_check[sym + n] == sym && sym != symbol_kind::S_YYerror && lr_table[sym + n] != lr_table_ninf)
+			{
+				if (count == MAX_EXPECTED)
+				{
+					count = 0;
+					break;
+				}
+				expected[count++] = sym;
+			}
+		}
+	}
+
+	msg += ", unexpected " + symbol_name(lookahead);
+	for (int i = 0; i < count; i++)
+	{
+		msg += (i ? " or " : ", expecting ") + symbol_name(expected[i]);
+	}
+	driver.error(driver.token_loc, msg);
+}
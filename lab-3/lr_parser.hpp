@@ -0,0 +1,83 @@
+#ifndef LR_PARSER_HPP
+#define LR_PARSER_HPP
+
+#include <string>
+#include <vector>
+
+#include "ast_node.hpp"
+#include "parser.h"
+
+class go_driver;
+
+/* Table-driven LALR(1) parser for the grammar in parser.y, used instead of
+ * Bison's generated parser when built with -DLR_PARSER.
+ *
+ * Bison is still run to build the compressed parse tables and the rule actions,
+ * which lr-gen.sh copies out of its output. The state stack holds plain integers,
+ * and the value stack holds the ids of nodes in the driver's pool, or the index
+ * of the token text for identifiers, or of the value of literals. The locations
+ * of the symbols are kept alongside, and computed for each reduction as Bison does.
+ * Syntax errors are reported and recovered from exactly as Bison does.
+ */
+class lr_parser
+{
+public:
+	lr_parser(go_driver &driver);
+
+	/* returns 0 if the input was accepted, 1 if parsing was aborted */
+	int parse();
+
+private:
+	go_driver &driver;
+
+	std::vector<int> states;
+	std::vector<unsigned int> values;
+	std::vector<yy::location> locations;
+
+	// location of the left-hand side of the rule being reduced
+	yy::location lhs_location;
+
+	// text of every identifier shifted so far
+	std::vector<std::string> texts;
+
+	// pool id of every string literal shifted so far
+	std::vector<uint32_t> strings;
+
+	// value of every integer literal shifted so far
+	std::vector<int_literal> ints;
+
+	// symbol kind of the lookahead token, negative if it has not been read yet
+	int lookahead;
+
+	// tokens left to shift before syntax errors are reported again
+	int err_status;
+
+	/* returns the state to shift to if positive, or minus the rule to reduce by if negative.
+	 * returns 0 on a syntax error. The lookahead is only read if the state needs it. */
+	int next_action(int state);
+
+	/* pushes the lookahead token and the state n onto the stack */
+	void shift(int n);
+
+	/* runs the action of rule n and replaces its right-hand side with its left-hand side */
+	void reduce(int n);
+
+	/* returns the node built by the action of rule n, see lr_actions.h */
+	ast_node *rule_action(int n);
+
+	/* returns the semantic value k symbols below the top of the stack */
+	template <class T>
+	T value(int k);
+
+	/* returns the location of the symbol k symbols below the top of the stack */
+	const yy::location &location(int k) const;
+
+	/* reports the error unless still recovering from the previous one, then pops states
+	 * until one where the error token can be shifted. Returns 0 if there is none. */
+	int recover();
+
+	/* records a syntax error listing the tokens expected in the current state */
+	void report_syntax_error();
+};
+
+#endif
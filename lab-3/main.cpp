@@ -1,72 +1,659 @@
-#include "parser.h"
-#include "lexer.h"
-
-#include <errno.h>
+#include <sys/wait.h>
 #include <unistd.h>
 
+#include <cerrno>
 #include <cstdio>
 #include <cstdlib>
+#include <cstring>
 #include <iostream>
+#include <sstream>
+
+#include "driver.hpp"
+#include "elf_object.hpp"
+#include "ir_builder.hpp"
+#include "ir_passes.hpp"
+#include "lex_pipeline.hpp"
+#include "object_cache.hpp"
+#include "parse_stats.hpp"
+#include "time_report.hpp"
+#include "x86_64.hpp"
+
+/* command line option flags */
+
+#define	LONG_OPT_TRACE_PARSING		"--parser-traces"
+#define	SHORT_OPT_TRACE_PARSING		"-p"
+#define	LONG_OPT_TRACE_SCANNING		"--scanner-traces"
+#define	SHORT_OPT_TRACE_SCANNING	"-s"
+#define	LONG_OPT_EMIT_IR			"--emit-ir"
+#define	SHORT_OPT_OPTIMIZE			"-O"
+#define	LONG_OPT_INLINE_LIMIT		"--inline-limit"
+#define	LONG_OPT_INLINE_BUDGET		"--inline-budget"
+#define	LONG_OPT_INLINE_REPORT		"--inline-report"
+#define	LONG_OPT_TAIL_CALL_REPORT	"--tail-call-report"
+#define	SHORT_OPT_ESCAPE_REPORT		"-m"
+#define	LONG_OPT_TIME_REPORT		"--time-report"
+#define	LONG_OPT_TIME_TRACE			"--time-trace"
+#define	LONG_OPT_LEX_FIRST			"--lex-first"
+#define	LONG_OPT_PIPELINE			"--pipeline"
+#define	LONG_OPT_WRITE_TOKENS		"--write-tokens"
+#define	LONG_OPT_READ_TOKENS		"--read-tokens"
+#define	LONG_OPT_ERROR_LIMIT		"--error-limit"
+#define	SHORT_OPT_COMPILE			"-c"
+#define	SHORT_OPT_OUTPUT			"-o"
+#define	LONG_OPT_BUILD				"--build"
+#define	LONG_OPT_CACHE_DIR			"--cache-dir"
+#define	LONG_OPT_RUNTIME			"--runtime"
+#define	SHORT_OPT_IMPORT_DIR		"-I"
+#define	LONG_OPT_STATS				"--stats"
 
+/* prints a program usage message */
 void printUsage(std::ostream& outputStream, char *programName)
 {
-	outputStream << "Usage: " << programName << " [FILE]" << std::endl;
+	outputStream
+		<< "Usage: " << programName << " [OPTION]... [FILE]..." << std::endl
+		<< std::endl
+		<< "\t-p, --parser-traces" << std::endl
+		<< "\t\tInclude parser traces" << std::endl
+		<< "\t-s, --scanner-traces" << std::endl
+		<< "\t\tPrint scanner traces" << std::endl
+		<< "\t--emit-ir" << std::endl
+		<< "\t\tPrint the intermediate representation instead of the AST" << std::endl
+		<< "\t-O" << std::endl
+		<< "\t\tOptimise the intermediate representation" << std::endl
+		<< "\t--inline-limit N" << std::endl
+		<< "\t\tWith -O, inline callees of at most N instructions (default 16, 0 disables inlining)" << std::endl
+		<< "\t--inline-budget N" << std::endl
+		<< "\t\tWith -O, do not grow a function past N instructions by inlining (default 400)" << std::endl
+		<< "\t--inline-report" << std::endl
+		<< "\t\tWith -O, print each inlining decision to stderr" << std::endl
+		<< "\t--tail-call-report" << std::endl
+		<< "\t\tWith -O or -c, print each tail call turned into a loop or a jump to stderr" << std::endl
+		<< "\t-m" << std::endl
+		<< "\t\tPrint whether each local array is kept in its frame or moved to the heap to stderr" << std::endl
+		<< "\t--time-report" << std::endl
+		<< "\t\tPrint the time and memory spent in each phase, over all files, to stderr" << std::endl
+		<< "\t--time-trace FILE" << std::endl
+		<< "\t\tWrite the phases of each file to FILE as Chrome trace events" << std::endl
+		<< "\t--stats FILE" << std::endl
+		<< "\t\tWrite counts of the tokens and reductions to FILE as JSON (built with make STATS=1)" << std::endl
+		<< "\t--lex-first" << std::endl
+		<< "\t\tScan each file whole before parsing it" << std::endl
+		<< "\t--pipeline" << std::endl
+		<< "\t\tScan each file on a separate thread while the one before it is parsed" << std::endl
+		<< "\t--write-tokens" << std::endl
+		<< "\t\tWrite the tokens of each file to a .tok file instead of parsing it" << std::endl
+		<< "\t--read-tokens" << std::endl
+		<< "\t\tParse the tokens written by --write-tokens, given in place of each file" << std::endl
+		<< "\t--error-limit N" << std::endl
+		<< "\t\tPrint at most N errors for each file (default 10, 0 for no limit)" << std::endl
+		<< "\t-c" << std::endl
+		<< "\t\tCompile each file to an x86-64 ELF object file, and a .x file of its exports" << std::endl
+		<< "\t-o FILE" << std::endl
+		<< "\t\tWrite the object or token file of the next file to FILE" << std::endl
+		<< "\t-I DIR" << std::endl
+		<< "\t\tLook for the export files of imported packages in DIR (default .)" << std::endl
+		<< "\t--build FILE" << std::endl
+		<< "\t\tCompile every file, reusing the objects of unchanged files, and link them" << std::endl
+		<< "\t\twith any .c, .o or .a files given into the executable FILE" << std::endl
+		<< "\t--cache-dir DIR" << std::endl
+		<< "\t\tKeep the objects compiled by --build in DIR (default .parser-cache)" << std::endl
+		<< "\t--runtime FILE" << std::endl
+		<< "\t\tLink --build executables with the runtime library FILE" << std::endl
+		<< "\t\t(default runtime/libruntime.a next to this program)" << std::endl;
 }
 
-int main(int argc, char **argv)
+/* options that select what is done with each parsed file */
+static bool emit_ir = false;
+static bool optimize = false;
+static bool compile = false;
+static ir_inline_options inlining;
+static bool tail_call_report = false;
+static bool escape_report = false;
+
+/* where the phases are timed, and where to report them */
+static time_report timing;
+static bool time_report_wanted = false;
+static const char *time_trace = NULL;
+
+/* where the counts of tokens and reductions are written, NULL if they are not */
+static const char *stats_file = NULL;
+
+/* how the tokens of each file reach the parser */
+static bool lex_first = false;
+static bool pipelined = false;
+static bool write_tokens = false;
+static bool read_tokens = false;
+
+/* scans the files ahead of the parser with --pipeline, NULL otherwise */
+static lex_pipeline *pipeline = NULL;
+
+/* name of the output file of the next file, empty to derive it from the file name */
+static std::string output;
+
+/* directories searched for the export files of imported packages, in order */
+static std::vector<std::string> import_dirs;
+
+/* executable linked by --build, NULL without it, and the objects compiled or found in
+ * the cache and other files to link into it, in the order they were given */
+static const char *build_output = NULL;
+static object_cache cache;
+static std::vector<std::string> link_inputs;
+static bool build_failed = false;
+
+/* runtime library linked by --build, empty for the one next to this program */
+static std::string runtime_lib;
+
+/* returns the name of the output file for the source file fname: its name with the
+ * extension ext */
+static std::string output_name(const char *fname, const char *ext)
 {
-	yydebug = 0;
-	
-	//yytext
-	//yyleng
-	//yylineno
+	std::string name(fname);
+	if (name == "-")
+	{
+		return std::string("a") + ext;
+	}
 
-	if (argc > 2)
+	std::string::size_type dot = name.rfind('.');
+	if (dot != std::string::npos && name.find('/', dot) == std::string::npos)
 	{
-		printUsage(std::cerr, argv[0]);
+		name.erase(dot);
 	}
+	return name + ext;
+}
 
-	// check if input was piped into the program via stdin
-	if (!isatty(STDIN_FILENO))
+/* turns the self tail calls of every function into loops */
+static void lower_tail_recursion(ir_module &module)
+{
+	for (std::vector<ir_function>::size_type f = 0; f != module.functions.size(); f++)
 	{
-		// check if the user also specified an input file
-		if (argc == 2)
+		std::size_t loops = ir_tail_recursion(module.functions[f]);
+		const std::string &name = module.symbols[module.functions[f].name];
+		for (std::size_t i = 0; tail_call_report && i != loops; i++)
 		{
-			std::cerr << "Detected input from stdin, ignoring file: \"" << argv[1] << "\"" << std::endl;
+			std::cerr << "tail call: " << name << " -> " << name << " (loop)" << std::endl;
 		}
+	}
+}
+
+/* translates the AST of driver to IR and prints it, or writes it to the object file
+ * oname, and its exports to xname unless it is empty. The export files looked for are
+ * added to imported unless it is NULL. returns 0 on success, 1 otherwise. */
+static int translate(go_driver &driver, const std::string &oname, const std::string &xname,
+	std::vector<std::string> *imported)
+{
+	time_report *timing = driver.timing;
+	ir_module module;
+	ir_builder builder(driver, module);
+	int failed;
 
-		// set input source to stdin
-		yyin = stdin;
+	builder.import_dirs = import_dirs;
+	builder.escape_report = escape_report ? &std::cerr : NULL;
+	{
+		phase_timer timer(timing, time_report::phase_build_ir);
+		failed = builder.build(driver.tree);
+	}
+	if (imported)
+	{
+		*imported = builder.import_candidates;
+	}
+	if (failed)
+	{
+		return 1;
+	}
+
+	{
+		phase_timer timer(timing, time_report::phase_optimize);
+		if (optimize || compile)
+		{
+			lower_tail_recursion(module);
+		}
+		if (optimize)
+		{
+			ir_optimize(module, inlining);
+		}
+	}
+
+	if (!compile)
+	{
+		phase_timer timer(timing, time_report::phase_print);
+		module.print(std::cout);
+		return 0;
+	}
+
+	elf_object obj;
+	{
+		phase_timer timer(timing, time_report::phase_codegen);
+		x86_64_codegen(module, obj, tail_call_report ? &std::cerr : NULL);
+	}
+
+	phase_timer timer(timing, time_report::phase_write_object);
+	if (obj.write(oname, module.symbols))
+	{
+		driver.diagnostics.report(driver.diagnostics.begin_file(oname), source_span(), msg_io, strerror(errno));
+		return 1;
+	}
+	if (!xname.empty() && builder.exports.write(xname))
+	{
+		driver.diagnostics.report(driver.diagnostics.begin_file(xname), source_span(), msg_io, strerror(errno));
+		return 1;
+	}
+	return 0;
+}
+
+/* scans the whole file denoted by fname into tokens, or takes its tokens from the
+ * pipeline. Exits after printing every error so far if the file cannot be read, as the
+ * scanner does. */
+static void scan(go_driver &driver, const char *fname, token_array &tokens)
+{
+	int err;
+	{
+		phase_timer timer(driver.timing, time_report::phase_lex);
+		err = pipeline ? pipeline->next(tokens) : driver.scan_file(fname, tokens);
+	}
+	if (err)
+	{
+		driver.diagnostics.report(driver.diagnostics.begin_file(fname), source_span(), msg_io, strerror(err));
+		driver.diagnostics.render(std::cerr);
+		exit(EXIT_FAILURE);
+	}
+}
+
+/* parses the file denoted by fname, or the tokens in it with --read-tokens.
+ * returns 0 if it was parsed without errors, 1 otherwise. */
+static int parse(go_driver &driver, const char *fname)
+{
+	token_array tokens;
+
+	if (read_tokens)
+	{
+		if (tokens.read(fname))
+		{
+			driver.diagnostics.report(driver.diagnostics.begin_file(fname), source_span(), msg_not_token_file);
+			return 1;
+		}
+	}
+	else if (lex_first || pipeline)
+	{
+		scan(driver, fname, tokens);
 	}
 	else
 	{
-		// check if the user specified an input file
-		if (argc == 2)
+		return driver.parse(fname);
+	}
+	return driver.parse_tokens(tokens);
+}
+
+/* returns 1 if the file name fname ends with ext */
+static int has_extension(const std::string &fname, const char *ext)
+{
+	std::string::size_type n = strlen(ext);
+	return fname.size() > n && !fname.compare(fname.size() - n, n, ext);
+}
+
+/* returns the options that change the code generated for a file */
+static std::string codegen_options()
+{
+	std::ostringstream options;
+	options << "-O " << optimize << " --inline-limit " << inlining.callee_limit
+		<< " --inline-budget " << inlining.caller_limit;
+	// the functions of imported packages decide which calls have results
+	for (std::vector<std::string>::size_type i = 0; i != import_dirs.size(); i++)
+	{
+		options << " -I " << import_dirs[i];
+	}
+	return options.str();
+}
+
+/* compiles the file denoted by fname for --build, unless the cache has an object
+ * compiled from the same source with the same compiler and options, against the same
+ * export files. Files the linker takes as they are, C sources and objects, are only
+ * added to the link. */
+static void build(go_driver &driver, const char *fname)
+{
+	if (has_extension(fname, ".c") || has_extension(fname, ".o") || has_extension(fname, ".a"))
+	{
+		link_inputs.push_back(fname);
+		return;
+	}
+
+	token_array source;
+	std::string key;
+	int err;
+	{
+		phase_timer timer(driver.timing, time_report::phase_read_input);
+		err = source.read_source(fname);
+		if (!err)
 		{
-			char *fname = argv[1];
-			FILE *fp;
+			key = cache.key(codegen_options(), source.source);
+		}
+	}
+	if (err)
+	{
+		driver.diagnostics.report(driver.diagnostics.begin_file(fname), source_span(), msg_io, strerror(err));
+		build_failed = true;
+		return;
+	}
 
-			if (!(fp = fopen(fname, "rb")))
-			{
-				std::cerr << "'" << fname << "': Couldn't open file" << std::endl;
-				exit(errno);
-			}
-			
-			// set input source to file
-			yyin = fp;
+	if (!cache.contains(key))
+	{
+		std::string temp = cache.temporary(key);
+		std::vector<std::string> imported;
+		if (driver.parse_buffer(source.source.data(), source.source.size(), fname)
+			|| translate(driver, temp, std::string(), &imported))
+		{
+			// drop anything written before the failure
+			remove(temp.c_str());
+			build_failed = true;
+			return;
+		}
+		if ((err = cache.store(temp, key, imported)))
+		{
+			driver.diagnostics.report(driver.diagnostics.begin_file(cache.path(key)), source_span(), msg_io, strerror(err));
+			build_failed = true;
+			return;
+		}
+	}
+	link_inputs.push_back(cache.path(key));
+}
+
+/* returns the runtime library built with this program, in runtime/ next to it, or an
+ * empty string if it cannot be found */
+static std::string default_runtime()
+{
+	char exe[4096];
+	ssize_t n = readlink("/proc/self/exe", exe, sizeof(exe) - 1);
+	if (n < 0)
+	{
+		return "";
+	}
+	std::string path(exe, n);
+	path = path.substr(0, path.rfind('/') + 1) + "runtime/libruntime.a";
+	return access(path.c_str(), R_OK) ? "" : path;
+}
+
+/* links the inputs of --build and the runtime library into the executable fname with
+ * the C compiler, $CC or cc. returns 0 on success, 1 otherwise. */
+static int link(go_driver &driver, const char *fname)
+{
+	const char *cc = getenv("CC");
+	std::vector<const char *> args;
+
+	if (runtime_lib.empty())
+	{
+		runtime_lib = default_runtime();
+	}
+
+	args.push_back(cc && *cc ? cc : "cc");
+	args.push_back("-o");
+	args.push_back(fname);
+	for (std::vector<std::string>::size_type i = 0; i != link_inputs.size(); i++)
+	{
+		args.push_back(link_inputs[i].c_str());
+	}
+	// after the objects, so that the linker takes what they use from it
+	if (!runtime_lib.empty())
+	{
+		args.push_back(runtime_lib.c_str());
+		args.push_back("-pthread");
+	}
+	args.push_back(NULL);
+
+	// the diagnostics are printed before the linker's own
+	std::cout.flush();
+	pid_t pid = fork();
+	if (pid == 0)
+	{
+		execvp(args[0], const_cast<char *const *>(&args[0]));
+		std::cerr << args[0] << ": " << strerror(errno) << std::endl;
+		_exit(127);
+	}
+
+	int status;
+	if (pid < 0 || waitpid(pid, &status, 0) < 0)
+	{
+		driver.diagnostics.report(driver.diagnostics.begin_file(fname), source_span(), msg_io, strerror(errno));
+		return 1;
+	}
+	if (!WIFEXITED(status) || WEXITSTATUS(status))
+	{
+		std::ostringstream reason;
+		reason << args[0] << " failed";
+		driver.diagnostics.report(driver.diagnostics.begin_file(fname), source_span(), msg_io, reason.str());
+		return 1;
+	}
+	return 0;
+}
+
+/* parses the file denoted by fname and prints its AST or IR, or writes its object file.
+ * With --write-tokens, writes its tokens instead. Errors are printed once every file has
+ * been processed. */
+static void process(go_driver &driver, const char *fname)
+{
+	if (build_output)
+	{
+		build(driver, fname);
+		return;
+	}
+	if (write_tokens)
+	{
+		token_array tokens;
+		std::string tname = output.empty() ? output_name(fname, ".tok") : output;
+		scan(driver, fname, tokens);
+		if (tokens.write(tname))
+		{
+			driver.diagnostics.report(driver.diagnostics.begin_file(tname), source_span(), msg_io, strerror(errno));
+		}
+		output.clear();
+		return;
+	}
+
+	if (!parse(driver, fname))
+	{
+		if (emit_ir || compile)
+		{
+			std::string oname = output.empty() ? output_name(fname, ".o") : output;
+			translate(driver, oname, compile ? output_name(oname.c_str(), ".x") : std::string(), NULL);
 		}
 		else
 		{
+			// print resulting tree
+			phase_timer timer(driver.timing, time_report::phase_print);
+			driver.print_ast();
+		}
+	}
+	output.clear();
+}
+
+int main(int argc, char **argv)
+{
+	go_driver driver;
+	int i = 1;
+
+	// with --pipeline, files are processed once every option has been read
+	std::vector<std::string> files, outputs;
+
+	// whether a file to parse was named, "-" for stdin included
+	bool named_input = false;
+
+	while (i < argc)
+	{
+		if ( !strcmp(argv[i], SHORT_OPT_TRACE_PARSING) || !strcmp(argv[i], LONG_OPT_TRACE_PARSING))
+		{
+			driver.trace_parsing = true;
+		}
+		else if (!strcmp(argv[i], SHORT_OPT_TRACE_SCANNING) || !strcmp(argv[i], LONG_OPT_TRACE_SCANNING))
+		{
+			driver.trace_scanning = true;
+		}
+		else if (!strcmp(argv[i], LONG_OPT_EMIT_IR))
+		{
+			emit_ir = true;
+		}
+		else if (!strcmp(argv[i], SHORT_OPT_OPTIMIZE))
+		{
+			optimize = true;
+		}
+		else if (!strcmp(argv[i], LONG_OPT_INLINE_LIMIT) && i + 1 < argc)
+		{
+			inlining.callee_limit = strtoul(argv[++i], NULL, 10);
+		}
+		else if (!strcmp(argv[i], LONG_OPT_INLINE_BUDGET) && i + 1 < argc)
+		{
+			inlining.caller_limit = strtoul(argv[++i], NULL, 10);
+		}
+		else if (!strcmp(argv[i], LONG_OPT_INLINE_REPORT))
+		{
+			inlining.report = &std::cerr;
+		}
+		else if (!strcmp(argv[i], LONG_OPT_TAIL_CALL_REPORT))
+		{
+			tail_call_report = true;
+		}
+		else if (!strcmp(argv[i], SHORT_OPT_ESCAPE_REPORT))
+		{
+			escape_report = true;
+		}
+		else if (!strcmp(argv[i], LONG_OPT_TIME_REPORT))
+		{
+			time_report_wanted = true;
+			driver.timing = &timing;
+		}
+		else if (!strcmp(argv[i], LONG_OPT_TIME_TRACE) && i + 1 < argc)
+		{
+			time_trace = argv[++i];
+			timing.tracing = true;
+			driver.timing = &timing;
+		}
+		else if (!strcmp(argv[i], LONG_OPT_STATS) && i + 1 < argc)
+		{
+			stats_file = argv[++i];
+#ifndef PARSER_STATS
+			std::cerr << LONG_OPT_STATS ": counting is not compiled in, rebuild with make STATS=1" << std::endl;
+			stats_file = NULL;
+#endif
+		}
+		else if (!strcmp(argv[i], LONG_OPT_LEX_FIRST))
+		{
+			lex_first = true;
+		}
+		else if (!strcmp(argv[i], LONG_OPT_PIPELINE))
+		{
+			pipelined = true;
+		}
+		else if (!strcmp(argv[i], LONG_OPT_WRITE_TOKENS))
+		{
+			write_tokens = true;
+		}
+		else if (!strcmp(argv[i], LONG_OPT_READ_TOKENS))
+		{
+			read_tokens = true;
+		}
+		else if (!strcmp(argv[i], LONG_OPT_ERROR_LIMIT) && i + 1 < argc)
+		{
+			driver.diagnostics.limit = strtoul(argv[++i], NULL, 10);
+		}
+		else if (!strcmp(argv[i], SHORT_OPT_COMPILE))
+		{
+			compile = true;
+		}
+		else if (!strcmp(argv[i], SHORT_OPT_OUTPUT) && i + 1 < argc)
+		{
+			output = argv[++i];
+		}
+		else if (!strcmp(argv[i], LONG_OPT_BUILD) && i + 1 < argc)
+		{
+			build_output = argv[++i];
+			compile = true;
+		}
+		else if (!strcmp(argv[i], LONG_OPT_CACHE_DIR) && i + 1 < argc)
+		{
+			cache.dir = argv[++i];
+		}
+		else if (!strcmp(argv[i], LONG_OPT_RUNTIME) && i + 1 < argc)
+		{
+			runtime_lib = argv[++i];
+		}
+		else if (!strcmp(argv[i], SHORT_OPT_IMPORT_DIR) && i + 1 < argc)
+		{
+			import_dirs.push_back(argv[++i]);
+		}
+		else if (argv[i][0] == '-' && argv[i][1])
+		{
+			// argument meaning is unknown
+			std::cerr << "Unrecognised option: " << argv[i] << std::endl;
 			printUsage(std::cerr, argv[0]);
-			std::cerr << "No input from stdin, and no file specified, exiting..." << std::endl;
 			return 1;
 		}
+		else if (pipelined && !build_output)
+		{
+			files.push_back(argv[i]);
+			outputs.push_back(output);
+			output.clear();
+			named_input = true;
+		}
+		else
+		{
+			// argument is a file to parse, report every error found in it
+			process(driver, argv[i]);
+			named_input = true;
+		}
+
+		i++;
+	}
+
+	// without files to parse, check if input was piped into the program via stdin
+	if (!named_input && !isatty(STDIN_FILENO))
+	{
+		if (pipelined && !build_output)
+		{
+			files.push_back("-");
+			outputs.push_back(output);
+		}
+		else
+		{
+			process(driver, "-");
+		}
 	}
 
-	// send output to stdout
-	yyout = stdout;
+	if (!files.empty())
+	{
+		// token files are read whole already
+		if (!read_tokens)
+		{
+			pipeline = new lex_pipeline(files, driver.trace_scanning);
+		}
+		for (std::vector<std::string>::size_type f = 0; f != files.size(); f++)
+		{
+			output = outputs[f];
+			process(driver, files[f].c_str());
+		}
+		delete pipeline;
+		pipeline = NULL;
+	}
 
-	yyparse();
+	if (build_output && !build_failed)
+	{
+		phase_timer timer(driver.timing, time_report::phase_link);
+		build_failed = link(driver, build_output);
+	}
 
-	return 0;
+	{
+		phase_timer timer(driver.timing, time_report::phase_print);
+		driver.diagnostics.render(std::cerr);
+	}
+
+	if (time_report_wanted)
+	{
+		timing.print(std::cerr);
+	}
+	if (time_trace && timing.write_trace(time_trace))
+	{
+		std::cerr << time_trace << ": " << strerror(errno) << std::endl;
+	}
+	if (stats_file && parse_stats::write(stats_file))
+	{
+		std::cerr << stats_file << ": " << strerror(errno) << std::endl;
+	}
+
+	return build_failed ? 1 : 0;
 }
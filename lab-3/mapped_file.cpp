@@ -0,0 +1,87 @@
+#include "mapped_file.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+
+mapped_file::mapped_file()
+{
+	data = NULL;
+	size = 0;
+	length = 0;
+}
+
+mapped_file::~mapped_file()
+{
+	unmap();
+}
+
+/* Reserves zero-filled anonymous pages for the file and the NUL bytes, then maps the
+ * file over their beginning: the bytes past the end of the file read as zero whether
+ * they fall in its last page or in the pages after it.
+ */
+int mapped_file::map(const std::string &fname)
+{
+	struct stat info;
+	int fd, err;
+
+	unmap();
+	if ((fd = open(fname.c_str(), O_RDONLY)) < 0)
+	{
+		return errno;
+	}
+	if (fstat(fd, &info))
+	{
+		err = errno;
+		close(fd);
+		return err;
+	}
+	if (!S_ISREG(info.st_mode))
+	{
+		// pipes and devices have no size to map
+		close(fd);
+		return ENODEV;
+	}
+
+	std::size_t page = sysconf(_SC_PAGESIZE);
+	std::size_t file_size = info.st_size;
+	std::size_t total = (file_size + 2 + page - 1) / page * page;
+
+	void *base = mmap(NULL, total, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (base == MAP_FAILED)
+	{
+		err = errno;
+		close(fd);
+		return err;
+	}
+	if (file_size && mmap(base, file_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, fd, 0) == MAP_FAILED)
+	{
+		err = errno;
+		munmap(base, total);
+		close(fd);
+		return err;
+	}
+	close(fd);
+
+	// the scanner reads the file once, front to back
+	madvise(base, total, MADV_SEQUENTIAL);
+
+	data = static_cast<char *>(base);
+	size = file_size;
+	length = total;
+	return 0;
+}
+
+void mapped_file::unmap()
+{
+	if (data)
+	{
+		munmap(data, length);
+	}
+	data = NULL;
+	size = 0;
+	length = 0;
+}
@@ -0,0 +1,136 @@
+#include "object_cache.hpp"
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+
+#include "sha256.hpp"
+
+object_cache::object_cache()
+{
+	dir = ".parser-cache";
+}
+
+/* returns the key of the object compiled from source with options. A rebuilt
+ * compiler may generate different code, so the key includes the size and time of
+ * modification of the compiler's executable, or the time it was built where the
+ * executable cannot be found. */
+std::string object_cache::key(const std::string &options, const std::string &source)
+{
+	if (compiler.empty())
+	{
+		std::ostringstream id;
+		struct stat info;
+		if (!stat("/proc/self/exe", &info))
+		{
+			id << info.st_dev << ':' << info.st_ino << ':' << info.st_size << ':'
+				<< info.st_mtim.tv_sec << '.' << info.st_mtim.tv_nsec;
+		}
+		else
+		{
+			id << __DATE__ " " __TIME__;
+		}
+		compiler = id.str();
+	}
+
+	// every part is followed by a NUL byte, so that none can run into the next
+	sha256 hash;
+	hash.update(compiler.c_str(), compiler.size() + 1);
+	hash.update(options.c_str(), options.size() + 1);
+	hash.update(source.data(), source.size());
+	return hash.hex_digest();
+}
+
+/* returns the path of the object of key, which may not exist */
+std::string object_cache::path(const std::string &key) const
+{
+	return dir + "/" + key + ".o";
+}
+
+/* returns the size and time of modification of the file denoted by fname, "-" if it
+ * does not exist */
+static std::string stamp(const std::string &fname)
+{
+	std::ostringstream id;
+	struct stat info;
+	if (stat(fname.c_str(), &info))
+	{
+		return "-";
+	}
+	id << info.st_size << ':' << info.st_mtim.tv_sec << '.' << info.st_mtim.tv_nsec;
+	return id.str();
+}
+
+/* returns 1 if the object of key is in the cache and the files it depends on are
+ * unchanged, 0 otherwise. They are listed in "<key>.deps", one per line after its
+ * stamp; an object without the list depends on nothing. */
+int object_cache::contains(const std::string &key) const
+{
+	struct stat info;
+	if (stat(path(key).c_str(), &info) || !S_ISREG(info.st_mode))
+	{
+		return 0;
+	}
+
+	std::ifstream deps((dir + "/" + key + ".deps").c_str());
+	std::string line;
+	while (std::getline(deps, line))
+	{
+		std::string::size_type space = line.find(' ');
+		if (space == std::string::npos || stamp(line.substr(space + 1)) != line.substr(0, space))
+		{
+			return 0;
+		}
+	}
+	return 1;
+}
+
+/* creates the directory if needed, and returns a path the object of key can be
+ * written to before it is stored. The path is unique to this process. */
+std::string object_cache::temporary(const std::string &key)
+{
+	mkdir(dir.c_str(), 0777);
+
+	std::ostringstream name;
+	name << path(key) << ".tmp." << getpid();
+	return name.str();
+}
+
+/* moves the object written to temp into the cache as the object of key, which
+ * depends on the files denoted by deps, existing or not. The list of dependencies is
+ * stored first, so that the object is never found without it.
+ * returns 0 on success, or the errno of the failure. */
+int object_cache::store(const std::string &temp, const std::string &key, const std::vector<std::string> &deps)
+{
+	if (!deps.empty())
+	{
+		std::string list = dir + "/" + key + ".deps";
+		std::string list_temp = temp + ".deps";
+		errno = 0;
+		std::ofstream out(list_temp.c_str());
+		for (std::vector<std::string>::size_type i = 0; i != deps.size(); i++)
+		{
+			out << stamp(deps[i]) << ' ' << deps[i] << '\n';
+		}
+		out.close();
+		if (!out || rename(list_temp.c_str(), list.c_str()))
+		{
+			int err = errno ? errno : EIO;
+			unlink(list_temp.c_str());
+			unlink(temp.c_str());
+			return err;
+		}
+	}
+
+	if (rename(temp.c_str(), path(key).c_str()))
+	{
+		int err = errno;
+		unlink(temp.c_str());
+		return err;
+	}
+	return 0;
+}
@@ -0,0 +1,47 @@
+#ifndef OBJECT_CACHE_HPP
+#define OBJECT_CACHE_HPP
+
+#include <string>
+#include <vector>
+
+/* A directory of object files, each named after the SHA-256 of everything it was
+ * compiled from: the identity of the compiler, the options that change the code
+ * generated, and the source. An object is written under a temporary name and renamed
+ * into place, so builds running at the same time never see half of one.
+ * The export files an object was compiled against are listed next to it with their
+ * size and time of modification, and the object is only reused while they are the same.
+ * Objects are never removed, and the directory can be deleted at any time.
+ */
+class object_cache
+{
+public:
+	// directory holding the objects
+	std::string dir;
+
+	object_cache();
+
+	/* returns the key of the object compiled from source with options */
+	std::string key(const std::string &options, const std::string &source);
+
+	/* returns the path of the object of key, which may not exist */
+	std::string path(const std::string &key) const;
+
+	/* returns 1 if the object of key is in the cache and the files it depends on are
+	 * unchanged, 0 otherwise */
+	int contains(const std::string &key) const;
+
+	/* creates the directory if needed, and returns a path the object of key can be
+	 * written to before it is stored */
+	std::string temporary(const std::string &key);
+
+	/* moves the object written to temp into the cache as the object of key, which
+	 * depends on the files denoted by deps, existing or not.
+	 * returns 0 on success, or the errno of the failure. */
+	int store(const std::string &temp, const std::string &key, const std::vector<std::string> &deps);
+
+private:
+	// identity of the compiler's executable, empty until the first key is made
+	std::string compiler;
+};
+
+#endif
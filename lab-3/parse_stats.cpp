@@ -0,0 +1,182 @@
+#include "parse_stats.hpp"
+
+#include <pthread.h>
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+histogram::histogram()
+{
+	memset(buckets, 0, sizeof(buckets));
+}
+
+void histogram::add(uint64_t value)
+{
+	int bucket = 0;
+	while (value && bucket != num_buckets - 1)
+	{
+		value >>= 1;
+		bucket++;
+	}
+	buckets[bucket]++;
+}
+
+void histogram::merge(const histogram &other)
+{
+	for (int i = 0; i != num_buckets; i++)
+	{
+		buckets[i] += other.buckets[i];
+	}
+}
+
+parse_stats::parse_stats()
+{
+	memset(tokens, 0, sizeof(tokens));
+	memset(token_names, 0, sizeof(token_names));
+	memset(reductions, 0, sizeof(reductions));
+	nesting = 0;
+	blank_bytes = 0;
+	lines = 0;
+}
+
+/* counts a token of the kind called name, of length bytes */
+void parse_stats::token(int kind, const char *name, std::size_t length)
+{
+	if (kind >= 0 && kind < max_tokens)
+	{
+		tokens[kind]++;
+		token_names[kind] = name;
+	}
+	token_length.add(length);
+	depth.add(nesting);
+}
+
+void parse_stats::open()
+{
+	nesting++;
+}
+
+/* unbalanced brackets are syntax errors, the depth never goes below 0 */
+void parse_stats::close()
+{
+	if (nesting)
+	{
+		nesting--;
+	}
+}
+
+void parse_stats::reduce(int rule)
+{
+	if (rule >= 0 && rule < max_rules)
+	{
+		reductions[rule]++;
+	}
+}
+
+/* the counts of every thread, which live until the program exits */
+static pthread_mutex_t threads_lock = PTHREAD_MUTEX_INITIALIZER;
+static std::vector<parse_stats *> threads;
+static __thread parse_stats *current;
+
+/* returns the counts of the calling thread, created on its first call */
+parse_stats &parse_stats::local()
+{
+	if (!current)
+	{
+		current = new parse_stats();
+		pthread_mutex_lock(&threads_lock);
+		threads.push_back(current);
+		pthread_mutex_unlock(&threads_lock);
+	}
+	return *current;
+}
+
+/* adds the counts of other to these */
+void parse_stats::merge(const parse_stats &other)
+{
+	for (int i = 0; i != max_tokens; i++)
+	{
+		tokens[i] += other.tokens[i];
+		if (other.token_names[i])
+		{
+			token_names[i] = other.token_names[i];
+		}
+	}
+	for (int i = 0; i != max_rules; i++)
+	{
+		reductions[i] += other.reductions[i];
+	}
+	token_length.merge(other.token_length);
+	depth.merge(other.depth);
+	blank_bytes += other.blank_bytes;
+	lines += other.lines;
+}
+
+/* writes the buckets of h as a JSON object, keyed by the smallest value of each */
+static void write_histogram(FILE *out, const histogram &h)
+{
+	const char *separator = "";
+
+	fprintf(out, "{");
+	for (int i = 0; i != histogram::num_buckets; i++)
+	{
+		if (h.buckets[i])
+		{
+			fprintf(out, "%s\"%llu\":%llu", separator, i ? 1ULL << (i - 1) : 0ULL, (unsigned long long) h.buckets[i]);
+			separator = ",";
+		}
+	}
+	fprintf(out, "}");
+}
+
+/* writes the sum of the counts of every thread to the file denoted by fname, as JSON.
+ * Tokens are keyed by their name in parser.y, and rules by their number in parser.output,
+ * which is one less than the number the parsers use.
+ * returns 0 on success, 1 otherwise. */
+int parse_stats::write(const std::string &fname)
+{
+	parse_stats sum;
+	const char *separator = "";
+
+	pthread_mutex_lock(&threads_lock);
+	for (std::vector<parse_stats *>::size_type t = 0; t != threads.size(); t++)
+	{
+		sum.merge(*threads[t]);
+	}
+	pthread_mutex_unlock(&threads_lock);
+
+	FILE *out = fopen(fname.c_str(), "w");
+	if (!out)
+	{
+		return 1;
+	}
+
+	fprintf(out, "{\n\"tokens\":{");
+	for (int i = 0; i != max_tokens; i++)
+	{
+		if (sum.tokens[i])
+		{
+			fprintf(out, "%s\"%s\":%llu", separator, sum.token_names[i], (unsigned long long) sum.tokens[i]);
+			separator = ",";
+		}
+	}
+	fprintf(out, "},\n\"token_length\":");
+	write_histogram(out, sum.token_length);
+	fprintf(out, ",\n\"nesting_depth\":");
+	write_histogram(out, sum.depth);
+	fprintf(out, ",\n\"blank_bytes\":%llu,\n\"lines\":%llu,\n\"reductions\":{",
+		(unsigned long long) sum.blank_bytes, (unsigned long long) sum.lines);
+	separator = "";
+	for (int i = 0; i != max_rules; i++)
+	{
+		if (sum.reductions[i])
+		{
+			fprintf(out, "%s\"%d\":%llu", separator, i - 1, (unsigned long long) sum.reductions[i]);
+			separator = ",";
+		}
+	}
+	fprintf(out, "}\n}\n");
+
+	return fclose(out) ? 1 : 0;
+}
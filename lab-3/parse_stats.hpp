@@ -0,0 +1,94 @@
+#ifndef PARSE_STATS_HPP
+#define PARSE_STATS_HPP
+
+#include <stdint.h>
+
+#include <cstddef>
+#include <string>
+
+/* a count of values by their power of two: bucket 0 counts 0, and bucket i counts
+ * the values from 2^(i-1) to 2^i - 1. The last bucket also counts anything larger. */
+class histogram
+{
+public:
+	enum { num_buckets = 16 };
+
+	uint64_t buckets[num_buckets];
+
+	histogram();
+
+	void add(uint64_t value);
+	void merge(const histogram &other);
+};
+
+/* Counts of what the scanner and the parser see: the tokens of each kind, their
+ * lengths, the bytes of blanks, the depth of brackets at each token, and the number
+ * of reductions by each rule of parser.y, as numbered in parser.output.
+ *
+ * Counting is compiled in with make STATS=1, which defines PARSER_STATS. Without it,
+ * the STATS_ macros expand to nothing, so the scanner and the parser pay nothing.
+ * Each thread counts into its own parse_stats, so that the scanner thread of
+ * --pipeline never shares them with the parser, and they are summed when written.
+ */
+class parse_stats
+{
+public:
+	enum
+	{
+		max_tokens = 64,
+		max_rules = 256
+	};
+
+	uint64_t tokens[max_tokens];
+	const char *token_names[max_tokens];
+	histogram token_length;
+
+	// depth of the "(" and "{" not closed yet, at each token
+	histogram depth;
+	uint64_t nesting;
+
+	uint64_t blank_bytes;
+	uint64_t lines;
+
+	uint64_t reductions[max_rules];
+
+	parse_stats();
+
+	/* counts a token of the kind called name, of length bytes */
+	void token(int kind, const char *name, std::size_t length);
+
+	void open();
+	void close();
+
+	/* counts a reduction by rule, numbered as by Bison's parser, from 1 */
+	void reduce(int rule);
+
+	/* returns the counts of the calling thread, created on its first call */
+	static parse_stats &local();
+
+	/* writes the sum of the counts of every thread to the file denoted by fname, as
+	 * JSON. returns 0 on success, 1 otherwise. */
+	static int write(const std::string &fname);
+
+private:
+	/* adds the counts of other to these */
+	void merge(const parse_stats &other);
+};
+
+#ifdef PARSER_STATS
+# define STATS_TOKEN(kind, name, length)	parse_stats::local().token(kind, name, length)
+# define STATS_OPEN()						parse_stats::local().open()
+# define STATS_CLOSE()						parse_stats::local().close()
+# define STATS_BLANKS(length)				(parse_stats::local().blank_bytes += (length))
+# define STATS_LINES(count)					(parse_stats::local().lines += (count), STATS_BLANKS(count))
+# define STATS_REDUCE(rule)					parse_stats::local().reduce(rule)
+#else
+# define STATS_TOKEN(kind, name, length)	((void) 0)
+# define STATS_OPEN()						((void) 0)
+# define STATS_CLOSE()						((void) 0)
+# define STATS_BLANKS(length)				((void) 0)
+# define STATS_LINES(count)					((void) 0)
+# define STATS_REDUCE(rule)					((void) 0)
+#endif
+
+#endif
@@ -14,11 +14,10 @@
 class go_driver;
 }
 
-%{
+%code requires
+{
 #include "ast_node.hpp"
-
-ast_node *root = &driver.tree;
-%}
+}
 
 /* so that we have a place to store the generated AST */
 %param { go_driver& driver }
@@ -35,6 +34,39 @@ ast_node *root = &driver.tree;
 %code
 {
 #include "driver.hpp"
+#include "parse_stats.hpp"
+
+#ifdef PARSER_STATS
+/* Bison has no hook for reductions, but expands YYLLOC_DEFAULT once for each of them,
+ * on the slice of the stack reduced while yyn holds the rule, and otherwise only for
+ * the location of the error token, on an array. The location is set as Bison would. */
+template <class Slice>
+static void count_reduction(const Slice &, int rule)
+{
+	STATS_REDUCE(rule);
+}
+
+template <class Symbol, std::size_t N>
+static void count_reduction(const Symbol (&)[N], int)
+{
+}
+
+# define YYLLOC_DEFAULT(Current, Rhs, N)									\
+	do																		\
+	{																		\
+		count_reduction(Rhs, yyn);											\
+		if (N)																\
+		{																	\
+			(Current).begin = YYRHSLOC(Rhs, 1).begin;						\
+			(Current).end = YYRHSLOC(Rhs, N).end;							\
+		}																	\
+		else																\
+		{																	\
+			(Current).begin = (Current).end = YYRHSLOC(Rhs, 0).end;		\
+		}																	\
+	}																		\
+	while (false)
+#endif
 }
 
 %define api.token.prefix {TOK_}
@@ -45,43 +77,71 @@ ast_node *root = &driver.tree;
 	PACKAGE		"package"
 	FUNC		"func"
 	VAR			"var"
+	RETURN		"return"
+	IF			"if"
+	ELSE		"else"
+	FOR			"for"
+	SWITCH		"switch"
+	CASE		"case"
+	DEFAULT		"default"
+	BREAK		"break"
+	CONTINUE	"continue"
 	LPAREN		"("
 	RPAREN		")"
 	LBRACE		"{"
 	RBRACE		"}"
+	LBRACKET	"["
+	RBRACKET	"]"
 	COMMA		","
 	EQUAL		"="
 	PLUS		"+"
 	MINUS		"-"
 	MUL			"*"
 	DIV			"/"
+	EQ			"=="
+	NE			"!="
+	LT			"<"
+	LE			"<="
+	GT			">"
+	GE			">="
+	SEMICOLON	";"
+	COLON		":"
 ;
 
 %token <std::string>
 	IDENTIFIER
+;
+
+%token <uint32_t>
 	STRINGLITERAL
-	INTEGERLITERAL
 ;
 
-%type <ast_root> 		program;
-%type <ast_ident> 		ident;
-%type <ast_str_lit> 	str_lit;
-%type <ast_int_lit> 	int_lit;
-%type <ast_block> 		block;
-%type <ast_stmt> 		stmts stmt var_decl func_decl;
-%type <ast_expr> 		expr func_call_args
-%type <ast_pkg_decl>	pkg_decl
-%type <ast_imp_decl>	imp_decls imp_decl
-%type <ast_imp_spec>	imp_specs imp_spec
-%type <ast_func_sig>	func_sig
-%type <ast_var_decl>	var_spec func_decl_args func_decl_arg
-%type <std::string>		binary_op
+%token <int_literal>
+	INTEGERLITERAL
 ;
 
+%type <ast_ident *>		ident var_type;
+%type <ast_str_lit *>	str_lit;
+%type <ast_int_lit *>	int_lit;
+%type <ast_block *>		block;
+%type <ast_stmt *>		stmts stmt var_decl func_decl return_stmt if_stmt for_stmt switch_stmt;
+%type <ast_expr *>		expr opt_expr exprs func_call_args;
+%type <ast_case_clause *>	case_clauses case_clause;
+%type <ast_pkg_decl *>	pkg_decl;
+%type <ast_imp_decl *>	imp_decls imp_decl;
+%type <ast_imp_spec *>	imp_specs imp_spec;
+%type <ast_func_sig *>	func_sig;
+%type <ast_var_decl *>	var_spec func_decl_args func_decl_arg;
+
+/* "ident (" may begin a function call, or an expression statement followed by a
+ * parenthesised expression. Shifting to the function call is the desired behaviour. */
+%expect 1
+
 %left ","
 
 %right "="
 
+%left "==" "!=" "<" "<=" ">" ">="
 %left "+" "-"
 %left "*" "/"
 
@@ -91,72 +151,123 @@ ast_node *root = &driver.tree;
 
 %start program;
 
-program:		pkg_decl imp_decls stmts			{root = ast_root($1, $2, $3);}
-|				pkg_decl stmts						{root = ast_root($1, $2);};
+program:		pkg_decl imp_decls stmts			{driver.tree = driver.add(new ast_root($1, $2, $3), @$);}
+|				pkg_decl stmts						{driver.tree = driver.add(new ast_root($1, $2), @$);};
 
-stmts:			stmt stmts							{$$ = $1; $$.setNext($2);}
+stmts:			stmt stmts							{if ($1) {$$ = $1; $$->next = $2;} else {$$ = $2;}}
 |				stmt								{$$ = $1;};
 
+/* on a syntax error, tokens are discarded until the start of the next statement */
 stmt:			func_decl							{$$ = $1;}
 |				var_decl							{$$ = $1;}
-|				expr								{$$ = $1;};
-
-pkg_decl:		"package" ident						{$$ = ast_pkg_decl($2);};
-
-imp_decls:		imp_decl imp_decls					{$$ = $1; $$.setNext($2);}
+|				return_stmt							{$$ = $1;}
+|				if_stmt								{$$ = $1;}
+|				for_stmt							{$$ = $1;}
+|				switch_stmt							{$$ = $1;}
+|				"break"								{$$ = driver.add(new ast_branch(node_break), @$);}
+|				"continue"							{$$ = driver.add(new ast_branch(node_continue), @$);}
+|				expr								{$$ = $1;}
+|				error								{$$ = NULL;};
+
+pkg_decl:		"package" ident						{$$ = driver.add(new ast_pkg_decl($2), @$);}
+|				error								{$$ = NULL;};
+
+imp_decls:		imp_decl imp_decls					{if ($1) {$$ = $1; $$->next = $2;} else {$$ = $2;}}
 |				imp_decl							{$$ = $1;};
 
-imp_decl:		"import" imp_spec					{$$ = $2;}
-|				"import" "(" imp_specs ")"			{$$ = ast_imp_decl($3);};
+imp_decl:		"import" imp_spec					{$$ = driver.add(new ast_imp_decl($2), @$);}
+|				"import" "(" imp_specs ")"			{$$ = driver.add(new ast_imp_decl($3), @$);}
+|				"import" error						{$$ = NULL;};
 
-imp_specs:		imp_spec imp_specs					{$$ = $1; $$.setNext($2);}
+imp_specs:		imp_spec imp_specs					{$$ = $1; $$->next = $2;}
 |				imp_spec							{$$ = $1;};
 
-imp_spec:		str_lit								{$$ = ast_imp_spec($1);}
-|				ident str_lit						{$$ = ast_imp_spec($1, $2);};
+imp_spec:		str_lit								{$$ = driver.add(new ast_imp_spec($1), @$);}
+|				ident str_lit						{$$ = driver.add(new ast_imp_spec($1, $2), @$);};
 
-func_decl:		"func" ident func_sig block			{$$ = ast_func_decl($2, $3, $4);};
+func_decl:		"func" ident func_sig block			{$$ = driver.add(new ast_func_decl($2, $3, $4), @$);};
 
-func_sig:		"(" func_decl_args ")" ident		{$$ = ast_func_sig($2, $4);}
-|				"(" func_decl_args ")"				{$$ = ast_func_sig($2);}
-|				"(" ")" ident						{$$ = ast_func_sig($3);}
-|				"(" ")"								{$$ = ast_func_sig();};
+func_sig:		"(" func_decl_args ")" var_type		{$$ = driver.add(new ast_func_sig($2, $4), @$);}
+|				"(" func_decl_args ")"				{$$ = driver.add(new ast_func_sig($2), @$);}
+|				"(" ")" var_type					{$$ = driver.add(new ast_func_sig($3), @$);}
+|				"(" ")"								{$$ = driver.add(new ast_func_sig(), @$);};
 
-block:			"{" stmts "}"						{$$ = ast_block($2);}
-|				"{" "}"								{$$ = ast_block();};
+block:			"{" stmts "}"						{$$ = driver.add(new ast_block($2), @$);}
+|				"{" "}"								{$$ = driver.add(new ast_block(), @$);};
 
-func_decl_args:	func_decl_arg "," func_decl_args	{$$ = $1; $$.setNext($3);}
+func_decl_args:	func_decl_arg "," func_decl_args	{$$ = $1; $$->next = $3;}
 |				func_decl_arg						{$$ = $1;};
 
-func_decl_arg:	ident ident							{$$ = ast_var_decl($1, $2);};
+func_decl_arg:	ident var_type						{$$ = driver.add(new ast_var_decl($1, $2), @$);};
 
-func_call_args:	expr "," func_call_args				{$$ = $1; $$.setNext($3);}
+func_call_args:	expr "," func_call_args				{$$ = $1; $$->next = $3;}
 |				expr								{$$ = $1;};
 
-var_decl:		"var" var_spec						{$$ = $2};
+var_decl:		"var" var_spec						{$$ = $2;};
 
-var_spec:		ident ident							{$$ = ast_var_decl($1, $2);}
-|				ident "=" expr						{$$ = ast_var_decl($1, $3);}
-|				ident ident "=" expr				{$$ = ast_var_decl($1, $2, $4);};
+return_stmt:	"return" expr						{$$ = driver.add(new ast_return($2), @$);};
 
-expr:			ident "=" expr						{$$ = ast_var_assign($1, $3);}
-|				ident "(" func_call_args ")"		{$$ = ast_func_call($1, $3);}
-|				ident "(" ")"						{$$ = ast_func_call($1);}
-|				ident								{$$ = $1;}
-|				int_lit								{$$ = $1;}
-|				"(" expr ")"						{$$ = $2;}
-|				expr binary_op expr					{$$ = ast_operation($1, $2, $3)};
+/* an else branch that is another if statement is held in a block of its own */
+if_stmt:		"if" expr block						{$$ = driver.add(new ast_if($2, $3, NULL), @$);}
+|				"if" expr block "else" block		{$$ = driver.add(new ast_if($2, $3, $5), @$);}
+|				"if" expr block "else" if_stmt		{$$ = driver.add(new ast_if($2, $3, driver.add(new ast_block($5), @5)), @$);};
+
+for_stmt:		"for" block							{$$ = driver.add(new ast_for(NULL, NULL, NULL, $2), @$);}
+|				"for" expr block					{$$ = driver.add(new ast_for(NULL, $2, NULL, $3), @$);}
+|				"for" opt_expr ";" opt_expr ";" opt_expr block	{$$ = driver.add(new ast_for($2, $4, $6, $7), @$);};
+
+opt_expr:		%empty								{$$ = NULL;}
+|				expr								{$$ = $1;};
 
-binary_op:		"+"									{$$ = "+";}
-|				"-"									{$$ = "-";}
-|				"*"									{$$ = "*";}
-|				"/"									{$$ = "/";};
+switch_stmt:	"switch" expr "{" case_clauses "}"	{$$ = driver.add(new ast_switch($2, $4), @$);}
+|				"switch" expr "{" "}"				{$$ = driver.add(new ast_switch($2, NULL), @$);}
+|				"switch" "{" case_clauses "}"		{$$ = driver.add(new ast_switch(NULL, $3), @$);}
+|				"switch" "{" "}"					{$$ = driver.add(new ast_switch(NULL, NULL), @$);};
 
-ident:			IDENTIFIER							{$$ = ast_ident($1);};
+case_clauses:	case_clause case_clauses			{$$ = $1; $$->next = $2;}
+|				case_clause							{$$ = $1;};
 
-str_lit:		STRINGLITERAL						{$$ = ast_str_lit($1);};
+case_clause:	"case" exprs ":" stmts				{$$ = driver.add(new ast_case_clause($2, $4), @$);}
+|				"case" exprs ":"					{$$ = driver.add(new ast_case_clause($2, NULL), @$);}
+|				"default" ":" stmts					{$$ = driver.add(new ast_case_clause(NULL, $3), @$);}
+|				"default" ":"						{$$ = driver.add(new ast_case_clause(NULL, NULL), @$);};
 
-int_lit:		INTEGERLITERAL						{$$ = ast_int_lit($1);};
+exprs:			expr "," exprs						{$$ = $1; $$->next = $3;}
+|				expr								{$$ = $1;};
+
+var_spec:		ident var_type						{$$ = driver.add(new ast_var_decl($1, $2), @$);}
+|				ident "=" expr						{$$ = driver.add(new ast_var_decl($1, $3), @$);}
+|				ident var_type "=" expr				{$$ = driver.add(new ast_var_decl($1, $2, $4), @$);};
+
+var_type:		ident								{$$ = $1;}
+|				"[" int_lit "]" ident				{$$ = driver.add(new ast_array_type($2, $4->name), @$);}
+|				"[" "]" ident						{$$ = driver.add(new ast_array_type($3->name), @$);};
+
+expr:			ident "=" expr						{$$ = driver.add(new ast_var_assign($1, $3), @$);}
+|				ident "(" func_call_args ")"		{$$ = driver.add(new ast_func_call($1, $3), @$);}
+|				ident "(" ")"						{$$ = driver.add(new ast_func_call($1), @$);}
+|				ident "[" expr "]" "=" expr			{$$ = driver.add(new ast_index_assign($1, $3, $6), @$);}
+|				ident "[" expr "]"					{$$ = driver.add(new ast_index($1, $3), @$);}
+|				ident "[" opt_expr ":" opt_expr "]"	{$$ = driver.add(new ast_slice_expr($1, $3, $5), @$);}
+|				ident								{$$ = $1;}
+|				int_lit								{$$ = $1;}
+|				"(" expr ")"						{$$ = $2;}
+|				expr "+" expr						{$$ = driver.add(new ast_operation($1, "+", $3), @$);}
+|				expr "-" expr						{$$ = driver.add(new ast_operation($1, "-", $3), @$);}
+|				expr "*" expr						{$$ = driver.add(new ast_operation($1, "*", $3), @$);}
+|				expr "/" expr						{$$ = driver.add(new ast_operation($1, "/", $3), @$);}
+|				expr "==" expr						{$$ = driver.add(new ast_operation($1, "==", $3), @$);}
+|				expr "!=" expr						{$$ = driver.add(new ast_operation($1, "!=", $3), @$);}
+|				expr "<" expr						{$$ = driver.add(new ast_operation($1, "<", $3), @$);}
+|				expr "<=" expr						{$$ = driver.add(new ast_operation($1, "<=", $3), @$);}
+|				expr ">" expr						{$$ = driver.add(new ast_operation($1, ">", $3), @$);}
+|				expr ">=" expr						{$$ = driver.add(new ast_operation($1, ">=", $3), @$);};
+
+ident:			IDENTIFIER							{$$ = driver.add(new ast_ident($1), @$);};
+
+str_lit:		STRINGLITERAL						{$$ = driver.add(new ast_str_lit($1), @$);};
+
+int_lit:		INTEGERLITERAL						{$$ = driver.add(new ast_int_lit($1), @$);};
 
 %%
 
@@ -0,0 +1,329 @@
+#include "runtime.hpp"
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "stack_map.hpp"
+
+/* size of the nursery of each thread in KiB, unless RT_NURSERY_KB says otherwise */
+#define NURSERY_KB			256
+
+/* arrays larger than this fraction of the nursery are allocated in the old generation */
+#define LARGE_FRACTION		4
+
+/* a range of memory where objects are bump-allocated, from start to top */
+struct space
+{
+	char *start;
+	char *top;
+	char *end;
+};
+
+/* a frame slot or global holding a reference, and the reference it held when found */
+struct root
+{
+	uintptr_t *slot;
+	uintptr_t value;
+};
+
+/* the heap of a thread, and the roots found by its last collection */
+struct rt_heap
+{
+	struct space nursery;
+	struct space old;
+
+	struct root *roots;
+	size_t num_roots;
+	size_t max_roots;
+
+	struct rt_stats stats;
+};
+
+extern "C"
+{
+	// the addresses of the global slices of every compiled file, absent if there are none
+	extern uintptr_t *__start_gc_roots[] __attribute__((weak));
+	extern uintptr_t *__stop_gc_roots[] __attribute__((weak));
+}
+
+static __thread rt_heap *current_heap = NULL;
+
+static pthread_once_t heap_key_once = PTHREAD_ONCE_INIT;
+static pthread_key_t heap_key;
+
+static void fail(const char *message)
+{
+	fprintf(stderr, "runtime: %s\n", message);
+	abort();
+}
+
+static void *checked_malloc(size_t size)
+{
+	void *p = malloc(size);
+	if (!p)
+	{
+		fail("out of memory");
+	}
+	return p;
+}
+
+/* frees the heap of a thread as it exits */
+static void free_heap(void *p)
+{
+	rt_heap *heap = (rt_heap *) p;
+	free(heap->nursery.start);
+	free(heap->old.start);
+	free(heap->roots);
+	free(heap);
+}
+
+static void create_heap_key()
+{
+	pthread_key_create(&heap_key, free_heap);
+}
+
+/* returns the heap of the calling thread, created on first use */
+static rt_heap *get_heap()
+{
+	if (current_heap)
+	{
+		return current_heap;
+	}
+
+	pthread_once(&heap_key_once, create_heap_key);
+	rt_heap *heap = (rt_heap *) checked_malloc(sizeof(rt_heap));
+	memset(heap, 0, sizeof(rt_heap));
+
+	const char *kb = getenv("RT_NURSERY_KB");
+	size_t size = (kb && atol(kb) > 0 ? atol(kb) : NURSERY_KB) * (size_t) 1024;
+	heap->nursery.start = heap->nursery.top = (char *) checked_malloc(size);
+	heap->nursery.end = heap->nursery.start + size;
+
+	pthread_setspecific(heap_key, heap);
+	current_heap = heap;
+	return heap;
+}
+
+static uint64_t now_ns()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * (uint64_t) 1000000000 + ts.tv_nsec;
+}
+
+/* size in bytes of the object at obj, its length word included */
+static size_t object_size(const char *obj)
+{
+	return 8 * (1 + *(const int64_t *) obj);
+}
+
+static void add_root(rt_heap *heap, uintptr_t *slot)
+{
+	if (heap->num_roots == heap->max_roots)
+	{
+		heap->max_roots = heap->max_roots ? 2 * heap->max_roots : 64;
+		heap->roots = (root *) realloc(heap->roots, heap->max_roots * sizeof(root));
+		if (!heap->roots)
+		{
+			fail("out of memory");
+		}
+	}
+	heap->roots[heap->num_roots].slot = slot;
+	heap->roots[heap->num_roots].value = *slot;
+	heap->num_roots++;
+}
+
+/* returns the stack map of the call that returns to ret, or NULL if ret is not in
+ * compiled code */
+static const int32_t *stack_map(const unsigned char *ret)
+{
+	if (memcmp(ret, STACK_MAP_NOP, STACK_MAP_NOP_SIZE))
+	{
+		return NULL;
+	}
+	int32_t disp;
+	memcpy(&disp, ret + STACK_MAP_NOP_SIZE, sizeof(disp));
+	const int32_t *map = (const int32_t *) (ret + disp);
+	return map[0] == STACK_MAP_MAGIC ? map : NULL;
+}
+
+/* Adds the references held by the frames of compiled code, following the chain of saved
+ * rbp from fp, the frame of the runtime function called by compiled code, up to the
+ * first frame returning to other code */
+static void stack_roots(rt_heap *heap, uintptr_t *fp)
+{
+	for (;;)
+	{
+		const int32_t *map = stack_map((const unsigned char *) fp[1]);
+		if (!map)
+		{
+			break;
+		}
+		uintptr_t *caller = (uintptr_t *) fp[0];
+		for (int32_t i = 0; i != map[1]; i++)
+		{
+			add_root(heap, (uintptr_t *) ((char *) caller + map[2 + i]));
+		}
+		fp = caller;
+	}
+}
+
+static int compare_roots(const void *a, const void *b)
+{
+	uintptr_t x = ((const root *) a)->value, y = ((const root *) b)->value;
+	return x < y ? -1 : x > y;
+}
+
+/* Copies the objects of from that the roots point into to the top of to, and makes the
+ * roots point into the copies. The roots are sorted by address, so a single walk over
+ * the objects finds the one each points into, at most one past its end. */
+static void evacuate(rt_heap *heap, const space &from, space &to)
+{
+	root *roots = (root *) checked_malloc((heap->num_roots + 1) * sizeof(root));
+	size_t count = 0;
+
+	for (size_t r = 0; r != heap->num_roots; r++)
+	{
+		uintptr_t value = heap->roots[r].value;
+		if (value > (uintptr_t) from.start && value <= (uintptr_t) from.top)
+		{
+			roots[count++] = heap->roots[r];
+		}
+	}
+	qsort(roots, count, sizeof(root), compare_roots);
+
+	char *obj = from.start;
+	char *copied = NULL;
+	char *copy = NULL;
+	for (size_t r = 0; r != count; r++)
+	{
+		while ((uintptr_t) obj + object_size(obj) < roots[r].value)
+		{
+			obj += object_size(obj);
+		}
+		if (obj != copied)
+		{
+			size_t size = object_size(obj);
+			memcpy(to.top, obj, size);
+			copy = to.top;
+			copied = obj;
+			to.top += size;
+			heap->stats.promoted_bytes += size;
+		}
+		*roots[r].slot = (uintptr_t) copy + (roots[r].value - (uintptr_t) obj);
+	}
+	free(roots);
+}
+
+/* Collects the nursery into the old generation or, if major is set or there may not be
+ * room for it there, both generations into a new old generation with room for extra
+ * bytes more. fp is the frame of the runtime function called by compiled code. */
+static void collect(rt_heap *heap, uintptr_t *fp, int major, size_t extra)
+{
+	uint64_t start = now_ns();
+	size_t nursery_used = heap->nursery.top - heap->nursery.start;
+	size_t old_used = heap->old.top - heap->old.start;
+
+	heap->num_roots = 0;
+	stack_roots(heap, fp);
+	for (uintptr_t **global = __start_gc_roots; global != __stop_gc_roots; global++)
+	{
+		add_root(heap, *global);
+	}
+
+	if (major || (size_t) (heap->old.end - heap->old.top) < nursery_used + extra)
+	{
+		// room for everything to survive, and as much again
+		size_t size = 2 * (old_used + nursery_used + extra) + (heap->nursery.end - heap->nursery.start);
+		space to;
+		to.start = to.top = (char *) checked_malloc(size);
+		to.end = to.start + size;
+		evacuate(heap, heap->old, to);
+		evacuate(heap, heap->nursery, to);
+		free(heap->old.start);
+		heap->old = to;
+		heap->stats.major_collections++;
+	}
+	else
+	{
+		evacuate(heap, heap->nursery, heap->old);
+		heap->stats.minor_collections++;
+	}
+	heap->nursery.top = heap->nursery.start;
+
+	uint64_t pause = now_ns() - start;
+	heap->stats.total_pause_ns += pause;
+	if (pause > heap->stats.max_pause_ns)
+	{
+		heap->stats.max_pause_ns = pause;
+	}
+}
+
+/* allocates size bytes from the nursery, or from the old generation for large objects,
+ * after collecting if there is no room */
+static __attribute__((noinline)) char *allocate_slow(rt_heap *heap, uintptr_t *fp, size_t size)
+{
+	if (size > (size_t) (heap->nursery.end - heap->nursery.start) / LARGE_FRACTION)
+	{
+		if ((size_t) (heap->old.end - heap->old.top) < size)
+		{
+			collect(heap, fp, 1, size);
+		}
+		char *obj = heap->old.top;
+		heap->old.top += size;
+		return obj;
+	}
+
+	collect(heap, fp, 0, 0);
+	char *obj = heap->nursery.top;
+	heap->nursery.top += size;
+	return obj;
+}
+
+int64_t *rt_alloc(int64_t words)
+{
+	if (words < 0 || words > (int64_t) (SIZE_MAX / 16))
+	{
+		fail("invalid array length");
+	}
+
+	rt_heap *heap = get_heap();
+	size_t size = 8 * (words + 1);
+	char *obj = heap->nursery.top;
+	if ((size_t) (heap->nursery.end - obj) >= size)
+	{
+		heap->nursery.top += size;
+	}
+	else
+	{
+		obj = allocate_slow(heap, (uintptr_t *) __builtin_frame_address(0), size);
+	}
+	heap->stats.allocated_bytes += size;
+
+	*(int64_t *) obj = words;
+	memset(obj + 8, 0, size - 8);
+	return (int64_t *) (obj + 8);
+}
+
+void rt_collect(void)
+{
+	collect(get_heap(), (uintptr_t *) __builtin_frame_address(0), 1, 0);
+}
+
+void rt_get_stats(struct rt_stats *stats)
+{
+	*stats = get_heap()->stats;
+}
+
+void rt_print_stats(FILE *out)
+{
+	const rt_stats &stats = get_heap()->stats;
+	fprintf(out, "allocated: %llu bytes, promoted: %llu bytes\n",
+		(unsigned long long) stats.allocated_bytes, (unsigned long long) stats.promoted_bytes);
+	fprintf(out, "collections: %llu minor, %llu major\n",
+		(unsigned long long) stats.minor_collections, (unsigned long long) stats.major_collections);
+	fprintf(out, "pauses: %.3f ms total, %.3f ms max\n",
+		stats.total_pause_ns / 1e6, stats.max_pause_ns / 1e6);
+}
@@ -0,0 +1,60 @@
+#ifndef RUNTIME_HPP
+#define RUNTIME_HPP
+
+#include <stdint.h>
+#include <stdio.h>
+
+/* Runtime library linked into the programs built with --build, also usable from C.
+ *
+ * The arrays that escape their function are allocated on a garbage-collected heap, one
+ * for each thread. New arrays are bump-allocated in a nursery, and those still referred
+ * to when it is full are copied to the old generation by a minor collection. When the
+ * old generation has no room left for them, a major collection copies what is still
+ * referred to in both generations to a new one, twice as large as that.
+ *
+ * References are found through the stack maps of the frames of compiled code, see
+ * stack_map.hpp, and the gc_roots section listing the global slices. Arrays hold no
+ * references, so the old generation never refers to the nursery and minor collections
+ * need no write barrier. A reference may point anywhere inside its array or just past
+ * its end: every array is preceded by a word holding its length, which keeps the end of
+ * one array from being the start of the next.
+ *
+ * C code must not keep references across calls to compiled code or to the runtime, and
+ * slices must not be shared between threads.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* counters of the heap of a thread */
+struct rt_stats
+{
+	uint64_t allocated_bytes;
+	uint64_t promoted_bytes;
+	uint64_t minor_collections;
+	uint64_t major_collections;
+
+	// time the collections stopped the thread for, in nanoseconds
+	uint64_t total_pause_ns;
+	uint64_t max_pause_ns;
+};
+
+/* returns the address of words zeroed 8-byte words on the heap of the calling thread,
+ * called by compiled code to allocate the arrays that escape */
+int64_t *rt_alloc(int64_t words);
+
+/* collects both generations of the heap of the calling thread */
+void rt_collect(void);
+
+/* copies the counters of the heap of the calling thread to stats */
+void rt_get_stats(struct rt_stats *stats);
+
+/* prints the counters of the heap of the calling thread to out */
+void rt_print_stats(FILE *out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,25 @@
+#ifndef STACK_MAP_HPP
+#define STACK_MAP_HPP
+
+/* Stack maps, written by the code generator of x86_64.cpp and read by the garbage
+ * collector of runtime.cpp.
+ *
+ * Every call of compiled code returns to the 8-byte nop "nop dword [rax + rax + disp32]",
+ * where disp32 is the offset from the return address to the map of the call, after the
+ * code of the function. A map is made of 32-bit words: STACK_MAP_MAGIC, the number of
+ * references live across the call, then the offset from rbp of the frame slot of each.
+ * Calls with the same references share a map.
+ */
+
+/* the first bytes of the nop, followed by disp32 */
+#define STACK_MAP_NOP		"\x0f\x1f\x84\x00"
+#define STACK_MAP_NOP_SIZE	4
+
+/* "smap", which cannot be mistaken for the nop when disp32 is 0 */
+#define STACK_MAP_MAGIC		0x70616d73
+
+/* the section listing the address of every global slice, which the linker gathers
+ * between __start_gc_roots and __stop_gc_roots */
+#define GC_ROOTS_SECTION	"gc_roots"
+
+#endif
@@ -0,0 +1,37 @@
+#ifndef SHA256_HPP
+#define SHA256_HPP
+
+#include <stdint.h>
+
+#include <cstddef>
+#include <string>
+
+/* SHA-256 of a stream of bytes, as specified by FIPS 180-4. Used to name objects in
+ * the build cache after their inputs.
+ */
+class sha256
+{
+public:
+	sha256();
+
+	/* adds size bytes beginning at data to the message */
+	void update(const void *data, std::size_t size);
+
+	/* returns the digest of the message as 64 hexadecimal digits. Nothing may be
+	 * added to the message afterwards. */
+	std::string hex_digest();
+
+private:
+	uint32_t state[8];
+
+	// bytes added so far
+	uint64_t length;
+
+	// bytes of the block being filled
+	unsigned char block[64];
+
+	/* mixes a full block into the state */
+	void compress(const unsigned char *data);
+};
+
+#endif
@@ -0,0 +1,221 @@
+#include "string_pool.hpp"
+
+#include <cstring>
+
+/* returns the id of the length bytes at value, adding them if needed */
+uint32_t string_pool::add(const char *value, std::size_t length)
+{
+	std::string key(value, length);
+	std::map<std::string, uint32_t>::iterator it = ids.find(key);
+	if (it != ids.end())
+	{
+		return it->second;
+	}
+
+	offsets.push_back(buffer.size());
+	buffer.append(value, length);
+	buffer.push_back('\0');
+	ids[key] = offsets.size() - 1;
+	return offsets.size() - 1;
+}
+
+/* returns the value of the hexadecimal digit c, or -1 if it is not one */
+static int hex_digit(char c)
+{
+	if (c >= '0' && c <= '9')
+	{
+		return c - '0';
+	}
+	if (c >= 'a' && c <= 'f')
+	{
+		return c - 'a' + 10;
+	}
+	if (c >= 'A' && c <= 'F')
+	{
+		return c - 'A' + 10;
+	}
+	return -1;
+}
+
+/* appends the UTF-8 encoding of the code point c to out */
+static void append_utf8(std::string &out, uint32_t c)
+{
+	if (c < 0x80)
+	{
+		out.push_back(c);
+	}
+	else if (c < 0x800)
+	{
+		out.push_back(0xc0 | c >> 6);
+		out.push_back(0x80 | (c & 0x3f));
+	}
+	else if (c < 0x10000)
+	{
+		out.push_back(0xe0 | c >> 12);
+		out.push_back(0x80 | (c >> 6 & 0x3f));
+		out.push_back(0x80 | (c & 0x3f));
+	}
+	else
+	{
+		out.push_back(0xf0 | c >> 18);
+		out.push_back(0x80 | (c >> 12 & 0x3f));
+		out.push_back(0x80 | (c >> 6 & 0x3f));
+		out.push_back(0x80 | (c & 0x3f));
+	}
+}
+
+/* decodes the escape sequence at the backslash at p, before end, onto out.
+ * returns the length of the sequence, or 0 if it is invalid. */
+static std::size_t decode_escape(const char *p, const char *end, std::string &out)
+{
+	if (end - p < 2)
+	{
+		return 0;
+	}
+
+	switch (p[1])
+	{
+		case 'a':	out.push_back('\a');	return 2;
+		case 'b':	out.push_back('\b');	return 2;
+		case 'f':	out.push_back('\f');	return 2;
+		case 'n':	out.push_back('\n');	return 2;
+		case 'r':	out.push_back('\r');	return 2;
+		case 't':	out.push_back('\t');	return 2;
+		case 'v':	out.push_back('\v');	return 2;
+		case '\\':	out.push_back('\\');	return 2;
+		case '"':	out.push_back('"');		return 2;
+	}
+
+	// a byte given by 3 octal digits
+	if (p[1] >= '0' && p[1] <= '7')
+	{
+		unsigned int byte = 0;
+		for (int i = 1; i != 4; i++)
+		{
+			if (end - p <= i || p[i] < '0' || p[i] > '7')
+			{
+				return 0;
+			}
+			byte = byte * 8 + (p[i] - '0');
+		}
+		if (byte > 0xff)
+		{
+			return 0;
+		}
+		out.push_back(byte);
+		return 4;
+	}
+
+	// a byte given by 2 hexadecimal digits, or a code point by 4 or 8
+	std::size_t digits;
+	switch (p[1])
+	{
+		case 'x':	digits = 2;	break;
+		case 'u':	digits = 4;	break;
+		case 'U':	digits = 8;	break;
+		default:	return 0;
+	}
+	if ((std::size_t) (end - p) < 2 + digits)
+	{
+		return 0;
+	}
+	uint32_t value = 0;
+	for (std::size_t i = 0; i != digits; i++)
+	{
+		int digit = hex_digit(p[2 + i]);
+		if (digit < 0)
+		{
+			return 0;
+		}
+		value = value << 4 | digit;
+	}
+
+	if (p[1] == 'x')
+	{
+		out.push_back(value);
+	}
+	else if (value > 0x10ffff || (value >= 0xd800 && value < 0xe000))
+	{
+		// not a code point, or a surrogate half
+		return 0;
+	}
+	else
+	{
+		append_utf8(out, value);
+	}
+	return 2 + digits;
+}
+
+/* decodes the escape sequences of the quoted literal of length bytes at text, and
+ * returns the id of its value. The text between escape sequences is copied a run at
+ * a time, so a literal without any is copied whole. */
+uint32_t string_pool::add_literal(const char *text, std::size_t length, std::size_t &bad_escape)
+{
+	// leave out the quotes
+	const char *p = text + 1;
+	const char *end = text + length - 1;
+
+	bad_escape = 0;
+	const char *backslash = static_cast<const char *>(memchr(p, '\\', end - p));
+	if (!backslash)
+	{
+		return add(p, end - p);
+	}
+
+	decoded.clear();
+	while (backslash)
+	{
+		decoded.append(p, backslash);
+
+		std::size_t escape = decode_escape(backslash, end, decoded);
+		if (!escape)
+		{
+			if (!bad_escape)
+			{
+				bad_escape = backslash - text;
+			}
+			// keep the backslash and the character it escapes
+			escape = end - backslash < 2 ? 1 : 2;
+			decoded.append(backslash, escape);
+		}
+
+		p = backslash + escape;
+		backslash = static_cast<const char *>(memchr(p, '\\', end - p));
+	}
+	decoded.append(p, end);
+
+	return add(decoded.data(), decoded.size());
+}
+
+/* returns the value of the string id, followed by a NUL byte */
+const char *string_pool::data(uint32_t id) const
+{
+	return buffer.data() + offsets[id];
+}
+
+/* returns the length of the string id, not counting the NUL byte */
+std::size_t string_pool::length(uint32_t id) const
+{
+	std::size_t next = id + 1 < offsets.size() ? offsets[id + 1] : buffer.size();
+	return next - offsets[id] - 1;
+}
+
+/* returns every string, each followed by a NUL byte, in the order they were added */
+const std::string &string_pool::bytes() const
+{
+	return buffer;
+}
+
+/* returns the number of different strings */
+std::size_t string_pool::size() const
+{
+	return offsets.size();
+}
+
+/* forgets every string */
+void string_pool::clear()
+{
+	buffer.clear();
+	offsets.clear();
+	ids.clear();
+}
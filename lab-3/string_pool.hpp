@@ -0,0 +1,53 @@
+#ifndef STRING_POOL_HPP
+#define STRING_POOL_HPP
+
+#include <stdint.h>
+
+#include <cstddef>
+#include <map>
+#include <string>
+#include <vector>
+
+/* The string literals of an input, decoded once and stored once each. Every string
+ * is followed by a NUL byte in a single buffer, laid out as it would be in a
+ * read-only data section, and is referred to by its index.
+ */
+class string_pool
+{
+public:
+	/* returns the id of the length bytes at value, adding them if needed */
+	uint32_t add(const char *value, std::size_t length);
+
+	/* decodes the escape sequences of the quoted literal of length bytes at text, and
+	 * returns the id of its value. An invalid escape sequence is kept as it is, and the
+	 * offset in text of the first one is stored in bad_escape, 0 if there is none. */
+	uint32_t add_literal(const char *text, std::size_t length, std::size_t &bad_escape);
+
+	/* returns the value of the string id, followed by a NUL byte */
+	const char *data(uint32_t id) const;
+
+	/* returns the length of the string id, not counting the NUL byte */
+	std::size_t length(uint32_t id) const;
+
+	/* returns every string, each followed by a NUL byte, in the order they were added */
+	const std::string &bytes() const;
+
+	/* returns the number of different strings */
+	std::size_t size() const;
+
+	/* forgets every string */
+	void clear();
+
+private:
+	std::string buffer;
+
+	// offset of each string in buffer
+	std::vector<uint32_t> offsets;
+
+	std::map<std::string, uint32_t> ids;
+
+	// value of the literal being decoded
+	std::string decoded;
+};
+
+#endif
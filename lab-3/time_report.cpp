@@ -0,0 +1,246 @@
+#include "time_report.hpp"
+
+#include <time.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <iomanip>
+#include <new>
+
+static const char *phase_names[time_report::num_phases] =
+{
+	"read input",
+	"lex",
+	"parse and build AST",
+	"print",
+	"build IR",
+	"optimise",
+	"generate code",
+	"write object",
+	"link"
+};
+
+// bytes requested from operator new since the program started
+static uint64_t allocated_bytes;
+
+void *operator new(std::size_t size)
+{
+	void *p = malloc(size ? size : 1);
+	if (!p)
+	{
+		throw std::bad_alloc();
+	}
+	__sync_fetch_and_add(&allocated_bytes, size);
+	return p;
+}
+
+void operator delete(void *p)
+{
+	free(p);
+}
+
+void *operator new[](std::size_t size)
+{
+	return operator new(size);
+}
+
+void operator delete[](void *p)
+{
+	free(p);
+}
+
+void *operator new(std::size_t size, const std::nothrow_t &) throw()
+{
+	void *p = malloc(size ? size : 1);
+	if (p)
+	{
+		__sync_fetch_and_add(&allocated_bytes, size);
+	}
+	return p;
+}
+
+void *operator new[](std::size_t size, const std::nothrow_t &nothrow) throw()
+{
+	return operator new(size, nothrow);
+}
+
+#if __cplusplus >= 201402L
+// sized deallocation would otherwise reach the library's operator delete
+void operator delete(void *p, std::size_t)
+{
+	free(p);
+}
+
+void operator delete[](void *p, std::size_t)
+{
+	free(p);
+}
+#endif
+
+/* returns the time of the clock identified by id in milliseconds */
+static double now(clockid_t id)
+{
+	struct timespec ts;
+	clock_gettime(id, &ts);
+	return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+time_report::time_report()
+{
+	tracing = false;
+	for (int p = 0; p != num_phases; p++)
+	{
+		phases[p].wall = 0;
+		phases[p].cpu = 0;
+		phases[p].bytes = 0;
+		phases[p].entries = 0;
+	}
+	origin = last_wall = now(CLOCK_MONOTONIC);
+	last_cpu = now(CLOCK_PROCESS_CPUTIME_ID);
+	last_bytes = __sync_add_and_fetch(&allocated_bytes, 0);
+}
+
+/* charges the time and allocations since the last call to the phases on the stack */
+void time_report::charge(bool sample_cpu)
+{
+	double wall = now(CLOCK_MONOTONIC);
+	uint64_t bytes = __sync_add_and_fetch(&allocated_bytes, 0);
+
+	if (!stack.empty())
+	{
+		phases[stack.back()].wall += wall - last_wall;
+		phases[stack.back()].bytes += bytes - last_bytes;
+	}
+	last_wall = wall;
+	last_bytes = bytes;
+
+	if (!sample_cpu)
+	{
+		return;
+	}
+
+	// the CPU time of lexing goes to the phase it was entered from
+	double cpu = now(CLOCK_PROCESS_CPUTIME_ID);
+	for (std::vector<phase>::size_type s = stack.size(); s-- > 0;)
+	{
+		if (stack[s] != phase_lex)
+		{
+			phases[stack[s]].cpu += cpu - last_cpu;
+			break;
+		}
+	}
+	last_cpu = cpu;
+}
+
+/* counts time against p until the matching call to leave */
+void time_report::enter(phase p)
+{
+	charge(p != phase_lex);
+	stack.push_back(p);
+	entered.push_back(last_wall);
+	phases[p].entries++;
+}
+
+void time_report::leave()
+{
+	phase p = stack.back();
+
+	charge(p != phase_lex);
+	if (tracing && p != phase_lex)
+	{
+		trace_event event = {p, file, (entered.back() - origin) * 1e3, (last_wall - entered.back()) * 1e3};
+		events.push_back(event);
+	}
+	stack.pop_back();
+	entered.pop_back();
+}
+
+/* prints the time spent in each phase as a table */
+void time_report::print(std::ostream &out)
+{
+	totals total = {0, 0, 0, 0};
+	std::ios::fmtflags flags = out.flags();
+	std::streamsize precision = out.precision();
+
+	out << std::left << std::setw(24) << "phase" << std::right
+		<< std::setw(12) << "wall (ms)" << std::setw(12) << "cpu (ms)"
+		<< std::setw(16) << "allocated (B)" << std::setw(10) << "entries" << std::endl;
+	out << std::fixed << std::setprecision(3);
+
+	for (int p = 0; p != num_phases; p++)
+	{
+		if (!phases[p].entries)
+		{
+			continue;
+		}
+		out << std::left << std::setw(24) << phase_names[p] << std::right
+			<< std::setw(12) << phases[p].wall;
+		if (p == phase_lex)
+		{
+			out << std::setw(12) << "-";
+		}
+		else
+		{
+			out << std::setw(12) << phases[p].cpu;
+		}
+		out << std::setw(16) << phases[p].bytes << std::setw(10) << phases[p].entries << std::endl;
+
+		total.wall += phases[p].wall;
+		total.cpu += phases[p].cpu;
+		total.bytes += phases[p].bytes;
+	}
+
+	out << std::left << std::setw(24) << "total" << std::right
+		<< std::setw(12) << total.wall << std::setw(12) << total.cpu
+		<< std::setw(16) << total.bytes << std::endl;
+
+	out.flags(flags);
+	out.precision(precision);
+}
+
+/* writes str as a JSON string */
+static void write_json_string(FILE *out, const std::string &str)
+{
+	fputc('"', out);
+	for (std::string::size_type i = 0; i != str.size(); i++)
+	{
+		unsigned char c = str[i];
+		if (c == '"' || c == '\\')
+		{
+			fprintf(out, "\\%c", c);
+		}
+		else if (c < 0x20)
+		{
+			fprintf(out, "\\u%04x", c);
+		}
+		else
+		{
+			fputc(c, out);
+		}
+	}
+	fputc('"', out);
+}
+
+/* writes the recorded trace events to the file denoted by fname, in the trace event
+ * format read by chrome://tracing and Perfetto. returns 0 on success, 1 otherwise. */
+int time_report::write_trace(const std::string &fname) const
+{
+	FILE *out = fopen(fname.c_str(), "w");
+	if (!out)
+	{
+		return 1;
+	}
+
+	fprintf(out, "{\"traceEvents\":[");
+	for (std::vector<trace_event>::size_type e = 0; e != events.size(); e++)
+	{
+		fprintf(out, "%s\n{\"name\":\"%s\",\"cat\":\"phase\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,"
+			"\"pid\":1,\"tid\":1,\"args\":{\"file\":", e ? "," : "", phase_names[events[e].p],
+			events[e].start, events[e].duration);
+		write_json_string(out, events[e].file);
+		fprintf(out, "}}");
+	}
+	fprintf(out, "\n],\"displayTimeUnit\":\"ms\"}\n");
+
+	return fclose(out) ? 1 : 0;
+}
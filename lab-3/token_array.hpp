@@ -0,0 +1,62 @@
+#ifndef TOKEN_ARRAY_HPP
+#define TOKEN_ARRAY_HPP
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include "diagnostics.hpp"
+
+/* kind of the tokens standing for lexical errors, replayed as their message */
+#define TOKEN_ERROR_KIND	0xff
+
+/* a token as the parser sees it: its symbol kind, and where its text is in the input */
+struct packed_token
+{
+	uint8_t kind;
+	uint32_t offset;
+	uint32_t length;
+} __attribute__((packed));
+
+/* The tokens of a whole input, scanned ahead of parsing by go_driver::scan_tokens,
+ * and parsed by go_driver::parse_tokens. Only the kind and position of each token
+ * are kept: its text and location are found again from the source.
+ */
+class token_array
+{
+public:
+	// name of the input, used in diagnostics
+	std::string file;
+
+	// text of the input
+	std::string source;
+
+	// tokens in the order they were scanned, ending with the end of input
+	std::vector<packed_token> tokens;
+
+	// message of each lexical error, a diag_message, in the order they were found
+	std::vector<uint8_t> messages;
+
+	/* exchanges the contents of the array with those of other */
+	void swap(token_array &other);
+
+	/* reads the input denoted by fname, "-" for stdin, into source.
+	 * returns 0 on success, or the errno of the failure. */
+	int read_source(const std::string &fname);
+
+	/* writes the array to the file denoted by fname, in host byte order.
+	 * returns 0 on success, 1 otherwise with errno set. */
+	int write(const std::string &fname) const;
+
+	/* reads an array written by write from the file denoted by fname.
+	 * returns 0 on success, 1 if the file could not be read or is not a token file. */
+	int read(const std::string &fname);
+
+private:
+	/* returns 1 if the tokens follow each other within the source, with a known message
+	 * for every error and the end of input last, 0 otherwise */
+	int valid() const;
+};
+
+#endif
@@ -0,0 +1,1075 @@
+#include "x86_64.hpp"
+
+#include <elf.h>
+
+#include <algorithm>
+#include <map>
+
+#include "linear_scan.hpp"
+#include "runtime/stack_map.hpp"
+
+/* register numbers as encoded in instructions */
+enum
+{
+	rax, rcx, rdx, rbx, rsp, rbp, rsi, rdi,
+	r8, r9, r10, r11, r12, r13, r14, r15
+};
+
+/* rax, rdx and r11 are never allocated, they hold intermediate results */
+static const int caller_saved[] = {rcx, rsi, rdi, r8, r9, r10};
+static const int callee_saved[] = {rbx, r12, r13, r14, r15};
+
+#define NUM_REG_ARGS	6
+static const int arg_regs[NUM_REG_ARGS] = {rdi, rsi, rdx, rcx, r8, r9};
+
+/* opcodes of the two-operand instructions "op reg, r/m" used for arithmetic */
+#define OP_ADD		0x03
+#define OP_SUB		0x2b
+#define OP_IMUL		0xaf0f		// two bytes, emitted low byte first
+#define OP_MOV_LOAD	0x8b
+#define OP_MOV_STORE	0x89
+#define OP_CMP		0x3b
+#define OP_LEA		0x8d
+
+/* condition codes, the low nibble of jcc and setcc. Flipping the lowest bit negates them */
+#define CC_E		0x4
+#define CC_NE		0x5
+#define CC_L		0xc
+#define CC_GE		0xd
+#define CC_LE		0xe
+#define CC_G		0xf
+
+/* returns the condition under which the comparison op is true */
+static int condition_code(ir_opcode op)
+{
+	switch (op)
+	{
+		case ir_eq:	return CC_E;
+		case ir_ne:	return CC_NE;
+		case ir_lt:	return CC_L;
+		case ir_le:	return CC_LE;
+		case ir_gt:	return CC_G;
+		case ir_ge:	return CC_GE;
+		default:	return -1;
+	}
+}
+
+/* a jump table, emitted after the code of its function: the lea loading its address, and
+ * where each entry jumps, a block or, for edges that set phis, the code doing so */
+struct x86_64_table
+{
+	uint32_t lea;
+	std::vector<uint32_t> targets;
+	std::vector<bool> is_block;
+};
+
+/* Emits the code of one function */
+class x86_64_emitter
+{
+public:
+	x86_64_emitter(const ir_module &module, const ir_function &func, elf_object &obj, std::ostream *report);
+
+	void emit_function();
+
+private:
+	const ir_module &module;
+	const ir_function &func;
+	elf_object &obj;
+	std::vector<unsigned char> &code;
+	ls_allocation alloc;
+	std::ostream *report;
+
+	// start of each block in the code, and the jumps to patch once they are all known
+	std::vector<uint32_t> block_offsets;
+	std::vector<std::pair<uint32_t, uint32_t> > jumps;
+	std::vector<x86_64_table> tables;
+
+	// displacements of the jumps taken when an index is out of range
+	std::vector<uint32_t> traps;
+
+	// number of calls emitted so far, and the displacement in the nop after each call
+	// with the index of the call
+	uint32_t calls;
+	std::vector<std::pair<uint32_t, uint32_t> > maps;
+
+	// number of operands referring to each value
+	std::vector<uint32_t> uses;
+
+	// frame offsets of the saved callee-saved registers, the parameters, the spill slots
+	// and the local arrays
+	std::vector<int32_t> save_offsets;
+	std::vector<int32_t> param_offsets;
+	int32_t slots_base;
+	int32_t arrays_base;
+	int32_t frame_size;
+
+	void byte(unsigned int b);
+	void imm32(int32_t v);
+	void imm64(int64_t v);
+
+	/* REX.W prefix for an instruction with reg in ModRM.reg and rm in ModRM.rm */
+	void rex(int reg, int rm);
+
+	/* "op reg, rm" between two registers, and between a register and [rbp + disp] */
+	void op_reg(unsigned int opcode, int reg, int rm);
+	void op_frame(unsigned int opcode, int reg, int32_t disp);
+
+	/* "op reg, [rip + symbol]", leaving a PC-relative relocation */
+	void op_global(unsigned int opcode, int reg, uint32_t symbol);
+
+	void mov_imm(int reg, int64_t imm);
+
+	/* frame offset of a spill slot, and of a spilled value */
+	int32_t frame_offset(int slot) const;
+	int32_t slot_offset(ir_value v) const;
+
+	/* copies the value v to reg, and reg to the location of v */
+	void load(int reg, ir_value v);
+	void store(ir_value v, int reg);
+
+	/* copies src to dst, through r11 if both are in memory */
+	void move(const ls_location &dst, const ls_location &src);
+
+	/* copies every source to its destination as if all at once, in an order that reads each
+	 * source before overwriting it. Cycles are broken through rax. */
+	void parallel_move(std::vector<ls_location> dsts, std::vector<ls_location> srcs);
+
+	/* moves the first six operands of call to the argument registers */
+	void move_args(const ir_inst &call);
+
+	/* sets the phis of block target to their operands coming from block b */
+	void move_phis(uint32_t b, uint32_t target);
+
+	void emit_prologue();
+	void emit_epilogue();
+	void emit_inst(uint32_t b, const ir_inst &inst);
+	void emit_call(const ir_inst &inst);
+	void emit_tail_call(const ir_inst &inst);
+	void emit_jump(uint32_t b, uint32_t target);
+
+	/* returns 1 if the edge from a block to target must set phis */
+	int has_phis(uint32_t target) const;
+
+	/* "jcc rel32" to block target, or to the code offset patched later if target is -1.
+	 * returns the offset of the displacement. */
+	uint32_t jcc(int cc, int64_t target);
+
+	/* sets the displacement of the jump at patch to reach the end of the code */
+	void patch_here(uint32_t patch);
+
+	/* compares the operands of inst, and returns the condition under which it is true */
+	int emit_compare(const ir_inst &inst);
+
+	/* ends block b with a jump to its first successor under the condition cc, and to its
+	 * second otherwise */
+	void emit_branch(uint32_t b, int cc);
+	void emit_switch(uint32_t b, const ir_inst &inst);
+	void emit_tables();
+
+	/* sets the words of an array to 0, and checks an index against a length */
+	void emit_zero(const ir_inst &inst);
+	void emit_check(const ir_inst &inst);
+	void emit_traps();
+
+	/* emits the stack maps of the calls after the code of the function */
+	void emit_stack_maps();
+};
+
+x86_64_emitter::x86_64_emitter(const ir_module &module, const ir_function &func, elf_object &obj, std::ostream *report)
+	: module(module), func(func), obj(obj), code(obj.text), report(report)
+{
+	ls_registers regs;
+	regs.caller_saved.assign(caller_saved, caller_saved + sizeof(caller_saved) / sizeof(*caller_saved));
+	regs.callee_saved.assign(callee_saved, callee_saved + sizeof(callee_saved) / sizeof(*callee_saved));
+	alloc = linear_scan(func, regs, ir_references(module, func));
+	calls = 0;
+
+	// [rbp] holds the caller's rbp, below it are the saved registers, parameters and spills
+	int32_t offset = 0;
+	for (std::vector<int>::size_type r = 0; r != alloc.used_callee_saved.size(); r++)
+	{
+		save_offsets.push_back(offset -= 8);
+	}
+	for (uint32_t p = 0; p != func.num_params; p++)
+	{
+		// parameters past the sixth are already on the stack, above the return address
+		param_offsets.push_back(p < NUM_REG_ARGS ? (offset -= 8) : 16 + 8 * (int32_t) (p - NUM_REG_ARGS));
+	}
+	slots_base = offset;
+	arrays_base = offset - 8 * alloc.num_slots - 8 * (int32_t) func.frame_words;
+	frame_size = -arrays_base;
+	frame_size = (frame_size + 15) & ~15;
+
+	uses.assign(func.num_values, 0);
+	for (std::vector<ir_block>::size_type b = 0; b != func.blocks.size(); b++)
+	{
+		const std::vector<ir_inst> &insts = func.blocks[b].insts;
+		for (std::vector<ir_inst>::size_type i = 0; i != insts.size(); i++)
+		{
+			ir_value operands[2] = {insts[i].a, insts[i].b};
+			for (int j = 0; j != 2; j++)
+			{
+				if (operands[j] != IR_NO_VALUE)
+				{
+					uses[operands[j]]++;
+				}
+			}
+			for (uint32_t j = 0; j != insts[i].args_count; j++)
+			{
+				uses[func.args[insts[i].args_begin + j]]++;
+			}
+		}
+	}
+}
+
+void x86_64_emitter::byte(unsigned int b)
+{
+	code.push_back(b & 0xff);
+}
+
+void x86_64_emitter::imm32(int32_t v)
+{
+	for (int i = 0; i < 4; i++)
+	{
+		byte((uint32_t) v >> (8 * i));
+	}
+}
+
+void x86_64_emitter::imm64(int64_t v)
+{
+	for (int i = 0; i < 8; i++)
+	{
+		byte((uint64_t) v >> (8 * i));
+	}
+}
+
+/* REX.W prefix for an instruction with reg in ModRM.reg and rm in ModRM.rm */
+void x86_64_emitter::rex(int reg, int rm)
+{
+	byte(0x48 | ((reg >> 3) << 2) | (rm >> 3));
+}
+
+/* "op reg, rm" between two registers */
+void x86_64_emitter::op_reg(unsigned int opcode, int reg, int rm)
+{
+	rex(reg, rm);
+	for (; opcode; opcode >>= 8)
+	{
+		byte(opcode);
+	}
+	byte(0xc0 | ((reg & 7) << 3) | (rm & 7));
+}
+
+/* "op reg, [rbp + disp]" */
+void x86_64_emitter::op_frame(unsigned int opcode, int reg, int32_t disp)
+{
+	rex(reg, rbp);
+	for (; opcode; opcode >>= 8)
+	{
+		byte(opcode);
+	}
+	if (disp >= -128 && disp <= 127)
+	{
+		byte(0x40 | ((reg & 7) << 3) | rbp);
+		byte(disp);
+	}
+	else
+	{
+		byte(0x80 | ((reg & 7) << 3) | rbp);
+		imm32(disp);
+	}
+}
+
+/* "op reg, [rip + symbol]", leaving a PC-relative relocation */
+void x86_64_emitter::op_global(unsigned int opcode, int reg, uint32_t symbol)
+{
+	rex(reg, 0);
+	for (; opcode; opcode >>= 8)
+	{
+		byte(opcode);
+	}
+	byte(((reg & 7) << 3) | 5);
+
+	// the displacement is relative to the end of the instruction, 4 bytes further
+	elf_reloc reloc = {(uint32_t) code.size(), symbol, R_X86_64_PC32, -4};
+	obj.relocs.push_back(reloc);
+	imm32(0);
+}
+
+void x86_64_emitter::mov_imm(int reg, int64_t imm)
+{
+	if (imm == (int32_t) imm)
+	{
+		// sign-extended 32-bit immediate
+		rex(0, reg);
+		byte(0xc7);
+		byte(0xc0 | (reg & 7));
+		imm32(imm);
+	}
+	else
+	{
+		rex(0, reg);
+		byte(0xb8 + (reg & 7));
+		imm64(imm);
+	}
+}
+
+/* frame offset of a spill slot */
+int32_t x86_64_emitter::frame_offset(int slot) const
+{
+	return slots_base - 8 * (slot + 1);
+}
+
+/* frame offset of a spilled value */
+int32_t x86_64_emitter::slot_offset(ir_value v) const
+{
+	return frame_offset(alloc.locations[v].slot);
+}
+
+/* copies the value v to reg */
+void x86_64_emitter::load(int reg, ir_value v)
+{
+	const ls_location &loc = alloc.locations[v];
+	if (loc.reg < 0)
+	{
+		op_frame(OP_MOV_LOAD, reg, slot_offset(v));
+	}
+	else if (loc.reg != reg)
+	{
+		op_reg(OP_MOV_LOAD, reg, loc.reg);
+	}
+}
+
+/* copies reg to the location of v */
+void x86_64_emitter::store(ir_value v, int reg)
+{
+	const ls_location &loc = alloc.locations[v];
+	if (loc.reg < 0)
+	{
+		op_frame(OP_MOV_STORE, reg, slot_offset(v));
+	}
+	else if (loc.reg != reg)
+	{
+		op_reg(OP_MOV_LOAD, loc.reg, reg);
+	}
+}
+
+/* copies src to dst, through r11 if both are in memory */
+void x86_64_emitter::move(const ls_location &dst, const ls_location &src)
+{
+	if (src.reg >= 0 && dst.reg >= 0)
+	{
+		op_reg(OP_MOV_LOAD, dst.reg, src.reg);
+	}
+	else if (src.reg >= 0)
+	{
+		op_frame(OP_MOV_STORE, src.reg, frame_offset(dst.slot));
+	}
+	else if (dst.reg >= 0)
+	{
+		op_frame(OP_MOV_LOAD, dst.reg, frame_offset(src.slot));
+	}
+	else
+	{
+		op_frame(OP_MOV_LOAD, r11, frame_offset(src.slot));
+		op_frame(OP_MOV_STORE, r11, frame_offset(dst.slot));
+	}
+}
+
+static bool same_location(const ls_location &a, const ls_location &b)
+{
+	return a.reg == b.reg && (a.reg >= 0 || a.slot == b.slot);
+}
+
+/* copies every source to its destination as if all at once, in an order that reads each
+ * source before overwriting it. Cycles are broken through rax. */
+void x86_64_emitter::parallel_move(std::vector<ls_location> dsts, std::vector<ls_location> srcs)
+{
+	for (std::vector<ls_location>::size_type i = 0; i != dsts.size(); i++)
+	{
+		if (same_location(dsts[i], srcs[i]))
+		{
+			dsts.erase(dsts.begin() + i);
+			srcs.erase(srcs.begin() + i--);
+		}
+	}
+
+	while (!dsts.empty())
+	{
+		bool progress = false;
+		for (std::vector<ls_location>::size_type i = 0; i != dsts.size(); i++)
+		{
+			bool needed = false;
+			for (std::vector<ls_location>::size_type j = 0; j != srcs.size(); j++)
+			{
+				needed = needed || (j != i && same_location(srcs[j], dsts[i]));
+			}
+			if (needed)
+			{
+				continue;
+			}
+
+			move(dsts[i], srcs[i]);
+			dsts.erase(dsts.begin() + i);
+			srcs.erase(srcs.begin() + i);
+			progress = true;
+			break;
+		}
+
+		if (!progress)
+		{
+			// every destination is still needed as a source: break the cycle through rax
+			ls_location saved = {rax, -1};
+			ls_location blocked = dsts[0];
+			move(saved, blocked);
+			for (std::vector<ls_location>::size_type j = 0; j != srcs.size(); j++)
+			{
+				if (same_location(srcs[j], blocked))
+				{
+					srcs[j] = saved;
+				}
+			}
+		}
+	}
+}
+
+/* moves the first six operands of call to the argument registers */
+void x86_64_emitter::move_args(const ir_inst &call)
+{
+	std::vector<ls_location> dsts, srcs;
+
+	for (uint32_t i = 0; i != call.args_count && i < NUM_REG_ARGS; i++)
+	{
+		ls_location dst = {arg_regs[i], -1};
+		dsts.push_back(dst);
+		srcs.push_back(alloc.locations[func.args[call.args_begin + i]]);
+	}
+	parallel_move(dsts, srcs);
+}
+
+/* sets the phis of block target to their operands coming from block b */
+void x86_64_emitter::move_phis(uint32_t b, uint32_t target)
+{
+	const ir_block &block = func.blocks[target];
+	std::vector<ls_location> dsts, srcs;
+	std::vector<uint32_t>::size_type p = std::find(block.preds.begin(), block.preds.end(), b) - block.preds.begin();
+
+	for (std::vector<ir_inst>::size_type i = 0; i != block.insts.size() && block.insts[i].op == ir_phi; i++)
+	{
+		const ir_inst &phi = block.insts[i];
+		if (alloc.locations[phi.result].reg < 0 && alloc.locations[phi.result].slot < 0)
+		{
+			continue;
+		}
+		dsts.push_back(alloc.locations[phi.result]);
+		srcs.push_back(alloc.locations[func.args[phi.args_begin + p]]);
+	}
+	parallel_move(dsts, srcs);
+}
+
+void x86_64_emitter::emit_prologue()
+{
+	byte(0x55);						// push rbp
+	op_reg(OP_MOV_LOAD, rbp, rsp);	// mov rbp, rsp
+	if (frame_size)
+	{
+		rex(0, rsp);				// sub rsp, frame_size
+		byte(0x81);
+		byte(0xc0 | (5 << 3) | rsp);
+		imm32(frame_size);
+	}
+
+	for (std::vector<int>::size_type r = 0; r != alloc.used_callee_saved.size(); r++)
+	{
+		op_frame(OP_MOV_STORE, alloc.used_callee_saved[r], save_offsets[r]);
+	}
+	for (uint32_t p = 0; p != func.num_params && p < NUM_REG_ARGS; p++)
+	{
+		op_frame(OP_MOV_STORE, arg_regs[p], param_offsets[p]);
+	}
+
+	// the collector may read the slot of a reference before it is first written
+	std::vector<bool> zeroed(alloc.num_slots, false);
+	bool rax_zero = false;
+	for (std::vector<std::vector<int> >::size_type c = 0; c != alloc.call_refs.size(); c++)
+	{
+		for (std::vector<int>::size_type r = 0; r != alloc.call_refs[c].size(); r++)
+		{
+			int slot = alloc.call_refs[c][r];
+			if (zeroed[slot])
+			{
+				continue;
+			}
+			if (!rax_zero)
+			{
+				byte(0x31);			// xor eax, eax
+				byte(0xc0);
+				rax_zero = true;
+			}
+			op_frame(OP_MOV_STORE, rax, frame_offset(slot));
+			zeroed[slot] = true;
+		}
+	}
+}
+
+void x86_64_emitter::emit_epilogue()
+{
+	for (std::vector<int>::size_type r = 0; r != alloc.used_callee_saved.size(); r++)
+	{
+		op_frame(OP_MOV_LOAD, alloc.used_callee_saved[r], save_offsets[r]);
+	}
+	byte(0xc9);						// leave
+	byte(0xc3);						// ret
+}
+
+void x86_64_emitter::emit_call(const ir_inst &inst)
+{
+	uint32_t stack_args = inst.args_count > NUM_REG_ARGS ? inst.args_count - NUM_REG_ARGS : 0;
+	int32_t stack_size = 8 * stack_args;
+
+	// the stack must stay 16-byte aligned at the call
+	if (stack_args % 2)
+	{
+		stack_size += 8;
+		rex(0, rsp);				// sub rsp, 8
+		byte(0x83);
+		byte(0xc0 | (5 << 3) | rsp);
+		byte(8);
+	}
+	for (uint32_t i = inst.args_count; i-- > NUM_REG_ARGS;)
+	{
+		load(rax, func.args[inst.args_begin + i]);
+		byte(0x50);					// push rax
+	}
+
+	move_args(inst);
+
+	// al holds the number of vector registers used by variadic callees
+	byte(0x31);						// xor eax, eax
+	byte(0xc0);
+	byte(0xe8);						// call rel32
+	elf_reloc reloc = {(uint32_t) code.size(), (uint32_t) inst.imm, R_X86_64_PLT32, -4};
+	obj.relocs.push_back(reloc);
+	imm32(0);
+
+	// nop dword [rax + rax + disp32], the offset to the stack map of the call
+	code.insert(code.end(), STACK_MAP_NOP, STACK_MAP_NOP + STACK_MAP_NOP_SIZE);
+	maps.push_back(std::make_pair((uint32_t) code.size(), calls++));
+	imm32(0);
+
+	if (stack_size)
+	{
+		rex(0, rsp);				// add rsp, stack_size
+		byte(0x81);
+		byte(0xc0 | rsp);
+		imm32(stack_size);
+	}
+	if (inst.result != IR_NO_VALUE)
+	{
+		store(inst.result, rax);
+	}
+}
+
+/* calls the function of inst with the frame of the caller torn down, so that the callee
+ * returns directly to our caller. Only arguments passed in registers are supported. */
+void x86_64_emitter::emit_tail_call(const ir_inst &inst)
+{
+	calls++;
+	move_args(inst);
+	for (std::vector<int>::size_type r = 0; r != alloc.used_callee_saved.size(); r++)
+	{
+		op_frame(OP_MOV_LOAD, alloc.used_callee_saved[r], save_offsets[r]);
+	}
+	byte(0xc9);						// leave
+	byte(0x31);						// xor eax, eax
+	byte(0xc0);
+	byte(0xe9);						// jmp rel32
+	elf_reloc reloc = {(uint32_t) code.size(), (uint32_t) inst.imm, R_X86_64_PLT32, -4};
+	obj.relocs.push_back(reloc);
+	imm32(0);
+
+	if (report)
+	{
+		*report << "tail call: " << module.symbols[func.name] << " -> " << module.symbols[inst.imm]
+			<< " (jump)" << std::endl;
+	}
+}
+
+/* sets the phis of target and jumps to it from the end of block b */
+void x86_64_emitter::emit_jump(uint32_t b, uint32_t target)
+{
+	move_phis(b, target);
+	if (target == b + 1)
+	{
+		// falls through
+		return;
+	}
+	byte(0xe9);						// jmp rel32
+	jumps.push_back(std::make_pair((uint32_t) code.size(), target));
+	imm32(0);
+}
+
+/* returns 1 if the edge from a block to target must set phis */
+int x86_64_emitter::has_phis(uint32_t target) const
+{
+	const std::vector<ir_inst> &insts = func.blocks[target].insts;
+	return !insts.empty() && insts[0].op == ir_phi;
+}
+
+/* "jcc rel32" to block target, or to the code offset patched later if target is -1.
+ * returns the offset of the displacement. */
+uint32_t x86_64_emitter::jcc(int cc, int64_t target)
+{
+	byte(0x0f);
+	byte(0x80 | cc);
+	uint32_t patch = code.size();
+	if (target >= 0)
+	{
+		jumps.push_back(std::make_pair(patch, (uint32_t) target));
+	}
+	imm32(0);
+	return patch;
+}
+
+/* sets the displacement of the jump at patch to reach the end of the code */
+void x86_64_emitter::patch_here(uint32_t patch)
+{
+	int32_t rel = code.size() - (patch + 4);
+	for (int k = 0; k < 4; k++)
+	{
+		code[patch + k] = (uint32_t) rel >> (8 * k);
+	}
+}
+
+/* compares the operands of inst, and returns the condition under which it is true */
+int x86_64_emitter::emit_compare(const ir_inst &inst)
+{
+	load(rax, inst.a);
+	if (alloc.locations[inst.b].reg >= 0)
+	{
+		op_reg(OP_CMP, rax, alloc.locations[inst.b].reg);
+	}
+	else
+	{
+		op_frame(OP_CMP, rax, slot_offset(inst.b));
+	}
+	return condition_code(inst.op);
+}
+
+/* Ends block b with a jump to its first successor under the condition cc, and to its
+ * second otherwise. The edge to the next block comes last, so that it falls through.
+ * An edge that sets phis does so in code of its own, which the other edge jumps over.
+ */
+void x86_64_emitter::emit_branch(uint32_t b, int cc)
+{
+	uint32_t first = func.blocks[b].succs[0];
+	uint32_t last = func.blocks[b].succs[1];
+
+	// cc stays the condition to take the first edge
+	if (first == b + 1)
+	{
+		std::swap(first, last);
+		cc ^= 1;
+	}
+
+	if (!has_phis(first))
+	{
+		jcc(cc, first);
+		emit_jump(b, last);
+		return;
+	}
+	uint32_t skip = jcc(cc ^ 1, -1);
+	emit_jump(b, first);
+	patch_here(skip);
+	emit_jump(b, last);
+}
+
+/* jumps through a table of 32-bit offsets from its own address, indexed by the operand
+ * less the value of the first entry. Values outside of the table, below it included as
+ * the comparison is unsigned, go to the first successor. */
+void x86_64_emitter::emit_switch(uint32_t b, const ir_inst &inst)
+{
+	const std::vector<uint32_t> &succs = func.blocks[b].succs;
+	x86_64_table table;
+
+	load(rax, inst.a);
+	if (inst.imm == (int32_t) inst.imm)
+	{
+		rex(0, rax);				// sub rax, imm
+		byte(0x81);
+		byte(0xc0 | (5 << 3) | rax);
+		imm32(inst.imm);
+	}
+	else
+	{
+		mov_imm(r11, inst.imm);
+		op_reg(OP_SUB, rax, r11);
+	}
+	rex(0, rax);					// cmp rax, entries - 1
+	byte(0x81);
+	byte(0xc0 | (7 << 3) | rax);
+	imm32(succs.size() - 2);
+	if (has_phis(succs[0]))
+	{
+		uint32_t skip = jcc(0x6, -1);	// jbe
+		emit_jump(b, succs[0]);
+		patch_here(skip);
+	}
+	else
+	{
+		jcc(0x7, succs[0]);			// ja
+	}
+
+	byte(0x4c);						// lea r11, [rip + table]
+	byte(0x8d);
+	byte(0x1d);
+	table.lea = code.size();
+	imm32(0);
+	byte(0x49);						// movsxd rax, dword [r11 + rax * 4]
+	byte(0x63);
+	byte(0x04);
+	byte(0x83);
+	op_reg(0x01, r11, rax);			// add rax, r11
+	byte(0xff);						// jmp rax
+	byte(0xe0);
+
+	// entries reaching blocks with phis jump to code setting them, shared by equal entries
+	std::vector<std::pair<uint32_t, uint32_t> > moves;
+	for (std::vector<uint32_t>::size_type s = 1; s != succs.size(); s++)
+	{
+		if (!has_phis(succs[s]))
+		{
+			table.targets.push_back(succs[s]);
+			table.is_block.push_back(true);
+			continue;
+		}
+
+		std::vector<std::pair<uint32_t, uint32_t> >::size_type m = 0;
+		while (m != moves.size() && moves[m].first != succs[s])
+		{
+			m++;
+		}
+		if (m == moves.size())
+		{
+			moves.push_back(std::make_pair(succs[s], (uint32_t) code.size()));
+			move_phis(b, succs[s]);
+			byte(0xe9);				// jmp rel32
+			jumps.push_back(std::make_pair((uint32_t) code.size(), succs[s]));
+			imm32(0);
+		}
+		table.targets.push_back(moves[m].second);
+		table.is_block.push_back(false);
+	}
+	tables.push_back(table);
+}
+
+/* emits the jump tables after the code of the function, aligned to 4 bytes */
+void x86_64_emitter::emit_tables()
+{
+	for (std::vector<x86_64_table>::size_type t = 0; t != tables.size(); t++)
+	{
+		while (code.size() % 4)
+		{
+			byte(0xcc);
+		}
+		uint32_t start = code.size();
+		patch_here(tables[t].lea);
+		for (std::vector<uint32_t>::size_type e = 0; e != tables[t].targets.size(); e++)
+		{
+			uint32_t target = tables[t].targets[e];
+			imm32((tables[t].is_block[e] ? block_offsets[target] : target) - start);
+		}
+	}
+}
+
+/* "rep stosq" would need rdi and rcx, which may hold values: a loop through r11 and rdx,
+ * which are never allocated, stores rax instead */
+void x86_64_emitter::emit_zero(const ir_inst &inst)
+{
+	load(r11, inst.a);
+	mov_imm(rdx, inst.imm);
+	byte(0x31);						// xor eax, eax
+	byte(0xc0);
+	uint32_t loop = code.size();
+	op_reg(OP_MOV_STORE, rax, r11);	// mov [r11], rax
+	code[code.size() - 1] &= 0x3f;
+	rex(0, r11);					// add r11, 8
+	byte(0x83);
+	byte(0xc0 | (r11 & 7));
+	byte(8);
+	rex(0, rdx);					// dec rdx
+	byte(0xff);
+	byte(0xc8 | rdx);
+	byte(0x75);						// jnz loop
+	byte(loop - (code.size() + 1));
+}
+
+/* the comparison is unsigned, so negative indices are out of range too. The jump to the
+ * trap is forward and not taken, which is how branches are predicted without history. */
+void x86_64_emitter::emit_check(const ir_inst &inst)
+{
+	emit_compare(inst);
+	traps.push_back(jcc(0x3, -1));	// jae
+}
+
+/* an index out of range stops the program with an invalid instruction */
+void x86_64_emitter::emit_traps()
+{
+	if (traps.empty())
+	{
+		return;
+	}
+	for (std::vector<uint32_t>::size_type t = 0; t != traps.size(); t++)
+	{
+		patch_here(traps[t]);
+	}
+	byte(0x0f);						// ud2
+	byte(0x0b);
+}
+
+/* emits the stack maps after the code of the function, aligned to 4 bytes, and sets the
+ * nop after each call to point to its own. Calls with the same references share a map. */
+void x86_64_emitter::emit_stack_maps()
+{
+	std::map<std::vector<int32_t>, uint32_t> emitted;
+
+	for (std::vector<std::pair<uint32_t, uint32_t> >::size_type m = 0; m != maps.size(); m++)
+	{
+		const std::vector<int> &slots = alloc.call_refs[maps[m].second];
+		std::vector<int32_t> offsets;
+		for (std::vector<int>::size_type r = 0; r != slots.size(); r++)
+		{
+			offsets.push_back(frame_offset(slots[r]));
+		}
+		std::sort(offsets.begin(), offsets.end());
+
+		std::map<std::vector<int32_t>, uint32_t>::iterator it = emitted.find(offsets);
+		if (it == emitted.end())
+		{
+			while (code.size() % 4)
+			{
+				byte(0xcc);
+			}
+			it = emitted.insert(std::make_pair(offsets, (uint32_t) code.size())).first;
+			imm32(STACK_MAP_MAGIC);
+			imm32(offsets.size());
+			for (std::vector<int32_t>::size_type o = 0; o != offsets.size(); o++)
+			{
+				imm32(offsets[o]);
+			}
+		}
+
+		// relative to the return address, the start of the nop
+		int32_t disp = it->second - (maps[m].first - STACK_MAP_NOP_SIZE);
+		for (int k = 0; k < 4; k++)
+		{
+			code[maps[m].first + k] = (uint32_t) disp >> (8 * k);
+		}
+	}
+}
+
+void x86_64_emitter::emit_inst(uint32_t b, const ir_inst &inst)
+{
+	switch (inst.op)
+	{
+		case ir_const:
+			if (alloc.locations[inst.result].reg >= 0)
+			{
+				mov_imm(alloc.locations[inst.result].reg, inst.imm);
+			}
+			else
+			{
+				mov_imm(rax, inst.imm);
+				store(inst.result, rax);
+			}
+			break;
+		case ir_param:
+			op_frame(OP_MOV_LOAD, rax, param_offsets[inst.imm]);
+			store(inst.result, rax);
+			break;
+		case ir_copy:
+			load(rax, inst.a);
+			store(inst.result, rax);
+			break;
+		case ir_add:
+		case ir_sub:
+		case ir_mul:
+		{
+			unsigned int opcode = inst.op == ir_add ? OP_ADD : inst.op == ir_sub ? OP_SUB : OP_IMUL;
+			load(rax, inst.a);
+			if (alloc.locations[inst.b].reg >= 0)
+			{
+				op_reg(opcode, rax, alloc.locations[inst.b].reg);
+			}
+			else
+			{
+				op_frame(opcode, rax, slot_offset(inst.b));
+			}
+			store(inst.result, rax);
+			break;
+		}
+		case ir_div:
+			load(rax, inst.a);
+			byte(0x48);					// cqo
+			byte(0x99);
+			if (alloc.locations[inst.b].reg >= 0)
+			{
+				op_reg(0xf7, 7, alloc.locations[inst.b].reg);	// idiv r
+			}
+			else
+			{
+				op_frame(0xf7, 7, slot_offset(inst.b));		// idiv [rbp + disp]
+			}
+			store(inst.result, rax);
+			break;
+		case ir_load:
+			op_global(OP_MOV_LOAD, rax, inst.imm);
+			store(inst.result, rax);
+			break;
+		case ir_store:
+			load(rax, inst.a);
+			op_global(OP_MOV_STORE, rax, inst.imm);
+			break;
+		case ir_frame_addr:
+			op_frame(OP_LEA, rax, arrays_base + 8 * (int32_t) inst.imm);
+			store(inst.result, rax);
+			break;
+		case ir_global_addr:
+			op_global(OP_LEA, rax, inst.imm);
+			store(inst.result, rax);
+			break;
+		case ir_read:
+			load(rax, inst.a);
+			op_reg(OP_MOV_LOAD, rax, rax);	// mov rax, [rax]
+			code[code.size() - 1] &= 0x3f;
+			store(inst.result, rax);
+			break;
+		case ir_write:
+			load(rax, inst.a);
+			load(r11, inst.b);
+			op_reg(OP_MOV_STORE, r11, rax);	// mov [rax], r11
+			code[code.size() - 1] &= 0x3f;
+			break;
+		case ir_zero:
+			emit_zero(inst);
+			break;
+		case ir_check:
+			emit_check(inst);
+			break;
+		case ir_call:
+			emit_call(inst);
+			break;
+		case ir_ret:
+			if (inst.a != IR_NO_VALUE)
+			{
+				load(rax, inst.a);
+			}
+			emit_epilogue();
+			break;
+		case ir_eq:
+		case ir_ne:
+		case ir_lt:
+		case ir_le:
+		case ir_gt:
+		case ir_ge:
+		{
+			int cc = emit_compare(inst);
+			byte(0x0f);					// setcc al
+			byte(0x90 | cc);
+			byte(0xc0);
+			byte(0x0f);					// movzx eax, al
+			byte(0xb6);
+			byte(0xc0);
+			store(inst.result, rax);
+			break;
+		}
+		case ir_jump:
+			emit_jump(b, inst.imm);
+			break;
+		case ir_branch:
+			load(rax, inst.a);
+			op_reg(0x85, rax, rax);		// test rax, rax
+			emit_branch(b, CC_NE);
+			break;
+		case ir_switch:
+			emit_switch(b, inst);
+			break;
+		default:
+			break;
+	}
+}
+
+void x86_64_emitter::emit_function()
+{
+	elf_function sym;
+
+	// functions start on 16-byte boundaries, padded with int3
+	while (code.size() % 16)
+	{
+		byte(0xcc);
+	}
+
+	sym.symbol = func.name;
+	sym.offset = code.size();
+
+	emit_prologue();
+	for (std::vector<ir_block>::size_type b = 0; b != func.blocks.size(); b++)
+	{
+		const std::vector<ir_inst> &insts = func.blocks[b].insts;
+		block_offsets.push_back(code.size());
+		for (std::vector<ir_inst>::size_type i = 0; i != insts.size(); i++)
+		{
+			// the arguments of a function with arrays may point into its frame
+			if (i + 2 == insts.size() && ir_is_tail_call(insts[i], insts[i + 1]) && insts[i].args_count <= NUM_REG_ARGS
+				&& !func.frame_words)
+			{
+				emit_tail_call(insts[i]);
+				break;
+			}
+
+			// a comparison only used by the branch after it sets the flags the branch tests
+			if (i + 2 == insts.size() && insts[i + 1].op == ir_branch && insts[i + 1].a == insts[i].result
+				&& condition_code(insts[i].op) >= 0 && uses[insts[i].result] == 1)
+			{
+				emit_branch(b, emit_compare(insts[i]));
+				break;
+			}
+			emit_inst(b, insts[i]);
+		}
+	}
+	emit_traps();
+	emit_tables();
+	emit_stack_maps();
+
+	// jumps are relative to the end of their 4-byte displacement
+	for (std::vector<std::pair<uint32_t, uint32_t> >::size_type j = 0; j != jumps.size(); j++)
+	{
+		int32_t rel = block_offsets[jumps[j].second] - (jumps[j].first + 4);
+		for (int k = 0; k < 4; k++)
+		{
+			code[jumps[j].first + k] = (uint32_t) rel >> (8 * k);
+		}
+	}
+
+	sym.size = code.size() - sym.offset;
+	obj.functions.push_back(sym);
+}
+
+/* Translates every function of module to x86-64 machine code following the System V ABI,
+ * in a single pass over each function after linear scan register allocation.
+ * Calls and accesses to globals are left to the linker as relocations, and calls whose
+ * result is returned right away become jumps, which are listed to report if it is not NULL.
+ * Every other call is followed by the stack map of the garbage collector, see
+ * runtime/stack_map.hpp.
+ */
+void x86_64_codegen(const ir_module &module, elf_object &obj, std::ostream *report)
+{
+	for (std::vector<ir_function>::size_type f = 0; f != module.functions.size(); f++)
+	{
+		x86_64_emitter emitter(module, module.functions[f], obj, report);
+		emitter.emit_function();
+	}
+	obj.variables = module.globals;
+	obj.variable_words = module.global_words;
+	obj.roots = module.roots;
+}
@@ -0,0 +1,18 @@
+#ifndef X86_64_HPP
+#define X86_64_HPP
+
+#include <ostream>
+
+#include "elf_object.hpp"
+#include "ir.hpp"
+
+/* Translates every function of module to x86-64 machine code following the System V ABI,
+ * in a single pass over each function after linear scan register allocation.
+ * Calls and accesses to globals are left to the linker as relocations, and calls whose
+ * result is returned right away become jumps, which are listed to report if it is not NULL.
+ * Every other call is followed by the stack map of the garbage collector, see
+ * runtime/stack_map.hpp.
+ */
+void x86_64_codegen(const ir_module &module, elf_object &obj, std::ostream *report);
+
+#endif